@@ -9,6 +9,7 @@
 #define PIN_CLICK_IN      32   // Gray
 #define PIN_CLICK_DEBUG   19   // Legacy debug LED (mirrored click input)
 #define PIN_STATUS_LED    PIN_CLICK_DEBUG  // Shared status LED output
+#define PIN_RAIL_SENSE    34   // Optional: divided 5 V rail (ADC1) for power-fail detection
 
 #ifndef RELAYS_ACTIVE_LOW
 #define RELAYS_ACTIVE_LOW 1
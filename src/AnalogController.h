@@ -22,6 +22,7 @@ public:
     else if ((millis()-_tChange) > _debounceMs) { _stable=r; }
   }
   bool pressed() const { return _stable; }
+  unsigned long changedAt() const { return _tChange; }  // millis() of the last raw edge
 private:
   uint8_t _pin=0; bool _activeLow=true; bool _stable=false, _lastRead=false;
   uint16_t _debounceMs=60; unsigned long _tChange=0;
@@ -70,6 +71,14 @@ public:
   MotionState state() const { return _state; }     // button-derived state (OPENING/CLOSING/IDLE)
   MotionState mapped() const { return _mapped; }   // same for now; reserved for future include HA/touch, etc.
 
+  // millis() of the newest raw contact edge on either input; a new state()
+  // is accepted one debounce interval after it.
+  unsigned long lastEdgeMs() const {
+    unsigned long up = _btnUp.changedAt();
+    unsigned long dn = _btnDown.changedAt();
+    return (long)(up - dn) > 0 ? up : dn;
+  }
+
 private:
   StatusStore &_store;
   const char* _label;
@@ -1,14 +1,35 @@
 #include "ClickCounter.h"
 #include "StatusLed.h"
+#include "Crc32.h"
 
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <climits>
-#include <driver/gpio.h>
-#include <esp_intr_alloc.h>
 #include <esp_err.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+
+namespace {
+  RTC_NOINIT_ATTR ClickCounter::RtcBlock s_rtcPos;
+
+  bool isWarmReset(esp_reset_reason_t reason) {
+    switch (reason) {
+      case ESP_RST_SW:
+      case ESP_RST_PANIC:
+      case ESP_RST_INT_WDT:
+      case ESP_RST_TASK_WDT:
+      case ESP_RST_WDT:
+        return true;
+      default:
+        return false;
+    }
+  }
 
-bool ClickCounter::s_isrServiceInstalled = false;
+  uint32_t rtcBlockCrc(const ClickCounter::RtcBlock& b) {
+    return crc32Ieee(&b, offsetof(ClickCounter::RtcBlock, crc32));
+  }
+}
 
 void ClickCounter::begin(uint8_t pinClick, bool simulate) {
   _pin = pinClick;
@@ -21,16 +42,18 @@ void ClickCounter::begin(uint8_t pinClick, bool simulate) {
   _lastPersistPos = 0;
   _lastPersistMs = millis();
   _lastPersistLevelLow = false;
+  _pendingClicks = 0;
+  _pendingSinceMs = 0;
+  _persistStats = PersistStats();
   _sensorExpectedLow = false;
   _sensorLiveLow = false;
   _sensorPersisted = false;
-  _simSensorLow = false;
   _overshootLogged = false;
   _lastActiveDirection = MotionState::IDLE;
   _tailHoldUntil = 0;
-  _edgePhase = 0;
-  _edgeCountIsr = 0;
-  _lastIsrUs = 0;
+  _edgesProcessed = 0;
+  _lastEdgeUs = 0;
+  _lastClickUs = 0;
 
   if (!_statusLed) {
     pinMode(PIN_CLICK_DEBUG, OUTPUT);
@@ -38,7 +61,38 @@ void ClickCounter::begin(uint8_t pinClick, bool simulate) {
   }
 
   _prefsOpen = _prefs.begin(NAMESPACE, false);
-  if (_prefsOpen) {
+  if (_prefsOpen && _prefs.isKey(KEY_BACKEND)) {
+    _backend = static_cast<Backend>(_prefs.getUChar(KEY_BACKEND, CLICK_COUNTER_BACKEND));
+  }
+  _coast.reset();
+  if (_prefsOpen && _prefs.getBytesLength(KEY_COAST) == sizeof(CoastModel::Blob)) {
+    CoastModel::Blob blob;
+    _prefs.getBytes(KEY_COAST, &blob, sizeof(blob));
+    _coast.load(blob);
+  }
+  _coastActive = false;
+
+  _gateUs = ISR_GATE_US;
+  _gateLearned = false;
+  if (_prefsOpen && _prefs.isKey(KEY_GATE)) {
+    uint32_t stored = _prefs.getUInt(KEY_GATE, ISR_GATE_US);
+    if (stored >= GateLearner::GATE_MIN_US && stored <= GateLearner::GATE_MAX_US) {
+      _gateUs = stored;
+      _gateLearned = true;
+    }
+  }
+  _posFlashOpen = _posFlash.open(CLICK_COUNTER_POS_LOG_PARTITION);
+  _posLogTried = false;
+  _restoredFromRtc = isWarmReset(esp_reset_reason()) && restoreFromRtc();
+  if (!_restoredFromRtc) ensurePosLog();
+
+  if (_restoredFromRtc) {
+    // Flash is only touched (log scan) on the first write after a warm boot.
+    bool unpersisted = rtc().unpersisted != 0;
+    _lastPersistPos = _pos;
+    _lastPersistLevelLow = _sensorExpectedLow;
+    if (unpersisted) persistPos(true);
+  } else if (_prefsOpen || _posLog.ready()) {
     loadFromNvs();
     _lastPersistPos = _pos;
     _lastPersistLevelLow = _sensorExpectedLow;
@@ -58,13 +112,12 @@ void ClickCounter::begin(uint8_t pinClick, bool simulate) {
   _calibOpenRaw = 0;
   _calibClosedRaw = 0;
 
+  _simSource.setLevel(_sensorExpectedLow);
+  selectSource();
   if (_simulate) {
-    _lastSimTickMs = millis();
     _sensorLiveLow = _sensorExpectedLow;
-    _simSensorLow = _sensorExpectedLow;
     mirrorSensorLevel();
   } else {
-    attachHardwareIsr();
     refreshLiveLevel();
     if (!_sensorPersisted) {
       _sensorExpectedLow = _sensorLiveLow;
@@ -73,12 +126,27 @@ void ClickCounter::begin(uint8_t pinClick, bool simulate) {
     }
     mirrorSensorLevel();
   }
+  _decoder.reset(_sensorLiveLow);
+
+  mirrorToRtc();
+}
+
+void ClickCounter::setRtcBlock(RtcBlock* block) {
+  _rtc = block;
+}
+
+ClickCounter::RtcBlock& ClickCounter::rtc() {
+  return _rtc ? *_rtc : s_rtcPos;
 }
 
 void ClickCounter::setLogger(LogFn logger) {
   _log = logger;
 }
 
+void ClickCounter::setEventLogger(LogEventFn fn) {
+  _event = fn;
+}
+
 void ClickCounter::setStatusLed(StatusLed* led) {
   _statusLed = led;
   if (_statusLed) {
@@ -87,37 +155,44 @@ void ClickCounter::setStatusLed(StatusLed* led) {
 }
 
 void ClickCounter::setMotion(MotionState s) {
+  if (s != MotionState::IDLE && s != _motion) {
+    _speed[dirIndex(s)].restart();
+  }
   if (_motion == MotionState::IDLE && s != MotionState::IDLE) {
+    if (_coastActive) finishCoast();
     prepareForMotion();
     _lastActiveDirection = s;
     _tailHoldUntil = 0;
+    _runStartPos = _pos;
   } else if (_motion != MotionState::IDLE && s == MotionState::IDLE) {
-    _tailHoldUntil = millis() + TAIL_HOLD_MS;
+    startCoast(_motion);
   }
   if (s != MotionState::IDLE) {
     _lastActiveDirection = s;
   }
   _motion = s;
+  _simSource.setRunning(s != MotionState::IDLE);
+}
+
+void ClickCounter::setPersistBudget(uint16_t clicks, uint32_t intervalMs) {
+  _persistClickBudget = clicks;
+  _persistIntervalMs = intervalMs;
 }
 
 void ClickCounter::setSimulation(bool simulate) {
   if (_simulate == simulate) return;
 
-  if (!_simulate) {
-    detachHardwareIsr();
-  }
-
   _simulate = simulate;
 
   if (_simulate) {
-    _lastSimTickMs = millis();
     _sensorLiveLow = _sensorExpectedLow;
-    _simSensorLow = _sensorExpectedLow;
+    _simSource.setLevel(_sensorExpectedLow);
+    selectSource();
     _lastActiveDirection = MotionState::IDLE;
     _tailHoldUntil = 0;
     mirrorSensorLevel();
   } else {
-    attachHardwareIsr();
+    selectSource();
     refreshLiveLevel();
     if (!_sensorPersisted) {
       _sensorExpectedLow = _sensorLiveLow;
@@ -128,14 +203,56 @@ void ClickCounter::setSimulation(bool simulate) {
     mirrorSensorLevel();
   }
 
-  _edgePhase = 0;
+  _decoder.reset(_sensorLiveLow);
+}
+
+bool ClickCounter::setHardwareBackend(Backend backend) {
+  if (backend == _backend) return true;
+  Backend previous = _backend;
+  _backend = backend;
+  if (!_simulate) {
+    selectSource();
+    if (_backend != backend) {
+      _backend = previous;
+      return false;
+    }
+    refreshLiveLevel();
+    clearPendingEdges();
+  }
+  if (_prefsOpen) _prefs.putUChar(KEY_BACKEND, static_cast<uint8_t>(_backend));
+  return true;
+}
+
+ClickCounter::Backend ClickCounter::hardwareBackend() const {
+  return _backend;
+}
+
+const char* ClickCounter::sourceName() const {
+  return _source ? _source->name() : "none";
+}
+
+void ClickCounter::selectSource() {
+  ClickSource* next = &_simSource;
+  if (!_simulate) {
+    next = (_backend == Backend::PCNT) ? static_cast<ClickSource*>(&_pcntSource)
+                                       : static_cast<ClickSource*>(&_isrSource);
+  }
+  if (next == _source) return;
+  if (_source) _source->stop();
+
+  if (!next->start(_pin) && next == &_pcntSource) {
+    // PCNT unavailable: stay functional on the interrupt path.
+    _backend = Backend::ISR;
+    next = &_isrSource;
+    next->start(_pin);
+  }
+  _source = next;
 }
 
 void ClickCounter::update(bool allowBeyondLimits) {
-  if (_simulate) {
-    simulateTicks();
-  } else {
-    drainHardwareEdges();
+  drainSource();
+  if (_simulate && _motion == MotionState::IDLE) {
+    refreshLiveLevel();
   }
 
   bool moving = (_motion != MotionState::IDLE);
@@ -144,14 +261,7 @@ void ClickCounter::update(bool allowBeyondLimits) {
   if (!allowBeyondLimits) {
     bool overshoot = (_pos < 0) || (_pos > _end);
     if (overshoot && !_overshootLogged) {
-      String msg;
-      msg.reserve(80);
-      msg += F("[CLICK] Motion overshoot detected (pos=");
-      msg += _pos;
-      msg += F(", end=");
-      msg += _end;
-      msg += F(")");
-      logMessage(msg);
+      logEvent(LogRecord(LogId::CLICK_OVERSHOOT, { _pos, _end }));
       _overshootLogged = true;
     } else if (!overshoot && _overshootLogged) {
       _overshootLogged = false;
@@ -170,8 +280,18 @@ void ClickCounter::update(bool allowBeyondLimits) {
 
   if (!moving && wasMoving) {
     persistPos(true);
+    learnGate();
+  } else if (_coastActive && !moving &&
+             (long)(millis() - _tailHoldUntil) > 0) {
+    finishCoast();
+  } else if (_pendingClicks) {
+    // Time budget also expires between clicks (slow or stalled motor).
+    persistPos(false);
+  } else if (!moving && !_coastActive && _posLog.ready()) {
+    _posLog.prepareNext();
   }
 
+  mirrorToRtc();
   _lastMotion = _motion;
 }
 
@@ -250,11 +370,24 @@ void ClickCounter::clearPanic() {
 }
 
 bool ClickCounter::canOpen() const {
-  return _pos > 0;
+  // While driving, stop early by the learned coast so the cover lands on 0.
+  int32_t lead = (_motion == MotionState::OPENING) ? runLead(MotionState::OPENING) : 0;
+  return _pos - lead > 0;
 }
 
 bool ClickCounter::canClose() const {
-  return _pos < _end;
+  int32_t lead = (_motion == MotionState::CLOSING) ? runLead(MotionState::CLOSING) : 0;
+  return _pos + lead < _end;
+}
+
+int32_t ClickCounter::runLead(MotionState dir) const {
+  // A run that started within the lead of the limit never gets up to
+  // cruising coast; capping at the clicks travelled so far lets it cover
+  // the last few clicks instead of stopping before the first one.
+  int32_t lead = _coast.lead(dirIndex(dir));
+  int32_t travel = _pos - _runStartPos;
+  if (travel < 0) travel = -travel;
+  return lead < travel ? lead : travel;
 }
 
 bool ClickCounter::panic() const {
@@ -269,85 +402,328 @@ int32_t ClickCounter::end() const {
   return _end;
 }
 
+int32_t ClickCounter::percent() const {
+  int32_t end = _end < 1 ? 1 : _end;
+  int32_t pct = (_pos <= 0) ? 0 : (int32_t)((static_cast<int64_t>(_pos) * 100) / end);
+  return pct > 100 ? 100 : pct;
+}
+
+uint32_t ClickCounter::clickIntervalUs(MotionState dir) const {
+  if (dir == MotionState::IDLE) return 0;
+  return _speed[dirIndex(dir)].intervalUs();
+}
+
+uint32_t ClickCounter::clickIntervalDevUs(MotionState dir) const {
+  if (dir == MotionState::IDLE) return 0;
+  return _speed[dirIndex(dir)].deviationUs();
+}
+
+float ClickCounter::speedCps(MotionState dir) const {
+  if (dir == MotionState::IDLE) return 0.0f;
+  return _speed[dirIndex(dir)].clicksPerSecond();
+}
+
+float ClickCounter::stopLeadClicks(MotionState dir, uint32_t latencyMs) const {
+  if (dir == MotionState::IDLE) return 0.0f;
+  const uint8_t idx = dirIndex(dir);
+  float lead = (_coast.runs(idx) >= CoastModel::MIN_RUNS) ? _coast.clicks(idx) : 0.0f;
+  return lead + speedCps(dir) * static_cast<float>(latencyMs) / 1000.0f;
+}
+
+uint32_t ClickCounter::etaMs() const {
+  uint32_t interval = clickIntervalUs(_motion);
+  if (!interval) return 0;
+  int32_t remaining = (_motion == MotionState::CLOSING) ? _end - _pos : _pos;
+  if (remaining <= 0) return 0;
+  return (uint32_t)((static_cast<uint64_t>(remaining) * interval) / 1000ULL);
+}
+
 void ClickCounter::forcePersist() {
   persistPos(true);
 }
 
-void ClickCounter::simulateTicks() {
-  const unsigned long now = millis();
-  const unsigned long period = 200;  // 5 Hz simulated click stream
+uint32_t ClickCounter::emergencyFlush() {
+  // Relays are already off; pick up edges still queued by the ISR (they are
+  // attributed through the tail hold) and commit whatever is in RAM. The
+  // hold-up time has no room for a sector erase; persistPos() keeps one
+  // prepared.
+  uint32_t started = micros();
+  _flushing = true;
+  drainSource();
+  persistPos(true);
+  _flushing = false;
+  _lastEmergencyFlushUs = micros() - started;
+  return _lastEmergencyFlushUs;
+}
 
-  if (_motion == MotionState::IDLE) {
-    _lastSimTickMs = now;
-    _sensorLiveLow = _simSensorLow;
-    mirrorSensorLevel();
-    return;
-  }
+ClickCounter::EdgeStats ClickCounter::edgeStats() const {
+  EdgeStats st;
+  st.edges = _edgesProcessed;
+  st.overflows = _source ? _source->overflows() : 0;
+  st.highWater = _source ? _source->highWater() : 0;
+  st.lastEdgeUs = _lastEdgeUs;
+  st.lastClickUs = _lastClickUs;
+  st.duplicates = _decoder.stats().duplicates;
+  st.resyncs = _decoder.stats().resyncs;
+  st.stray = _strayClicks;
+  return st;
+}
 
-  if (now < _lastSimTickMs) {
-    _lastSimTickMs = now;
-  }
+ClickCounter::GateInfo ClickCounter::gateInfo() const {
+  GateInfo info;
+  info.gateUs = _gateUs;
+  info.learned = _gateLearned;
+  info.confidence = _gateConfidence;
+  info.gatedEdges = _edgesGated;
+  info.rateDrops = _rateDrops;
+  info.seq = _gateSeq;
+  return info;
+}
 
-  uint32_t pendingEdges = 0;
-  while ((unsigned long)(now - _lastSimTickMs) >= period) {
-    _lastSimTickMs += period;
-    pendingEdges += 2;  // one high + one low per click
-  }
+const GateLearner& ClickCounter::gateHistogram() const {
+  return _gateLearner;
+}
 
-  if (pendingEdges) {
-    processEdgeBatch(pendingEdges);
-  }
+const ClickCounter::RunStats& ClickCounter::lastRun() const {
+  return _lastRun;
 }
 
-void ClickCounter::drainHardwareEdges() {
-  uint32_t edges = 0;
-  noInterrupts();
-  edges = _edgeCountIsr;
-  _edgeCountIsr = 0;
-  interrupts();
+const CoastModel& ClickCounter::coastModel() const {
+  return _coast;
+}
 
-  if (!edges) {
-    return;
-  }
+uint32_t ClickCounter::lastEmergencyFlushUs() const {
+  return _lastEmergencyFlushUs;
+}
 
-  processEdgeBatch(edges);
+const ClickCounter::PersistStats& ClickCounter::persistStats() const {
+  return _persistStats;
 }
 
-void ClickCounter::processEdgeBatch(uint32_t edges) {
-  if (!edges) return;
+bool ClickCounter::restoredFromRtc() const {
+  return _restoredFromRtc;
+}
 
-  bool anyTailHoldUsed = false;
+bool ClickCounter::posLogActive() const {
+  return _posLog.ready();
+}
 
-  for (uint32_t i = 0; i < edges; ++i) {
-    _edgePhase ^= 1;
-    _sensorLiveLow = !_sensorLiveLow;
-    mirrorSensorLevel();
+const PosLog::Stats& ClickCounter::posLogStats() const {
+  return _posLog.stats();
+}
+
+void ClickCounter::drainSource() {
+  if (!_source) return;
+  EdgeSample batch[EDGE_BATCH];
+  size_t n;
+  while ((n = _source->drain(batch, EDGE_BATCH)) > 0) {
+    processEdgeBatch(batch, n);
+  }
+}
+
+void ClickCounter::processEdgeBatch(const EdgeSample* edges, size_t count) {
+  if (!count) return;
 
-    if (_edgePhase == 0) {
+  bool anyTailHoldUsed = false;
+  const bool timed = _source && _source->timestamped();
+  uint16_t drivenClicks = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!gateEdge(edges[i])) continue;
+    ++_edgesProcessed;
+    _lastEdgeUs = edges[i].us;
+    uint8_t clicks = _decoder.feed(edges[i], timed);
+    if (_decoder.low() != _sensorLiveLow) {
+      _sensorLiveLow = _decoder.low();
+      mirrorSensorLevel();
+    }
+    if (clicks && !timed && !plausibleClick(edges[i].us)) clicks = 0;
+
+    if (clicks) {
       bool usedTailHold = false;
       MotionState dir = computeEffectiveDirection(&usedTailHold);
 
       if (dir == MotionState::CLOSING) {
         _pos += 1;
-        persistPos(false);
+        _lastClickUs = edges[i].us;
+        notePendingClick();
       } else if (dir == MotionState::OPENING) {
         _pos -= 1;
-        persistPos(false);
+        _lastClickUs = edges[i].us;
+        notePendingClick();
       }
+      if (dir != MotionState::IDLE && dir == _motion) ++drivenClicks;
+      if (dir == MotionState::IDLE) ++_strayClicks;
 
       if (usedTailHold) anyTailHoldUsed = true;
     }
   }
 
+  // Coasting after the relays drop isn't cruising speed; only driven clicks count.
+  if (drivenClicks) {
+    _speed[dirIndex(_motion)].addClicks(_lastClickUs, drivenClicks);
+  }
+
   _sensorExpectedLow = _sensorLiveLow;
   _sensorPersisted = true;
 
   if (_simulate) {
-    _simSensorLow = _sensorLiveLow;
+    _simSource.setLevel(_sensorLiveLow);
   }
 
   if (_motion == MotionState::IDLE && anyTailHoldUsed) {
-    _tailHoldUntil = millis() + TAIL_HOLD_MS;
+    // Keep the window open a little past each coast click.
+    unsigned long now = millis();
+    _coastLastClickMs = now;
+    if ((long)(now + CoastModel::MIN_HOLD_MS - _tailHoldUntil) > 0) {
+      _tailHoldUntil = now + CoastModel::MIN_HOLD_MS;
+    }
+  }
+
+  mirrorToRtc();
+}
+
+void ClickCounter::notePendingClick() {
+  if (!_pendingClicks++) _pendingSinceMs = millis();
+  persistPos(false);
+  if (_pendingClicks) ++_persistStats.writesAvoided;
+}
+
+bool ClickCounter::gateEdge(const EdgeSample& edge) {
+  // PCNT edges share one drain timestamp and are filtered in hardware.
+  if (!_source || !_source->timestamped()) return true;
+
+  if (_havePrevRawEdge && _motion != MotionState::IDLE && _source == &_isrSource) {
+    _gateLearner.add(edge.us - _prevRawEdgeUs);
+  }
+  _prevRawEdgeUs = edge.us;
+  _havePrevRawEdge = true;
+
+  if (_haveAcceptedEdge && (uint32_t)(edge.us - _lastAcceptedUs) < _gateUs) {
+    ++_edgesGated;
+    return false;
+  }
+  _lastAcceptedUs = edge.us;
+  _haveAcceptedEdge = true;
+  return true;
+}
+
+// PCNT edges have no timestamps of their own, and the hardware glitch
+// filter tops out at ~12.7 us, well short of contact bounce. Bounce shows
+// up as extra clicks in the same drain as the real one (or the next), so a
+// click sooner than half the fastest learned click interval after the
+// previous counted one is dropped. Until a speed has been learned every
+// click counts, and with click periods down near the control period this
+// cannot tell bounce from motion: PCNT still wants a clean (RC-filtered)
+// input.
+bool ClickCounter::plausibleClick(uint32_t us) {
+  uint32_t interval = _speed[0].intervalUs();
+  const uint32_t closing = _speed[1].intervalUs();
+  if (!interval || (closing && closing < interval)) interval = closing;
+  if (interval && _haveUntimedClick && (uint32_t)(us - _lastUntimedClickUs) < interval / 2) {
+    ++_rateDrops;
+    return false;
+  }
+  _lastUntimedClickUs = us;
+  _haveUntimedClick = true;
+  return true;
+}
+
+void ClickCounter::startCoast(MotionState dir) {
+  const uint8_t idx = dirIndex(dir);
+  _coastActive = true;
+  _coastDir = dir;
+  _coastStopPos = _pos;
+  _coastStopMs = millis();
+  _coastLastClickMs = _coastStopMs;
+  _coastLead = static_cast<uint8_t>(runLead(dir));
+  _coastLimitStop = (dir == MotionState::CLOSING) ? (_pos + _coastLead >= _end)
+                                                  : (_pos - _coastLead <= 0);
+  _tailHoldUntil = _coastStopMs + _coast.holdMs(idx);
+}
+
+void ClickCounter::finishCoast() {
+  _coastActive = false;
+  const uint8_t idx = dirIndex(_coastDir);
+  int32_t coast = _pos - _coastStopPos;
+  if (coast < 0) coast = -coast;
+
+  RunStats run;
+  run.dir = _coastDir;
+  run.startPos = _runStartPos;
+  run.stopPos = _coastStopPos;
+  run.finalPos = _pos;
+  run.coastClicks = static_cast<uint16_t>(coast);
+  run.coastMs = coast ? (uint32_t)(_coastLastClickMs - _coastStopMs) : 0;
+  run.predictedClicks = _coastLead;
+  run.limitStop = _coastLimitStop;
+  run.limitError = _pos - ((_coastDir == MotionState::CLOSING) ? _end : 0);
+  run.seq = _lastRun.seq + 1;
+  _lastRun = run;
+
+  int32_t travel = _coastStopPos - _runStartPos;
+  if (travel < 0) travel = -travel;
+  if (travel >= COAST_MIN_TRAVEL) {
+    _coast.addRun(idx, run.coastClicks, run.coastMs);
+    if (_prefsOpen) _prefs.putBytes(KEY_COAST, &_coast.blob(), sizeof(CoastModel::Blob));
+  }
+
+  if (_pendingClicks) persistPos(true);
+
+  String msg;
+  msg.reserve(112);
+  msg += F("[CLICK] Run ");
+  msg += (_coastDir == MotionState::CLOSING) ? F("closing") : F("opening");
+  msg += F(": coast ");
+  msg += run.coastClicks;
+  msg += F(" (predicted ");
+  msg += run.predictedClicks;
+  msg += F(") in ");
+  msg += run.coastMs;
+  msg += F(" ms");
+  if (run.limitStop) {
+    msg += F(", limit error ");
+    msg += run.limitError;
+  }
+  logMessage(msg);
+}
+
+void ClickCounter::learnGate() {
+  // PCNT has no gate to learn; a run that tripped its click-rate check is
+  // still worth a click_diag update.
+  if (_source == &_pcntSource && _rateDrops != _rateDropsReported) {
+    _rateDropsReported = _rateDrops;
+    ++_gateSeq;
+  }
+  // Only the interrupt path sees raw bounce; simulation would teach nonsense.
+  if (_source != &_isrSource || _gateLearner.samples() == 0) return;
+  ++_gateSeq;
+
+  GateLearner::Result r;
+  if (_gateLearner.derive(&r)) {
+    _gateConfidence = r.confidence;
+    uint32_t diff = (r.gateUs > _gateUs) ? r.gateUs - _gateUs : _gateUs - r.gateUs;
+    if (_gateLearned && diff * 10UL < _gateUs) return;
+    _gateUs = r.gateUs;
+    _gateLearned = true;
+    if (_prefsOpen) _prefs.putUInt(KEY_GATE, _gateUs);
+    String msg;
+    msg.reserve(80);
+    msg += F("[CLICK] Debounce gate learned: ");
+    msg += _gateUs;
+    msg += F(" us (confidence ");
+    msg += r.confidence;
+    msg += F("%)");
+    logMessage(msg);
+  } else if (_gateLearned &&
+             _gateLearner.samples() >= GateLearner::MIN_SAMPLES * 4) {
+    // Plenty of data but no clear gap any more: stop trusting the old value.
+    _gateUs = ISR_GATE_US;
+    _gateLearned = false;
+    _gateConfidence = 0;
+    if (_prefsOpen) _prefs.remove(KEY_GATE);
+    logMessage(String(F("[CLICK] Debounce gate confidence low, using fixed ")) +
+               ISR_GATE_US + F(" us"));
   }
 }
 
@@ -374,64 +750,26 @@ MotionState ClickCounter::computeEffectiveDirection(bool* tailHoldUsed) {
   return MotionState::IDLE;
 }
 
-void ClickCounter::attachHardwareIsr() {
-  if (_isrAttached) return;
-
-  gpio_config_t cfg = {};
-  cfg.intr_type = GPIO_INTR_ANYEDGE;
-  cfg.mode = GPIO_MODE_INPUT;
-  cfg.pull_up_en = GPIO_PULLUP_ENABLE;
-  cfg.pull_down_en = GPIO_PULLDOWN_DISABLE;
-  cfg.pin_bit_mask = (1ULL << _pin);
-  gpio_config(&cfg);
-
-  if (!s_isrServiceInstalled) {
-    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3);
-    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
-      s_isrServiceInstalled = true;
-    } else {
-      if (Serial) {
-        Serial.printf("[GPIO] Failed to install ISR service (err=%d)\n", static_cast<int>(err));
-      }
-    }
-  }
-
-  if (s_isrServiceInstalled) {
-    esp_err_t add = gpio_isr_handler_add(static_cast<gpio_num_t>(_pin), ClickCounter::gpioIsrThunk, this);
-    if (add == ESP_OK) {
-      gpio_intr_enable(static_cast<gpio_num_t>(_pin));
-      _isrAttached = true;
-      _edgeCountIsr = 0;
-      _lastIsrUs = 0;
-    } else {
-      if (Serial) {
-        Serial.printf("[GPIO] Failed to add ISR handler (err=%d)\n", static_cast<int>(add));
-      }
-    }
-  }
-}
-
-void ClickCounter::detachHardwareIsr() {
-  if (!_isrAttached) return;
-  gpio_intr_disable(static_cast<gpio_num_t>(_pin));
-  gpio_isr_handler_remove(static_cast<gpio_num_t>(_pin));
-  _isrAttached = false;
-  _edgeCountIsr = 0;
-  _lastIsrUs = 0;
-}
-
 void ClickCounter::persistEnd() {
-  if (!_prefsOpen) return;
   if (_end < 0) _end = 0;
+  mirrorToRtc();
+  if (!_prefsOpen) return;
   _prefs.putInt(KEY_END, _end);
 }
 
 void ClickCounter::persistPos(bool force) {
-  if (!_prefsOpen) return;
+  ensurePosLog();
+  if (!_prefsOpen && !_posLog.ready()) return;
   if (!force && _pos == _lastPersistPos &&
       _sensorExpectedLow == _lastPersistLevelLow) {
+    _pendingClicks = 0;
     return;
   }
+  if (!force && _persistClickBudget > 0) {
+    bool clicksSpent = _pendingClicks >= _persistClickBudget;
+    bool timeSpent = (unsigned long)(millis() - _pendingSinceMs) >= _persistIntervalMs;
+    if (!clicksSpent && !timeSpent) return;
+  }
 
   PosRecV1 rec;
   rec.epoch = ++_epoch;
@@ -440,22 +778,43 @@ void ClickCounter::persistPos(bool force) {
   memset(rec.reserved, 0, sizeof(rec.reserved));
   rec.crc32 = computeRecCrc(rec.epoch, rec.pos, rec.level);
 
+  // Log lines name where the record went: the log partition or the NVS key.
+  const char* tag = "[NVS]";
+  const char* store = CLICK_COUNTER_POS_LOG_PARTITION;
   char key[12];
-  snprintf(key, sizeof(key), "pos_%u", rec.epoch % POS_SLOTS);
+  size_t stored = 0;
   unsigned long started = millis();
-  size_t stored = _prefs.putBytes(key, &rec, sizeof(rec));
+  if (_posLog.ready()) {
+    tag = "[POSLOG]";
+    PosLog::Record logRec;
+    logRec.epoch = rec.epoch;
+    logRec.pos = rec.pos;
+    logRec.level = rec.level;
+    stored = _posLog.append(logRec, !_flushing) ? sizeof(rec) : 0;
+  } else {
+    snprintf(key, sizeof(key), "pos_%u", rec.epoch % POS_SLOTS);
+    store = key;
+    stored = _prefs.putBytes(key, &rec, sizeof(rec));
+  }
   unsigned long duration = millis() - started;
+  // Keep an erased sector ready so the power-fail flush never waits on one.
+  if (!_flushing && _posLog.ready()) _posLog.prepareNext();
   _lastPersistPos = _pos;
   _lastPersistLevelLow = _sensorExpectedLow;
   _lastPersistMs = millis();
   _sensorPersisted = true;
+  _pendingClicks = 0;
+  mirrorToRtc();
+  ++_persistStats.writes;
+  if (duration > _persistStats.maxWriteMs) _persistStats.maxWriteMs = duration;
+  if (duration > 25) ++_persistStats.slowWrites;
   if (stored != sizeof(rec)) {
-    Serial.printf("[NVS] putBytes failed for %s (stored=%u, expected=%u, pos=%ld, epoch=%lu)\n",
-                  key, static_cast<unsigned>(stored), static_cast<unsigned>(sizeof(rec)),
+    Serial.printf("%s Position write failed for %s (stored=%u, expected=%u, pos=%ld, epoch=%lu)\n",
+                  tag, store, static_cast<unsigned>(stored), static_cast<unsigned>(sizeof(rec)),
                   static_cast<long>(_pos), static_cast<unsigned long>(rec.epoch));
   } else if (duration > 25) {
-    Serial.printf("[NVS] putBytes %s took %lums (pos=%ld)\n",
-                  key, duration, static_cast<long>(_pos));
+    Serial.printf("%s Position write %s took %lums (pos=%ld)\n",
+                  tag, store, duration, static_cast<long>(_pos));
   }
 }
 
@@ -514,7 +873,7 @@ void ClickCounter::clampCalibrationRange() {
 void ClickCounter::prepareForMotion() {
   if (_simulate) {
     _sensorLiveLow = _sensorExpectedLow;
-    _simSensorLow = _sensorExpectedLow;
+    _simSource.setLevel(_sensorExpectedLow);
     return;
   }
 
@@ -547,26 +906,25 @@ void ClickCounter::prepareForMotion() {
 }
 
 void ClickCounter::refreshLiveLevel() {
-  if (_simulate) {
-    _sensorLiveLow = _simSensorLow;
-    mirrorSensorLevel();
-    return;
-  }
-  int level = digitalRead(_pin);
+  int level = _source ? _source->readLevel() : digitalRead(_pin);
   _sensorLiveLow = (level == LOW);
   mirrorSensorLevel();
 }
 
 void ClickCounter::clearPendingEdges() {
-  _edgePhase = 0;
+  _decoder.reset(_sensorLiveLow);
+  _havePrevRawEdge = false;
+  _haveAcceptedEdge = false;
   _sensorExpectedLow = _sensorLiveLow;
-  if (_simulate) {
-    return;
+  if (_source) _source->discard();
+}
+
+void ClickCounter::logEvent(const LogRecord& record) {
+  if (_event) {
+    _event(record);
+  } else {
+    logMessage(record.toString());
   }
-  noInterrupts();
-  _edgeCountIsr = 0;
-  _lastIsrUs = 0;
-  interrupts();
 }
 
 void ClickCounter::logMessage(const String& message) {
@@ -586,12 +944,56 @@ void ClickCounter::mirrorSensorLevel() {
   }
 }
 
+bool ClickCounter::restoreFromRtc() {
+  const RtcBlock& b = rtc();
+  if (b.magic != RTC_POS_MAGIC || b.crc32 != rtcBlockCrc(b)) return false;
+  if (b.end < 0 || b.end > SET_MAX_POS) return false;
+  if (b.pos < SET_MIN_POS || b.pos > SET_MAX_POS) return false;
+
+  _epoch = b.epoch;
+  _pos = b.pos;
+  _end = b.end;
+  _sensorExpectedLow = (b.level != 0);
+  _sensorLiveLow = _sensorExpectedLow;
+  _sensorPersisted = true;
+  return true;
+}
+
+void ClickCounter::mirrorToRtc() {
+  uint8_t level = _sensorExpectedLow ? 1 : 0;
+  uint8_t unpersisted = (_pos != _lastPersistPos ||
+                         _sensorExpectedLow != _lastPersistLevelLow) ? 1 : 0;
+  RtcBlock& b = rtc();
+  if (b.magic == RTC_POS_MAGIC && b.epoch == _epoch && b.pos == _pos &&
+      b.end == _end && b.level == level && b.unpersisted == unpersisted) {
+    return;
+  }
+  b.magic = RTC_POS_MAGIC;
+  b.epoch = _epoch;
+  b.pos = _pos;
+  b.end = _end;
+  b.level = level;
+  b.unpersisted = unpersisted;
+  memset(b.reserved, 0, sizeof(b.reserved));
+  b.crc32 = rtcBlockCrc(b);
+}
+
+void ClickCounter::ensurePosLog() {
+  if (_posLogTried) return;
+  _posLogTried = true;
+  if (_posFlashOpen) _posLog.begin(&_posFlash);
+}
+
 void ClickCounter::loadFromNvs() {
   loadEnd();
   loadPos();
 }
 
 void ClickCounter::loadEnd() {
+  if (!_prefsOpen) {
+    _end = DEFAULT_END;
+    return;
+  }
   if (_prefs.isKey(KEY_END)) {
     _end = _prefs.getInt(KEY_END, DEFAULT_END);
   } else {
@@ -602,6 +1004,34 @@ void ClickCounter::loadEnd() {
 }
 
 void ClickCounter::loadPos() {
+  bool found = false;
+  if (_posLog.ready() && _posLog.hasRecord()) {
+    const PosLog::Record& rec = _posLog.newest();
+    _epoch = rec.epoch;
+    _pos = rec.pos;
+    _sensorExpectedLow = (rec.level != 0);
+    _sensorPersisted = true;
+    found = true;
+  } else {
+    found = _prefsOpen && loadLegacyPos();
+    if (_posLog.ready()) migrateLegacyPos(found);
+  }
+
+  if (!found) {
+    _epoch = 0;
+    _pos = 0;
+    _sensorExpectedLow = false;
+    _sensorPersisted = false;
+  }
+
+  if (_pos < SET_MIN_POS) _pos = SET_MIN_POS;
+  if (_pos > SET_MAX_POS) _pos = SET_MAX_POS;
+
+  _sensorLiveLow = _sensorExpectedLow;
+  _lastPersistLevelLow = _sensorExpectedLow;
+}
+
+bool ClickCounter::loadLegacyPos() {
   bool found = false;
   uint32_t bestEpoch = 0;
   int32_t bestPos = 0;
@@ -649,31 +1079,33 @@ void ClickCounter::loadPos() {
     _pos = bestPos;
     _sensorExpectedLow = bestLevelLow;
     _sensorPersisted = bestHasLevel;
-  } else {
-    _epoch = 0;
-    _pos = 0;
-    _sensorExpectedLow = false;
-    _sensorPersisted = false;
   }
+  return found;
+}
 
-  if (_pos < SET_MIN_POS) _pos = SET_MIN_POS;
-  if (_pos > SET_MAX_POS) _pos = SET_MAX_POS;
-
-  _sensorLiveLow = _sensorExpectedLow;
-  _lastPersistLevelLow = _sensorExpectedLow;
+void ClickCounter::migrateLegacyPos(bool found) {
+  // First boot on the log: carry the newest NVS slot over, then drop the
+  // slots so a later log wipe cannot resurrect a stale position.
+  if (!found) return;
+  PosLog::Record rec;
+  rec.epoch = ++_epoch;
+  rec.pos = _pos;
+  rec.level = _sensorExpectedLow ? 1 : 0;
+  if (!_posLog.append(rec)) {
+    Serial.printf("[POSLOG] Migration append failed (pos=%ld)\n", static_cast<long>(_pos));
+    return;
+  }
+  for (uint8_t i = 0; i < POS_SLOTS; ++i) {
+    char key[12];
+    snprintf(key, sizeof(key), "pos_%u", i);
+    if (_prefs.isKey(key)) _prefs.remove(key);
+  }
+  Serial.printf("[POSLOG] Migrated NVS position (pos=%ld, epoch=%lu)\n",
+                static_cast<long>(_pos), static_cast<unsigned long>(_epoch));
 }
 
 uint32_t ClickCounter::crc32(const void* data, size_t len) {
-  uint32_t crc = 0xFFFFFFFF;
-  const uint8_t* p = static_cast<const uint8_t*>(data);
-  while (len--) {
-    crc ^= *p++;
-    for (int i = 0; i < 8; ++i) {
-      uint32_t mask = -(crc & 1);
-      crc = (crc >> 1) ^ (0xEDB88320 & mask);
-    }
-  }
-  return ~crc;
+  return crc32Ieee(data, len);
 }
 
 uint32_t ClickCounter::computeRecCrc(uint32_t epoch, int32_t pos, uint8_t level) {
@@ -693,15 +1125,3 @@ uint32_t ClickCounter::computeRecCrcLegacy(uint32_t epoch, int32_t pos) {
   memcpy(buf + sizeof(epoch), &pos, sizeof(pos));
   return crc32(buf, sizeof(buf));
 }
-
-void IRAM_ATTR ClickCounter::gpioIsrThunk(void* arg) {
-  if (!arg) return;
-  static_cast<ClickCounter*>(arg)->onIsr();
-}
-
-void IRAM_ATTR ClickCounter::onIsr() {
-  uint32_t now = micros();
-  if ((uint32_t)(now - _lastIsrUs) < ISR_GATE_US) return;
-  _lastIsrUs = now;
-  _edgeCountIsr++;
-}
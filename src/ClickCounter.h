@@ -3,6 +3,15 @@
 #include <Preferences.h>
 #include "pins.h"
 #include "AnalogController.h"  // MotionState
+#include "PartitionFlashDevice.h"
+#include "PosLog.h"
+#include "EdgeRing.h"
+#include "ClickSource.h"
+#include "EdgeDecoder.h"
+#include "GateLearner.h"
+#include "SpeedEstimator.h"
+#include "CoastModel.h"
+#include "LogEvents.h"
 
 
 // Default to hardware click counting; simulation can be toggled at runtime.
@@ -10,17 +19,68 @@
 #define CLICK_COUNTER_USE_SIMULATION 0
 #endif
 
+// Hardware edge source: 0 = GPIO interrupt + software gate, 1 = PCNT
+// pulse counter. Can be changed at runtime (setHardwareBackend) and the
+// choice is kept in NVS.
+#ifndef CLICK_COUNTER_BACKEND
+#define CLICK_COUNTER_BACKEND 0
+#endif
+
+// Write-behind position journal: while the motor runs, clicks are kept in RAM
+// and committed once either budget is used up. Stopping always commits.
+// A click budget of 0 restores write-through (one NVS write per click).
+#ifndef CLICK_COUNTER_PERSIST_CLICK_BUDGET
+#define CLICK_COUNTER_PERSIST_CLICK_BUDGET 16
+#endif
+
+#ifndef CLICK_COUNTER_PERSIST_INTERVAL_MS
+#define CLICK_COUNTER_PERSIST_INTERVAL_MS 2000
+#endif
+
+// Raw data partition holding the append-only position log. When it is
+// missing from the partition table the legacy pos_N NVS slots are used.
+#ifndef CLICK_COUNTER_POS_LOG_PARTITION
+#define CLICK_COUNTER_POS_LOG_PARTITION "poslog"
+#endif
+
 class StatusLed;
 
 class ClickCounter {
 public:
   using LogFn = void (*)(const String&);
 
+  enum class Backend : uint8_t { ISR = 0, PCNT = 1 };
+
+  struct PersistStats {
+    uint32_t writes = 0;         // position records written (log or NVS)
+    uint32_t writesAvoided = 0;  // per-click writes coalesced away
+    uint32_t slowWrites = 0;     // writes that took longer than 25 ms
+    uint32_t maxWriteMs = 0;
+  };
+
+  // Mirror of the live state in RTC slow memory, which survives software and
+  // watchdog resets but not power loss.
+  struct RtcBlock {
+    uint32_t magic;
+    uint32_t epoch;
+    int32_t  pos;
+    int32_t  end;
+    uint8_t  level;
+    uint8_t  unpersisted;
+    uint8_t  reserved[2];
+    uint32_t crc32;
+  };
+
   void begin(uint8_t pinClick = PIN_CLICK_IN,
              bool simulate = CLICK_COUNTER_USE_SIMULATION);
+  // Replaces the RTC_NOINIT block (before begin()); host tests use it to
+  // stage what a reset left behind.
+  void setRtcBlock(RtcBlock* block);
   void setLogger(LogFn logger);
+  void setEventLogger(LogEventFn fn);
   void setStatusLed(class StatusLed* led);
   void setMotion(MotionState s);
+  void setPersistBudget(uint16_t clicks, uint32_t intervalMs);
   void update(bool allowBeyondLimits = false);
 
   void beginCalibration();
@@ -30,6 +90,9 @@ public:
   void clearPanic();
 
   void setSimulation(bool simulate);
+  bool setHardwareBackend(Backend backend);
+  Backend hardwareBackend() const;
+  const char* sourceName() const;
 
   bool canOpen() const;
   bool canClose() const;
@@ -37,8 +100,66 @@ public:
 
   int32_t position() const;
   int32_t end() const;
+  int32_t percent() const;  // position as 0..100 of the calibrated travel
+
+  // Filtered travel speed learned from click timing; 0 until a run has
+  // produced a couple of click batches in that direction.
+  uint32_t clickIntervalUs(MotionState dir) const;
+  uint32_t clickIntervalDevUs(MotionState dir) const;
+  float speedCps(MotionState dir) const;
+  // Time until the limit in the current direction at the learned speed;
+  // 0 while idle or before a speed is known.
+  uint32_t etaMs() const;
+  // Clicks the cover is expected to travel after a stop issued now: the
+  // learned coast plus latencyMs at the live speed.
+  float stopLeadClicks(MotionState dir, uint32_t latencyMs) const;
 
   void forcePersist();
+  uint32_t emergencyFlush();
+  uint32_t lastEmergencyFlushUs() const;
+  const PersistStats& persistStats() const;
+
+  struct EdgeStats {
+    uint32_t edges = 0;        // edges handed to the decoder
+    uint32_t overflows = 0;    // ring drops (ISR) or counter-limit events (PCNT)
+    uint32_t highWater = 0;    // deepest ring fill seen (ISR)
+    uint32_t lastEdgeUs = 0;   // micros() of the newest edge
+    uint32_t lastClickUs = 0;  // micros() of the newest counted click
+    uint32_t duplicates = 0;   // same-level edges the decoder dropped
+    uint32_t resyncs = 0;      // missed edges recovered by the decoder
+    uint32_t stray = 0;        // clicks seen idle, after the tail window closed
+  };
+  EdgeStats edgeStats() const;
+
+  struct GateInfo {
+    uint32_t gateUs = 0;       // debounce gate currently applied
+    bool learned = false;      // false = fixed ISR_GATE_US fallback
+    uint8_t confidence = 0;
+    uint32_t gatedEdges = 0;   // edges dropped by the gate
+    uint32_t rateDrops = 0;    // PCNT clicks dropped by the click-rate check
+    uint32_t seq = 0;          // bumps after every run that fed the histogram
+  };
+  GateInfo gateInfo() const;
+  const GateLearner& gateHistogram() const;
+
+  // Summary of the last completed run, filled once its coast has settled.
+  struct RunStats {
+    MotionState dir = MotionState::IDLE;
+    int32_t startPos = 0;
+    int32_t stopPos = 0;         // position when the relays dropped
+    int32_t finalPos = 0;        // after coasting
+    uint16_t coastClicks = 0;
+    uint32_t coastMs = 0;        // relay drop to last coast click
+    uint8_t predictedClicks = 0; // lead applied by canOpen()/canClose()
+    bool limitStop = false;      // stopped for the open/close limit
+    int32_t limitError = 0;      // finalPos - limit, when limitStop
+    uint32_t seq = 0;
+  };
+  const RunStats& lastRun() const;
+  const CoastModel& coastModel() const;
+  bool restoredFromRtc() const;
+  bool posLogActive() const;
+  const PosLog::Stats& posLogStats() const;
 
 private:
   struct PosRecV0 {
@@ -60,20 +181,33 @@ private:
 
   static constexpr const char* NAMESPACE      = "poolcover";
   static constexpr const char* KEY_END        = "end";
+  static constexpr const char* KEY_BACKEND    = "backend";
+  static constexpr const char* KEY_GATE       = "gate_us";
+  static constexpr const char* KEY_COAST      = "coast";
   static constexpr uint8_t     POS_SLOTS      = 8;
-  static constexpr uint32_t    ISR_GATE_US    = 2250;
+  static constexpr uint32_t    ISR_GATE_US    = 2250;  // fallback debounce gate
+  static constexpr uint32_t    ISR_FLOOR_US   = 200;   // ISR-side spacing floor
+  static constexpr size_t      EDGE_BATCH     = 32;
   static constexpr int32_t     SET_MIN_POS    = -512;
   static constexpr int32_t     SET_MAX_POS    = 8192;
   static constexpr int32_t     DEFAULT_END    = 256;
-  static constexpr uint32_t    TAIL_HOLD_MS   = 100;
+  static constexpr int32_t     COAST_MIN_TRAVEL = 4;  // shorter runs don't reach speed
+  static constexpr uint32_t    RTC_POS_MAGIC  = 0x50435254;  // "PCRT"
 
-  void simulateTicks();
-  void drainHardwareEdges();
+  void drainSource();
+  void selectSource();
   void persistEnd();
   void persistPos(bool force);
+  void notePendingClick();
   void loadFromNvs();
+  bool restoreFromRtc();
+  void mirrorToRtc();
+  RtcBlock& rtc();
+  void ensurePosLog();
   void loadEnd();
   void loadPos();
+  bool loadLegacyPos();
+  void migrateLegacyPos(bool found);
   static uint32_t crc32(const void* data, size_t len);
   static uint32_t computeRecCrc(uint32_t epoch, int32_t pos, uint8_t level);
   static uint32_t computeRecCrcLegacy(uint32_t epoch, int32_t pos);
@@ -84,26 +218,55 @@ private:
   void refreshLiveLevel();
   void clearPendingEdges();
   void logMessage(const String& message);
+  void logEvent(const LogRecord& record);
   void mirrorSensorLevel();
-  void processEdgeBatch(uint32_t edges);
+  void processEdgeBatch(const EdgeSample* edges, size_t count);
+  bool gateEdge(const EdgeSample& edge);
+  bool plausibleClick(uint32_t us);
+  void learnGate();
+  void startCoast(MotionState dir);
+  void finishCoast();
+  int32_t runLead(MotionState dir) const;
+  static uint8_t dirIndex(MotionState dir) { return dir == MotionState::CLOSING ? 1 : 0; }
   MotionState computeEffectiveDirection(bool* tailHoldUsed);
-  void attachHardwareIsr();
-  void detachHardwareIsr();
-
-  static void IRAM_ATTR gpioIsrThunk(void* arg);
-  void IRAM_ATTR onIsr();
-  static bool s_isrServiceInstalled;
 
   Preferences _prefs;
+  PartitionFlashDevice _posFlash;
+  PosLog _posLog;
+  bool _posFlashOpen = false;
+  bool _posLogTried = false;
+  bool _restoredFromRtc = false;
+  RtcBlock* _rtc = nullptr;  // nullptr = the RTC_NOINIT block
   uint8_t _pin = PIN_CLICK_IN;
   bool _simulate = true;
 
   LogFn _log = nullptr;
+  LogEventFn _event = nullptr;
   StatusLed* _statusLed = nullptr;
 
-  volatile uint32_t _edgeCountIsr = 0;
-  volatile uint32_t _lastIsrUs = 0;
-  bool _isrAttached = false;
+  IsrClickSource _isrSource{ISR_FLOOR_US};
+  PcntClickSource _pcntSource;
+  SimClickSource _simSource;
+  ClickSource* _source = nullptr;
+  Backend _backend = static_cast<Backend>(CLICK_COUNTER_BACKEND);
+  uint32_t _edgesProcessed = 0;
+  uint32_t _lastEdgeUs = 0;
+  uint32_t _lastClickUs = 0;
+
+  GateLearner _gateLearner;
+  uint32_t _gateUs = ISR_GATE_US;
+  bool _gateLearned = false;
+  uint8_t _gateConfidence = 0;
+  uint32_t _edgesGated = 0;
+  uint32_t _gateSeq = 0;
+  uint32_t _prevRawEdgeUs = 0;
+  bool _havePrevRawEdge = false;
+  uint32_t _lastAcceptedUs = 0;
+  bool _haveAcceptedEdge = false;
+  uint32_t _rateDrops = 0;
+  uint32_t _rateDropsReported = 0;
+  uint32_t _lastUntimedClickUs = 0;
+  bool _haveUntimedClick = false;
 
   MotionState _motion = MotionState::IDLE;
   MotionState _lastMotion = MotionState::IDLE;
@@ -114,10 +277,16 @@ private:
 
   uint32_t _epoch = 0;
 
-  unsigned long _lastSimTickMs = 0;
   unsigned long _lastPersistMs = 0;
   int32_t _lastPersistPos = 0;
   bool _lastPersistLevelLow = false;
+  uint16_t _persistClickBudget = CLICK_COUNTER_PERSIST_CLICK_BUDGET;
+  uint32_t _persistIntervalMs = CLICK_COUNTER_PERSIST_INTERVAL_MS;
+  uint32_t _pendingClicks = 0;
+  unsigned long _pendingSinceMs = 0;
+  PersistStats _persistStats;
+  uint32_t _lastEmergencyFlushUs = 0;
+  bool _flushing = false;  // inside emergencyFlush(): no sector erases
 
   bool _prefsOpen = false;
 
@@ -132,9 +301,21 @@ private:
   bool _sensorExpectedLow = false;
   bool _sensorLiveLow = false;
   bool _sensorPersisted = false;
-  bool _simSensorLow = false;
   bool _overshootLogged = false;
   MotionState _lastActiveDirection = MotionState::IDLE;
   unsigned long _tailHoldUntil = 0;
-  uint8_t _edgePhase = 0;
+  EdgeDecoder _decoder;
+  SpeedEstimator _speed[2];  // [0] opening, [1] closing
+
+  CoastModel _coast;
+  bool _coastActive = false;
+  MotionState _coastDir = MotionState::IDLE;
+  int32_t _runStartPos = 0;
+  int32_t _coastStopPos = 0;
+  unsigned long _coastStopMs = 0;
+  unsigned long _coastLastClickMs = 0;
+  uint8_t _coastLead = 0;
+  bool _coastLimitStop = false;
+  RunStats _lastRun;
+  uint32_t _strayClicks = 0;
 };
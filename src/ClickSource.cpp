@@ -0,0 +1,357 @@
+#include "ClickSource.h"
+
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+#include <esp_intr_alloc.h>
+#include <esp_err.h>
+
+// ---- IsrClickSource -------------------------------------------------------
+
+bool IsrClickSource::s_isrServiceInstalled = false;
+
+bool IsrClickSource::start(uint8_t pin) {
+  if (_attached) return true;
+  _pin = pin;
+
+  gpio_config_t cfg = {};
+  cfg.intr_type = GPIO_INTR_ANYEDGE;
+  cfg.mode = GPIO_MODE_INPUT;
+  cfg.pull_up_en = GPIO_PULLUP_ENABLE;
+  cfg.pull_down_en = GPIO_PULLDOWN_DISABLE;
+  cfg.pin_bit_mask = (1ULL << _pin);
+  gpio_config(&cfg);
+
+  if (!s_isrServiceInstalled) {
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+      s_isrServiceInstalled = true;
+    } else {
+      if (Serial) {
+        Serial.printf("[GPIO] Failed to install ISR service (err=%d)\n", static_cast<int>(err));
+      }
+    }
+  }
+
+  if (s_isrServiceInstalled) {
+    esp_err_t add = gpio_isr_handler_add(static_cast<gpio_num_t>(_pin), IsrClickSource::gpioIsrThunk, this);
+    if (add == ESP_OK) {
+      gpio_intr_enable(static_cast<gpio_num_t>(_pin));
+      _attached = true;
+      discard();
+    } else {
+      if (Serial) {
+        Serial.printf("[GPIO] Failed to add ISR handler (err=%d)\n", static_cast<int>(add));
+      }
+    }
+  }
+  return _attached;
+}
+
+void IsrClickSource::stop() {
+  if (!_attached) return;
+  gpio_intr_disable(static_cast<gpio_num_t>(_pin));
+  gpio_isr_handler_remove(static_cast<gpio_num_t>(_pin));
+  _attached = false;
+  discard();
+}
+
+size_t IsrClickSource::drain(EdgeSample* out, size_t max) {
+  return _ring.pop(out, max);
+}
+
+void IsrClickSource::discard() {
+  // The mux (not noInterrupts(), which is core-local) orders this against an
+  // ISR running on the other core.
+  portENTER_CRITICAL(&_mux);
+  _lastIsrUs = 0;
+  _ring.clear();
+  portEXIT_CRITICAL(&_mux);
+}
+
+int IsrClickSource::readLevel() const {
+  return digitalRead(_pin);
+}
+
+void IRAM_ATTR IsrClickSource::gpioIsrThunk(void* arg) {
+  if (!arg) return;
+  static_cast<IsrClickSource*>(arg)->onIsr();
+}
+
+void IRAM_ATTR IsrClickSource::onIsr() {
+  uint32_t now = micros();
+  uint8_t level = gpio_ll_get_level(&GPIO, static_cast<gpio_num_t>(_pin)) ? 1 : 0;
+  portENTER_CRITICAL_ISR(&_mux);
+  if ((uint32_t)(now - _lastIsrUs) >= _gateUs) {
+    _lastIsrUs = now;
+    _ring.push(now, level);
+  }
+  portEXIT_CRITICAL_ISR(&_mux);
+}
+
+// ---- PcntClickSource ------------------------------------------------------
+
+#if CLICK_SOURCE_LEGACY_PCNT
+
+bool PcntClickSource::s_isrServiceInstalled = false;
+
+bool PcntClickSource::start(uint8_t pin) {
+  if (_running) return true;
+  _pin = pin;
+
+  // Count on both edges; no control pin. The counter resets to 0 when it
+  // reaches LIMIT and raises PCNT_EVT_H_LIM, which onLimit() accumulates.
+  pcnt_config_t cfg = {};
+  cfg.pulse_gpio_num = _pin;
+  cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  cfg.lctrl_mode = PCNT_MODE_KEEP;
+  cfg.hctrl_mode = PCNT_MODE_KEEP;
+  cfg.pos_mode = PCNT_COUNT_INC;
+  cfg.neg_mode = PCNT_COUNT_INC;
+  cfg.counter_h_lim = LIMIT;
+  cfg.counter_l_lim = -1;
+  cfg.unit = UNIT;
+  cfg.channel = PCNT_CHANNEL_0;
+  esp_err_t err = pcnt_unit_config(&cfg);  // also enables the pin's pull-up
+  if (err == ESP_OK) err = pcnt_set_filter_value(UNIT, GLITCH_APB_CYCLES);
+  if (err == ESP_OK) err = pcnt_filter_enable(UNIT);
+  if (err == ESP_OK) err = pcnt_event_enable(UNIT, PCNT_EVT_H_LIM);
+  if (err == ESP_OK && !s_isrServiceInstalled) {
+    err = pcnt_isr_service_install(0);
+    if (err == ESP_ERR_INVALID_STATE) err = ESP_OK;  // someone else installed it
+    if (err == ESP_OK) s_isrServiceInstalled = true;
+  }
+  if (err == ESP_OK) {
+    err = pcnt_isr_handler_add(UNIT, PcntClickSource::onLimit, this);
+    _handlerAdded = (err == ESP_OK);
+  }
+  if (err == ESP_OK) err = pcnt_counter_pause(UNIT);
+  if (err == ESP_OK) err = pcnt_counter_clear(UNIT);
+  if (err == ESP_OK) err = pcnt_counter_resume(UNIT);
+
+  if (err != ESP_OK) {
+    if (Serial) {
+      Serial.printf("[PCNT] Setup failed (err=%d)\n", static_cast<int>(err));
+    }
+    _running = true;  // let stop() release whatever was set up
+    stop();
+    return false;
+  }
+
+  _running = true;
+  _limitEvents = 0;
+  _lastTotal = 0;
+  _pending = 0;
+  return true;
+}
+
+void PcntClickSource::stop() {
+  if (!_running) return;
+  pcnt_counter_pause(UNIT);
+  pcnt_event_disable(UNIT, PCNT_EVT_H_LIM);
+  if (_handlerAdded) {
+    pcnt_isr_handler_remove(UNIT);
+    _handlerAdded = false;
+  }
+  _running = false;
+  _pending = 0;
+}
+
+void PcntClickSource::collect() {
+  if (!_running) return;
+  // Re-read when a wrap lands between the two reads.
+  uint32_t limits = 0;
+  int16_t count = 0;
+  do {
+    limits = _limitEvents;
+    if (pcnt_get_counter_value(UNIT, &count) != ESP_OK) return;
+  } while (limits != _limitEvents);
+
+  const uint32_t total = limits * static_cast<uint32_t>(LIMIT) + static_cast<uint32_t>(count);
+  // A wrap whose interrupt has not run yet reads as a step back; the next
+  // collect() picks the edges up.
+  if (static_cast<int32_t>(total - _lastTotal) < 0) return;
+  _pending += total - _lastTotal;
+  _lastTotal = total;
+}
+
+void IRAM_ATTR PcntClickSource::onLimit(void* arg) {
+  // The ISR service clears the status; the counter has already restarted at 0.
+  PcntClickSource* self = static_cast<PcntClickSource*>(arg);
+  self->_limitEvents = self->_limitEvents + 1;
+}
+
+#else  // IDF 5 pulse_cnt driver
+
+bool PcntClickSource::start(uint8_t pin) {
+  if (_running) return true;
+  _pin = pin;
+
+  gpio_config_t cfg = {};
+  cfg.intr_type = GPIO_INTR_DISABLE;
+  cfg.mode = GPIO_MODE_INPUT;
+  cfg.pull_up_en = GPIO_PULLUP_ENABLE;
+  cfg.pull_down_en = GPIO_PULLDOWN_DISABLE;
+  cfg.pin_bit_mask = (1ULL << _pin);
+  gpio_config(&cfg);
+
+  pcnt_unit_config_t unitCfg = {};
+  unitCfg.low_limit = -1;
+  unitCfg.high_limit = LIMIT;
+  unitCfg.flags.accum_count = 1;
+  esp_err_t err = pcnt_new_unit(&unitCfg, &_unit);
+
+  if (err == ESP_OK) {
+    pcnt_glitch_filter_config_t filter = {};
+    filter.max_glitch_ns = GLITCH_NS;
+    err = pcnt_unit_set_glitch_filter(_unit, &filter);
+  }
+  if (err == ESP_OK) {
+    pcnt_chan_config_t chanCfg = {};
+    chanCfg.edge_gpio_num = _pin;
+    chanCfg.level_gpio_num = -1;
+    err = pcnt_new_channel(_unit, &chanCfg, &_chan);
+  }
+  if (err == ESP_OK) {
+    err = pcnt_channel_set_edge_action(_chan,
+                                       PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                       PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+  }
+  if (err == ESP_OK) err = pcnt_unit_add_watch_point(_unit, LIMIT);
+  if (err == ESP_OK) {
+    pcnt_event_callbacks_t cbs = {};
+    cbs.on_reach = PcntClickSource::onLimit;
+    err = pcnt_unit_register_event_callbacks(_unit, &cbs, this);
+  }
+  if (err == ESP_OK) err = pcnt_unit_enable(_unit);
+  if (err == ESP_OK) err = pcnt_unit_clear_count(_unit);
+  if (err == ESP_OK) err = pcnt_unit_start(_unit);
+
+  if (err != ESP_OK) {
+    if (Serial) {
+      Serial.printf("[PCNT] Setup failed (err=%d)\n", static_cast<int>(err));
+    }
+    _running = true;  // let stop() release whatever was created
+    stop();
+    return false;
+  }
+
+  _running = true;
+  _lastTotal = 0;
+  _pending = 0;
+  return true;
+}
+
+void PcntClickSource::stop() {
+  if (!_running) return;
+  if (_unit) {
+    pcnt_unit_stop(_unit);
+    pcnt_unit_disable(_unit);
+  }
+  if (_chan) {
+    pcnt_del_channel(_chan);
+    _chan = nullptr;
+  }
+  if (_unit) {
+    pcnt_del_unit(_unit);
+    _unit = nullptr;
+  }
+  _running = false;
+  _pending = 0;
+}
+
+void PcntClickSource::collect() {
+  if (!_running) return;
+  int count = 0;
+  if (pcnt_unit_get_count(_unit, &count) != ESP_OK) return;
+  _pending += static_cast<uint32_t>(count) - _lastTotal;
+  _lastTotal = static_cast<uint32_t>(count);
+}
+
+bool IRAM_ATTR PcntClickSource::onLimit(pcnt_unit_handle_t /*unit*/,
+                                        const pcnt_watch_event_data_t* /*data*/,
+                                        void* ctx) {
+  // The driver folds the limit into its accumulated count; just note it.
+  PcntClickSource* self = static_cast<PcntClickSource*>(ctx);
+  self->_limitEvents = self->_limitEvents + 1;
+  return false;
+}
+
+#endif  // CLICK_SOURCE_LEGACY_PCNT
+
+size_t PcntClickSource::drain(EdgeSample* out, size_t max) {
+  collect();
+  size_t n = _pending < max ? _pending : max;
+  if (!n) return 0;
+
+  // The newest edge left the pin at its current level; walk backwards.
+  uint32_t now = micros();
+  uint8_t level = (readLevel() == HIGH) ? 1 : 0;
+  uint32_t remaining = _pending - n;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t fromNewest = remaining + (n - 1 - i);
+    out[i].us = now;
+    out[i].level = (fromNewest & 1) ? (level ^ 1) : level;
+  }
+  _pending = remaining;
+  return n;
+}
+
+void PcntClickSource::discard() {
+  collect();
+  _pending = 0;
+}
+
+int PcntClickSource::readLevel() const {
+  return digitalRead(_pin);
+}
+
+// ---- SimClickSource -------------------------------------------------------
+
+bool SimClickSource::start(uint8_t /*pin*/) {
+  _lastTickMs = millis();
+  _halfPending = 0;
+  return true;
+}
+
+void SimClickSource::setRunning(bool running) {
+  if (running && !_running) {
+    _lastTickMs = millis();
+    _halfPending = 0;
+  }
+  _running = running;
+}
+
+size_t SimClickSource::drain(EdgeSample* out, size_t max) {
+  const unsigned long now = millis();
+  if (!_running) {
+    _lastTickMs = now;
+    _halfPending = 0;
+    return 0;
+  }
+  if (now < _lastTickMs) {
+    _lastTickMs = now;
+  }
+
+  // One high + one low edge per click, half a period apart.
+  size_t n = 0;
+  while (n < max) {
+    if (!_halfPending) {
+      if ((unsigned long)(now - _lastTickMs) < PERIOD_MS) break;
+      _tickUs = static_cast<uint32_t>(_lastTickMs) * 1000UL;
+      _lastTickMs += PERIOD_MS;
+      _halfPending = 2;
+    }
+    _low = !_low;
+    out[n].us = _tickUs + (2 - _halfPending) * (PERIOD_MS * 500UL);
+    out[n].level = _low ? 0 : 1;
+    --_halfPending;
+    ++n;
+  }
+  return n;
+}
+
+void SimClickSource::discard() {
+  _lastTickMs = millis();
+  _halfPending = 0;
+}
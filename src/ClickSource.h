@@ -0,0 +1,136 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include "EdgeRing.h"
+
+// IDF 5 has the handle-based pulse_cnt driver; the Arduino 2.x core ships
+// IDF 4.4, which only has the legacy unit-number API.
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <driver/pulse_cnt.h>
+#define CLICK_SOURCE_LEGACY_PCNT 0
+#else
+#include <driver/pcnt.h>
+#define CLICK_SOURCE_LEGACY_PCNT 1
+#endif
+
+// Where ClickCounter gets its edges from. All sources hand out the same
+// EdgeSample records, so the position logic is identical whichever one is
+// active.
+class ClickSource {
+public:
+  virtual ~ClickSource() = default;
+
+  virtual const char* name() const = 0;
+  virtual bool start(uint8_t pin) = 0;
+  virtual void stop() = 0;
+  // Oldest first; returns the number of samples written.
+  virtual size_t drain(EdgeSample* out, size_t max) = 0;
+  // Drop everything queued (motion start resynchronises on the live level).
+  virtual void discard() = 0;
+  // Current pin level, HIGH or LOW.
+  virtual int readLevel() const = 0;
+  // False when edge timestamps are synthesised at drain time.
+  virtual bool timestamped() const { return true; }
+  virtual uint32_t overflows() const { return 0; }
+  virtual uint32_t highWater() const { return 0; }
+};
+
+// GPIO ANYEDGE interrupt feeding an EdgeRing, with a minimum edge spacing.
+class IsrClickSource : public ClickSource {
+public:
+  static constexpr size_t RING_SIZE = 128;
+
+  explicit IsrClickSource(uint32_t gateUs) : _gateUs(gateUs) {}
+
+  const char* name() const override { return "isr"; }
+  bool start(uint8_t pin) override;
+  void stop() override;
+  size_t drain(EdgeSample* out, size_t max) override;
+  void discard() override;
+  int readLevel() const override;
+  uint32_t overflows() const override { return _ring.overflows(); }
+  uint32_t highWater() const override { return _ring.highWater(); }
+
+private:
+  static void IRAM_ATTR gpioIsrThunk(void* arg);
+  void IRAM_ATTR onIsr();
+  static bool s_isrServiceInstalled;
+
+  uint8_t _pin = 255;
+  bool _attached = false;
+  uint32_t _gateUs;
+  EdgeRing<RING_SIZE> _ring;
+  portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  volatile uint32_t _lastIsrUs = 0;
+};
+
+// PCNT peripheral counting both edges in hardware: no interrupt per edge,
+// a hardware glitch filter, and an interrupt only when the counter wraps at
+// LIMIT. Edges are not individually timestamped; drain() stamps them with
+// the drain time and reconstructs their levels backwards from the live pin
+// level.
+//
+// The glitch filter (at most ~12.7 us) is the only debounce here: contact
+// bounce longer than that is counted. Without timestamps the learned ISR
+// gate cannot apply, so ClickCounter falls back on a click-rate check
+// (plausibleClick()); the input still needs an RC filter to be trusted.
+class PcntClickSource : public ClickSource {
+public:
+  static constexpr int      LIMIT = 30000;
+  static constexpr uint32_t GLITCH_NS = 10000;  // hardware max is ~12.7 us
+  // The legacy filter is set in APB clock cycles (80 MHz, 10 bits).
+  static constexpr uint16_t GLITCH_APB_CYCLES = GLITCH_NS * 80 / 1000;
+
+  const char* name() const override { return "pcnt"; }
+  bool start(uint8_t pin) override;
+  void stop() override;
+  size_t drain(EdgeSample* out, size_t max) override;
+  void discard() override;
+  int readLevel() const override;
+  bool timestamped() const override { return false; }
+  uint32_t overflows() const override { return _limitEvents; }
+
+private:
+  void collect();
+
+  uint8_t _pin = 255;
+  bool _running = false;
+  uint32_t _lastTotal = 0;    // edges counted up to the previous collect()
+  uint32_t _pending = 0;
+  volatile uint32_t _limitEvents = 0;
+#if CLICK_SOURCE_LEGACY_PCNT
+  static constexpr pcnt_unit_t UNIT = PCNT_UNIT_0;
+  static void IRAM_ATTR onLimit(void* arg);
+  static bool s_isrServiceInstalled;
+  bool _handlerAdded = false;
+#else
+  static bool IRAM_ATTR onLimit(pcnt_unit_handle_t unit,
+                                const pcnt_watch_event_data_t* data,
+                                void* ctx);
+  pcnt_unit_handle_t _unit = nullptr;
+  pcnt_channel_handle_t _chan = nullptr;
+#endif
+};
+
+// Synthetic click stream (5 Hz while running) for bench work without a motor.
+class SimClickSource : public ClickSource {
+public:
+  static constexpr unsigned long PERIOD_MS = 200;
+
+  const char* name() const override { return "sim"; }
+  bool start(uint8_t /*pin*/) override;
+  void stop() override {}
+  size_t drain(EdgeSample* out, size_t max) override;
+  void discard() override;
+  int readLevel() const override { return _low ? LOW : HIGH; }
+
+  void setRunning(bool running);
+  void setLevel(bool low) { _low = low; }
+
+private:
+  bool _running = false;
+  bool _low = false;
+  unsigned long _lastTickMs = 0;
+  uint8_t _halfPending = 0;   // edges of the current tick not yet handed out
+  uint32_t _tickUs = 0;
+};
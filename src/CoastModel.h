@@ -0,0 +1,65 @@
+#pragma once
+#include <Arduino.h>
+
+// Learned overrun per travel direction: how many clicks the cover keeps
+// making after the relays drop, and how long the last of them takes.
+//
+// Kept as small EWMAs (clicks in 1/16 steps) so the whole model fits in one
+// NVS blob. The click counter uses it to size the post-stop tail window and
+// to drop the relays early enough to land on a limit.
+class CoastModel {
+public:
+  static constexpr uint16_t MIN_RUNS = 3;        // before lead() is trusted
+  static constexpr uint32_t MIN_HOLD_MS = 100;   // the old fixed tail hold
+  static constexpr uint32_t MAX_HOLD_MS = 1500;
+  static constexpr uint8_t  MAX_LEAD = 8;
+
+  struct Blob {
+    uint16_t clicksX16[2];
+    uint16_t ms[2];
+    uint16_t runs[2];
+  };
+
+  void reset() { memset(&_b, 0, sizeof(_b)); }
+
+  void load(const Blob& b) { _b = b; }
+  const Blob& blob() const { return _b; }
+
+  void addRun(uint8_t dir, uint16_t clicks, uint32_t coastMs) {
+    if (dir > 1) return;
+    if (coastMs > 0xFFFF) coastMs = 0xFFFF;
+    int32_t x16 = static_cast<int32_t>(clicks) * 16;
+    if (_b.runs[dir] == 0) {
+      _b.clicksX16[dir] = static_cast<uint16_t>(x16);
+      _b.ms[dir] = static_cast<uint16_t>(coastMs);
+    } else {
+      _b.clicksX16[dir] = static_cast<uint16_t>(_b.clicksX16[dir] + (x16 - _b.clicksX16[dir]) / 4);
+      _b.ms[dir] = static_cast<uint16_t>(_b.ms[dir] +
+                    (static_cast<int32_t>(coastMs) - _b.ms[dir]) / 4);
+    }
+    if (_b.runs[dir] < 0xFFFF) ++_b.runs[dir];
+  }
+
+  // Expected coast clicks, rounded; 0 until MIN_RUNS runs were seen.
+  uint8_t lead(uint8_t dir) const {
+    if (dir > 1 || _b.runs[dir] < MIN_RUNS) return 0;
+    uint32_t clicks = (_b.clicksX16[dir] + 8) / 16;
+    return clicks > MAX_LEAD ? MAX_LEAD : static_cast<uint8_t>(clicks);
+  }
+
+  // Tail window after a stop: half again the learned coast time.
+  uint32_t holdMs(uint8_t dir) const {
+    if (dir > 1) return MIN_HOLD_MS;
+    uint32_t hold = _b.ms[dir] + _b.ms[dir] / 2;
+    if (hold < MIN_HOLD_MS) hold = MIN_HOLD_MS;
+    if (hold > MAX_HOLD_MS) hold = MAX_HOLD_MS;
+    return hold;
+  }
+
+  float clicks(uint8_t dir) const { return dir > 1 ? 0.0f : _b.clicksX16[dir] / 16.0f; }
+  uint32_t coastMs(uint8_t dir) const { return dir > 1 ? 0 : _b.ms[dir]; }
+  uint16_t runs(uint8_t dir) const { return dir > 1 ? 0 : _b.runs[dir]; }
+
+private:
+  Blob _b{};
+};
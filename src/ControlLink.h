@@ -0,0 +1,157 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <cstring>
+#include "Mailbox.h"
+#include "LoopProfiler.h"
+#include "AnalogController.h"  // MotionState
+#include "ClickCounter.h"
+#include "PositionTarget.h"
+#include "LatencyTracer.h"
+#include "RelaysModule.h"
+#include "LogEvents.h"
+
+// Everything that crosses between the control task (relays, clicks, safety)
+// and the network task (Wi-Fi, MQTT, log publishing). The control side
+// never touches the network; the network side never touches the hardware
+// modules and only sees the state through snapshots.
+
+// Network -> control.
+struct ControlCommand {
+  enum class Type : uint8_t {
+    HA_MOTION,            // value = MotionState
+    SET_OPEN_HERE,
+    SET_CLOSED_HERE,
+    ENTER_SET_MODE,
+    EXIT_SET_MODE,
+    CLICK_BACKEND,        // value = ClickCounter::Backend
+    SET_MAX_RUNTIME,      // value = seconds
+    SET_STALL_FACTOR,     // value = factor x10
+    SET_POSITION_CLICKS,  // value = clicks
+    SET_POSITION_PCT,     // value = 0..100
+  };
+  Type type;
+  int32_t value;
+  uint32_t stampUs;  // micros() when the broker message arrived
+};
+
+// Control -> network: one free-form log line. Longer lines are truncated.
+// Frequent lines go as LogRecords instead; seq orders the two streams.
+struct LogEvent {
+  uint16_t seq;
+  char text[160];
+
+  void set(const String& line) {
+    size_t n = line.length();
+    if (n >= sizeof(text)) n = sizeof(text) - 1;
+    memcpy(text, line.c_str(), n);
+    text[n] = '\0';
+  }
+};
+
+// Control-loop period statistics over fixed windows of WINDOW passes.
+struct LoopTiming {
+  static constexpr uint32_t WINDOW = 1000;
+
+  uint32_t nominalUs = 5000;
+  // Last completed window.
+  uint32_t avgPeriodUs = 0;
+  uint32_t maxPeriodUs = 0;
+  uint32_t maxJitterUs = 0;   // largest |period - nominal|
+  uint32_t overruns = 0;      // periods over twice the nominal
+  uint32_t windows = 0;
+
+  void add(uint32_t periodUs) {
+    _sum += periodUs;
+    if (periodUs > _max) _max = periodUs;
+    uint32_t jitter = periodUs > nominalUs ? periodUs - nominalUs : nominalUs - periodUs;
+    if (jitter > _maxJitter) _maxJitter = jitter;
+    if (periodUs > nominalUs * 2) ++_overruns;
+    if (++_count < WINDOW) return;
+    avgPeriodUs = static_cast<uint32_t>(_sum / _count);
+    maxPeriodUs = _max;
+    maxJitterUs = _maxJitter;
+    overruns = _overruns;
+    ++windows;
+    _sum = 0;
+    _count = 0;
+    _max = 0;
+    _maxJitter = 0;
+    _overruns = 0;
+  }
+
+private:
+  uint64_t _sum = 0;
+  uint32_t _count = 0;
+  uint32_t _max = 0;
+  uint32_t _maxJitter = 0;
+  uint32_t _overruns = 0;
+};
+
+// Control -> network: full state for publishing, refreshed every pass. The
+// latency stats and the control profiler window are large and change a few
+// times a minute at most, so they have their own slots in ControlLink.
+struct ControlSnapshot {
+  const char* modeLabel = "LOCAL";     // string literals only
+  MotionState action = MotionState::IDLE;
+  MotionState analogState = MotionState::IDLE;
+  const char* analogLabel = "Neutral";
+  bool setModeActive = false;
+  bool panicActive = false;
+
+  int32_t pos = 0;
+  int32_t end = 0;
+  int32_t pct = 0;
+  float speedCps = 0.0f;
+  float openCps = 0.0f;
+  float closeCps = 0.0f;
+  uint32_t etaMs = 0;
+
+  uint32_t maxRunSeconds = 0;
+  uint32_t runElapsedSeconds = 0;
+  bool safetyActive = false;
+  uint32_t noClickGuardSeconds = 0;
+  float stallFactor = 0.0f;
+  uint32_t stallLimitMs = 0;
+  uint32_t stallTrips = 0;
+  uint32_t powerFailFlushUs = 0;
+
+  ClickCounter::PersistStats persist;
+  bool posLogActive = false;
+  uint32_t posLogErases = 0;
+  ClickCounter::EdgeStats edges;
+  const char* clickSource = "none";
+
+  bool gotoActive = false;
+  int32_t gotoTarget = 0;
+  PositionTarget::Stats gotoStats;
+
+  ClickCounter::GateInfo gate;
+  uint32_t gateSamples = 0;
+  uint32_t gateCounts[GateLearner::BUCKETS] = {};
+
+  ClickCounter::RunStats run;
+  CoastModel coast;
+
+  RelaysModule::Stats relays;
+  const char* relayPhase = "off";
+
+  LoopTiming control;
+  bool tasksSplit = false;
+  uint32_t commandDrops = 0;
+  uint32_t logDrops = 0;
+  uint32_t logHighWater = 0;   // deepest log/event queue
+};
+
+struct ControlLink {
+  Mailbox<ControlCommand, 16> commands;
+  Mailbox<LogEvent, 32> logs;
+  Mailbox<LogRecord, 64> events;
+  LatestValue<ControlSnapshot> state;
+  LatestValue<LatencyTracer::Stats> latency;   // published when its seq moves
+#if LOOP_PROFILER_ENABLED
+  LatestValue<LoopProfiler::Window> profile;   // last completed control window
+#endif
+  std::atomic<bool> wifiUp{false};
+  std::atomic<bool> mqttUp{false};
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <Arduino.h>
+#include <cstring>
+#include <esp_attr.h>
+#include <esp_system.h>
+
+// The newest log bytes, kept in RTC slow memory so they survive the panic
+// reboot (ESP.restart()) and watchdog resets, but not power loss.
+//
+// append() is on the logging path: it copies the line into a byte ring and
+// then commits head and length with a single 32-bit store, so a reset in
+// the middle of a line can only cost that line. Old text is overwritten a
+// byte at a time, not a line at a time; the reader drops the partial first
+// line instead.
+//
+// begin() takes what the previous boot left behind (if the block is valid
+// and the reset was not a power-on), keeps it with the reset reason and the
+// uptime of the last line, and starts the ring over for this boot.
+class CrashLog {
+public:
+  static constexpr size_t BYTES = 2048;
+  static constexpr uint32_t MAGIC = 0x474C5243;  // "CRLG"
+
+  void begin(esp_reset_reason_t reason) {
+    Block& b = block();
+    _reason = reason;
+    _prevLen = 0;
+    _prevUptimeMs = 0;
+    _havePrev = false;
+    const uint32_t head = b.state & 0xFFFF;
+    const uint32_t used = b.state >> 16;
+    if (reason != ESP_RST_POWERON && b.magic == MAGIC && head < BYTES && used <= BYTES) {
+      _havePrev = true;
+      _prevUptimeMs = b.uptimeMs;
+      size_t skip = 0;
+      if (used == BYTES) {
+        while (skip < used && b.text[(head + skip) % BYTES] != '\n') ++skip;
+        if (skip < used) ++skip;
+      }
+      for (size_t i = skip; i < used; ++i) _prev[_prevLen++] = b.text[(head + i) % BYTES];
+    }
+    b.magic = MAGIC;
+    b.state = 0;
+    b.uptimeMs = 0;
+  }
+
+  void append(const char* text, size_t len, uint32_t nowMs) {
+    Block& b = block();
+    uint32_t head = b.state & 0xFFFF;
+    uint32_t used = b.state >> 16;
+    if (len > BYTES - 1) len = BYTES - 1;
+    size_t at = (head + used) % BYTES;
+    const size_t tail = BYTES - at;
+    if (len <= tail) {
+      memcpy(b.text + at, text, len);
+    } else {
+      memcpy(b.text + at, text, tail);
+      memcpy(b.text, text + tail, len - tail);
+    }
+    b.text[(at + len) % BYTES] = '\n';
+    used += len + 1;
+    if (used > BYTES) {
+      head = (head + used - BYTES) % BYTES;
+      used = BYTES;
+    }
+    b.state = head | (used << 16);
+    b.uptimeMs = nowMs;
+  }
+
+  // Keeps the uptime current between lines (one store).
+  void stamp(uint32_t nowMs) { block().uptimeMs = nowMs; }
+
+  bool hasPrevious() const { return _havePrev; }
+  const char* previous() const { return _prev; }
+  size_t previousLen() const { return _prevLen; }
+  // The previous boot's last stamp()/append(): its uptime at the reset,
+  // to within one network pass unless that task was the one stuck.
+  uint32_t previousUptimeMs() const { return _prevUptimeMs; }
+  esp_reset_reason_t resetReason() const { return _reason; }
+
+  static const char* reasonName(esp_reset_reason_t reason) {
+    switch (reason) {
+      case ESP_RST_POWERON:   return "power-on";
+      case ESP_RST_EXT:       return "external";
+      case ESP_RST_SW:        return "software";
+      case ESP_RST_PANIC:     return "panic";
+      case ESP_RST_INT_WDT:   return "int-wdt";
+      case ESP_RST_TASK_WDT:  return "task-wdt";
+      case ESP_RST_WDT:       return "wdt";
+      case ESP_RST_DEEPSLEEP: return "deep-sleep";
+      case ESP_RST_BROWNOUT:  return "brownout";
+      case ESP_RST_SDIO:      return "sdio";
+      default:                return "unknown";
+    }
+  }
+
+private:
+  struct Block {
+    uint32_t magic;
+    uint32_t state;     // head | used << 16
+    uint32_t uptimeMs;
+    char text[BYTES];
+  };
+
+  static Block& block() {
+    static RTC_NOINIT_ATTR Block b;
+    return b;
+  }
+
+  char _prev[BYTES];
+  size_t _prevLen = 0;
+  uint32_t _prevUptimeMs = 0;
+  esp_reset_reason_t _reason = ESP_RST_UNKNOWN;
+  bool _havePrev = false;
+};
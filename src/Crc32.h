@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bitwise CRC-32 (IEEE 802.3, reflected). Small and table-free; records are
+// only a handful of bytes.
+inline uint32_t crc32Ieee(const void* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  while (len--) {
+    crc ^= *p++;
+    for (int i = 0; i < 8; ++i) {
+      uint32_t mask = -(crc & 1);
+      crc = (crc >> 1) ^ (0xEDB88320 & mask);
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+#include "EdgeRing.h"
+
+// Turns level-tagged sensor edges into clicks.
+//
+// A click is the falling edge that closes a low -> high -> low cycle. The
+// level sampled with each edge, not a toggle, decides where the decoder is,
+// so a lost or doubled edge can never shift the phase of later clicks:
+//   - an edge at the level we're already at is a duplicate and dropped;
+//   - unless it arrives a whole cycle after the last transition, in which
+//     case the opposite edge was missed and the skipped click is counted.
+// The half-period estimate that tells the two apart is only kept for
+// timestamped sources; without timestamps a same-level edge is always a
+// duplicate.
+class EdgeDecoder {
+public:
+  struct Stats {
+    uint32_t transitions = 0;  // level changes accepted
+    uint32_t duplicates = 0;   // same-level edges dropped
+    uint32_t resyncs = 0;      // missed edges recovered from timing
+  };
+
+  void reset(bool low) {
+    _low = low;
+    _haveLast = false;
+  }
+
+  // Returns the clicks produced by this edge (0 or 1).
+  uint8_t feed(const EdgeSample& edge, bool timed) {
+    const bool low = (edge.level == 0);
+    const uint32_t dt = edge.us - _lastUs;
+
+    if (low == _low) {
+      if (timed && _haveLast && _halfPeriodUs &&
+          dt >= _halfPeriodUs + _halfPeriodUs / 2) {
+        ++_stats.resyncs;
+        _lastUs = edge.us;
+        return 1;
+      }
+      ++_stats.duplicates;
+      return 0;
+    }
+
+    if (timed && _haveLast) trackHalfPeriod(dt);
+    ++_stats.transitions;
+    _low = low;
+    _lastUs = edge.us;
+    _haveLast = timed;
+    return low ? 1 : 0;
+  }
+
+  bool low() const { return _low; }
+  uint32_t halfPeriodUs() const { return _halfPeriodUs; }
+  const Stats& stats() const { return _stats; }
+
+private:
+  void trackHalfPeriod(uint32_t dt) {
+    if (!_halfPeriodUs) {
+      _halfPeriodUs = dt;
+      return;
+    }
+    // Stop/start gaps aren't cycles; ignore anything far off the estimate.
+    if (dt >= _halfPeriodUs * 4) return;
+    int32_t delta = static_cast<int32_t>(dt) - static_cast<int32_t>(_halfPeriodUs);
+    _halfPeriodUs = static_cast<uint32_t>(static_cast<int32_t>(_halfPeriodUs) + delta / 8);
+  }
+
+  bool _low = false;
+  bool _haveLast = false;
+  uint32_t _lastUs = 0;
+  uint32_t _halfPeriodUs = 0;
+  Stats _stats;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+// One click-sensor edge as seen by the ISR.
+struct EdgeSample {
+  uint32_t us;     // micros() at the edge
+  uint8_t  level;  // pin level sampled right after the edge (1 = HIGH)
+};
+
+// Lock-free single-producer/single-consumer ring. The GPIO ISR pushes, the
+// control loop pops in batches. Indices run free and are masked on access;
+// release/acquire on them publishes the slot contents across cores.
+template <size_t N>
+class EdgeRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "EdgeRing size must be a power of two");
+
+public:
+  // Producer side (ISR). Drops the edge and counts an overflow when full.
+  bool IRAM_ATTR push(uint32_t us, uint8_t level) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    uint32_t used = head - tail;
+    if (used >= N) {
+      _overflows.store(_overflows.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+      return false;
+    }
+    EdgeSample& slot = _buf[head & (N - 1)];
+    slot.us = us;
+    slot.level = level;
+    _head.store(head + 1, std::memory_order_release);
+    if (used + 1 > _highWater.load(std::memory_order_relaxed)) {
+      _highWater.store(used + 1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side. Copies up to max samples, oldest first.
+  size_t pop(EdgeSample* out, size_t max) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+    size_t n = head - tail;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = _buf[(tail + i) & (N - 1)];
+    }
+    _tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer side. Discards everything queued so far.
+  void clear() {
+    _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  size_t pending() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+  }
+
+  uint32_t overflows() const { return _overflows.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  EdgeSample _buf[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+  std::atomic<uint32_t> _overflows{0};
+  std::atomic<uint32_t> _highWater{0};
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Minimal NOR-flash view used by the position log: byte-addressed reads and
+// writes (writes can only clear bits) plus whole-sector erase. The ESP32
+// implementation is PartitionFlashDevice.h; this header stays free of
+// Arduino and ESP-IDF so the log can be built and tested on a PC.
+class FlashDevice {
+public:
+  virtual ~FlashDevice() = default;
+
+  virtual size_t size() const = 0;
+  virtual size_t sectorSize() const = 0;
+  virtual bool read(size_t offset, void* dst, size_t len) = 0;
+  virtual bool write(size_t offset, const void* src, size_t len) = 0;
+  virtual bool eraseSector(size_t sector) = 0;
+};
+
+// RAM-backed device with NOR semantics (erase -> 0xFF, write ANDs bits) for
+// host builds. Torn writes can be staged by limiting the bytes a write
+// actually lands via failAfterBytes().
+template <size_t Sectors, size_t SectorBytes = 4096>
+class RamFlashDevice : public FlashDevice {
+public:
+  RamFlashDevice() { memset(_mem, 0xFF, sizeof(_mem)); }
+
+  size_t size() const override { return sizeof(_mem); }
+  size_t sectorSize() const override { return SectorBytes; }
+
+  bool read(size_t offset, void* dst, size_t len) override {
+    if (offset + len > sizeof(_mem)) return false;
+    memcpy(dst, _mem + offset, len);
+    return true;
+  }
+
+  bool write(size_t offset, const void* src, size_t len) override {
+    if (offset + len > sizeof(_mem)) return false;
+    const uint8_t* p = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < len; ++i) {
+      if (_budget == 0) return false;
+      if (_budget > 0) --_budget;
+      _mem[offset + i] &= p[i];
+    }
+    return true;
+  }
+
+  bool eraseSector(size_t sector) override {
+    if ((sector + 1) * SectorBytes > sizeof(_mem)) return false;
+    memset(_mem + sector * SectorBytes, 0xFF, SectorBytes);
+    return true;
+  }
+
+  // Negative = unlimited; otherwise the number of bytes still written.
+  void failAfterBytes(long bytes) { _budget = bytes; }
+
+private:
+  uint8_t _mem[Sectors * SectorBytes];
+  long _budget = -1;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <Arduino.h>
+
+// Histogram of raw inter-edge intervals used to size the click debounce gate.
+//
+// Buckets are spaced by sqrt(2) from 100 us up. Contact bounce from the
+// PC817 stage lands in short buckets, real half-click intervals in long ones.
+// derive() looks for those two clusters and puts the gate in the empty
+// stretch between them; without a clear gap it reports no result and the
+// caller keeps its fixed fallback.
+class GateLearner {
+public:
+  static constexpr uint8_t  BUCKETS = 20;
+  static constexpr uint32_t MIN_SAMPLES = 64;
+  static constexpr uint32_t DECAY_AT = 4096;     // halve all counts beyond this
+  static constexpr uint32_t GATE_MIN_US = 500;
+  static constexpr uint32_t GATE_MAX_US = 10000;
+
+  struct Result {
+    uint32_t gateUs = 0;
+    uint8_t  confidence = 0;   // percent of samples in the real-edge cluster
+  };
+
+  static uint32_t bucketLowerUs(uint8_t i) {
+    static const uint32_t kLower[BUCKETS] = {
+      100, 141, 200, 283, 400, 566, 800, 1131, 1600, 2263,
+      3200, 4525, 6400, 9051, 12800, 18102, 25600, 36204, 51200, 72408
+    };
+    return kLower[i < BUCKETS ? i : BUCKETS - 1];
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < BUCKETS; ++i) _counts[i] = 0;
+    _total = 0;
+  }
+
+  void add(uint32_t intervalUs) {
+    uint8_t b = 0;
+    while (b + 1 < BUCKETS && intervalUs >= bucketLowerUs(b + 1)) ++b;
+    ++_counts[b];
+    if (++_total >= DECAY_AT) {
+      _total = 0;
+      for (uint8_t i = 0; i < BUCKETS; ++i) {
+        _counts[i] >>= 1;
+        _total += _counts[i];
+      }
+    }
+  }
+
+  bool derive(Result* out) const {
+    if (_total < MIN_SAMPLES) return false;
+
+    // Runs of significant (>= 2 %) buckets; the highest run is the real
+    // edges, the one below it (if any) the bounce.
+    int realStart = -1, realEnd = -1, bounceEnd = -1;
+    uint32_t realMass = 0;
+    int runStart = -1;
+    uint32_t runMass = 0;
+    for (int i = 0; i <= BUCKETS; ++i) {
+      bool sig = (i < BUCKETS) && (_counts[i] * 50UL >= _total);
+      if (sig) {
+        if (runStart < 0) {
+          runStart = i;
+          runMass = 0;
+        }
+        runMass += _counts[i];
+      } else if (runStart >= 0) {
+        if (realEnd >= 0) bounceEnd = realEnd;
+        realStart = runStart;
+        realEnd = i - 1;
+        realMass = runMass;
+        runStart = -1;
+      }
+    }
+    if (realStart < 0) return false;
+    if (realMass * 5UL < _total) return false;   // real cluster under 20 %
+
+    uint32_t realLo = bucketLowerUs(static_cast<uint8_t>(realStart));
+    uint32_t gate;
+    if (bounceEnd < 0) {
+      gate = realLo / 2;
+    } else {
+      uint32_t bounceHi = bucketLowerUs(static_cast<uint8_t>(bounceEnd + 1));
+      if (realLo < bounceHi * 2) return false;   // clusters too close
+      gate = isqrt(static_cast<uint64_t>(bounceHi) * realLo);
+    }
+    if (gate < GATE_MIN_US) gate = GATE_MIN_US;
+    if (gate > GATE_MAX_US) gate = GATE_MAX_US;
+    if (gate * 4UL > realLo * 3UL) return false;  // would eat real edges
+
+    out->gateUs = gate;
+    out->confidence = static_cast<uint8_t>((realMass * 100UL) / _total);
+    return true;
+  }
+
+  uint32_t count(uint8_t i) const { return i < BUCKETS ? _counts[i] : 0; }
+  uint32_t samples() const { return _total; }
+
+private:
+  static uint32_t isqrt(uint64_t v) {
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+      if (v >= r + bit) {
+        v -= r + bit;
+        r = (r >> 1) + bit;
+      } else {
+        r >>= 1;
+      }
+      bit >>= 2;
+    }
+    return static_cast<uint32_t>(r);
+  }
+
+  uint32_t _counts[BUCKETS] = {0};
+  uint32_t _total = 0;
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "LoopProfiler.h"  // Log2Histogram
+
+// Command-to-actuation latency, split by input source, start/stop and stage.
+//
+// Every accepted motion command gets a trace id and is timestamped as it
+// moves through the control path:
+//   input      arrival -> control task accepts it (switch debounce, or
+//              MQTT arrival -> mailbox pickup)
+//   arbitrate  accepted -> it is the commanded motion
+//   relays     commanded -> relays reach it (enable closed / opened)
+//   motion     relays -> first counted click (start) or last coast click
+//              (stop: the motor has actually stopped)
+//   total      arrival -> motion
+//
+// One trace is in flight; a newer command supersedes it. Timestamps are
+// micros() supplied by the caller and motion states are opaque codes, so a
+// recorded event sequence replays unchanged on a host.
+class LatencyTracer {
+public:
+  enum Source : uint8_t { SRC_WALL, SRC_HA, SOURCES };
+  enum Kind : uint8_t { KIND_START, KIND_STOP, KINDS };
+  enum Stage : uint8_t { ST_INPUT, ST_ARBITRATE, ST_RELAYS, ST_MOTION, ST_TOTAL, STAGES };
+
+  static constexpr uint32_t TIMEOUT_US = 15000000;  // never reached the motor
+  using Histogram = Log2Histogram<24>;               // up to ~8.4 s, then open
+
+  struct Summary {
+    uint32_t n;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+  };
+
+  struct Record {
+    uint16_t id;
+    uint8_t source;
+    uint8_t kind;
+    uint32_t stageUs[STAGES];
+  };
+
+  struct Stats {
+    uint32_t seq;          // bumped on every completed trace
+    uint32_t completed;
+    uint32_t superseded;
+    uint32_t dropped;      // timed out before the motor followed
+    Record last;
+    Summary summary[SOURCES][KINDS][STAGES];
+  };
+
+  // stopNeedsCoast: a stop while the motor runs waits for the run summary;
+  // a stop during spin-up ends at the relays.
+  uint16_t begin(Source source, uint8_t target, bool stop, bool stopNeedsCoast,
+                 uint32_t inputUs, uint32_t acceptedUs) {
+    if (_active) ++_stats.superseded;
+    _active = true;
+    _id = ++_nextId;
+    _source = source;
+    _kind = stop ? KIND_STOP : KIND_START;
+    _target = target;
+    _needsCoast = stop && stopNeedsCoast;
+    _next = ST_RELAYS;
+    _t[ST_INPUT] = inputUs;
+    _t[ST_ARBITRATE] = acceptedUs;
+    return _id;
+  }
+
+  // Called every control pass with the commanded and actual relay states.
+  void update(uint8_t commanded, uint8_t relayState, uint32_t nowUs) {
+    if (!_active) return;
+    if (_next == ST_RELAYS && commanded == _target) {
+      _t[ST_RELAYS] = nowUs;
+      _next = ST_MOTION;
+    }
+    if (_next == ST_MOTION && relayState == _target) {
+      _t[ST_MOTION] = nowUs;
+      _next = ST_TOTAL;
+      if (_kind == KIND_STOP && !_needsCoast) finish(nowUs);
+      return;
+    }
+    if (nowUs - _t[ST_INPUT] > TIMEOUT_US) {
+      _active = false;
+      ++_stats.dropped;
+    }
+  }
+
+  bool awaitingClick() const { return _active && _kind == KIND_START && _next == ST_TOTAL; }
+  bool awaitingCoast() const { return _active && _kind == KIND_STOP && _next == ST_TOTAL; }
+
+  // First counted click of a start.
+  void click(uint32_t clickUs) {
+    if (awaitingClick()) finish(clickUs);
+  }
+
+  // Run summary of a stop: the last coast click came coastUs after the
+  // relays dropped (0 when the cover did not coast).
+  void coastDone(uint32_t coastUs) {
+    if (awaitingCoast()) finish(_t[ST_MOTION] + coastUs);
+  }
+
+  bool active() const { return _active; }
+  uint16_t activeId() const { return _id; }
+  const Stats& stats() const { return _stats; }
+  const Histogram& histogram(uint8_t source, uint8_t kind, uint8_t stage) const {
+    return _hist[source][kind][stage];
+  }
+
+  static const char* sourceName(uint8_t s) { return s == SRC_HA ? "ha" : "wall"; }
+  static const char* kindName(uint8_t k) { return k == KIND_STOP ? "stop" : "start"; }
+  static const char* stageName(uint8_t s) {
+    static const char* const names[STAGES] = { "input", "arbitrate", "relays", "motion", "total" };
+    return s < STAGES ? names[s] : "?";
+  }
+
+private:
+  void finish(uint32_t endUs) {
+    Record& r = _stats.last;
+    r.id = _id;
+    r.source = _source;
+    r.kind = _kind;
+    // _t[i] is the start of stage i; the end of the last one is endUs.
+    for (uint8_t i = 0; i < ST_TOTAL; ++i) {
+      uint32_t stageEnd = (i + 1 < ST_TOTAL) ? _t[i + 1] : endUs;
+      r.stageUs[i] = stageEnd - _t[i];
+    }
+    r.stageUs[ST_TOTAL] = endUs - _t[ST_INPUT];
+
+    for (uint8_t i = 0; i < STAGES; ++i) {
+      Histogram& h = _hist[_source][_kind][i];
+      h.add(r.stageUs[i]);
+      Summary& s = _stats.summary[_source][_kind][i];
+      s.n = h.count;
+      s.p50Us = h.percentileUs(0.50f);
+      s.p90Us = h.percentileUs(0.90f);
+      s.p99Us = h.percentileUs(0.99f);
+      s.maxUs = h.maxUs;
+    }
+    ++_stats.completed;
+    ++_stats.seq;
+    _active = false;
+  }
+
+  bool _active = false;
+  bool _needsCoast = false;
+  uint16_t _id = 0;
+  uint16_t _nextId = 0;
+  uint8_t _source = SRC_WALL;
+  uint8_t _kind = KIND_START;
+  uint8_t _target = 0;
+  uint8_t _next = ST_RELAYS;     // stage whose start is stamped next
+  uint32_t _t[ST_TOTAL] = {};    // start time of each stage
+  Stats _stats = {};
+  Histogram _hist[SOURCES][KINDS][STAGES] = {};
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// LZSS-style compressor for log snapshots.
+//
+// The input is the ring buffer itself (up to two spans), so the match
+// window costs no extra RAM; the encoder only keeps a 2 KB hash table of
+// recent positions and one token group. Output goes to a sink in small
+// pieces, and encoding is deterministic, so a caller that has to announce
+// the size first (MQTT beginPublish) runs it once to count, once to send.
+//
+// Stream layout (decoder: tools/decode_log_snapshot.py):
+//   "LGZ1", raw length, first seq, last seq  (uint32 little-endian each)
+//   then groups of one flag byte + 8 tokens, flag bit i (LSB first) set
+//   for a match:
+//     literal  1 byte
+//     match    2 bytes: low 8 bits of (distance - 1), then its high 4 bits
+//              << 4 | min(length - 3, 15); a nibble of 15 adds one byte
+//              (length - 18). Distance 1..4096, length 3..273.
+class LogLz {
+public:
+  static constexpr size_t HEADER_BYTES = 16;
+  static constexpr uint16_t WINDOW = 4096;
+  static constexpr uint8_t MIN_MATCH = 3;
+  static constexpr uint16_t MAX_MATCH = MIN_MATCH + 15 + 255;
+  static constexpr uint8_t HASH_BITS = 10;
+
+  using Sink = void (*)(void* ctx, const uint8_t* data, size_t len);
+
+  static void header(uint8_t out[HEADER_BYTES], uint32_t rawLen, uint32_t firstSeq, uint32_t lastSeq) {
+    memcpy(out, "LGZ1", 4);
+    putU32(out + 4, rawLen);
+    putU32(out + 8, firstSeq);
+    putU32(out + 12, lastSeq);
+  }
+
+  // Compresses a + b as one input (at most 64 KB); returns the number of
+  // bytes handed to sink (header not included). sink may be null to count.
+  size_t encode(const char* a, size_t aLen, const char* b, size_t bLen, Sink sink, void* ctx) {
+    _a = reinterpret_cast<const uint8_t*>(a);
+    _aLen = aLen;
+    _b = reinterpret_cast<const uint8_t*>(b);
+    _n = aLen + bLen;
+    _sink = sink;
+    _ctx = ctx;
+    _out = 0;
+    _groupLen = 1;
+    _group[0] = 0;
+    _tokens = 0;
+    memset(_table, 0, sizeof(_table));
+
+    size_t i = 0;
+    while (i < _n) {
+      size_t len = 0;
+      size_t dist = 0;
+      if (i + MIN_MATCH <= _n) {
+        const uint16_t h = hashAt(i);
+        const size_t cand = _table[h];
+        _table[h] = static_cast<uint16_t>(i + 1);
+        if (cand && i - (cand - 1) <= WINDOW) {
+          size_t c = cand - 1;
+          size_t max = _n - i < MAX_MATCH ? _n - i : MAX_MATCH;
+          while (len < max && at(c + len) == at(i + len)) ++len;
+          dist = i - c;
+        }
+      }
+      if (len >= MIN_MATCH) {
+        emitMatch(dist, len);
+        for (size_t k = i + 1; k < i + len && k + MIN_MATCH <= _n; ++k) {
+          _table[hashAt(k)] = static_cast<uint16_t>(k + 1);
+        }
+        i += len;
+      } else {
+        emitLiteral(at(i));
+        ++i;
+      }
+    }
+    flushGroup();
+    return _out;
+  }
+
+private:
+  static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+  }
+
+  uint8_t at(size_t i) const { return i < _aLen ? _a[i] : _b[i - _aLen]; }
+
+  uint16_t hashAt(size_t i) const {
+    uint32_t v = at(i) | (at(i + 1) << 8) | (static_cast<uint32_t>(at(i + 2)) << 16);
+    return static_cast<uint16_t>((v * 2654435761u) >> (32 - HASH_BITS));
+  }
+
+  void emitLiteral(uint8_t c) {
+    _group[_groupLen++] = c;
+    nextToken();
+  }
+
+  void emitMatch(size_t dist, size_t len) {
+    const size_t d = dist - 1;
+    const size_t l = len - MIN_MATCH;
+    _group[0] |= static_cast<uint8_t>(1u << _tokens);
+    _group[_groupLen++] = static_cast<uint8_t>(d);
+    _group[_groupLen++] = static_cast<uint8_t>(((d >> 8) << 4) | (l < 15 ? l : 15));
+    if (l >= 15) _group[_groupLen++] = static_cast<uint8_t>(l - 15);
+    nextToken();
+  }
+
+  void nextToken() {
+    if (++_tokens == 8) flushGroup();
+  }
+
+  void flushGroup() {
+    if (_tokens) {
+      if (_sink) _sink(_ctx, _group, _groupLen);
+      _out += _groupLen;
+    }
+    _group[0] = 0;
+    _groupLen = 1;
+    _tokens = 0;
+  }
+
+  const uint8_t* _a = nullptr;
+  size_t _aLen = 0;
+  const uint8_t* _b = nullptr;
+  size_t _n = 0;
+  Sink _sink = nullptr;
+  void* _ctx = nullptr;
+  size_t _out = 0;
+
+  uint16_t _table[1u << HASH_BITS];  // last position + 1 per hash, 0 = none
+  uint8_t _group[1 + 8 * 3];
+  uint8_t _groupLen = 1;
+  uint8_t _tokens = 0;
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <Arduino.h>
+#include <cstring>
+
+// Output stage of the network-side log path.
+//
+// line() only copies the text into two fixed buffers: a serial backlog,
+// written by pumpSerial() in chunks the UART TX buffer can take without
+// blocking, and an MQTT batch that the caller publishes as one
+// newline-separated payload per BATCH_INTERVAL_MS, or sooner when the next
+// line would not fit (batchFits()). Lines that find a buffer full are
+// dropped and counted; nothing allocates.
+//
+// The batch is capped at 255 bytes, the longest state Home Assistant keeps
+// for the log_stream sensor.
+class LogDrain {
+public:
+  static constexpr size_t SERIAL_BYTES = 2048;
+  static constexpr size_t BATCH_BYTES = 255;
+  static constexpr uint32_t BATCH_INTERVAL_MS = 250;
+
+  struct Stats {
+    uint32_t lines = 0;
+    uint32_t serialDrops = 0;     // backlog full
+    uint32_t batchDrops = 0;      // batch full, or discarded with no broker
+    uint32_t batches = 0;
+    uint32_t maxBatchLines = 0;
+    uint32_t serialHighWater = 0; // bytes
+  };
+
+  void line(const char* text, size_t len) {
+    ++_stats.lines;
+    queueSerial(text, len);
+    queueBatch(text, len);
+  }
+
+  // Never blocks: writes what the UART can take right now.
+  void pumpSerial() {
+    while (_serialUsed) {
+      int room = Serial.availableForWrite();
+      if (room <= 0) break;
+      size_t chunk = SERIAL_BYTES - _serialHead;
+      if (chunk > _serialUsed) chunk = _serialUsed;
+      if (chunk > static_cast<size_t>(room)) chunk = static_cast<size_t>(room);
+      size_t written = Serial.write(reinterpret_cast<const uint8_t*>(_serial + _serialHead), chunk);
+      if (!written) break;
+      _serialHead = (_serialHead + written) % SERIAL_BYTES;
+      _serialUsed -= written;
+    }
+  }
+
+  // A batch is ready once the oldest line in it has waited
+  // BATCH_INTERVAL_MS, or early when the next line would not fit.
+  bool batchDue(uint32_t nowMs) const {
+    if (!_batchLines) return false;
+    return _batchFull || nowMs - _batchStartMs >= BATCH_INTERVAL_MS;
+  }
+  bool batchFits(size_t len) const {
+    if (len > BATCH_BYTES) len = BATCH_BYTES;
+    return _batchLen + len + (_batchLines ? 1 : 0) <= BATCH_BYTES;
+  }
+
+  const char* batch() const { return _batch; }
+  size_t batchLen() const { return _batchLen; }
+  // The newest line of the batch, for the retained "last line" topic.
+  const char* lastLine() const { return _batch + _lastLineAt; }
+  size_t lastLineLen() const { return _batchLen - _lastLineAt; }
+
+  void batchSent() {
+    ++_stats.batches;
+    clearBatch();
+  }
+
+  // No broker: the lines stay in the ring snapshot only, and count as
+  // batch drops.
+  void discardBatch() {
+    _stats.batchDrops += _batchLines;
+    clearBatch();
+  }
+
+  bool idle() const { return !_serialUsed && !_batchLines; }
+  const Stats& stats() const { return _stats; }
+
+private:
+  void clearBatch() {
+    _batchLen = 0;
+    _batchLines = 0;
+    _lastLineAt = 0;
+    _batchFull = false;
+  }
+
+  void queueSerial(const char* text, size_t len) {
+    if (len + 2 > SERIAL_BYTES - _serialUsed) {
+      ++_stats.serialDrops;
+      return;
+    }
+    putSerial(text, len);
+    putSerial("\r\n", 2);
+    if (_serialUsed > _stats.serialHighWater) _stats.serialHighWater = _serialUsed;
+  }
+
+  void putSerial(const char* text, size_t len) {
+    size_t at = (_serialHead + _serialUsed) % SERIAL_BYTES;
+    size_t tail = SERIAL_BYTES - at;
+    if (len <= tail) {
+      memcpy(_serial + at, text, len);
+    } else {
+      memcpy(_serial + at, text, tail);
+      memcpy(_serial, text + tail, len - tail);
+    }
+    _serialUsed += len;
+  }
+
+  void queueBatch(const char* text, size_t len) {
+    if (len > BATCH_BYTES) len = BATCH_BYTES;
+    size_t need = len + (_batchLines ? 1 : 0);
+    if (_batchLen + need > BATCH_BYTES) {
+      _batchFull = true;
+      ++_stats.batchDrops;
+      return;
+    }
+    if (!_batchLines) _batchStartMs = millis();
+    if (_batchLines) _batch[_batchLen++] = '\n';
+    _lastLineAt = _batchLen;
+    memcpy(_batch + _batchLen, text, len);
+    _batchLen += len;
+    _batch[_batchLen] = '\0';
+    ++_batchLines;
+    if (_batchLines > _stats.maxBatchLines) _stats.maxBatchLines = _batchLines;
+  }
+
+  char _serial[SERIAL_BYTES];
+  size_t _serialHead = 0;
+  size_t _serialUsed = 0;
+
+  char _batch[BATCH_BYTES + 1];
+  size_t _batchLen = 0;
+  size_t _lastLineAt = 0;
+  uint32_t _batchLines = 0;
+  uint32_t _batchStartMs = 0;
+  bool _batchFull = false;
+
+  Stats _stats;
+};
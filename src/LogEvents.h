@@ -0,0 +1,111 @@
+#pragma once
+#include <Arduino.h>
+#include <cstdio>
+#include <initializer_list>
+#include <type_traits>
+
+// Binary log events for lines emitted from the control path.
+//
+// Instead of building a String when something happens, the producer fills a
+// fixed-size LogRecord: event id, millis() stamp and up to MAX_ARGS integer
+// or static-string arguments. Records travel through a preallocated mailbox
+// and are only turned into text (format()) where they are consumed.
+// String arguments are stored as pointers, so they must be string literals
+// or otherwise outlive the record.
+enum class LogId : uint8_t {
+  CTRL_HA_DESIRED,   // motion label
+  CTRL_COMMANDED,    // motion label
+  CTRL_RELAY_STATE,  // motion label
+  MODE,              // mode label
+  RELAYS_ACTION,     // action label
+  CLICK_OVERSHOOT,   // pos, end
+  COUNT
+};
+
+// "{}" is replaced by the next argument.
+inline const char* logFormat(LogId id) {
+  switch (id) {
+    case LogId::CTRL_HA_DESIRED:  return "[CTRL] HA desired -> {}";
+    case LogId::CTRL_COMMANDED:   return "[CTRL] Commanded motion -> {}";
+    case LogId::CTRL_RELAY_STATE: return "[CTRL] Relay state -> {}";
+    case LogId::MODE:             return "[MODE] -> {}";
+    case LogId::RELAYS_ACTION:    return "[RELAYS] Action -> {}";
+    case LogId::CLICK_OVERSHOOT:  return "[CLICK] Motion overshoot detected (pos={}, end={})";
+    default:                      return "[LOG] event {}";
+  }
+}
+
+struct LogArg {
+  bool isStr;
+  union {
+    int32_t i;
+    const char* s;
+  };
+
+  template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+  LogArg(T v) : isStr(false), i(static_cast<int32_t>(v)) {}
+  LogArg(const char* v) : isStr(true), s(v) {}
+};
+
+struct LogRecord {
+  static constexpr uint8_t MAX_ARGS = 4;
+
+  uint32_t ms = 0;
+  uint16_t seq = 0;       // set by the queue owner, orders records vs text lines
+  LogId id = LogId::COUNT;
+  uint8_t argc = 0;
+  uint8_t strMask = 0;    // bit i: args[i] is a string
+  union {
+    int32_t i;
+    const char* s;
+  } args[MAX_ARGS] = {};
+
+  LogRecord() = default;
+  LogRecord(LogId eventId, std::initializer_list<LogArg> list) : ms(millis()), id(eventId) {
+    for (const LogArg& a : list) {
+      if (argc == MAX_ARGS) break;
+      if (a.isStr) {
+        args[argc].s = a.s;
+        strMask |= 1u << argc;
+      } else {
+        args[argc].i = a.i;
+      }
+      ++argc;
+    }
+  }
+
+  // Writes the text line (NUL-terminated, truncated to cap); returns its length.
+  size_t format(char* out, size_t cap) const {
+    if (!cap) return 0;
+    const char* f = logFormat(id);
+    size_t n = 0;
+    uint8_t next = 0;
+    auto put = [&](char c) { if (n + 1 < cap) out[n++] = c; };
+    while (*f) {
+      if (f[0] == '{' && f[1] == '}') {
+        f += 2;
+        if (next >= argc) continue;
+        if (strMask & (1u << next)) {
+          for (const char* s = args[next].s ? args[next].s : "?"; *s; ++s) put(*s);
+        } else {
+          char num[12];
+          int len = snprintf(num, sizeof(num), "%ld", static_cast<long>(args[next].i));
+          for (int k = 0; k < len; ++k) put(num[k]);
+        }
+        ++next;
+      } else {
+        put(*f++);
+      }
+    }
+    out[n] = '\0';
+    return n;
+  }
+
+  String toString() const {
+    char buf[160];
+    format(buf, sizeof(buf));
+    return String(buf);
+  }
+};
+
+using LogEventFn = void (*)(const LogRecord&);
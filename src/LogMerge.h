@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+// Network side of the two log queues: text lines and events merged back
+// into the order they were logged.
+//
+// Only queued records take a seq, so the numbering has no gaps: the next
+// line is whichever head carries expected(). If neither does, that record
+// is still being pushed and a later pass picks it up; after MAX_MISSES
+// passes the older head is taken instead, so a lost record cannot stall
+// the log.
+class LogMerge {
+public:
+  static constexpr uint8_t MAX_MISSES = 8;
+
+  enum class Take : uint8_t { NONE, TEXT, EVENT };
+
+  // textSeq / eventSeq: the seq at the head of each queue, null when it is
+  // empty. Returns the queue to pop next; NONE ends this pass.
+  Take next(const uint16_t* textSeq, const uint16_t* eventSeq) {
+    if (!textSeq && !eventSeq) return Take::NONE;
+    Take take;
+    if (textSeq && *textSeq == _next) {
+      take = Take::TEXT;
+    } else if (eventSeq && *eventSeq == _next) {
+      take = Take::EVENT;
+    } else {
+      if (++_misses < MAX_MISSES) return Take::NONE;
+      take = textSeq && (!eventSeq || static_cast<int16_t>(*textSeq - *eventSeq) < 0) ? Take::TEXT : Take::EVENT;
+      ++_skips;
+    }
+    _misses = 0;
+    _next = static_cast<uint16_t>((take == Take::TEXT ? *textSeq : *eventSeq) + 1);
+    return take;
+  }
+
+  uint16_t expected() const { return _next; }
+  // Heads taken out of turn after MAX_MISSES passes.
+  uint32_t skips() const { return _skips; }
+
+private:
+  uint16_t _next = 0;
+  uint8_t _misses = 0;
+  uint32_t _skips = 0;
+};
@@ -0,0 +1,195 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Per-section timing histograms for a periodic loop.
+//
+// Each section keeps a count, sum, max and a log2 histogram of durations in
+// microseconds (see Log2Histogram). The owning task marks section boundaries
+// with lap() or wraps a call in a Scope, and calls roll() once per window;
+// the completed window is what gets published. One profiler per task: it is
+// not safe to record into from two tasks.
+//
+// Build with -DLOOP_PROFILER_ENABLED=0 to drop the PROFILE_* call sites and
+// the profilers themselves. The header has no Arduino dependency so the same
+// scopes can be timed in a host build.
+#ifndef LOOP_PROFILER_ENABLED
+#define LOOP_PROFILER_ENABLED 1
+#endif
+
+#if defined(ARDUINO)
+#include <esp_timer.h>
+inline uint32_t profilerNowUs() { return static_cast<uint32_t>(esp_timer_get_time()); }
+#else
+#include <chrono>
+inline uint32_t profilerNowUs() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(
+      duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+#endif
+
+// Log2 histogram of microsecond durations: octave i holds [2^i, 2^(i+1))
+// us, octave 0 also holds 0 us, and the last octave is open-ended. Each
+// octave is split into SUB equal slices so percentiles come out within a
+// few percent instead of up to 2x; bucket(i) still reports whole octaves.
+template <uint8_t N, uint8_t SUB = 4>
+struct Log2Histogram {
+  static constexpr uint8_t BUCKETS = N;
+  static constexpr uint8_t SUB_BUCKETS = SUB;
+
+  uint32_t count;
+  uint32_t maxUs;
+  uint64_t sumUs;
+  uint32_t slices[N * SUB];
+
+  void add(uint32_t us) {
+    ++count;
+    sumUs += us;
+    if (us > maxUs) maxUs = us;
+    ++slices[sliceFor(us)];
+  }
+
+  uint32_t meanUs() const { return count ? static_cast<uint32_t>(sumUs / count) : 0; }
+
+  // Samples in octave i.
+  uint32_t bucket(uint8_t i) const {
+    if (i >= N) return 0;
+    uint32_t n = 0;
+    for (uint8_t j = 0; j < SUB; ++j) n += slices[i * SUB + j];
+    return n;
+  }
+
+  // The p-th fraction, interpolated linearly inside its slice and capped
+  // at max.
+  uint32_t percentileUs(float p) const {
+    if (!count) return 0;
+    uint32_t rank = static_cast<uint32_t>(p * static_cast<float>(count) + 0.5f);
+    if (rank < 1) rank = 1;
+    uint32_t seen = 0;
+    for (uint16_t s = 0; s < N * SUB; ++s) {
+      if (seen + slices[s] < rank) {
+        seen += slices[s];
+        continue;
+      }
+      const uint32_t lo = sliceLowerUs(s);
+      const uint32_t hi = (s + 1 < N * SUB) ? sliceLowerUs(s + 1) : maxUs;
+      const uint64_t span = hi > lo ? hi - lo : 0;
+      const uint32_t at = lo + static_cast<uint32_t>(span * (rank - seen) / slices[s]);
+      return at < maxUs ? at : maxUs;
+    }
+    return maxUs;
+  }
+
+  static uint8_t bucketFor(uint32_t us) {
+    uint8_t b = 0;
+    while (us > 1 && b < N - 1) {
+      us >>= 1;
+      ++b;
+    }
+    return b;
+  }
+
+  static uint16_t sliceFor(uint32_t us) {
+    const uint8_t b = bucketFor(us);
+    const uint64_t j = (static_cast<uint64_t>(us - octaveLowerUs(b)) * SUB) / octaveWidthUs(b);
+    return static_cast<uint16_t>(b * SUB + (j < SUB ? j : SUB - 1));
+  }
+
+  static uint32_t sliceLowerUs(uint16_t s) {
+    const uint8_t b = static_cast<uint8_t>(s / SUB);
+    return octaveLowerUs(b) + static_cast<uint32_t>(
+        static_cast<uint64_t>(octaveWidthUs(b)) * (s % SUB) / SUB);
+  }
+
+  static uint32_t octaveLowerUs(uint8_t b) { return b ? (1u << b) : 0; }
+  static uint32_t octaveWidthUs(uint8_t b) { return b ? (1u << b) : 2; }
+};
+
+class LoopProfiler {
+public:
+  static constexpr uint8_t MAX_SECTIONS = 10;
+  static constexpr uint8_t BUCKETS = 16;  // up to 32.8 ms, then open
+
+  using Section = Log2Histogram<BUCKETS>;
+
+  struct Window {
+    uint32_t seq = 0;       // bumped by every roll()
+    uint32_t lengthMs = 0;
+    uint8_t sections = 0;
+    Section section[MAX_SECTIONS] = {};
+  };
+
+  // names must outlive the profiler (string literals).
+  LoopProfiler(const char* const* names, uint8_t count)
+    : _names(names), _count(count > MAX_SECTIONS ? MAX_SECTIONS : count) {
+    _live.sections = _count;
+    _last.sections = _count;
+  }
+
+  const char* name(uint8_t i) const { return i < _count ? _names[i] : "?"; }
+  uint8_t sections() const { return _count; }
+
+  void record(uint8_t section, uint32_t us) {
+    if (section >= _count) return;
+    _live.section[section].add(us);
+  }
+
+  // Sequential sections: start() at the top of the pass, then lap(section)
+  // after each one charges the time since the previous mark to it.
+  void start() { _markUs = profilerNowUs(); }
+  void lap(uint8_t section) {
+    uint32_t now = profilerNowUs();
+    record(section, now - _markUs);
+    _markUs = now;
+  }
+
+  class Scope {
+  public:
+    Scope(LoopProfiler& p, uint8_t section) : _p(p), _section(section), _startUs(profilerNowUs()) {}
+    ~Scope() { _p.record(_section, profilerNowUs() - _startUs); }
+  private:
+    LoopProfiler& _p;
+    uint8_t _section;
+    uint32_t _startUs;
+  };
+
+  // Closes the window once windowMs has passed; returns true when it did.
+  bool roll(uint32_t nowMs, uint32_t windowMs) {
+    if (nowMs - _windowStartMs < windowMs) return false;
+    uint32_t seq = _last.seq + 1;
+    _last = _live;
+    _last.seq = seq;
+    _last.lengthMs = nowMs - _windowStartMs;
+    memset(_live.section, 0, sizeof(_live.section));
+    _windowStartMs = nowMs;
+    return true;
+  }
+
+  const Window& last() const { return _last; }
+
+private:
+  const char* const* _names;
+  uint8_t _count;
+  uint32_t _markUs = 0;
+  uint32_t _windowStartMs = 0;
+  Window _live;
+  Window _last;
+};
+
+#if LOOP_PROFILER_ENABLED
+#define PROFILE_CAT_(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT_(a, b)
+#define PROFILE_START(prof) (prof).start()
+#define PROFILE_LAP(prof, section) (prof).lap(section)
+#define PROFILE_RECORD(prof, section, us) (prof).record((section), (us))
+#define PROFILE_SCOPE(prof, section) \
+  LoopProfiler::Scope PROFILE_CAT(_profScope, __LINE__)((prof), (section))
+#define PROFILE_ROLL(prof, nowMs, windowMs) (prof).roll((nowMs), (windowMs))
+#else
+#define PROFILE_START(prof) do {} while (0)
+#define PROFILE_LAP(prof, section) do {} while (0)
+#define PROFILE_RECORD(prof, section, us) do {} while (0)
+#define PROFILE_SCOPE(prof, section) do {} while (0)
+#define PROFILE_ROLL(prof, nowMs, windowMs) do {} while (0)
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+// Bounded single-producer / single-consumer queue for passing fixed-size
+// messages between the control and network tasks. No locks, no heap: a
+// full queue drops the new message and counts it.
+template <typename T, size_t N>
+class Mailbox {
+  static_assert((N & (N - 1)) == 0, "Mailbox size must be a power of two");
+
+public:
+  bool push(const T& item) {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    const uint32_t tail = _tail.load(std::memory_order_acquire);
+    if (head - tail >= N) {
+      _drops.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    _slots[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    uint32_t depth = head + 1 - tail;
+    if (depth > _highWater.load(std::memory_order_relaxed)) {
+      _highWater.store(depth, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  bool pop(T* out) {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    const uint32_t head = _head.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    *out = _slots[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: the oldest message without removing it (nullptr when
+  // empty). Stays valid until the next pop().
+  const T* peek() const {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    const uint32_t head = _head.load(std::memory_order_acquire);
+    if (head == tail) return nullptr;
+    return &_slots[tail & (N - 1)];
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t drops() const { return _drops.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+  T _slots[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+  std::atomic<uint32_t> _drops{0};
+  std::atomic<uint32_t> _highWater{0};
+};
+
+// Latest-value slot (triple buffer): the writer never waits and the reader
+// always gets the newest complete value. Used for state snapshots, where
+// only the most recent one matters.
+template <typename T>
+class LatestValue {
+public:
+  // Writer side: fill back(), then publish().
+  T& back() { return _buf[_back]; }
+  void publish() {
+    uint8_t prev = _middle.exchange(static_cast<uint8_t>(_back | FRESH), std::memory_order_acq_rel);
+    _back = prev & INDEX;
+  }
+
+  // Reader side: true if a newer value was swapped in since the last call.
+  bool fetch() {
+    if (!(_middle.load(std::memory_order_acquire) & FRESH)) return false;
+    uint8_t prev = _middle.exchange(_front, std::memory_order_acq_rel);
+    _front = prev & INDEX;
+    return true;
+  }
+  const T& front() const { return _buf[_front]; }
+
+private:
+  static constexpr uint8_t INDEX = 0x03;
+  static constexpr uint8_t FRESH = 0x04;
+
+  T _buf[3]{};
+  uint8_t _back = 0;
+  uint8_t _front = 1;
+  std::atomic<uint8_t> _middle{2};
+};
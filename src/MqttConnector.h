@@ -0,0 +1,192 @@
+#pragma once
+#include <Arduino.h>
+#include <lwip/sockets.h>
+
+// Broker connection attempts without blocking the caller.
+//
+// The TCP handshake runs on a non-blocking socket that poll() checks with a
+// zero-timeout select(), so an unreachable or blackholed broker costs the
+// network loop nothing while the attempt is pending. Once the socket is up,
+// the caller wraps it in a WiFiClient and lets PubSubClient send CONNECT
+// over it (that part only waits on a broker that already answered the SYN).
+//
+// Failed attempts back off exponentially with jitter, so a device fleet
+// that lost the broker together does not reconnect in lockstep. Attempt
+// durations and failure reasons are kept as small histograms.
+class MqttConnector {
+public:
+  static constexpr uint32_t BACKOFF_MIN_MS = 1000;
+  static constexpr uint32_t BACKOFF_MAX_MS = 60000;
+  static constexpr uint32_t TCP_TIMEOUT_MS = 5000;
+
+  enum class Poll : uint8_t { PENDING, READY, FAILED };
+
+  enum class Failure : uint8_t {
+    DNS,            // broker host did not resolve
+    TCP_TIMEOUT,    // no SYN-ACK within TCP_TIMEOUT_MS
+    TCP_REFUSED,    // RST from the broker host
+    TCP_ERROR,      // anything else at the socket level
+    MQTT_TIMEOUT,   // TCP up, no CONNACK
+    MQTT_REJECTED,  // CONNACK with a non-zero return code
+    LOST,           // an established session dropped
+    COUNT
+  };
+
+  // Upper bounds (ms) of the duration buckets; the last bucket is open.
+  static constexpr uint8_t DURATION_BUCKETS = 8;
+  static uint32_t durationBoundMs(uint8_t i) {
+    static const uint16_t bounds[DURATION_BUCKETS - 1] = { 25, 50, 100, 250, 500, 1000, 2500 };
+    return i < DURATION_BUCKETS - 1 ? bounds[i] : UINT32_MAX;
+  }
+
+  struct Stats {
+    uint32_t attempts = 0;
+    uint32_t connects = 0;
+    uint32_t lastConnectMs = 0;
+    uint32_t maxConnectMs = 0;
+    uint32_t durations[DURATION_BUCKETS] = {};
+    uint32_t failures[static_cast<uint8_t>(Failure::COUNT)] = {};
+  };
+
+  ~MqttConnector() { closeSocket(); }
+
+  bool pending() const { return _fd >= 0; }
+  bool due(uint32_t nowMs) const { return !pending() && (int32_t)(nowMs - _nextAttemptMs) >= 0; }
+  uint32_t backoffMs() const { return _backoffMs; }
+  uint32_t retryInMs(uint32_t nowMs) const {
+    return (int32_t)(_nextAttemptMs - nowMs) > 0 ? _nextAttemptMs - nowMs : 0;
+  }
+  const Stats& stats() const { return _stats; }
+  Failure lastFailure() const { return _lastFailure; }
+
+  // Starts the TCP handshake. addrBe is the IPv4 address in network order.
+  // Returns false if the attempt failed on the spot (already recorded).
+  bool begin(uint32_t addrBe, uint16_t port, uint32_t nowMs) {
+    closeSocket();
+    ++_stats.attempts;
+    _startMs = nowMs;
+    _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_fd < 0) {
+      fail(Failure::TCP_ERROR, nowMs);
+      return false;
+    }
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = addrBe;
+    int rc = connect(_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    if (rc < 0 && errno != EINPROGRESS) {
+      fail(errno == ECONNREFUSED ? Failure::TCP_REFUSED : Failure::TCP_ERROR, nowMs);
+      return false;
+    }
+    return true;
+  }
+
+  // Never waits. READY means takeSocket() holds a connected socket.
+  Poll poll(uint32_t nowMs) {
+    if (_fd < 0) return Poll::FAILED;
+
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(_fd, &wfds);
+    struct timeval tv = { 0, 0 };
+    int rc = select(_fd + 1, nullptr, &wfds, nullptr, &tv);
+    if (rc < 0) {
+      fail(Failure::TCP_ERROR, nowMs);
+      return Poll::FAILED;
+    }
+    if (rc == 0) {
+      if (nowMs - _startMs < TCP_TIMEOUT_MS) return Poll::PENDING;
+      fail(Failure::TCP_TIMEOUT, nowMs);
+      return Poll::FAILED;
+    }
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+    if (err != 0) {
+      fail(err == ECONNREFUSED ? Failure::TCP_REFUSED : Failure::TCP_ERROR, nowMs);
+      return Poll::FAILED;
+    }
+
+    // Hand over in the same mode WiFiClient::connect() leaves its sockets.
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) & ~O_NONBLOCK);
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return Poll::READY;
+  }
+
+  // Ownership of the socket passes to the caller.
+  int takeSocket() {
+    int fd = _fd;
+    _fd = -1;
+    return fd;
+  }
+
+  // The broker accepted the session: record the duration, reset backoff.
+  void succeeded(uint32_t nowMs) {
+    uint32_t ms = nowMs - _startMs;
+    _stats.lastConnectMs = ms;
+    if (ms > _stats.maxConnectMs) _stats.maxConnectMs = ms;
+    uint8_t b = 0;
+    while (ms > durationBoundMs(b)) ++b;
+    ++_stats.durations[b];
+    ++_stats.connects;
+    _backoffMs = 0;
+  }
+
+  void fail(Failure reason, uint32_t nowMs) {
+    closeSocket();
+    _lastFailure = reason;
+    ++_stats.failures[static_cast<uint8_t>(reason)];
+    // A drop after a good session retries soon; repeated failures double.
+    if (reason == Failure::LOST || !_backoffMs) {
+      _backoffMs = BACKOFF_MIN_MS;
+    } else if (_backoffMs < BACKOFF_MAX_MS / 2) {
+      _backoffMs *= 2;
+    } else {
+      _backoffMs = BACKOFF_MAX_MS;
+    }
+    // Equal jitter: half fixed, half random.
+    uint32_t half = _backoffMs / 2;
+    _nextAttemptMs = nowMs + half + static_cast<uint32_t>(random(0, static_cast<long>(half) + 1));
+  }
+
+  // The network came back: the next attempt need not wait out a backoff
+  // that grew while the broker was unreachable for a different reason.
+  void resetBackoff(uint32_t nowMs) {
+    _backoffMs = 0;
+    _nextAttemptMs = nowMs;
+  }
+
+  static const char* failureName(Failure f) {
+    switch (f) {
+      case Failure::DNS:           return "dns";
+      case Failure::TCP_TIMEOUT:   return "tcp_timeout";
+      case Failure::TCP_REFUSED:   return "tcp_refused";
+      case Failure::TCP_ERROR:     return "tcp_error";
+      case Failure::MQTT_TIMEOUT:  return "mqtt_timeout";
+      case Failure::MQTT_REJECTED: return "mqtt_rejected";
+      case Failure::LOST:          return "lost";
+      default:                     return "?";
+    }
+  }
+
+private:
+  void closeSocket() {
+    if (_fd >= 0) {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+
+  int _fd = -1;
+  uint32_t _startMs = 0;
+  uint32_t _nextAttemptMs = 0;
+  uint32_t _backoffMs = 0;
+  Failure _lastFailure = Failure::COUNT;
+  Stats _stats;
+};
@@ -4,16 +4,19 @@
 #include <WiFiClient.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
-#include <vector>
 #include "mqtt_config.h"
 #include "StatusStore.h"
-#include "ClickCounter.h"
+#include "ControlLink.h"
+#include "MqttConnector.h"
+#include "RingLogger.h"     // LogSpans
+#include "LogDrain.h"
+#include "LogCodec.h"
+#include "WifiModule.h"
 #include "AnalogController.h"
 
 class MqttModule {
 public:
   using LogFn = void (*)(const String&);
-  using MaxRuntimeHandler = void (*)(uint32_t seconds);
 
   explicit MqttModule(StatusStore& store, LogFn logger = nullptr)
     : _store(store), _wifiClient(), _mqtt(_wifiClient), _log(logger) {}
@@ -24,31 +27,28 @@ public:
       this->onMessage(topic, payload, len);
     });
     _mqtt.setKeepAlive(20);        // seconds
-    _mqtt.setSocketTimeout(5);     // seconds
+    _mqtt.setSocketTimeout(2);     // seconds; CONNACK wait once TCP is up
     _mqtt.setBufferSize(MQTT_MAX_PACKET_SIZE);
-    _lastConnTry = 0;
     _lastHeartbeat = 0;
     _lastStatePub = 0;
     _haLastSeen = 0;
     _haConnected = false;
-    _cmdQueue.clear();
   }
 
-  void setMaxRuntimeHandler(MaxRuntimeHandler handler) {
-    _maxRuntimeHandler = handler;
-  }
+  // Commands from the broker are handed to the control task through here.
+  void setControlLink(ControlLink* link) { _link = link; }
+
+  // Connection timing for the state JSON (both live on the network task).
+  void setWifi(const WifiModule* wifi) { _wifi = wifi; }
+  void setLogDrain(const LogDrain* drain) { _logDrain = drain; }
+  // log_fetch {"since_seq": n, "max_bytes": b} is answered by the log owner.
+  using LogFetchFn = void (*)(uint32_t sinceSeq, uint32_t maxBytes);
+  void setLogFetch(LogFetchFn fn) { _logFetch = fn; }
+  // log_snapshot: the whole ring, compressed, on log_lz.
+  using LogSnapshotFn = void (*)();
+  void setLogSnapshot(LogSnapshotFn fn) { _logSnapshot = fn; }
 
-  void update(const char* modeStr,
-              MotionState action,
-              MotionState analogState,
-              const char* analogLabel,
-              bool setModeActive,
-              bool panicActive,
-              const ClickCounter& clicks,
-              uint32_t safetyMaxRunSeconds,
-              uint32_t safetyElapsedSeconds,
-              bool safetyActive,
-              uint32_t noClickGuardSeconds) {
+  void update(const ControlSnapshot& snap) {
     ensureConnected();
 
     const unsigned long now = millis();
@@ -61,20 +61,21 @@ public:
       publishJson(TOPIC_HEARTBEAT, doc, /*retain=*/false);
     }
 
-    if (_mqtt.connected() && (now - _lastStatePub > 1000UL)) {
+    const unsigned long statePeriod =
+        (snap.action != MotionState::IDLE) ? STATE_PUB_DRIVE_MS : STATE_PUB_IDLE_MS;
+    if (_mqtt.connected() && (now - _lastStatePub >= statePeriod)) {
       _lastStatePub = now;
-      publishState(now,
-                   modeStr,
-                   action,
-                   analogState,
-                   analogLabel,
-                   setModeActive,
-                   panicActive,
-                   clicks,
-                   safetyMaxRunSeconds,
-                   safetyElapsedSeconds,
-                   safetyActive,
-                   noClickGuardSeconds);
+      publishState(now, snap);
+    }
+
+    if (_mqtt.connected() && snap.gate.seq != _lastGateSeq) {
+      _lastGateSeq = snap.gate.seq;
+      publishClickDiag(snap);
+    }
+
+    if (_mqtt.connected() && snap.run.seq != _lastRunSeq) {
+      _lastRunSeq = snap.run.seq;
+      publishRun(snap);
     }
 
     updateHaRow(now);
@@ -84,29 +85,127 @@ public:
     }
   }
 
-  MotionState desiredFromHA() const { return _haDesired; }
-  void clearHaDesired() { _haDesired = MotionState::IDLE; }
-
   bool haConnected() const { return _haConnected; }
   bool isConnected() { return _mqtt.connected(); }
 
-  bool hasPendingCommand() const { return !_cmdQueue.empty(); }
-  String popCommand() {
-    if (_cmdQueue.empty()) return String();
-    String cmd = _cmdQueue.front();
-    _cmdQueue.erase(_cmdQueue.begin());
-    return cmd;
+  // One batch of lines on the stream topic, its newest line as "last".
+  void publishLogBatch(const LogDrain& drain) {
+    if (!_mqtt.connected()) return;
+    _mqtt.publish(TOPIC_LOG_STREAM, reinterpret_cast<const uint8_t*>(drain.batch()),
+                  drain.batchLen(), /*retained=*/false);
+    _mqtt.publish(TOPIC_LOG_LAST, reinterpret_cast<const uint8_t*>(drain.lastLine()),
+                  drain.lastLineLen(), /*retained=*/true);
   }
 
-  void publishLogLine(const String& line) {
-    if (!_mqtt.connected()) return;
-    _mqtt.publish(TOPIC_LOG_STREAM, line.c_str(), /*retain=*/false);
-    _mqtt.publish(TOPIC_LOG_LAST, line.c_str(), /*retain=*/true);
+  // A run of log lines under an "@first-last newest" header line, streamed
+  // from the ring buffer in place.
+  bool publishLogPage(const char* topic, uint32_t first, uint32_t last, uint32_t newest,
+                      const LogSpans& lines, bool retain) {
+    if (!_mqtt.connected()) return false;
+    char header[40];
+    int n = snprintf(header, sizeof(header), "@%lu-%lu %lu\n", (unsigned long)first,
+                     (unsigned long)last, (unsigned long)newest);
+    if (!_mqtt.beginPublish(topic, n + lines.size(), retain)) return false;
+    _mqtt.write(reinterpret_cast<const uint8_t*>(header), n);
+    if (lines.firstLen) _mqtt.write(reinterpret_cast<const uint8_t*>(lines.first), lines.firstLen);
+    if (lines.secondLen) _mqtt.write(reinterpret_cast<const uint8_t*>(lines.second), lines.secondLen);
+    return _mqtt.endPublish() != 0;
+  }
+
+  // The previous boot's log tail under an "@reset-reason uptime_ms" header.
+  bool publishPreviousBoot(const char* reason, uint32_t uptimeMs, const char* text, size_t len) {
+    if (!_mqtt.connected()) return false;
+    char header[40];
+    int n = snprintf(header, sizeof(header), "@%s %lu\n", reason, (unsigned long)uptimeMs);
+    if (!_mqtt.beginPublish(TOPIC_LOG_PREV, n + len, /*retain=*/true)) return false;
+    _mqtt.write(reinterpret_cast<const uint8_t*>(header), n);
+    if (len) _mqtt.write(reinterpret_cast<const uint8_t*>(text), len);
+    return _mqtt.endPublish() != 0;
+  }
+
+  // The whole ring, LogLz-compressed (tools/decode_log_snapshot.py).
+  // Encoded twice: once to learn the size, once into the publish.
+  bool publishLogCompressed(uint32_t first, uint32_t last, const LogSpans& lines) {
+    if (!_mqtt.connected()) return false;
+    size_t packed = _lz.encode(lines.first, lines.firstLen, lines.second, lines.secondLen, nullptr, nullptr);
+    uint8_t header[LogLz::HEADER_BYTES];
+    LogLz::header(header, lines.size(), first, last);
+    if (!_mqtt.beginPublish(TOPIC_LOG_LZ, sizeof(header) + packed, /*retain=*/true)) return false;
+    _mqtt.write(header, sizeof(header));
+    _lz.encode(lines.first, lines.firstLen, lines.second, lines.secondLen,
+               [](void* ctx, const uint8_t* data, size_t len) {
+                 static_cast<PubSubClient*>(ctx)->write(data, len);
+               }, &_mqtt);
+    bool ok = _mqtt.endPublish() != 0;
+    if (_log) {
+      _log(String(F("[LOG] Snapshot ")) + lines.size() + F(" B -> ") +
+           (sizeof(header) + packed) + F(" B compressed"));
+    }
+    return ok;
+  }
+
+  // Latency stats, each time another trace completes.
+  void publishLatency(const LatencyTracer::Stats& lat) {
+    StaticJsonDocument<3072> doc;
+    doc["seq"] = lat.seq;
+    doc["completed"] = lat.completed;
+    doc["superseded"] = lat.superseded;
+    doc["dropped"] = lat.dropped;
+
+    JsonObject last = doc.createNestedObject("last");
+    last["id"] = lat.last.id;
+    last["source"] = LatencyTracer::sourceName(lat.last.source);
+    last["kind"] = LatencyTracer::kindName(lat.last.kind);
+    for (uint8_t st = 0; st < LatencyTracer::STAGES; ++st) {
+      last[LatencyTracer::stageName(st)] = usToMs(lat.last.stageUs[st]);
+    }
+
+    // {source: {kind: {stage: {n, p50, p90, p99, max}}}}, milliseconds.
+    for (uint8_t src = 0; src < LatencyTracer::SOURCES; ++src) {
+      JsonObject bySource = doc.createNestedObject(LatencyTracer::sourceName(src));
+      for (uint8_t kind = 0; kind < LatencyTracer::KINDS; ++kind) {
+        if (!lat.summary[src][kind][LatencyTracer::ST_TOTAL].n) continue;
+        JsonObject byKind = bySource.createNestedObject(LatencyTracer::kindName(kind));
+        for (uint8_t st = 0; st < LatencyTracer::STAGES; ++st) {
+          const LatencyTracer::Summary& s = lat.summary[src][kind][st];
+          JsonObject o = byKind.createNestedObject(LatencyTracer::stageName(st));
+          o["n"] = s.n;
+          o["p50"] = usToMs(s.p50Us);
+          o["p90"] = usToMs(s.p90Us);
+          o["p99"] = usToMs(s.p99Us);
+          o["max"] = usToMs(s.maxUs);
+        }
+      }
+    }
+    publishJson(TOPIC_LATENCY, doc, /*retain=*/true);
   }
 
-  void publishLogSnapshot(const String& blob) {
+  // One profiler window. Histograms are whole octaves starting at the first
+  // non-empty one ("lo"); octave i covers [2^i, 2^(i+1)) us.
+  void publishProfile(const char* task, const char* const* names, const LoopProfiler::Window& w) {
     if (!_mqtt.connected()) return;
-    _mqtt.publish(TOPIC_LOG_BLOB, blob.c_str(), /*retain=*/true);
+    StaticJsonDocument<3072> doc;
+    doc["task"] = task;
+    doc["seq"] = w.seq;
+    doc["window_ms"] = w.lengthMs;
+    JsonObject sections = doc.createNestedObject("sections");
+    for (uint8_t i = 0; i < w.sections; ++i) {
+      const LoopProfiler::Section& sec = w.section[i];
+      JsonObject o = sections.createNestedObject(names[i]);
+      o["n"] = sec.count;
+      o["mean_us"] = sec.meanUs();
+      o["p50_us"] = sec.percentileUs(0.50f);
+      o["p99_us"] = sec.percentileUs(0.99f);
+      o["max_us"] = sec.maxUs;
+      uint8_t lo = 0;
+      uint8_t hi = LoopProfiler::BUCKETS;
+      while (lo < hi && !sec.bucket(lo)) ++lo;
+      while (hi > lo && !sec.bucket(hi - 1)) --hi;
+      o["lo"] = lo;
+      JsonArray hist = o.createNestedArray("hist");
+      for (uint8_t b = lo; b < hi; ++b) hist.add(sec.bucket(b));
+    }
+    publishJson(TOPIC_METRICS, doc, /*retain=*/false);
   }
 
 private:
@@ -115,28 +214,75 @@ private:
   StatusStore& _store;
   WiFiClient _wifiClient;
   PubSubClient _mqtt;
-  unsigned long _lastConnTry{0};
+  MqttConnector _connector;
+  bool _sessionUp{false};
+  bool _wifiUp{false};
   unsigned long _lastHeartbeat{0};
   unsigned long _lastStatePub{0};
   unsigned long _haLastSeen{0};
   bool _haConnected{false};
-  MotionState _haDesired{MotionState::IDLE};
-  std::vector<String> _cmdQueue;
+  ControlLink* _link{nullptr};
+  const WifiModule* _wifi{nullptr};
+  const LogDrain* _logDrain{nullptr};
+  LogFetchFn _logFetch{nullptr};
+  LogSnapshotFn _logSnapshot{nullptr};
+  LogLz _lz;
   LogFn _log{nullptr};
+  char _json[3072];  // serialized documents; the state one is past 2 KB
+  uint32_t _jsonDrops{0};  // documents too big to publish whole
   unsigned long _lastHaStaleLog{0};
-  MaxRuntimeHandler _maxRuntimeHandler{nullptr};
+  uint32_t _lastGateSeq{0};
+  uint32_t _lastRunSeq{0};
 
+  // Never blocks on an unreachable broker: the TCP handshake is polled by
+  // MqttConnector and PubSubClient only runs the MQTT CONNECT over the
+  // already-open socket.
   void ensureConnected() {
+    const uint32_t now = millis();
+
     if (_mqtt.connected()) return;
 
-    const unsigned long now = millis();
-    if (now - _lastConnTry < 2000UL) return;
-    _lastConnTry = now;
+    if (_sessionUp) {
+      _sessionUp = false;
+      _connector.fail(MqttConnector::Failure::LOST, now);
+      if (_log) _log(String(F("[MQTT] Session lost, state=")) + _mqtt.state() +
+                     F(", retry in ") + _connector.retryInMs(now) + F(" ms"));
+    }
 
-    String clientId = String(DEVICE_NAME) + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
-    String target = String(MQTT_BROKER_HOST) + ":" + String(MQTT_BROKER_PORT);
-    if (_log) _log(String(F("[MQTT] Connecting to ")) + target);
+    bool wifiUp = WiFi.status() == WL_CONNECTED;
+    if (wifiUp && !_wifiUp) _connector.resetBackoff(now);
+    _wifiUp = wifiUp;
+    if (!wifiUp) return;
+
+    if (!_connector.pending()) {
+      if (!_connector.due(now)) return;
 
+      IPAddress ip;
+      // An IP literal skips DNS; a host name costs one (blocking) lookup.
+      if (!ip.fromString(MQTT_BROKER_HOST) && !WiFi.hostByName(MQTT_BROKER_HOST, ip)) {
+        _connector.fail(MqttConnector::Failure::DNS, now);
+        logConnectFailure(now);
+        return;
+      }
+      if (_log) _log(String(F("[MQTT] Connecting to ")) + brokerTarget());
+      if (!_connector.begin(static_cast<uint32_t>(ip), MQTT_BROKER_PORT, now)) {
+        logConnectFailure(now);
+      }
+      return;
+    }
+
+    switch (_connector.poll(now)) {
+      case MqttConnector::Poll::PENDING:
+        return;
+      case MqttConnector::Poll::FAILED:
+        logConnectFailure(now);
+        return;
+      case MqttConnector::Poll::READY:
+        break;
+    }
+
+    _wifiClient = WiFiClient(_connector.takeSocket());
+    String clientId = String(DEVICE_NAME) + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
     bool ok = _mqtt.connect(clientId.c_str(),
                             MQTT_USERNAME[0] ? MQTT_USERNAME : nullptr,
                             MQTT_PASSWORD[0] ? MQTT_PASSWORD : nullptr,
@@ -144,13 +290,20 @@ private:
                             1,
                             true,
                             "offline");
+    const uint32_t done = millis();
 
     if (!ok) {
-      if (_log) _log(String(F("[MQTT] Connect failed, state=")) + _mqtt.state());
-      _store.setStatus("HASS", "Waiting");
+      MqttConnector::Failure reason = (_mqtt.state() == MQTT_CONNECTION_TIMEOUT) ? MqttConnector::Failure::MQTT_TIMEOUT
+                                                          : MqttConnector::Failure::MQTT_REJECTED;
+      _wifiClient.stop();
+      _connector.fail(reason, done);
+      logConnectFailure(done);
       return;
     }
 
+    _connector.succeeded(done);
+    _sessionUp = true;
+
     _mqtt.publish(TOPIC_AVAIL, "online", true);
     _mqtt.subscribe(TOPIC_CMD, 1);
     _mqtt.subscribe(TOPIC_HA_STATUS, 0);
@@ -160,7 +313,22 @@ private:
     _lastHaStaleLog = 0;
     _store.setStatus("HASS", "OK");
 
-    if (_log) _log(String(F("[MQTT] Connected to ")) + target);
+    if (_log) _log(String(F("[MQTT] Connected to ")) + brokerTarget() + F(" in ") +
+                   _connector.stats().lastConnectMs + F(" ms"));
+  }
+
+  void logConnectFailure(uint32_t now) {
+    _store.setStatus("HASS", "Waiting");
+    if (!_log) return;
+    const MqttConnector::Failure reason = _connector.lastFailure();
+    String line = String(F("[MQTT] Connect failed (")) + MqttConnector::failureName(reason);
+    if (reason == MqttConnector::Failure::MQTT_REJECTED) line += String(F(", state=")) + _mqtt.state();
+    line += String(F("), retry in ")) + _connector.retryInMs(now) + F(" ms");
+    _log(line);
+  }
+
+  static String brokerTarget() {
+    return String(MQTT_BROKER_HOST) + ":" + String(MQTT_BROKER_PORT);
   }
 
   void onMessage(char* topic, byte* payload, unsigned int len) {
@@ -203,26 +371,70 @@ private:
 
       if (_log) _log(String(F("[MQTT] Command received: ")) + scmd);
 
-      if      (scmd == "open_auto"   || scmd == "open_manually") setHaDesired(MotionState::OPENING);
-      else if (scmd == "close_auto"  || scmd == "close_manually") setHaDesired(MotionState::CLOSING);
-      else if (scmd == "stop")                                      setHaDesired(MotionState::IDLE);
-      else if (scmd == "set_open_here")    _cmdQueue.push_back("set_open_here");
-      else if (scmd == "set_closed_here")  _cmdQueue.push_back("set_closed_here");
-      else if (scmd == "enter_set_mode")   _cmdQueue.push_back("enter_set_mode");
-      else if (scmd == "exit_set_mode")    _cmdQueue.push_back("exit_set_mode");
+      using Cmd = ControlCommand::Type;
+      if      (scmd == "open_auto"   || scmd == "open_manually") sendCommand(Cmd::HA_MOTION, (int32_t)MotionState::OPENING);
+      else if (scmd == "close_auto"  || scmd == "close_manually") sendCommand(Cmd::HA_MOTION, (int32_t)MotionState::CLOSING);
+      else if (scmd == "stop")                                      sendCommand(Cmd::HA_MOTION, (int32_t)MotionState::IDLE);
+      else if (scmd == "set_position") {
+        // {"percent": 0..100} or {"clicks": n}; resolved against end in main.
+        if (doc.containsKey("clicks")) {
+          sendCommand(Cmd::SET_POSITION_CLICKS, (int32_t)(doc["clicks"] | 0));
+        } else if (doc.containsKey("percent") || doc.containsKey("value")) {
+          int32_t pct = doc.containsKey("percent") ? (int32_t)(doc["percent"] | -1)
+                                                   : (int32_t)(doc["value"] | -1);
+          if (pct >= 0 && pct <= 100) {
+            sendCommand(Cmd::SET_POSITION_PCT, pct);
+          } else {
+            if (_log) _log(String(F("[MQTT] Invalid set_position percent")));
+          }
+        } else {
+          if (_log) _log(String(F("[MQTT] Invalid set_position payload")));
+        }
+      }
+      else if (scmd == "set_open_here")    sendCommand(Cmd::SET_OPEN_HERE);
+      else if (scmd == "set_closed_here")  sendCommand(Cmd::SET_CLOSED_HERE);
+      else if (scmd == "enter_set_mode")   sendCommand(Cmd::ENTER_SET_MODE);
+      else if (scmd == "exit_set_mode")    sendCommand(Cmd::EXIT_SET_MODE);
+      else if (scmd == "set_click_backend") {
+        String backend = doc["backend"] | "";
+        backend.toLowerCase();
+        if (backend == "isr" || backend == "pcnt") {
+          sendCommand(Cmd::CLICK_BACKEND, backend == "pcnt"
+                        ? (int32_t)ClickCounter::Backend::PCNT
+                        : (int32_t)ClickCounter::Backend::ISR);
+        } else {
+          if (_log) _log(String(F("[MQTT] Invalid click backend payload")));
+        }
+      }
       else if (scmd == "set_max_runtime") {
         uint32_t seconds = doc["seconds"] | 0U;
         if (seconds == 0U) seconds = doc["value"] | 0U;
         if (seconds == 0U) seconds = doc["seconds_s"] | 0U;
         if (seconds > 0U) {
           if (_log) _log(String(F("[MQTT] Set max runtime -> ")) + seconds + F(" s"));
-          if (_maxRuntimeHandler) {
-            _maxRuntimeHandler(seconds);
-          }
+          sendCommand(Cmd::SET_MAX_RUNTIME, (int32_t)seconds);
         } else {
           if (_log) _log(String(F("[MQTT] Invalid max runtime payload")));
         }
       }
+      else if (scmd == "set_stall_factor") {
+        float factor = doc["factor"] | 0.0f;
+        if (factor <= 0.0f) factor = doc["value"] | 0.0f;
+        if (factor > 0.0f) {
+          if (_log) _log(String(F("[MQTT] Set stall factor -> ")) + String(factor, 1));
+          sendCommand(Cmd::SET_STALL_FACTOR, (int32_t)(factor * 10.0f + 0.5f));
+        } else {
+          if (_log) _log(String(F("[MQTT] Invalid stall factor payload")));
+        }
+      }
+      else if (scmd == "log_fetch") {
+        uint32_t since = doc["since_seq"] | 0U;
+        uint32_t budget = doc["max_bytes"] | 1024U;
+        if (_logFetch) _logFetch(since, budget);
+      }
+      else if (scmd == "log_snapshot") {
+        if (_logSnapshot) _logSnapshot();
+      }
       else if (scmd == "ping") {
         StaticJsonDocument<128> pong;
         pong["ok"] = true;
@@ -236,10 +448,11 @@ private:
     }
   }
 
-  void setHaDesired(MotionState s) {
-    if (_haDesired == s) return;
-    _haDesired = s;
-    if (_log) _log(String(F("[MQTT] HA desired -> ")) + motionToStr(s));
+  void sendCommand(ControlCommand::Type type, int32_t value = 0) {
+    ControlCommand cmd{type, value, (uint32_t)micros()};
+    if (!_link || !_link->commands.push(cmd)) {
+      if (_log) _log(String(F("[MQTT] Command dropped (control mailbox full)")));
+    }
   }
 
   void updateHaRow(unsigned long now) {
@@ -276,40 +489,129 @@ private:
     _store.setStatus("HASS", "OK");
   }
 
-  void publishState(unsigned long now,
-                    const char* modeStr,
-                    MotionState action,
-                    MotionState analogState,
-                    const char* analogLabel,
-                    bool setModeActive,
-                    bool panicActive,
-                    const ClickCounter& clicks,
-                    uint32_t safetyMaxRunSeconds,
-                    uint32_t safetyElapsedSeconds,
-                    bool safetyActive,
-                    uint32_t noClickGuardSeconds) {
-    StaticJsonDocument<512> doc;
-    doc["mode"] = modeStr;
-    doc["action"] = motionToStr(action);
+  void publishState(unsigned long now, const ControlSnapshot& snap) {
+    StaticJsonDocument<3072> doc;
+    doc["mode"] = snap.modeLabel;
+    doc["action"] = motionToStr(snap.action);
     JsonObject analog = doc.createNestedObject("analog");
-    analog["switch"] = analogLabel ? analogLabel : "Neutral";
-    analog["motion"] = motionToStr(analogState);
-    doc["set_mode_active"] = setModeActive;
-    doc["panic"] = panicActive;
-    doc["pos"] = clicks.position();
-    doc["end"] = clicks.end();
+    analog["switch"] = snap.analogLabel ? snap.analogLabel : "Neutral";
+    analog["motion"] = motionToStr(snap.analogState);
+    doc["set_mode_active"] = snap.setModeActive;
+    doc["panic"] = snap.panicActive;
+    doc["pos"] = snap.pos;
+    doc["end"] = snap.end;
+    doc["pct"] = snap.pct;
+    JsonObject travel = doc.createNestedObject("travel");
+    travel["speed_cps"] = roundf(snap.speedCps * 100.0f) / 100.0f;
+    travel["eta_ms"] = snap.etaMs;
+    travel["open_cps"] = roundf(snap.openCps * 100.0f) / 100.0f;
+    travel["close_cps"] = roundf(snap.closeCps * 100.0f) / 100.0f;
     JsonObject wifi = doc.createNestedObject("wifi");
     wifi["ip"] = WiFi.localIP().toString();
     wifi["rssi"] = (int)WiFi.RSSI();
+    if (_wifi) {
+      const WifiModule::Stats& ws = _wifi->stats();
+      wifi["boot_to_ip_ms"] = ws.bootToIpMs;
+      wifi["to_ip_ms"] = ws.lastToIpMs;
+      wifi["hint"] = WifiModule::hintName(ws.lastHint);
+      wifi["connects"] = ws.connects;
+      wifi["scans"] = ws.scans;
+      wifi["scan_ms"] = ws.lastScanMs;
+      wifi["hint_misses"] = ws.hintMisses;
+    }
     bool brokerConnected = _mqtt.connected();
     doc["ha_connected"] = brokerConnected;
     doc["uptime"] = (uint32_t)(millis() / 1000UL);
 
     JsonObject safety = doc.createNestedObject("safety");
-    safety["max_run_s"] = safetyMaxRunSeconds;
-    safety["run_elapsed_s"] = safetyElapsedSeconds;
-    safety["active"] = safetyActive;
-    safety["no_click_guard_s"] = noClickGuardSeconds;
+    safety["max_run_s"] = snap.maxRunSeconds;
+    safety["run_elapsed_s"] = snap.runElapsedSeconds;
+    safety["active"] = snap.safetyActive;
+    safety["no_click_guard_s"] = snap.noClickGuardSeconds;
+    safety["stall_factor"] = roundf(snap.stallFactor * 10.0f) / 10.0f;
+    safety["stall_limit_ms"] = snap.stallLimitMs;
+    safety["stall_trips"] = snap.stallTrips;
+    safety["power_fail_flush_us"] = snap.powerFailFlushUs;
+
+    JsonObject nvs = doc.createNestedObject("nvs");
+    nvs["writes"] = snap.persist.writes;
+    nvs["avoided"] = snap.persist.writesAvoided;
+    nvs["slow"] = snap.persist.slowWrites;
+    nvs["max_ms"] = snap.persist.maxWriteMs;
+    nvs["log"] = snap.posLogActive;
+    nvs["log_erases"] = snap.posLogErases;
+
+    JsonObject edge = doc.createNestedObject("edges");
+    edge["source"] = snap.clickSource;
+    edge["count"] = snap.edges.edges;
+    edge["overflows"] = snap.edges.overflows;
+    edge["ring_high_water"] = snap.edges.highWater;
+    edge["duplicates"] = snap.edges.duplicates;
+    edge["resyncs"] = snap.edges.resyncs;
+    edge["stray"] = snap.edges.stray;
+
+    JsonObject target = doc.createNestedObject("goto");
+    target["active"] = snap.gotoActive;
+    target["target"] = snap.gotoTarget;
+    target["moves"] = snap.gotoStats.moves;
+    target["cancelled"] = snap.gotoStats.cancelled;
+    target["last_error"] = snap.gotoStats.lastError;
+    target["mean_abs_error"] = roundf(snap.gotoStats.meanAbsError() * 100.0f) / 100.0f;
+    target["max_abs_error"] = snap.gotoStats.maxAbsError;
+
+    JsonObject control = doc.createNestedObject("control");
+    control["tasks"] = snap.tasksSplit;
+    control["period_us"] = snap.control.avgPeriodUs;
+    control["max_period_us"] = snap.control.maxPeriodUs;
+    control["max_jitter_us"] = snap.control.maxJitterUs;
+    control["overruns"] = snap.control.overruns;
+    control["cmd_drops"] = snap.commandDrops;
+    control["log_drops"] = snap.logDrops;
+
+    JsonObject log = doc.createNestedObject("log");
+    log["queue_drops"] = snap.logDrops;
+    log["queue_high_water"] = snap.logHighWater;
+    if (_logDrain) {
+      const LogDrain::Stats& ls = _logDrain->stats();
+      log["lines"] = ls.lines;
+      log["serial_drops"] = ls.serialDrops;
+      log["serial_high_water"] = ls.serialHighWater;
+      log["batch_drops"] = ls.batchDrops;
+      log["batches"] = ls.batches;
+      log["max_batch_lines"] = ls.maxBatchLines;
+    }
+
+    // Timed relay transitions: [intended ms, count, last actual us, last late us,
+    // max late us].
+    JsonObject relay = doc.createNestedObject("relays");
+    relay["phase"] = snap.relayPhase;
+    relay["timer_fires"] = snap.relays.timerFires;
+    relay["loop_fires"] = snap.relays.loopFires;
+    relay["writes"] = snap.relays.outputWrites;
+    relay["interlock_trips"] = snap.relays.interlockTrips;
+    for (uint8_t i = 0; i < RelaysModule::TRANSITIONS; ++i) {
+      const RelaysModule::TransitionTiming& t = snap.relays.timing[i];
+      JsonArray row = relay.createNestedArray(RelaysModule::transitionName(i));
+      row.add(t.intendedMs);
+      row.add(t.count);
+      row.add(t.lastActualUs);
+      row.add(t.lastLateUs);
+      row.add(t.maxLateUs);
+    }
+
+    const MqttConnector::Stats& cs = _connector.stats();
+    JsonObject conn = doc.createNestedObject("mqtt");
+    conn["attempts"] = cs.attempts;
+    conn["connects"] = cs.connects;
+    conn["last_ms"] = cs.lastConnectMs;
+    conn["max_ms"] = cs.maxConnectMs;
+    conn["json_drops"] = _jsonDrops;
+    JsonArray durations = conn.createNestedArray("dur_hist");
+    for (uint8_t i = 0; i < MqttConnector::DURATION_BUCKETS; ++i) durations.add(cs.durations[i]);
+    JsonObject failures = conn.createNestedObject("fail");
+    for (uint8_t i = 0; i < static_cast<uint8_t>(MqttConnector::Failure::COUNT); ++i) {
+      failures[MqttConnector::failureName(static_cast<MqttConnector::Failure>(i))] = cs.failures[i];
+    }
 
     _haConnected = brokerConnected;
     if (_haConnected) {
@@ -321,12 +623,67 @@ private:
     publishJson(TOPIC_STATE, doc, /*retain=*/true);
   }
 
+  void publishClickDiag(const ControlSnapshot& snap) {
+    StaticJsonDocument<1024> doc;
+    doc["gate_us"] = snap.gate.gateUs;
+    doc["learned"] = snap.gate.learned;
+    doc["confidence"] = snap.gate.confidence;
+    doc["gated_edges"] = snap.gate.gatedEdges;
+    doc["rate_drops"] = snap.gate.rateDrops;
+    doc["samples"] = snap.gateSamples;
+    JsonArray lower = doc.createNestedArray("bucket_lo_us");
+    JsonArray counts = doc.createNestedArray("counts");
+    for (uint8_t i = 0; i < GateLearner::BUCKETS; ++i) {
+      lower.add(GateLearner::bucketLowerUs(i));
+      counts.add(snap.gateCounts[i]);
+    }
+    publishJson(TOPIC_CLICK_DIAG, doc, /*retain=*/true);
+  }
+
+  void publishRun(const ControlSnapshot& snap) {
+    StaticJsonDocument<512> doc;
+    const ClickCounter::RunStats& run = snap.run;
+    doc["seq"] = run.seq;
+    doc["dir"] = motionToStr(run.dir);
+    doc["start"] = run.startPos;
+    doc["stop"] = run.stopPos;
+    doc["final"] = run.finalPos;
+    doc["coast_clicks"] = run.coastClicks;
+    doc["predicted_clicks"] = run.predictedClicks;
+    doc["coast_ms"] = run.coastMs;
+    doc["limit_stop"] = run.limitStop;
+    if (run.limitStop) doc["limit_error"] = run.limitError;
+
+    const CoastModel& coast = snap.coast;
+    JsonObject model = doc.createNestedObject("coast_model");
+    model["open_clicks"] = roundf(coast.clicks(0) * 100.0f) / 100.0f;
+    model["open_ms"] = coast.coastMs(0);
+    model["open_runs"] = coast.runs(0);
+    model["close_clicks"] = roundf(coast.clicks(1) * 100.0f) / 100.0f;
+    model["close_ms"] = coast.coastMs(1);
+    model["close_runs"] = coast.runs(1);
+    publishJson(TOPIC_RUN, doc, /*retain=*/true);
+  }
+
+  static float usToMs(uint32_t us) { return roundf(us / 100.0f) / 10.0f; }
+
+  // A document that ran out of pool or does not fit _json would go out cut
+  // short, and a retained one would stay on the broker that way: count it
+  // and log it (1st, 2nd, 4th, ... time) instead of publishing.
   template<typename TJsonDoc>
   void publishJson(const char* topic, const TJsonDoc& doc, bool retain) {
-    char buf[768];
-    size_t n = serializeJson(doc, buf, sizeof(buf));
+    const size_t need = measureJson(doc);
+    if (doc.overflowed() || need >= sizeof(_json)) {
+      ++_jsonDrops;
+      if (_log && !(_jsonDrops & (_jsonDrops - 1))) {
+        _log(String(F("[MQTT] Not publishing ")) + topic + F(": ") + need + F(" B JSON") +
+             (doc.overflowed() ? F(", pool overflowed") : F("")) + F(" (") + _jsonDrops + F(" dropped)"));
+      }
+      return;
+    }
+    size_t n = serializeJson(doc, _json, sizeof(_json));
     if (n > 0) {
-      _mqtt.publish(topic, buf, retain);
+      _mqtt.publish(topic, _json, retain);
     }
   }
 
@@ -0,0 +1,36 @@
+#pragma once
+#include <esp_partition.h>
+#include "FlashDevice.h"
+
+// Raw data partition (see partitions.csv).
+class PartitionFlashDevice : public FlashDevice {
+public:
+  static constexpr size_t SECTOR_BYTES = 4096;
+
+  bool open(const char* label) {
+    _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                      ESP_PARTITION_SUBTYPE_ANY, label);
+    return _part != nullptr;
+  }
+
+  size_t size() const override { return _part ? _part->size : 0; }
+  size_t sectorSize() const override { return SECTOR_BYTES; }
+
+  bool read(size_t offset, void* dst, size_t len) override {
+    if (!_part) return false;
+    return esp_partition_read(_part, offset, dst, len) == ESP_OK;
+  }
+
+  bool write(size_t offset, const void* src, size_t len) override {
+    if (!_part) return false;
+    return esp_partition_write(_part, offset, src, len) == ESP_OK;
+  }
+
+  bool eraseSector(size_t sector) override {
+    if (!_part) return false;
+    return esp_partition_erase_range(_part, sector * SECTOR_BYTES, SECTOR_BYTES) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t* _part = nullptr;
+};
@@ -0,0 +1,217 @@
+#include "PosLog.h"
+#include "Crc32.h"
+
+#include <cstring>
+
+bool PosLog::begin(FlashDevice* device) {
+  _dev = nullptr;
+  _hasRecord = false;
+  _newest = Record();
+  _stats = Stats();
+  _sector = 0;
+  _slot = 0;
+  _needErase = false;
+  _nextErased = false;
+
+  if (!device) return false;
+  size_t sectorBytes = device->sectorSize();
+  if (!sectorBytes || sectorBytes % ENTRY_SIZE) return false;
+  _sectors = device->size() / sectorBytes;
+  _slotsPerSector = sectorBytes / ENTRY_SIZE;
+  if (_sectors < 2) return false;
+  _dev = device;
+
+  // Newest sector = highest epoch in slot 0.
+  bool found = false;
+  size_t head = 0;
+  uint32_t headEpoch = 0;
+  Entry e;
+  for (size_t s = 0; s < _sectors; ++s) {
+    if (!readEntry(s, 0, &e)) {
+      _dev = nullptr;
+      return false;
+    }
+    if (isValid(e) && (!found || e.epoch > headEpoch)) {
+      found = true;
+      head = s;
+      headEpoch = e.epoch;
+    }
+  }
+
+  if (!found) {
+    _needErase = true;
+    return true;
+  }
+
+  // Slots are filled in order, so [0, used) is written and [used, end) erased.
+  size_t lo = 1;
+  size_t hi = _slotsPerSector;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (!readEntry(head, mid, &e)) {
+      _dev = nullptr;
+      return false;
+    }
+    if (isErased(e)) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  size_t used = lo;
+
+  // Walk back over torn tail records; slot 0 is known valid.
+  for (size_t i = used; i-- > 0;) {
+    if (!readEntry(head, i, &e)) {
+      _dev = nullptr;
+      return false;
+    }
+    if (isValid(e)) {
+      _newest.epoch = e.epoch;
+      _newest.pos = e.pos;
+      _newest.level = e.level;
+      _hasRecord = true;
+      break;
+    }
+    ++_stats.tornSkipped;
+  }
+
+  _sector = head;
+  _slot = used;
+  return true;
+}
+
+bool PosLog::ready() const {
+  return _dev != nullptr;
+}
+
+bool PosLog::hasRecord() const {
+  return _hasRecord;
+}
+
+const PosLog::Record& PosLog::newest() const {
+  return _newest;
+}
+
+const PosLog::Stats& PosLog::stats() const {
+  return _stats;
+}
+
+bool PosLog::append(const Record& rec, bool mayErase) {
+  if (!_dev) return false;
+
+  Entry e;
+  e.epoch = rec.epoch;
+  e.pos = rec.pos;
+  e.level = rec.level;
+  memset(e.reserved, 0, sizeof(e.reserved));
+  e.crc32 = entryCrc(e);
+
+  // A failed or torn write burns its slot; retry once in the next one.
+  for (uint8_t attempt = 0; attempt < 2; ++attempt) {
+    if (_slot >= _slotsPerSector) {
+      _sector = (_sector + 1) % _sectors;
+      _slot = 0;
+      _needErase = !_nextErased;
+      _nextErased = false;
+    }
+    if (_needErase) {
+      if (!mayErase) {
+        ++_stats.eraseBlocked;
+        return false;
+      }
+      if (!_dev->eraseSector(_sector)) {
+        ++_stats.writeFailures;
+        return false;
+      }
+      ++_stats.erases;
+      _needErase = false;
+    }
+
+    size_t off = offsetOf(_sector, _slot);
+    Entry check;
+    if (_dev->write(off, &e, ENTRY_SIZE) &&
+        _dev->read(off, &check, ENTRY_SIZE) &&
+        memcmp(&check, &e, ENTRY_SIZE) == 0) {
+      ++_slot;
+      _newest = rec;
+      _hasRecord = true;
+      ++_stats.appends;
+      return true;
+    }
+    ++_stats.writeFailures;
+    if (!burnSlot(off)) continue;  // nothing landed: the slot is still free
+    if (_slot == 0) {
+      // begin() only looks at slot 0 to find the head; a sector without a
+      // valid one is skipped, so carry on in the next sector.
+      _slot = _slotsPerSector;
+    } else {
+      ++_slot;
+    }
+  }
+  return false;
+}
+
+bool PosLog::prepareNext() {
+  if (!_dev) return false;
+  size_t sector = _sector;
+  if (!_needErase) {
+    if (_nextErased || _slotsPerSector - _slot > PREPARE_FREE_SLOTS) return true;
+    // The current sector holds the newest records; only older ones go.
+    sector = (_sector + 1) % _sectors;
+  }
+  if (!_dev->eraseSector(sector)) {
+    ++_stats.writeFailures;
+    return false;
+  }
+  ++_stats.erases;
+  if (_needErase) {
+    _needErase = false;
+  } else {
+    _nextErased = true;
+  }
+  return true;
+}
+
+bool PosLog::burnSlot(size_t off) {
+  // begin() takes the first erased slot as the fill level, so a failed slot
+  // must not stay erased or the records after it would be lost. All zeros
+  // is never a valid record. Returns false if the slot still reads erased
+  // and can be reused.
+  static const uint8_t zeros[ENTRY_SIZE] = {};
+  _dev->write(off, zeros, ENTRY_SIZE);
+  Entry check;
+  return !_dev->read(off, &check, ENTRY_SIZE) || !isErased(check);
+}
+
+bool PosLog::readEntry(size_t sector, size_t slot, Entry* out) {
+  ++_stats.bootReads;
+  return _dev->read(offsetOf(sector, slot), out, ENTRY_SIZE);
+}
+
+size_t PosLog::offsetOf(size_t sector, size_t slot) const {
+  return sector * _slotsPerSector * ENTRY_SIZE + slot * ENTRY_SIZE;
+}
+
+bool PosLog::isErased(const Entry& e) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&e);
+  for (size_t i = 0; i < ENTRY_SIZE; ++i) {
+    if (p[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+bool PosLog::isValid(const Entry& e) {
+  return !isErased(e) && e.crc32 == entryCrc(e);
+}
+
+uint32_t PosLog::entryCrc(const Entry& e) {
+  uint8_t buf[sizeof(e.epoch) + sizeof(e.pos) + sizeof(e.level)];
+  size_t off = 0;
+  memcpy(buf + off, &e.epoch, sizeof(e.epoch));
+  off += sizeof(e.epoch);
+  memcpy(buf + off, &e.pos, sizeof(e.pos));
+  off += sizeof(e.pos);
+  buf[off] = e.level;
+  return crc32Ieee(buf, sizeof(buf));
+}
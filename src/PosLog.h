@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "FlashDevice.h"
+
+// Append-only position log on a raw flash region.
+//
+// The region is split into erase sectors, each holding a run of fixed-size
+// CRC-protected records filled front to back. When a sector is full the
+// next one is erased and filling continues there, so the log wraps and the
+// oldest sector is always the one sacrificed. Epochs grow monotonically, so
+// at boot the newest sector is the one whose first record carries the
+// highest epoch, and the fill level inside it is found by binary search for
+// the first erased slot. Torn records (power lost mid-write) fail their CRC
+// and are skipped. A write that fails while running is overwritten with
+// zeros so it can't leave an erased hole, and a failed slot 0 moves the
+// log on to the next sector.
+//
+// Erasing a sector takes tens of milliseconds, too long for the power-fail
+// flush. prepareNext() erases the next sector ahead of time, once the
+// current one is nearly full, and append(rec, false) refuses to erase.
+class PosLog {
+public:
+  struct Record {
+    uint32_t epoch = 0;
+    int32_t  pos = 0;
+    uint8_t  level = 0;
+  };
+
+  struct Stats {
+    uint32_t appends = 0;
+    uint32_t erases = 0;
+    uint32_t writeFailures = 0;
+    uint32_t tornSkipped = 0;   // invalid records stepped over at boot
+    uint32_t bootReads = 0;     // record reads needed to locate the head
+    uint32_t eraseBlocked = 0;  // append(rec, false) calls that needed an erase
+  };
+
+  // prepareNext() erases ahead once this few slots are left.
+  static constexpr size_t PREPARE_FREE_SLOTS = 32;
+
+  bool begin(FlashDevice* device);
+  bool ready() const;
+  bool hasRecord() const;
+  const Record& newest() const;
+  // mayErase = false fails instead of erasing a sector inline.
+  bool append(const Record& rec, bool mayErase = true);
+  // Makes sure the next append won't erase. Cheap unless it erases.
+  bool prepareNext();
+  const Stats& stats() const;
+
+private:
+  // Same layout as ClickCounter::PosRecV1.
+  struct Entry {
+    uint32_t epoch;
+    int32_t  pos;
+    uint8_t  level;
+    uint8_t  reserved[3];
+    uint32_t crc32;
+  };
+
+  static constexpr size_t ENTRY_SIZE = sizeof(Entry);
+
+  bool readEntry(size_t sector, size_t slot, Entry* out);
+  bool burnSlot(size_t off);
+  size_t offsetOf(size_t sector, size_t slot) const;
+  static bool isErased(const Entry& e);
+  static bool isValid(const Entry& e);
+  static uint32_t entryCrc(const Entry& e);
+
+  FlashDevice* _dev = nullptr;
+  size_t _sectors = 0;
+  size_t _slotsPerSector = 0;
+  size_t _sector = 0;        // sector holding the write cursor
+  size_t _slot = 0;          // next free slot in _sector
+  bool _needErase = false;   // _sector content unknown, erase before writing
+  bool _nextErased = false;  // sector after _sector already erased
+  bool _hasRecord = false;
+  Record _newest;
+  Stats _stats;
+};
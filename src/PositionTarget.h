@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>
+#include "AnalogController.h"  // MotionState
+
+// On-device "drive to position" state for set_position.
+//
+// The main loop starts a move through the normal Home Assistant command
+// path and asks shouldStop() every pass. The stop is issued early by the
+// predicted overrun (coast plus what the cover travels before the relays
+// open), so the cover settles on the target rather than past it. Once the
+// click counter has finished the run, settle() records the landing error.
+class PositionTarget {
+public:
+  struct Stats {
+    uint32_t moves = 0;          // moves that ran to a stop and settled
+    uint32_t cancelled = 0;      // overridden by another command / panic
+    int32_t lastError = 0;       // final position - target, clicks
+    uint32_t maxAbsError = 0;
+    uint32_t sumAbsError = 0;
+    float meanAbsError() const { return moves ? (float)sumAbsError / (float)moves : 0.0f; }
+  };
+
+  void start(int32_t target, int32_t pos, uint32_t commandSerial) {
+    _target = target;
+    _dir = (target > pos) ? MotionState::CLOSING : MotionState::OPENING;
+    _serial = commandSerial;
+    _active = true;
+    _awaitingRun = false;
+  }
+
+  // Another command took over before the stop was issued.
+  void cancel() {
+    if (!_active) return;
+    _active = false;
+    ++_stats.cancelled;
+  }
+
+  bool shouldStop(int32_t pos, float leadClicks) const {
+    if (!_active) return false;
+    float remaining = (_dir == MotionState::CLOSING) ? (float)(_target - pos)
+                                                     : (float)(pos - _target);
+    return remaining <= leadClicks + 0.5f;
+  }
+
+  // The relays are being dropped for this move; the next run summary with a
+  // sequence number past runSeq carries the landing position.
+  void stopped(uint32_t runSeq) {
+    _active = false;
+    _awaitingRun = true;
+    _runSeq = runSeq;
+  }
+
+  // Returns true when the run summary was taken as this move's result.
+  bool settle(uint32_t runSeq, int32_t finalPos) {
+    if (!_awaitingRun || runSeq == _runSeq) return false;
+    _awaitingRun = false;
+    int32_t error = finalPos - _target;
+    uint32_t absError = (uint32_t)(error < 0 ? -error : error);
+    _stats.lastError = error;
+    _stats.sumAbsError += absError;
+    if (absError > _stats.maxAbsError) _stats.maxAbsError = absError;
+    ++_stats.moves;
+    return true;
+  }
+
+  bool active() const { return _active; }
+  int32_t target() const { return _target; }
+  MotionState direction() const { return _dir; }
+  uint32_t commandSerial() const { return _serial; }
+  const Stats& stats() const { return _stats; }
+
+private:
+  bool _active = false;
+  bool _awaitingRun = false;
+  int32_t _target = 0;
+  MotionState _dir = MotionState::IDLE;
+  uint32_t _serial = 0;
+  uint32_t _runSeq = 0;
+  Stats _stats;
+};
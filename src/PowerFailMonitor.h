@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include "pins.h"
+
+// Supply-rail monitor for the power-fail flush. Samples a divided copy of the
+// 5 V logic input (upstream of the 3.3 V regulator, so the bulk capacitors
+// still give a few ms of hold-up once it trips) on an ADC1 pin.
+//
+// Off by default: it needs the divider on PIN_RAIL_SENSE.
+#ifndef POWER_FAIL_MONITOR_ENABLED
+#define POWER_FAIL_MONITOR_ENABLED 0
+#endif
+
+// Thresholds at the ADC pin (after the divider).
+#ifndef POWER_FAIL_TRIP_MV
+#define POWER_FAIL_TRIP_MV 2200
+#endif
+
+#ifndef POWER_FAIL_RECOVER_MV
+#define POWER_FAIL_RECOVER_MV 2600
+#endif
+
+class PowerFailMonitor {
+public:
+  void begin(uint8_t pin,
+             uint16_t tripMv = POWER_FAIL_TRIP_MV,
+             uint16_t recoverMv = POWER_FAIL_RECOVER_MV,
+             uint8_t tripSamples = 2) {
+    _pin = pin;
+    _tripMv = tripMv;
+    _recoverMv = recoverMv;
+    _tripSamples = tripSamples ? tripSamples : 1;
+    _lowSamples = 0;
+    _failed = false;
+    _armed = false;
+    _events = 0;
+    pinMode(_pin, INPUT);
+    analogSetPinAttenuation(_pin, ADC_11db);
+    _railMv = analogReadMilliVolts(_pin);
+    _enabled = true;
+  }
+
+  // Returns true exactly once per power-fail event. Only arms after the rail
+  // has been seen healthy, so a slow ramp at boot cannot trip it.
+  bool update() {
+    if (!_enabled) return false;
+    _railMv = analogReadMilliVolts(_pin);
+
+    if (_railMv >= _recoverMv) {
+      _armed = true;
+      _failed = false;
+      _lowSamples = 0;
+      return false;
+    }
+    if (!_armed || _failed) return false;
+    if (_railMv >= _tripMv) {
+      _lowSamples = 0;
+      return false;
+    }
+    if (++_lowSamples < _tripSamples) return false;
+
+    _failed = true;
+    ++_events;
+    return true;
+  }
+
+  bool enabled() const { return _enabled; }
+  bool failed() const { return _failed; }
+  uint16_t railMv() const { return _railMv; }
+  uint32_t events() const { return _events; }
+
+private:
+  uint8_t _pin = 255;
+  bool _enabled = false;
+  bool _armed = false;
+  bool _failed = false;
+  uint16_t _tripMv = POWER_FAIL_TRIP_MV;
+  uint16_t _recoverMv = POWER_FAIL_RECOVER_MV;
+  uint8_t _tripSamples = 2;
+  uint8_t _lowSamples = 0;
+  uint16_t _railMv = 0;
+  uint32_t _events = 0;
+};
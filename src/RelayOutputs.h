@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include "pins.h"
+
+// The four relay outputs, switched together.
+//
+// write() takes the full set of relays that should be energised and applies
+// it as one GPIO write-1-to-clear / write-1-to-set pair: every contact that
+// opens does so in the first register write, every contact that closes in
+// the second, so outputs never change one by one and a transition is
+// break-before-make. FWD and REV are never energised together: such a
+// request opens both directions and the enable instead, and is counted.
+//
+// Without ARDUINO the register pair goes to relayOutputsHostWrite(), which
+// a host build defines to record transitions.
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <soc/gpio_struct.h>
+#else
+void relayOutputsHostWrite(uint32_t w1tc, uint32_t w1ts);
+#endif
+
+static_assert(PIN_RELAY_PSU < 32 && PIN_RELAY_FWD < 32 &&
+              PIN_RELAY_REV < 32 && PIN_RELAY_EN < 32,
+              "relay pins must share the GPIO0-31 output register");
+
+class RelayOutputs {
+public:
+  enum Relay : uint8_t {
+    PSU = 1 << 0,
+    FWD = 1 << 1,
+    REV = 1 << 2,
+    EN  = 1 << 3,
+  };
+
+  static constexpr uint32_t PIN_MASK_ALL =
+      (1UL << PIN_RELAY_PSU) | (1UL << PIN_RELAY_FWD) |
+      (1UL << PIN_RELAY_REV) | (1UL << PIN_RELAY_EN);
+
+  // Pins are driven to their off level before they become outputs.
+  void begin(bool activeLow) {
+    _activeLow = activeLow;
+    _state = 0;
+#if defined(ARDUINO)
+    const uint8_t pins[] = { PIN_RELAY_FWD, PIN_RELAY_REV, PIN_RELAY_PSU, PIN_RELAY_EN };
+    for (uint8_t pin : pins) {
+      digitalWrite(pin, _activeLow ? HIGH : LOW);
+      pinMode(pin, OUTPUT);
+    }
+#endif
+    apply(0);
+  }
+
+  // Returns false if the request broke the FWD/REV interlock.
+  bool write(uint8_t relays) {
+    bool ok = true;
+    if ((relays & FWD) && (relays & REV)) {
+      relays &= ~(FWD | REV | EN);
+      ++_interlockTrips;
+      ok = false;
+    }
+    if (relays != _state) apply(relays);
+    return ok;
+  }
+
+  uint8_t state() const { return _state; }
+  uint32_t writes() const { return _writes; }
+  uint32_t interlockTrips() const { return _interlockTrips; }
+
+  static uint32_t pinMask(uint8_t relays) {
+    uint32_t mask = 0;
+    if (relays & PSU) mask |= 1UL << PIN_RELAY_PSU;
+    if (relays & FWD) mask |= 1UL << PIN_RELAY_FWD;
+    if (relays & REV) mask |= 1UL << PIN_RELAY_REV;
+    if (relays & EN)  mask |= 1UL << PIN_RELAY_EN;
+    return mask;
+  }
+
+private:
+  void apply(uint8_t relays) {
+    const uint32_t on = pinMask(relays);
+    const uint32_t off = PIN_MASK_ALL & ~on;
+    // Active-low: energised = low. Contacts that open go first.
+    const uint32_t high = _activeLow ? off : on;
+    const uint32_t low = _activeLow ? on : off;
+    if (_activeLow) {
+      outSet(high);
+      outClear(low);
+    } else {
+      outClear(low);
+      outSet(high);
+    }
+    _state = relays;
+    ++_writes;
+  }
+
+#if defined(ARDUINO)
+  static inline void outSet(uint32_t mask) { if (mask) GPIO.out_w1ts = mask; }
+  static inline void outClear(uint32_t mask) { if (mask) GPIO.out_w1tc = mask; }
+#else
+  static inline void outSet(uint32_t mask) { if (mask) relayOutputsHostWrite(0, mask); }
+  static inline void outClear(uint32_t mask) { if (mask) relayOutputsHostWrite(mask, 0); }
+#endif
+
+  bool _activeLow = true;
+  uint8_t _state = 0;
+  uint32_t _writes = 0;
+  uint32_t _interlockTrips = 0;
+};
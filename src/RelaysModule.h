@@ -1,223 +1,447 @@
 #pragma once
 #include <Arduino.h>
 #include "pins.h"
+#include "RelayOutputs.h"
+#include "LogEvents.h"
 #include "StatusStore.h"
 #include "AnalogController.h"   // MotionState
 
+#if defined(ARDUINO)
+#include <esp_timer.h>
+#else
+// Host build: a test defines these to run the one-shot on a simulated
+// clock, as it does relayOutputsHostWrite() for the outputs.
+int64_t relayTimerHostNowUs();
+bool relayTimerHostCreate(void (*fn)(void*), void* arg);
+void relayTimerHostArm(int64_t deadlineUs);  // 0 = disarm
+#endif
+
+// The sequencer's clock and one-shot timer: esp_timer on the device.
+class RelayTimer {
+public:
+  using Callback = void (*)(void*);
+
+  ~RelayTimer() {
+#if defined(ARDUINO)
+    if (_handle) {
+      esp_timer_stop(_handle);
+      esp_timer_delete(_handle);
+    }
+#endif
+  }
+
+  // The callback runs in the esp_timer task. False if no timer could be
+  // created.
+  bool begin(Callback fn, void* arg) {
+#if defined(ARDUINO)
+    esp_timer_create_args_t args = {};
+    args.callback = fn;
+    args.arg = arg;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "relays";
+    if (esp_timer_create(&args, &_handle) != ESP_OK) _handle = nullptr;
+    return _handle != nullptr;
+#else
+    _created = relayTimerHostCreate(fn, arg);
+    return _created;
+#endif
+  }
+
+  bool active() const {
+#if defined(ARDUINO)
+    return _handle != nullptr;
+#else
+    return _created;
+#endif
+  }
+
+  // Fires once at deadlineUs on nowUs()'s clock, at once if that has
+  // passed; replaces any pending fire. 0 only disarms.
+  void armAt(int64_t deadlineUs) {
+    if (!active()) return;
+#if defined(ARDUINO)
+    esp_timer_stop(_handle);
+    if (!deadlineUs) return;
+    const int64_t wait = deadlineUs - nowUs();
+    esp_timer_start_once(_handle, wait > 0 ? static_cast<uint64_t>(wait) : 0);
+#else
+    relayTimerHostArm(deadlineUs);
+#endif
+  }
+
+  void stop() { armAt(0); }
+
+  // 64-bit microseconds since boot: no wrap in the device's lifetime.
+  static int64_t nowUs() {
+#if defined(ARDUINO)
+    return esp_timer_get_time();
+#else
+    return relayTimerHostNowUs();
+#endif
+  }
+
+private:
+#if defined(ARDUINO)
+  esp_timer_handle_t _handle = nullptr;
+#else
+  bool _created = false;
+#endif
+};
+
+// Relay sequencer: PSU spin-up, direction contacts, enable, reversal
+// dead-time and PSU hold-over, as an explicit state machine.
+//
+// Timed transitions are scheduled on an esp_timer one-shot, so they happen
+// when due even if the control loop is late; update() also applies any
+// overdue transition as a fallback. All deadlines are on the 64-bit
+// esp_timer clock (no millis() wrap). The dead-time also holds across a
+// stop: reversing within _deadMs of the contacts opening waits it out. The
+// timer callback only switches relays; status rows and log lines are
+// produced from update().
 class RelaysModule {
 public:
   using LogFn = void (*)(const String&);
 
+  enum class Phase : uint8_t {
+    OFF,        // everything open, PSU off
+    PSU_HOLD,   // stopped, PSU kept on for a quick restart
+    DEAD_TIME,  // reversing: everything open for _deadMs, PSU on
+    SPIN_UP,    // PSU just switched on
+    ARMING,     // direction contact closed, enable pending
+    RUNNING     // direction + enable closed
+  };
+
+  // Timed transitions, for actual-vs-intended timing.
+  enum Transition : uint8_t { T_SPIN_UP, T_ENABLE, T_DEAD_TIME, T_PSU_HOLD, TRANSITIONS };
+
+  struct TransitionTiming {
+    uint32_t count = 0;
+    uint32_t intendedMs = 0;   // configured interval
+    uint32_t lastActualUs = 0; // measured interval of the last one
+    uint32_t lastLateUs = 0;
+    uint32_t maxLateUs = 0;
+  };
+
+  struct Stats {
+    TransitionTiming timing[TRANSITIONS];
+    uint32_t timerFires = 0;   // applied from the esp_timer callback
+    uint32_t loopFires = 0;    // applied by update() (timer late or missed)
+    uint32_t outputWrites = 0;
+    uint32_t interlockTrips = 0;
+  };
+
   explicit RelaysModule(StatusStore& store, LogFn logger = nullptr)
     : _store(store), _log(logger) {}
 
   void begin(bool activeLow = true,
              uint32_t deadMs = 1000,
              uint32_t psuSpinMs = 1000) {
-    _activeLow   = activeLow;
     _deadMs      = deadMs;
     _psuSpinMs   = psuSpinMs;
+    _out.begin(activeLow);
 
-    uint8_t offLevel = _activeLow ? HIGH : LOW;
-    auto primePin = [&](uint8_t pin) {
-      digitalWrite(pin, offLevel);
-      pinMode(pin, OUTPUT);
-      digitalWrite(pin, offLevel);
-    };
-
-    primePin(PIN_RELAY_FWD);
-    primePin(PIN_RELAY_REV);
-    primePin(PIN_RELAY_PSU);
-    primePin(PIN_RELAY_EN);
+    if (!_timer.active() && !_timer.begin(&RelaysModule::onTimer, this)) {
+      if (_log) _log(String(F("[RELAYS] esp_timer unavailable, sequencing from loop only")));
+    }
 
-    _cur = MotionState::IDLE;
+    portENTER_CRITICAL(&_mux);
     _want = MotionState::IDLE;
-    _psuOn = false;
-    _tChangeAllowed = 0;
-    _tPsuReady = 0;
-    _latchedDrive = MotionState::IDLE;
-    _enableOn = false;
-    _tEnableReady = 0;
-    _psuHoldActive = false;
-    _tPsuHoldOff = 0;
-    driveEnable(false);
-
-    if (_store.setStatus("Action", "Idle") && _log) {
-      _log(String(F("[RELAYS] Action -> Idle")));
-    }
+    _dir = MotionState::IDLE;
+    _lastDir = MotionState::IDLE;
+    _reverseAllowedUs = 0;
+    _deadlineUs = 0;
+    enterOff();
+    portEXIT_CRITICAL(&_mux);
+    _stats.timing[T_SPIN_UP].intendedMs = _psuSpinMs;
+    _stats.timing[T_ENABLE].intendedMs = _enableDelayMs;
+    _stats.timing[T_DEAD_TIME].intendedMs = _deadMs;
+    _stats.timing[T_PSU_HOLD].intendedMs = _psuHoldMs;
+
+    if (_store.setStatus("Action", "Idle")) logAction("Idle");
   }
 
   // Desired motion (from buttons): OPENING / CLOSING / IDLE
   void request(MotionState want) {
-    if (want != MotionState::IDLE) {
-      _psuHoldActive = false;
-    }
-    // If switching direction while moving: enforce dead-time
-    MotionState active = (_cur != MotionState::IDLE) ? _cur : _latchedDrive;
-    if (want != MotionState::IDLE && active != MotionState::IDLE && want != active) {
-      // stop, start dead-time window; PSU stays ON during this 1s
-      allStop();
-      _cur = MotionState::IDLE;
-      _latchedDrive = MotionState::IDLE;
-      _tChangeAllowed = millis() + _deadMs;
-      if (_store.setStatus("Action", "Idle (dead-time)") && _log) {
-        _log(String(F("[RELAYS] Action -> Idle (dead-time)")));
-      }
+    const int64_t now = RelayTimer::nowUs();
+    portENTER_CRITICAL(&_mux);
+    if (want != _want) {
+      _want = want;
+      applyWant(now);
     }
-    _want = want;
+    portEXIT_CRITICAL(&_mux);
+    armTimer();
   }
 
-  void emergencyPanicOff(const char* reason = "panic") {
-    allStop();
-    drive(PIN_RELAY_PSU, false);
-    _psuOn = false;
-    _cur = MotionState::IDLE;
+  // quiet skips the log line so time-critical callers (power-fail flush)
+  // are not held up by serial/MQTT output.
+  void emergencyPanicOff(const char* reason = "panic", bool quiet = false) {
+    portENTER_CRITICAL(&_mux);
     _want = MotionState::IDLE;
-    _psuHoldActive = false;
-    if (_store.setStatus("Action", "ERROR Panic") && _log) {
+    enterOff();
+    portEXIT_CRITICAL(&_mux);
+    _timer.stop();
+    if (_store.setStatus("Action", "ERROR Panic") && _log && !quiet) {
       const char* why = (reason && reason[0]) ? reason : "panic";
       _log(String(F("[RELAYS] Action -> ERROR Panic (")) + why + F(")"));
     }
   }
 
   void update() {
-    const unsigned long now = millis();
+    const int64_t now = RelayTimer::nowUs();
+    portENTER_CRITICAL(&_mux);
+    bool fired = advance(now);
+    if (fired) ++_stats.loopFires;
+    const Phase phase = _phase;
+    const MotionState dir = _dir;
+    portEXIT_CRITICAL(&_mux);
+    if (fired) armTimer();
 
-    // If the operator wants IDLE (Neutral): stop & PSU OFF immediately (per current spec)
-    if (_want == MotionState::IDLE) {
-      if (_cur != MotionState::IDLE) {
-        allStop();
-        _cur = MotionState::IDLE;
-        _latchedDrive = MotionState::IDLE;
-        _psuHoldActive = true;
-        _tPsuHoldOff = now + _psuHoldMs;
-      }
-      if (_enableOn) driveEnable(false);
-      if (_latchedDrive != MotionState::IDLE) {
-        stopDirections();
-        _latchedDrive = MotionState::IDLE;
-      }
+    const uint32_t trips = _out.interlockTrips();
+    if (trips != _loggedTrips) {
+      _loggedTrips = trips;
+      if (_log) _log(String(F("[RELAYS] Interlock: FWD+REV requested, directions opened (")) + trips + F(")"));
+    }
 
-      if (_psuHoldActive && (long)(_tPsuHoldOff - now) <= 0) {
-        _psuHoldActive = false;
-      }
+    const char* label = phaseLabel(phase, dir);
+    if (_store.setStatus("Action", label)) logAction(label);
+  }
 
-      if (_psuHoldActive) {
-        if (!_psuOn) {
-          drive(PIN_RELAY_PSU, true);
-          _psuOn = true;
-        }
-      } else if (_psuOn) {
-        drive(PIN_RELAY_PSU, false);
-        _psuOn = false;
-      }
+  // Action changes go out as binary events when set; other lines use LogFn.
+  void setEventLogger(LogEventFn fn) { _event = fn; }
 
-      const char* label = _psuHoldActive ? "Idle (PSU hold)" : "Idle";
-      if (_store.setStatus("Action", label) && _log) {
-        _log(String(F("[RELAYS] Action -> ")) + label);
-      }
-      return;
-    }
+  MotionState current() const {
+    return (_phase == Phase::RUNNING) ? _dir : MotionState::IDLE;
+  }
+  Phase phase() const { return _phase; }
+  // Copy: the timer task updates the counters.
+  Stats stats() const {
+    portENTER_CRITICAL(&_mux);
+    Stats s = _stats;
+    s.outputWrites = _out.writes();
+    s.interlockTrips = _out.interlockTrips();
+    portEXIT_CRITICAL(&_mux);
+    return s;
+  }
 
-    // If still in dead-time after a direction change, just wait (PSU stays ON)
-    if (now < _tChangeAllowed) {
-      if (_enableOn) driveEnable(false);
-      return;
+  static const char* phaseName(Phase p) {
+    switch (p) {
+      case Phase::PSU_HOLD:  return "psu_hold";
+      case Phase::DEAD_TIME: return "dead_time";
+      case Phase::SPIN_UP:   return "spin_up";
+      case Phase::ARMING:    return "arming";
+      case Phase::RUNNING:   return "running";
+      default:               return "off";
     }
+  }
 
-    // Need motion -> ensure PSU is ON and has spun up
-    if (!_psuOn) {
-      drive(PIN_RELAY_PSU, true);
-      _psuOn = true;
-      _tPsuReady = now + _psuSpinMs;
-      if (_store.setStatus("Action", "PSU spin-up") && _log) {
-        _log(String(F("[RELAYS] Action -> PSU spin-up")));
-      }
-      return;
-    }
-    if (now < _tPsuReady) {
-      if (_enableOn) driveEnable(false);
-      return;
+  static const char* transitionName(uint8_t t) {
+    switch (t) {
+      case T_SPIN_UP:   return "spin_up";
+      case T_ENABLE:    return "enable";
+      case T_DEAD_TIME: return "dead_time";
+      case T_PSU_HOLD:  return "psu_hold";
+      default:          return "?";
     }
+  }
+
+private:
+  StatusStore& _store;
+  LogFn _log = nullptr;
+  LogEventFn _event = nullptr;
 
-    MotionState target = _want;
+  RelayOutputs _out;
+  RelayTimer _timer;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
 
-    // Adjust direction relays if needed (keep enable open while switching)
-    if (_latchedDrive != target) {
-      if (_enableOn) driveEnable(false);
-      stopDirections();
-      if (target == MotionState::OPENING) {
-        drive(PIN_RELAY_FWD, true);
-      } else if (target == MotionState::CLOSING) {
-        drive(PIN_RELAY_REV, true);
-      }
-      _latchedDrive = target;
-      _tEnableReady = now + _enableDelayMs;
-      if (_store.setStatus("Action", target == MotionState::OPENING ? "Opening (arming)"
-                                                                    : "Closing (arming)") && _log) {
-        _log(String(F("[RELAYS] Action -> ")) +
-             (target == MotionState::OPENING ? F("Opening (arming)") : F("Closing (arming)")));
+  // Guarded by _mux (shared with the esp_timer task).
+  volatile Phase _phase = Phase::OFF;
+  volatile MotionState _dir = MotionState::IDLE;   // contact currently closed
+  MotionState _want = MotionState::IDLE;
+  int64_t _deadlineUs = 0;      // 0 = nothing scheduled
+  int64_t _phaseStartUs = 0;
+  MotionState _lastDir = MotionState::IDLE;  // last contact to open
+  int64_t _reverseAllowedUs = 0;             // opposite contact may close
+  Stats _stats;
+  uint32_t _loggedTrips = 0;
+
+  uint32_t _deadMs = 1000;
+  uint32_t _psuSpinMs = 1000;
+  static constexpr uint32_t _enableDelayMs = 200;
+  static constexpr uint32_t _psuHoldMs = 60000;
+
+  static void onTimer(void* arg) {
+    RelaysModule* self = static_cast<RelaysModule*>(arg);
+    const int64_t now = RelayTimer::nowUs();
+    portENTER_CRITICAL(&self->_mux);
+    bool fired = self->advance(now);
+    if (fired) ++self->_stats.timerFires;
+    portEXIT_CRITICAL(&self->_mux);
+    // A stale fire (deadline moved later meanwhile) re-arms for the new one.
+    self->armTimer();
+  }
+
+  // (Re)arm the one-shot for the current deadline. Outside the lock: the
+  // esp_timer calls take their own.
+  void armTimer() {
+    if (!_timer.active()) return;
+    portENTER_CRITICAL(&_mux);
+    const int64_t deadline = _deadlineUs;
+    portEXIT_CRITICAL(&_mux);
+    _timer.armAt(deadline);
+  }
+
+  // ---- state machine; callers hold _mux ----
+
+  void applyWant(int64_t now) {
+    if (_want == MotionState::IDLE) {
+      if (_phase == Phase::RUNNING) {
+        enterPsuHold(now);
+      } else if (_phase != Phase::PSU_HOLD && _phase != Phase::OFF) {
+        enterOff();
       }
       return;
     }
 
-    // Engage enable relay once direction contacts are set and delay elapsed
-    if (!_enableOn) {
-      if (now < _tEnableReady) return;
-      driveEnable(true);
-      _cur = _latchedDrive;
-      const char* label = (_cur == MotionState::OPENING) ? "Opening" : "Closing";
-      if (_store.setStatus("Action", label) && _log) {
-        _log(String(F("[RELAYS] Action -> ")) + label);
-      }
-      return;
+    switch (_phase) {
+      case Phase::OFF:
+        enterSpinUp(now);
+        break;
+      case Phase::PSU_HOLD:
+        armOrWait(now);
+        break;
+      case Phase::ARMING:
+      case Phase::RUNNING:
+        // Reversing while the contacts are (being) closed: open everything
+        // and wait out the dead-time with the PSU on.
+        if (_want != _dir) enterDeadTime(now);
+        break;
+      case Phase::SPIN_UP:
+      case Phase::DEAD_TIME:
+        break;  // the pending transition picks up _want
     }
+  }
 
-    // Maintain current status when running
-    _cur = _latchedDrive;
+  // Applies the scheduled transition if it is due; true when it did.
+  bool advance(int64_t now) {
+    if (!_deadlineUs || now < _deadlineUs) return false;
+    const int64_t deadline = _deadlineUs;
+    switch (_phase) {
+      case Phase::SPIN_UP:
+        noteTiming(T_SPIN_UP, now, deadline);
+        if (_want != MotionState::IDLE) armOrWait(now); else enterOff();
+        break;
+      case Phase::ARMING:
+        noteTiming(T_ENABLE, now, deadline);
+        _out.write(RelayOutputs::PSU | dirRelay(_dir) | RelayOutputs::EN);
+        _phase = Phase::RUNNING;
+        _phaseStartUs = now;
+        _deadlineUs = 0;
+        break;
+      case Phase::DEAD_TIME:
+        noteTiming(T_DEAD_TIME, now, deadline);
+        if (_want != MotionState::IDLE) armOrWait(now); else enterOff();
+        break;
+      case Phase::PSU_HOLD:
+        noteTiming(T_PSU_HOLD, now, deadline);
+        enterOff();
+        break;
+      default:
+        _deadlineUs = 0;
+        return false;
+    }
+    return true;
   }
 
-  MotionState current() const { return _cur; }
+  void noteTiming(Transition t, int64_t now, int64_t deadline) {
+    TransitionTiming& tt = _stats.timing[t];
+    uint32_t late = static_cast<uint32_t>(now - deadline);
+    ++tt.count;
+    tt.lastActualUs = static_cast<uint32_t>(now - _phaseStartUs);
+    tt.lastLateUs = late;
+    if (late > tt.maxLateUs) tt.maxLateUs = late;
+  }
 
-private:
-  StatusStore& _store;
-  LogFn _log = nullptr;
+  void enterOff() {
+    openContacts();
+    _out.write(0);
+    _phase = Phase::OFF;
+    _deadlineUs = 0;
+  }
 
-  bool _activeLow = true;
-  bool _psuOn = false;
-  bool _enableOn = false;
+  void enterPsuHold(int64_t now) {
+    openContacts();
+    _out.write(RelayOutputs::PSU);
+    _phase = Phase::PSU_HOLD;
+    _phaseStartUs = now;
+    _deadlineUs = now + static_cast<int64_t>(_psuHoldMs) * 1000;
+  }
 
-  MotionState _cur  = MotionState::IDLE;
-  MotionState _want = MotionState::IDLE;
-  MotionState _latchedDrive = MotionState::IDLE;
+  void enterDeadTime(int64_t now) {
+    openContacts();
+    _out.write(RelayOutputs::PSU);
+    _phase = Phase::DEAD_TIME;
+    _phaseStartUs = now;
+    _deadlineUs = _reverseAllowedUs > now ? _reverseAllowedUs : now;
+  }
 
-  unsigned long _tChangeAllowed = 0;
-  unsigned long _tPsuReady = 0;
-  unsigned long _tEnableReady = 0;
+  // Close the wanted contact, unless that reverses one that opened less
+  // than _deadMs ago.
+  void armOrWait(int64_t now) {
+    if (_want != _lastDir && now < _reverseAllowedUs) {
+      enterDeadTime(now);
+    } else {
+      enterArming(now);
+    }
+  }
 
-  uint32_t _deadMs = 1000;
-  uint32_t _psuSpinMs = 1000;
-  static constexpr uint32_t _enableDelayMs = 200;
-  static constexpr uint32_t _psuHoldMs = 60000;
-  bool _psuHoldActive = false;
-  unsigned long _tPsuHoldOff = 0;
-
-  inline void drive(uint8_t pin, bool on) {
-    digitalWrite(pin, (_activeLow ? !on : on));
-  }
-  inline void allStop() {
-    stopDirections();
-    driveEnable(false);
-    _latchedDrive = MotionState::IDLE;
-    _tEnableReady = 0;
-  }
-  inline void stopDirections() {
-    drive(PIN_RELAY_FWD, false);
-    drive(PIN_RELAY_REV, false);
-  }
-  inline void driveEnable(bool on) {
-    digitalWrite(PIN_RELAY_EN, (_activeLow ? !on : on));
-    _enableOn = on;
-    if (!on) _tEnableReady = 0;
+  void enterSpinUp(int64_t now) {
+    openContacts();
+    _out.write(RelayOutputs::PSU);
+    _phase = Phase::SPIN_UP;
+    _phaseStartUs = now;
+    _deadlineUs = now + static_cast<int64_t>(_psuSpinMs) * 1000;
+  }
+
+  // Direction contacts switch with the enable open.
+  void enterArming(int64_t now) {
+    openContacts();
+    _out.write(RelayOutputs::PSU | dirRelay(_want));
+    _dir = _want;
+    _phase = Phase::ARMING;
+    _phaseStartUs = now;
+    _deadlineUs = now + static_cast<int64_t>(_enableDelayMs) * 1000;
+  }
+
+  static const char* phaseLabel(Phase phase, MotionState dir) {
+    switch (phase) {
+      case Phase::PSU_HOLD:  return "Idle (PSU hold)";
+      case Phase::DEAD_TIME: return "Idle (dead-time)";
+      case Phase::SPIN_UP:   return "PSU spin-up";
+      case Phase::ARMING:    return dir == MotionState::OPENING ? "Opening (arming)" : "Closing (arming)";
+      case Phase::RUNNING:   return dir == MotionState::OPENING ? "Opening" : "Closing";
+      default:               return "Idle";
+    }
+  }
+
+  void logAction(const char* label) {
+    if (_event) {
+      _event(LogRecord(LogId::RELAYS_ACTION, { label }));
+    } else if (_log) {
+      _log(String(F("[RELAYS] Action -> ")) + label);
+    }
+  }
+
+  static uint8_t dirRelay(MotionState dir) {
+    return dir == MotionState::OPENING ? RelayOutputs::FWD : RelayOutputs::REV;
+  }
+
+  // Bookkeeping for a direction contact about to open; the caller's write
+  // opens it.
+  inline void openContacts() {
+    if (_dir != MotionState::IDLE) {
+      _lastDir = _dir;
+      _reverseAllowedUs = RelayTimer::nowUs() + static_cast<int64_t>(_deadMs) * 1000;
+    }
+    _dir = MotionState::IDLE;
   }
 };
@@ -1,49 +1,151 @@
 #pragma once
 #include <Arduino.h>
-#include <deque>
 
+// Contiguous pieces of the log, oldest first: [first, first + firstLen)
+// then [second, second + secondLen). Valid until the next append().
+struct LogSpans {
+  const char* first = nullptr;
+  size_t firstLen = 0;
+  const char* second = nullptr;
+  size_t secondLen = 0;
+
+  size_t size() const { return firstLen + secondLen; }
+};
+
+// Rolling log of whole lines in a fixed circular byte buffer.
+//
+// Nothing is allocated after construction: append() copies the line in
+// (adding the newline) and evicts the oldest lines to make room, each in
+// O(1) via a ring of line start offsets. Readers get the text in place as
+// at most two spans (see view()). Lines longer than the buffer are cut.
+//
+// Line n since boot has sequence number n (the first is 1), so a reader
+// can ask for what it has not seen yet with viewFrom().
+template <size_t N>
 class RingLogger {
 public:
-  explicit RingLogger(size_t maxBytes = 6 * 1024) : _maxBytes(maxBytes) {}
-
-  // Append one full line (adds newline if missing)
-  void append(const String& line) {
-    String s = line;
-    if (!s.endsWith("\n")) s += "\n";
-    const size_t len = s.length();
-    // Evict oldest until it fits
-    while ((_totalBytes + len) > _maxBytes && !_lines.empty()) {
-      _totalBytes -= _lines.front().length();
-      _lines.pop_front();
+  static_assert(N >= 64 && N <= 65535, "offsets are 16-bit");
+  static constexpr size_t MAX_LINES = N / 16;  // evicts early if lines average < 16 B
+
+  void append(const String& line) { append(line.c_str(), line.length()); }
+
+  void append(const char* text, size_t len) {
+    bool newline = len && text[len - 1] == '\n';
+    if (newline) --len;
+    if (len > N - 1) len = N - 1;
+    const size_t need = len + 1;
+
+    while (_lineCount && (N - _used < need || _lineCount == MAX_LINES)) {
+      evictOldest();
     }
-    _lines.push_back(std::move(s));
-    _totalBytes += len;
-    _dirty = true;
+
+    const uint16_t start = static_cast<uint16_t>((_head + _used) % N);
+    _starts[(_firstLine + _lineCount) % MAX_LINES] = start;
+    ++_lineCount;
+    put(start, text, len);
+    _buf[(start + len) % N] = '\n';
+    _used += need;
+    ++_appends;
   }
 
-  // Compose a single multi-line blob; cheap if unchanged
-  String blob() {
-    if (!_dirty && _cachedValid) return _cached;
-    String out; out.reserve(_totalBytes + 16);
-    for (auto &l : _lines) out += l;
-    _cached = std::move(out);
-    _cachedValid = true;
-    _dirty = false;
-    return _cached;
+  LogSpans view() const {
+    LogSpans v;
+    if (!_used) return v;
+    v.first = _buf + _head;
+    if (_head + _used <= N) {
+      v.firstLen = _used;
+    } else {
+      v.firstLen = N - _head;
+      v.second = _buf;
+      v.secondLen = _used - v.firstLen;
+    }
+    return v;
   }
 
+  // Whole lines from sequence number `since` on (or the oldest kept, if
+  // that is gone), up to maxBytes but at least one line. *first and *last
+  // get the sequence numbers covered; the view is empty when nothing is
+  // newer than `since`.
+  LogSpans viewFrom(uint32_t since, size_t maxBytes, uint32_t* first, uint32_t* last) const {
+    LogSpans v;
+    const uint32_t oldest = firstSeq();
+    if (since < oldest) since = oldest;
+    *first = since;
+    *last = since - 1;
+    if (!_lineCount || static_cast<int32_t>(since - lastSeq()) > 0) return v;
+
+    const size_t skip = since - oldest;
+    const size_t from = lineOffset(skip);
+    size_t to = from;
+    for (size_t i = skip; i < _lineCount; ++i) {
+      size_t end = (i + 1 < _lineCount) ? lineOffset(i + 1) : _used;
+      if (end - from > maxBytes && i > skip) break;
+      to = end;
+      *last = oldest + static_cast<uint32_t>(i);
+    }
+
+    const size_t start = (_head + from) % N;
+    const size_t len = to - from;
+    v.first = _buf + start;
+    if (start + len <= N) {
+      v.firstLen = len;
+    } else {
+      v.firstLen = N - start;
+      v.second = _buf;
+      v.secondLen = len - v.firstLen;
+    }
+    return v;
+  }
+
+  uint32_t lastSeq() const { return _appends; }
+  uint32_t firstSeq() const { return _appends - _lineCount + 1; }
+
   void clear() {
-    _lines.clear(); _totalBytes = 0;
-    _dirty = true; _cachedValid = false; _cached = "";
+    _head = 0;
+    _used = 0;
+    _firstLine = 0;
+    _lineCount = 0;
   }
 
-  size_t sizeBytes() const { return _totalBytes; }
+  size_t sizeBytes() const { return _used; }
+  size_t lines() const { return _lineCount; }
+  uint32_t appends() const { return _appends; }
+  static constexpr size_t capacity() { return N; }
 
 private:
-  std::deque<String> _lines;
-  size_t _maxBytes;
-  size_t _totalBytes{0};
-  bool _dirty{true};
-  bool _cachedValid{false};
-  String _cached;
+  // Bytes from the oldest line to the start of line i (0 = oldest).
+  size_t lineOffset(size_t i) const {
+    return (_starts[(_firstLine + i) % MAX_LINES] + N - _head) % N;
+  }
+
+  void evictOldest() {
+    _firstLine = static_cast<uint16_t>((_firstLine + 1) % MAX_LINES);
+    --_lineCount;
+    if (!_lineCount) {
+      _head = 0;
+      _used = 0;
+      return;
+    }
+    const uint16_t next = _starts[_firstLine];
+    _used -= (next + N - _head) % N;
+    _head = next;
+  }
+
+  void put(size_t at, const char* text, size_t len) {
+    const size_t tail = N - at;
+    if (len <= tail) {
+      memcpy(_buf + at, text, len);
+    } else {
+      memcpy(_buf + at, text, tail);
+      memcpy(_buf, text + tail, len - tail);
+    }
+  }
+
+  char _buf[N];
+  uint16_t _starts[MAX_LINES];
+  uint16_t _head = 0;        // offset of the oldest line
+  size_t _used = 0;          // bytes held, newlines included
+  uint16_t _firstLine = 0;   // index of the oldest line in _starts
+  uint16_t _lineCount = 0;
+  uint32_t _appends = 0;
 };
@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+
+// Filtered click interval (and its spread) for one travel direction.
+//
+// Fed once per processed edge batch with the time of the newest click and
+// the number of clicks since the previous feed, so it works for both
+// timestamped edges and the PCNT backend (where a batch shares one drain
+// time). The mean is updated once per WINDOW_CLICKS clicks from the time
+// the whole window took, which averages out per-click jitter; the spread
+// is still tracked per feed. The first window of a run only sets the
+// reference: spin-up is not representative of cruising speed.
+class SpeedEstimator {
+public:
+  static constexpr uint16_t WINDOW_CLICKS = 4;
+
+  void restart() {
+    _haveRef = false;
+    _warm = false;
+  }
+
+  void addClicks(uint32_t us, uint16_t clicks) {
+    if (!clicks) return;
+    if (!_haveRef) {
+      _refUs = us;
+      _lastUs = us;
+      _windowClicks = 0;
+      _haveRef = true;
+      return;
+    }
+    if (us == _lastUs) return;
+
+    if (_intervalUs) {
+      int32_t delta = static_cast<int32_t>((us - _lastUs) / clicks) - static_cast<int32_t>(_intervalUs);
+      int32_t dev = (delta < 0 ? -delta : delta) - static_cast<int32_t>(_devUs);
+      _devUs = static_cast<uint32_t>(static_cast<int32_t>(_devUs) + dev / 4);
+    }
+    _lastUs = us;
+    _windowClicks += clicks;
+    if (_windowClicks < WINDOW_CLICKS) return;
+
+    uint32_t interval = (us - _refUs) / _windowClicks;
+    _refUs = us;
+    _windowClicks = 0;
+    if (!_warm) {
+      _warm = true;
+      return;
+    }
+    if (!_intervalUs) {
+      _intervalUs = interval;
+    } else {
+      int32_t delta = static_cast<int32_t>(interval) - static_cast<int32_t>(_intervalUs);
+      _intervalUs = static_cast<uint32_t>(static_cast<int32_t>(_intervalUs) + delta / 4);
+    }
+    ++_samples;
+  }
+
+  uint32_t intervalUs() const { return _intervalUs; }
+  uint32_t deviationUs() const { return _devUs; }  // mean absolute deviation
+  uint32_t samples() const { return _samples; }
+  float clicksPerSecond() const {
+    return _intervalUs ? 1000000.0f / static_cast<float>(_intervalUs) : 0.0f;
+  }
+
+private:
+  bool _haveRef = false;
+  bool _warm = false;         // spin-up window of this run is behind us
+  uint32_t _refUs = 0;        // start of the current window
+  uint32_t _lastUs = 0;       // previous feed
+  uint16_t _windowClicks = 0;
+  uint32_t _intervalUs = 0;
+  uint32_t _devUs = 0;
+  uint32_t _samples = 0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <Arduino.h>
+
+// Watches the gap since the last click while the relays drive and trips
+// when it grows past a multiple of the expected click interval.
+//
+// The expected interval and its spread come from the click counter's speed
+// estimate for the driving direction. The multiple is the configured factor
+// or, on a noisy cover, whatever the observed spread needs (DEV_MULTIPLE
+// mean deviations), whichever is larger. Before the first click of a run the
+// limit also allows for spin-up. Until a direction has a speed estimate, the
+// caller's fixed fallback window is used instead.
+class StallDetector {
+public:
+  static constexpr float    DEFAULT_FACTOR = 3.0f;
+  static constexpr float    MIN_FACTOR = 1.5f;
+  static constexpr float    MAX_FACTOR = 10.0f;
+  static constexpr float    DEV_MULTIPLE = 6.0f;
+  static constexpr uint32_t MIN_LIMIT_MS = 300;
+  static constexpr uint32_t SPINUP_MS = 1000;
+
+  void setFactor(float factor) {
+    if (factor < MIN_FACTOR) factor = MIN_FACTOR;
+    if (factor > MAX_FACTOR) factor = MAX_FACTOR;
+    _factor = factor;
+  }
+  float factor() const { return _factor; }
+
+  void start(uint32_t nowMs, int32_t pos, uint32_t fallbackMs) {
+    _active = true;
+    _progress = false;
+    _lastPos = pos;
+    _lastProgressMs = nowMs;
+    _fallbackMs = fallbackMs;
+    _limitMs = fallbackMs;
+  }
+
+  void stop() { _active = false; }
+
+  // Returns true once, on the update that finds the gap over the limit.
+  bool update(uint32_t nowMs, int32_t pos, uint32_t meanUs, uint32_t devUs) {
+    if (!_active) return false;
+    if (pos != _lastPos) {
+      _lastPos = pos;
+      _lastProgressMs = nowMs;
+      _progress = true;
+    }
+
+    _limitMs = _fallbackMs;
+    if (meanUs) {
+      float multiple = 1.0f + DEV_MULTIPLE * static_cast<float>(devUs) / static_cast<float>(meanUs);
+      if (multiple < _factor) multiple = _factor;
+      uint32_t limit = static_cast<uint32_t>(static_cast<float>(meanUs) * multiple / 1000.0f);
+      if (limit < MIN_LIMIT_MS) limit = MIN_LIMIT_MS;
+      if (!_progress) limit += SPINUP_MS;
+      _limitMs = limit;
+    }
+
+    _gapMs = nowMs - _lastProgressMs;
+    if (_gapMs <= _limitMs) return false;
+    _active = false;
+    ++_trips;
+    return true;
+  }
+
+  bool active() const { return _active; }
+  bool sawProgress() const { return _progress; }
+  uint32_t limitMs() const { return _limitMs; }
+  uint32_t gapMs() const { return _gapMs; }
+  uint32_t trips() const { return _trips; }
+
+private:
+  float _factor = DEFAULT_FACTOR;
+  bool _active = false;
+  bool _progress = false;
+  int32_t _lastPos = 0;
+  uint32_t _lastProgressMs = 0;
+  uint32_t _fallbackMs = 0;
+  uint32_t _limitMs = 0;
+  uint32_t _gapMs = 0;
+  uint32_t _trips = 0;
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <Arduino.h>
+#include <mutex>
 
+// Rows are written from both the control and the network task.
 class StatusStore {
 public:
   struct Entry {
@@ -11,6 +13,7 @@ public:
   static constexpr uint8_t MAX_ITEMS = 10;
 
   void configure(const char* labels[], uint8_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
     _count = min<uint8_t>(count, MAX_ITEMS);
     for (uint8_t i = 0; i < _count; ++i) {
       _entries[i].label = labels[i];
@@ -20,6 +23,7 @@ public:
   }
 
   bool setStatus(const String& label, const String& value) {
+    std::lock_guard<std::mutex> lock(_mutex);
     for (uint8_t i = 0; i < _count; ++i) {
       if (_entries[i].label.equalsIgnoreCase(label)) {
         if (_entries[i].value == value) return false;
@@ -55,6 +59,7 @@ public:
   const Entry& entry(uint8_t index) const { return _entries[index]; }
 
 private:
+  std::mutex _mutex;
   Entry _entries[MAX_ITEMS];
   uint8_t _count = 0;
   bool _dirty = false;
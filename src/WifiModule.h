@@ -1,13 +1,29 @@
 #pragma once
 #include <Arduino.h>
 #include <WiFi.h>
+#include <Preferences.h>
+#include <esp_attr.h>
 #include "wifi_config.h"
 #include "StatusStore.h"
+#include "Crc32.h"
 
 class WifiModule {
 public:
   using LogFn = void (*)(const String&);
 
+  // Where the channel/BSSID used for the current attempt came from.
+  enum class HintSource : uint8_t { NONE, CONFIG, RTC, NVS, SCAN };
+
+  struct Stats {
+    uint32_t bootToIpMs = 0;     // begin() to the first IP
+    uint32_t lastToIpMs = 0;     // attempt start (scan included) to IP
+    uint32_t connects = 0;
+    uint32_t scans = 0;
+    uint32_t lastScanMs = 0;
+    uint32_t hintMisses = 0;     // hinted attempts that timed out
+    HintSource lastHint = HintSource::NONE;
+  };
+
   explicit WifiModule(StatusStore &store, LogFn logger = nullptr)
     : _store(store), _log(logger) {}
 
@@ -41,24 +57,31 @@ public:
     _store.setStatus("Wifi", "Connecting");
     if (_log) _log(String(F("[WIFI] Starting connection")));
     _connected = false;
+    _phase = Phase::IDLE;
     _backoffMs = 1000;
     _lastAttempt = 0;
     _lastInfoPush = 0;
+    _beginMs = millis();
+    _attemptStartMs = _beginMs;
+    _prefsOpen = _prefs.begin(NVS_NAMESPACE, false);
 
-    // Optional hints
+    // Hints, strongest first: build config, this boot's RTC copy, NVS.
     _channel = (uint8_t)WIFI_CHANNEL_HINT;
+    memset(_bssid, 0, sizeof(_bssid));
+    _haveBssid = false;
+    _hint = HintSource::NONE;
 #ifdef WIFI_BSSID_HINT
     {
       const uint8_t hint[6] = WIFI_BSSID_HINT;
       memcpy(_bssid, hint, 6);
       _haveBssid = true;
+      _hint = HintSource::CONFIG;
     }
 #else
-    memset(_bssid, 0, sizeof(_bssid));
-    _haveBssid = false;
+    if (_channel == 0) loadStoredHint();
 #endif
 
-    startConnect(true);
+    startConnect(millis());
   }
 
   void update() {
@@ -68,15 +91,18 @@ public:
     if (s == WL_CONNECTED) {
       if (!_connected) {
         _connected = true;
+        _phase = Phase::IDLE;
         _backoffMs = 2000;
+        ++_stats.connects;
+        _stats.lastToIpMs = now - _attemptStartMs;
+        if (_stats.connects == 1) _stats.bootToIpMs = now - _beginMs;
+        _stats.lastHint = _hint;
         _store.setStatus("Wifi", connectedStatus());
-        if (_log) _log(String(F("[WIFI] Connected: ")) + connectedStatus());
-        // Learn channel & BSSID on first success if not fixed
-        if (_channel == 0 || !_haveBssid) {
-          _channel = WiFi.channel();
-          const uint8_t* cur = WiFi.BSSID();
-          if (cur) { memcpy(_bssid, cur, 6); _haveBssid = true; }
+        if (_log) {
+          _log(String(F("[WIFI] Connected: ")) + connectedStatus() + F(" in ") +
+               _stats.lastToIpMs + F(" ms (hint: ") + hintName(_hint) + F(")"));
         }
+        rememberAp();
       }
       // periodic refresh (IP may change)
       if (now - _lastInfoPush > 30000UL) {
@@ -93,65 +119,226 @@ public:
         _log(String(F("[WIFI] Disconnected")));
       }
       _backoffMs = 1000;
-      _lastAttempt = 0;
+      _lastAttempt = now - _backoffMs;
+      _attemptStartMs = now;
+    }
+
+    switch (_phase) {
+      case Phase::SCANNING:
+        pollScan(now);
+        return;
+      case Phase::CONNECTING:
+        if (now - _lastAttempt < ATTEMPT_TIMEOUT_MS) return;
+        // The stored AP may have moved channel or been replaced: rescan.
+        if (_hint != HintSource::NONE && _hint != HintSource::CONFIG) {
+          ++_stats.hintMisses;
+          if (_log) _log(String(F("[WIFI] Hinted connect timed out, will rescan")));
+          forgetHint();
+        }
+        _phase = Phase::IDLE;
+        break;
+      case Phase::IDLE:
+        break;
     }
 
     if (now - _lastAttempt >= _backoffMs) {
-      _lastAttempt = now;
-      startConnect(false);
+      startConnect(now);
       _backoffMs = min<uint32_t>(_backoffMs * 2, 60000UL);
     }
   }
 
   bool isConnected() const { return _connected; }
+  const Stats& stats() const { return _stats; }
+
+  static const char* hintName(HintSource h) {
+    switch (h) {
+      case HintSource::CONFIG: return "config";
+      case HintSource::RTC:    return "rtc";
+      case HintSource::NVS:    return "nvs";
+      case HintSource::SCAN:   return "scan";
+      default:                 return "none";
+    }
+  }
 
 private:
+  enum class Phase : uint8_t { IDLE, SCANNING, CONNECTING };
+
+  static constexpr const char* NVS_NAMESPACE = "wifi";
+  static constexpr const char* KEY_AP = "ap";
+  static constexpr uint32_t AP_MAGIC = 0x57415031;       // "WAP1"
+  static constexpr uint32_t ATTEMPT_TIMEOUT_MS = 10000;  // association + DHCP
+  static constexpr uint32_t SCAN_TIMEOUT_MS = 10000;
+
+  // Last good AP, kept in NVS and mirrored in RTC memory (survives the
+  // panic and watchdog reboots without touching flash).
+  struct ApRecord {
+    uint32_t magic;
+    uint8_t  channel;
+    uint8_t  bssid[6];
+    uint8_t  reserved;
+    uint32_t crc32;
+  };
+
+  static ApRecord& rtcAp() {
+    static RTC_NOINIT_ATTR ApRecord rec;
+    return rec;
+  }
+
+  static bool recordValid(const ApRecord& r) {
+    return r.magic == AP_MAGIC && r.channel > 0 &&
+           r.crc32 == crc32Ieee(&r, offsetof(ApRecord, crc32));
+  }
+
   StatusStore &_store;
   LogFn _log = nullptr;
   bool _connected = false;
+  Phase _phase = Phase::IDLE;
 
   uint8_t _channel = 0;
   uint8_t _bssid[6] = {0};
   bool _haveBssid = false;
+  HintSource _hint = HintSource::NONE;
+
+  Preferences _prefs;
+  bool _prefsOpen = false;
 
+  uint32_t _beginMs = 0;
+  uint32_t _attemptStartMs = 0;
+  uint32_t _scanStartMs = 0;
   uint32_t _lastAttempt = 0;
   uint32_t _lastInfoPush = 0;
   uint32_t _backoffMs = 1000;
+  Stats _stats;
 
-  void startConnect(bool /*first*/) {
-#if defined(WIFI_SSID) && defined(WIFI_PASS)
-    // If we don't yet know channel/BSSID, scan once to pick the best AP
+  void loadStoredHint() {
+    ApRecord rec;
+    HintSource source = HintSource::NONE;
+    if (recordValid(rtcAp())) {
+      rec = rtcAp();
+      source = HintSource::RTC;
+    } else if (_prefsOpen && _prefs.getBytesLength(KEY_AP) == sizeof(ApRecord) &&
+               _prefs.getBytes(KEY_AP, &rec, sizeof(rec)) == sizeof(rec) && recordValid(rec)) {
+      rtcAp() = rec;
+      source = HintSource::NVS;
+    }
+    if (source == HintSource::NONE) return;
+    _channel = rec.channel;
+    memcpy(_bssid, rec.bssid, 6);
+    _haveBssid = true;
+    _hint = source;
+  }
+
+  void forgetHint() {
+    _channel = (uint8_t)WIFI_CHANNEL_HINT;
+    _haveBssid = false;
+    _hint = HintSource::NONE;
+    rtcAp().magic = 0;
+  }
+
+  // Store the AP we ended up on; NVS is only written when it changed.
+  void rememberAp() {
+    ApRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = AP_MAGIC;
+    rec.channel = (uint8_t)WiFi.channel();
+    const uint8_t* cur = WiFi.BSSID();
+    if (!cur || rec.channel == 0) return;
+    memcpy(rec.bssid, cur, 6);
+    rec.crc32 = crc32Ieee(&rec, offsetof(ApRecord, crc32));
+
+#ifndef WIFI_BSSID_HINT
+    _channel = rec.channel;
+    memcpy(_bssid, rec.bssid, 6);
+    _haveBssid = true;
+#endif
+
+    bool changed = !recordValid(rtcAp()) || memcmp(&rtcAp(), &rec, sizeof(rec)) != 0;
+    rtcAp() = rec;
+    if (!_prefsOpen) return;
+    ApRecord stored;
+    if (!changed && _prefs.getBytesLength(KEY_AP) == sizeof(ApRecord) &&
+        _prefs.getBytes(KEY_AP, &stored, sizeof(stored)) == sizeof(stored) &&
+        memcmp(&stored, &rec, sizeof(rec)) == 0) {
+      return;
+    }
+    _prefs.putBytes(KEY_AP, &rec, sizeof(rec));
+    if (_log) _log(String(F("[WIFI] Stored AP hint (ch ")) + rec.channel + F(")"));
+  }
+
+  // With a channel and BSSID the attempt goes straight to association;
+  // otherwise an asynchronous scan picks the strongest AP first.
+  void startConnect(uint32_t now) {
+    _lastAttempt = now;
     if (_channel == 0 || !_haveBssid) {
-      int n = WiFi.scanNetworks(false, true);
-      int bestIdx = -1; int bestRSSI = -127;
-      uint8_t bestCh = 0; uint8_t bestBssid[6] = {0};
-      for (int i = 0; i < n; ++i) {
-        if (WiFi.SSID(i) == String(WIFI_SSID)) {
-          int rssi = WiFi.RSSI(i);
-          if (rssi > bestRSSI) {
-            bestRSSI = rssi; bestIdx = i;
-            bestCh = (uint8_t)WiFi.channel(i);
-            const uint8_t *b = WiFi.BSSID(i);
-            memcpy(bestBssid, b, 6);
-          }
+      startScan(now);
+      return;
+    }
+    beginAssociation(now);
+  }
+
+  void startScan(uint32_t now) {
+    WiFi.disconnect();
+    int16_t rc = WiFi.scanNetworks(/*async=*/true, /*show_hidden=*/true);
+    if (rc == WIFI_SCAN_FAILED) {
+      if (_log) _log(String(F("[WIFI] Scan failed to start")));
+      beginAssociation(now);
+      return;
+    }
+    _phase = Phase::SCANNING;
+    _scanStartMs = now;
+    ++_stats.scans;
+    _store.setStatus("Wifi", "Scanning");
+  }
+
+  void pollScan(uint32_t now) {
+    int16_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) {
+      if (now - _scanStartMs < SCAN_TIMEOUT_MS) return;
+      if (_log) _log(String(F("[WIFI] Scan timed out")));
+      n = WIFI_SCAN_FAILED;
+    }
+    _stats.lastScanMs = now - _scanStartMs;
+
+    int bestIdx = -1;
+    int bestRSSI = -127;
+    for (int i = 0; i < n; ++i) {
+      if (WiFi.SSID(i) == String(WIFI_SSID)) {
+        int rssi = WiFi.RSSI(i);
+        if (rssi > bestRSSI) {
+          bestRSSI = rssi;
+          bestIdx = i;
         }
       }
-      if (bestIdx >= 0) {
-        _channel = bestCh;
-        memcpy(_bssid, bestBssid, 6);
-        _haveBssid = true;
-      }
     }
+    if (bestIdx >= 0) {
+      _channel = (uint8_t)WiFi.channel(bestIdx);
+      memcpy(_bssid, WiFi.BSSID(bestIdx), 6);
+      _haveBssid = true;
+      _hint = HintSource::SCAN;
+    }
+    if (_log) {
+      _log(String(F("[WIFI] Scan done in ")) + _stats.lastScanMs + F(" ms, ") +
+           (n > 0 ? n : 0) + F(" APs, ") + (bestIdx >= 0 ? String(F("found ch ")) + _channel + F(" ") + bestRSSI + F(" dBm")
+                                                         : String(F("SSID not seen"))));
+    }
+    WiFi.scanDelete();
+    beginAssociation(now);
+  }
 
+  void beginAssociation(uint32_t now) {
+#if defined(WIFI_SSID) && defined(WIFI_PASS)
     if (_log) {
       _log(String(F("[WIFI] Attempting connection")));
     }
     _store.setStatus("Wifi", "Connecting");
+    _phase = Phase::CONNECTING;
+    _lastAttempt = now;
     if (_haveBssid && _channel > 0) {
       WiFi.begin(WIFI_SSID, WIFI_PASS, _channel, _bssid, true);
     } else if (_channel > 0) {
       WiFi.begin(WIFI_SSID, WIFI_PASS, _channel);
     } else {
+      _hint = HintSource::NONE;
       WiFi.begin(WIFI_SSID, WIFI_PASS);
     }
 #else
@@ -1,5 +1,9 @@
 #include <Arduino.h>
 #include <Preferences.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
 #include "StatusStore.h"
 #include "WifiModule.h"
 #include "AnalogController.h"
@@ -8,20 +12,82 @@
 #include "ClickCounter.h"
 #include "StatusLed.h"
 #include "RingLogger.h"
+#include "PowerFailMonitor.h"
+#include "StallDetector.h"
+#include "PositionTarget.h"
+#include "ControlLink.h"
+#include "LoopProfiler.h"
+#include "LatencyTracer.h"
+#include "LogEvents.h"
+#include "LogDrain.h"
+#include "LogMerge.h"
+#include "CrashLog.h"
 #include "pins.h"
 
+// 1 = relay/click/safety logic runs in its own task pinned to core 1 and
+// Wi-Fi/MQTT/logging in a task on core 0, talking only through ControlLink.
+// 0 = both steps run back-to-back in Arduino loop() as before.
+#ifndef CONTROL_TASKS_ENABLED
+#define CONTROL_TASKS_ENABLED 1
+#endif
+
+static constexpr uint32_t CONTROL_PERIOD_MS = 5;
+static constexpr uint32_t NET_PERIOD_MS = 10;
+static constexpr UBaseType_t CONTROL_TASK_PRIORITY = 5;
+static constexpr UBaseType_t NET_TASK_PRIORITY = 2;
+static constexpr uint32_t CONTROL_TASK_STACK = 6144;
+static constexpr uint32_t NET_TASK_STACK = 10240;
+
+static constexpr uint32_t PROFILE_WINDOW_MS = 10000;
+
 static constexpr size_t LOG_BUFFER_BYTES = 8 * 1024;
 static constexpr unsigned long LOG_SNAPSHOT_INTERVAL_MS = 1500;
+static constexpr size_t LOG_DELTA_MAX_BYTES = 1024;  // per log_blob publish
+static constexpr uint32_t LOG_FETCH_MIN_BYTES = 256;
+static constexpr uint32_t LOG_FETCH_MAX_BYTES = 4096;
 static constexpr unsigned long POS_STATUS_INTERVAL_MS = 500;
 
 static StatusStore statusStore;
-static RingLogger ringLog(LOG_BUFFER_BYTES);
+static RingLogger<LOG_BUFFER_BYTES> ringLog;
+static LogDrain logDrain;
+static CrashLog crashLog;  // tail kept across panic/watchdog resets
 static WifiModule* wifi = nullptr;
 static AnalogController* analogCtl = nullptr;
 static RelaysModule* relays = nullptr;
 static MqttModule* mqtt = nullptr;
 static ClickCounter clicks;
 static StatusLed statusLed;
+static PowerFailMonitor powerFail;
+static ControlLink controlLink;
+static LoopTiming controlTiming;
+static uint64_t lastControlPassUs = 0;
+static bool controlStarted = false;
+static uint16_t controlLogSeq = 0;  // control side: orders logs vs events
+static LogMerge logMerge;           // network side: puts them back in order
+
+static LatencyTracer latencyTracer;
+static uint32_t tracedRunSeq = 0;
+static uint32_t loggedTraceSeq = 0;
+static uint32_t sentTraceSeq = 0;       // control side: latest in controlLink.latency
+static uint32_t publishedTraceSeq = 0;  // network side: latest on tele/latency
+
+#if LOOP_PROFILER_ENABLED
+enum ControlProfileSection : uint8_t {
+  CTRL_INPUT, CTRL_COMMANDS, CTRL_ARBITRATE, CTRL_RELAYS, CTRL_CLICKS,
+  CTRL_SAFETY, CTRL_STATUS, CTRL_PASS, CTRL_PERIOD, CTRL_SECTIONS
+};
+static const char* const CONTROL_SECTION_NAMES[CTRL_SECTIONS] = {
+  "input", "commands", "arbitrate", "relays", "clicks",
+  "safety", "status", "pass", "period"
+};
+enum NetProfileSection : uint8_t { NET_WIFI, NET_LOGS, NET_MQTT, NET_PASS, NET_PERIOD, NET_SECTIONS };
+static const char* const NET_SECTION_NAMES[NET_SECTIONS] = { "wifi", "logs", "mqtt", "pass", "period" };
+
+static LoopProfiler controlProfile(CONTROL_SECTION_NAMES, CTRL_SECTIONS);
+static LoopProfiler netProfile(NET_SECTION_NAMES, NET_SECTIONS);
+static uint32_t lastNetPassUs = 0;
+static uint32_t sentProfileSeq = 0;
+#endif
 
 static MotionState lastAnalogRaw = MotionState::IDLE;
 static MotionState lastAnalogEffective = MotionState::IDLE;
@@ -31,6 +97,9 @@ static bool setModeActive = false;
 static bool panicLatched = false;
 static bool lastMqttConnected = false;
 static unsigned long lastLogSnapshotMs = 0;
+static uint32_t logBlobSeq = 0;   // newest line already on log_blob
+static bool previousBootPublished = false;
+static std::atomic<bool> logFlushRequested{false};
 static unsigned long lastPosStatusMs = 0;
 static const char* lastModeLabel = "LOCAL";
 static bool clickSimulationEnabled = false;
@@ -51,9 +120,16 @@ static bool driveActive = false;
 static unsigned long driveLastUpdateMs = 0;
 static uint32_t driveAccumMs = 0;
 
-static bool noClickMonitorActive = false;
-static unsigned long noClickStartMs = 0;
-static int32_t noClickPosAtEnable = 0;
+// Stall guard: whole-run gap check against the learned click interval.
+// NO_CLICK_PANIC_WINDOW_MS is its fallback until a direction has a speed.
+static StallDetector stallDetector;
+
+// set_position: stop this long before the predicted coast would carry the
+// cover past the target (loop pass + relay release).
+static PositionTarget positionTarget;
+static constexpr uint32_t POSITION_STOP_LATENCY_MS = 20;
+
+static constexpr uint32_t POWER_FAIL_FLUSH_BUDGET_US = 20000UL;
 
 static bool panicRebootPending = false;
 static unsigned long panicRebootAtMs = 0;
@@ -69,16 +145,39 @@ static uint32_t haCommandSeq = 0;
 static CommandSource activeCommandSource = CommandSource::NONE;
 static bool haClearedLocally = false;
 static MotionState lastHaDesired = MotionState::IDLE;
+// HA's wish, owned by the control side; fed by HA_MOTION commands.
+static MotionState haDesired = MotionState::IDLE;
+static uint32_t haMotionSerial = 0;
 
 static void logLine(const String& message);
 static void logLine(const __FlashStringHelper* message) {
   logLine(String(message));
 }
+static void netLogLine(const String& message);
+static void flushLogBatch();
+static void publishLogDelta();
+static void publishPreviousBoot();
+static void logEvent(const LogRecord& record);
+static void logEvent(LogId id, std::initializer_list<LogArg> args) {
+  logEvent(LogRecord(id, args));
+}
+
+static void controlStep();
+static void traceCommand(LatencyTracer::Source source, MotionState target, uint32_t inputUs);
+static void traceMotion(int32_t posBeforeClicks);
+static void netStep();
+static void publishControlSnapshot(MotionState analogState);
+static void flushLogsForReset();
+#if CONTROL_TASKS_ENABLED
+static void controlTask(void*);
+static void netTask(void*);
+#endif
 
 static void triggerPanic(const char* reason, bool requestReboot);
 static void schedulePanicReboot(unsigned long now);
 static void resetSafetyRuntime(const char* reason);
-static void onMqttSetMaxRuntime(uint32_t seconds);
+static void onSetMaxRuntime(uint32_t seconds);
+static void onSetStallFactor(float factor);
 static void loadSafetyConfig();
 static void persistSafetyMaxRunSeconds(uint32_t seconds);
 
@@ -123,11 +222,16 @@ static const char* computeModeLabel(CommandSource source,
 }
 
 static void clearHaDesiredLocal() {
-  if (!mqtt) return;
-  mqtt->clearHaDesired();
+  haDesired = MotionState::IDLE;
   haClearedLocally = true;
 }
 
+static void setHaDesired(MotionState s) {
+  if (haDesired == s) return;
+  haDesired = s;
+  logEvent(LogId::CTRL_HA_DESIRED, { motionLabel(s) });
+}
+
 static void updateSafetyRow() {
   const char* label = panicLatched ? "Panic"
                                    : (setModeActive ? "Set Mode" : "Nominal");
@@ -150,6 +254,10 @@ static void loadSafetyConfig() {
 
   safetyMaxRunSeconds = stored;
   logLine(String(F("[SAFETY] Max runtime limit = ")) + safetyMaxRunSeconds + F(" s"));
+
+  uint32_t stallX10 = configPrefs.getUInt("stall_x10", 0);
+  if (stallX10 > 0) stallDetector.setFactor(stallX10 / 10.0f);
+  logLine(String(F("[SAFETY] Stall factor = ")) + String(stallDetector.factor(), 1) + F("x"));
 }
 
 static void persistSafetyMaxRunSeconds(uint32_t seconds) {
@@ -188,13 +296,28 @@ static void triggerPanic(const char* reason, bool requestReboot) {
   driveActive = false;
   driveAccumMs = 0;
   driveLastUpdateMs = 0;
-  noClickMonitorActive = false;
+  stallDetector.stop();
   if (requestReboot) {
     schedulePanicReboot(millis());
   }
 }
 
-static void onMqttSetMaxRuntime(uint32_t seconds) {
+static void handlePowerFail() {
+  // Order matters: open the motor circuit first, then spend the remaining
+  // hold-up time on the position record. Logging comes last.
+  if (relays) relays->emergencyPanicOff("power-fail", /*quiet=*/true);
+  uint32_t flushUs = clicks.emergencyFlush();
+  logLine(String(F("[POWER] Rail low (")) + powerFail.railMv() +
+          F(" mV), position flushed in ") + flushUs + F(" us (pos=") +
+          clicks.position() + F(")"));
+  if (flushUs > POWER_FAIL_FLUSH_BUDGET_US) {
+    logLine(String(F("[POWER] Flush exceeded budget (")) +
+            POWER_FAIL_FLUSH_BUDGET_US + F(" us)"));
+  }
+  triggerPanic("power-fail", true);
+}
+
+static void onSetMaxRuntime(uint32_t seconds) {
   uint32_t clamped = seconds;
   if (clamped < 30U) {
     clamped = 30U;
@@ -218,6 +341,32 @@ static void onMqttSetMaxRuntime(uint32_t seconds) {
   resetSafetyRuntime("config change");
 }
 
+static void onSetStallFactor(float factor) {
+  stallDetector.setFactor(factor);
+  if (stallDetector.factor() != factor) {
+    logLine(String(F("[SAFETY] Stall factor clamp applied (requested=")) +
+            String(factor, 1) + F(")"));
+  }
+  if (configPrefsOpen) {
+    configPrefs.putUInt("stall_x10", (uint32_t)(stallDetector.factor() * 10.0f + 0.5f));
+  }
+  logLine(String(F("[SAFETY] Stall factor updated -> ")) +
+          String(stallDetector.factor(), 1) + F("x"));
+}
+
+static void checkStall(unsigned long now, MotionState dir) {
+  if (!stallDetector.update(now, clicks.position(),
+                            clicks.clickIntervalUs(dir),
+                            clicks.clickIntervalDevUs(dir))) {
+    return;
+  }
+  bool midTravel = stallDetector.sawProgress();
+  logLine(String(F("[SAFETY] No click for ")) + stallDetector.gapMs() +
+          F(" ms (limit ") + stallDetector.limitMs() + F(" ms, ") +
+          motionLabel(dir) + F(")"));
+  triggerPanic(midTravel ? "click-stall" : "no-click-after-enable", true);
+}
+
 static void enterSetMode(const char* origin) {
   if (setModeActive) return;
   setModeActive = true;
@@ -260,58 +409,239 @@ static void exitSetMode(const char* origin) {
   analogCommandSeq = ++commandSeqCounter;
 }
 
-static void processHaCommands() {
-  if (!mqtt) return;
-  while (mqtt->hasPendingCommand()) {
-    String cmd = mqtt->popCommand();
-    if (!cmd.length()) continue;
-    if (cmd == "set_open_here") {
-      resetMqttSetModeStreak();
-      clicks.setOpenHere();
-      logLine(F("[CMD] Marked current position as fully open"));
-    } else if (cmd == "set_closed_here") {
-      resetMqttSetModeStreak();
-      clicks.setClosedHere();
-      logLine(F("[CMD] Marked current position as fully closed"));
-    } else if (cmd == "enter_set_mode") {
-      if (mqttSetModeStreak < UINT8_MAX) {
-        ++mqttSetModeStreak;
-        if (mqttSetModeStreak >= MQTT_TOGGLE_THRESHOLD) {
-          toggleSimulationMode("[CMD] ");
+static void startPositionMove(bool percent, int32_t value) {
+  if (setModeActive || panicLatched) {
+    logLine(F("[GOTO] Refused: set mode or panic active"));
+    return;
+  }
+  int32_t end = clicks.end();
+  int32_t target = percent
+    ? (int32_t)((static_cast<int64_t>(value) * end + 50) / 100)
+    : value;
+  if (target < 0) target = 0;
+  if (target > end) target = end;
+
+  int32_t pos = clicks.position();
+  MotionState dir = (target > pos) ? MotionState::CLOSING : MotionState::OPENING;
+  float lead = clicks.stopLeadClicks(dir, POSITION_STOP_LATENCY_MS);
+  int32_t distance = (target > pos) ? target - pos : pos - target;
+  if ((float)distance <= lead + 0.5f) {
+    logLine(String(F("[GOTO] Already at target ")) + target + F(" (pos=") + pos + F(")"));
+    return;
+  }
+
+  if (positionTarget.active()) positionTarget.cancel();
+  positionTarget.start(target, pos, haMotionSerial);
+  setHaDesired(dir);
+  logLine(String(F("[GOTO] Target ")) + target + F(" from ") + pos + F(" (") +
+          motionLabel(dir) + F(", lead ") + String(lead, 1) + F(")"));
+}
+
+// Runs after arbitration and limit checks: keeps the move going, drops it
+// when anything else took over, and stops early for the predicted coast.
+static MotionState applyPositionTarget(MotionState target, CommandSource source) {
+  if (!positionTarget.active()) return target;
+
+  bool overridden = panicLatched || setModeActive ||
+                    source == CommandSource::WALL_SWITCH ||
+                    haMotionSerial != positionTarget.commandSerial();
+  if (overridden) {
+    positionTarget.cancel();
+    logLine(F("[GOTO] Cancelled by another command"));
+    return target;
+  }
+
+  if (target != positionTarget.direction()) {
+    // Limit check stopped it first; still report where it landed.
+    positionTarget.stopped(clicks.lastRun().seq);
+    return target;
+  }
+
+  MotionState dir = positionTarget.direction();
+  if (relays && relays->current() == dir &&
+      positionTarget.shouldStop(clicks.position(),
+                                clicks.stopLeadClicks(dir, POSITION_STOP_LATENCY_MS))) {
+    positionTarget.stopped(clicks.lastRun().seq);
+    clearHaDesiredLocal();
+    logLine(String(F("[GOTO] Stopping at ")) + clicks.position() +
+            F(" for target ") + positionTarget.target());
+    return MotionState::IDLE;
+  }
+  return target;
+}
+
+static void settlePositionTarget() {
+  const ClickCounter::RunStats& run = clicks.lastRun();
+  if (!positionTarget.settle(run.seq, run.finalPos)) return;
+  const PositionTarget::Stats& st = positionTarget.stats();
+  logLine(String(F("[GOTO] Landed at ")) + run.finalPos + F(" (target ") +
+          positionTarget.target() + F(", error ") + st.lastError + F(")"));
+}
+
+static void processControlCommands() {
+  using Cmd = ControlCommand::Type;
+  ControlCommand cmd;
+  while (controlLink.commands.pop(&cmd)) {
+    switch (cmd.type) {
+      case Cmd::HA_MOTION:
+        ++haMotionSerial;
+        setHaDesired(static_cast<MotionState>(cmd.value));
+        traceCommand(LatencyTracer::SRC_HA, static_cast<MotionState>(cmd.value), cmd.stampUs);
+        break;
+      case Cmd::SET_OPEN_HERE:
+        resetMqttSetModeStreak();
+        clicks.setOpenHere();
+        logLine(F("[CMD] Marked current position as fully open"));
+        break;
+      case Cmd::SET_CLOSED_HERE:
+        resetMqttSetModeStreak();
+        clicks.setClosedHere();
+        logLine(F("[CMD] Marked current position as fully closed"));
+        break;
+      case Cmd::ENTER_SET_MODE:
+        if (mqttSetModeStreak < UINT8_MAX) {
+          ++mqttSetModeStreak;
+          if (mqttSetModeStreak >= MQTT_TOGGLE_THRESHOLD) {
+            toggleSimulationMode("[CMD] ");
+          }
+        }
+        enterSetMode("[CMD] ");
+        break;
+      case Cmd::EXIT_SET_MODE:
+        resetMqttSetModeStreak();
+        exitSetMode("[CMD] ");
+        break;
+      case Cmd::CLICK_BACKEND: {
+        resetMqttSetModeStreak();
+        if (relays && relays->current() != MotionState::IDLE) {
+          logLine(F("[CMD] Click backend change refused while driving"));
+          break;
         }
+        bool ok = clicks.setHardwareBackend(static_cast<ClickCounter::Backend>(cmd.value));
+        logLine(String(F("[CMD] Click backend -> ")) +
+                (clicks.hardwareBackend() == ClickCounter::Backend::PCNT
+                     ? F("PCNT (12.7 us glitch filter only: needs an RC-filtered input)")
+                     : F("ISR")) +
+                (ok ? F("") : F(" (requested backend unavailable)")));
+        break;
       }
-      enterSetMode("[CMD] ");
-    } else if (cmd == "exit_set_mode") {
-      resetMqttSetModeStreak();
-      exitSetMode("[CMD] ");
-    } else {
-      resetMqttSetModeStreak();
+      case Cmd::SET_MAX_RUNTIME:
+        onSetMaxRuntime(static_cast<uint32_t>(cmd.value));
+        break;
+      case Cmd::SET_STALL_FACTOR:
+        onSetStallFactor(cmd.value / 10.0f);
+        break;
+      case Cmd::SET_POSITION_CLICKS:
+      case Cmd::SET_POSITION_PCT:
+        resetMqttSetModeStreak();
+        startPositionMove(cmd.type == Cmd::SET_POSITION_PCT, cmd.value);
+        if (positionTarget.active()) {
+          traceCommand(LatencyTracer::SRC_HA, positionTarget.direction(), cmd.stampUs);
+        }
+        break;
     }
   }
 }
 
+// Control side: hand the line to the network task, never block on I/O.
+// During setup() there is only one thread, so lines go straight out.
 static void logLine(const String& message) {
   if (!message.length()) return;
-  if (Serial && Serial.availableForWrite() > message.length() + 2) {
-    Serial.println(message);
-  } else {
-    Serial.println(message);
+  if (!controlStarted) {
+    netLogLine(message);
+    return;
   }
+  LogEvent ev;
+  ev.seq = controlLogSeq;
+  ev.set(message);
+  // A dropped line takes no seq, so the network side never waits for it.
+  if (controlLink.logs.push(ev)) ++controlLogSeq;
+}
+
+// Same, for binary events: formatted only once the network side takes them.
+static void logEvent(const LogRecord& record) {
+  if (!controlStarted) {
+    netLogLine(record.toString());
+    return;
+  }
+  LogRecord r = record;
+  r.seq = controlLogSeq;
+  if (controlLink.events.push(r)) ++controlLogSeq;
+}
+
+// Network side: keep in the ring buffer and queue for serial and MQTT.
+// Nothing here waits on the UART or the broker; pumpLogs() does the output.
+static void netLogLine(const String& message) {
+  if (!message.length()) return;
   ringLog.append(message);
-  if (mqtt) {
-    mqtt->publishLogLine(message);
-    unsigned long now = millis();
-    if (lastLogSnapshotMs == 0 || now - lastLogSnapshotMs >= LOG_SNAPSHOT_INTERVAL_MS) {
-      lastLogSnapshotMs = now;
-      mqtt->publishLogSnapshot(ringLog.blob());
-    }
+  crashLog.append(message.c_str(), message.length(), millis());
+  if (!logDrain.batchFits(message.length())) flushLogBatch();
+  logDrain.line(message.c_str(), message.length());
+  if (!controlStarted) logDrain.pumpSerial();
+}
+
+static void flushLogBatch() {
+  if (mqtt && mqtt->isConnected()) {
+    mqtt->publishLogBatch(logDrain);
+    logDrain.batchSent();
+  } else {
+    logDrain.discardBatch();
   }
 }
 
+static void pumpLogs(unsigned long now) {
+  crashLog.stamp(now);
+  logDrain.pumpSerial();
+  // A pending reset wants every line out now, and to hear when they are.
+  const bool flushing = logFlushRequested.load(std::memory_order_acquire);
+  if (logDrain.batchDue(now) || (flushing && logDrain.batchLen())) flushLogBatch();
+  if (flushing && controlLink.logs.empty() && controlLink.events.empty() && logDrain.idle()) {
+    logFlushRequested.store(false, std::memory_order_release);
+  }
+  if (mqtt && ringLog.lastSeq() != logBlobSeq &&
+      now - lastLogSnapshotMs >= LOG_SNAPSHOT_INTERVAL_MS) {
+    lastLogSnapshotMs = now;
+    publishLogDelta();
+  }
+}
+
+// log_blob carries only the lines since the previous publish (a long
+// backlog goes out over several intervals); older lines via log_fetch.
+static void publishLogDelta() {
+  uint32_t first = 0;
+  uint32_t last = 0;
+  LogSpans lines = ringLog.viewFrom(logBlobSeq + 1, LOG_DELTA_MAX_BYTES, &first, &last);
+  if (!lines.size()) return;
+  if (mqtt->publishLogPage(TOPIC_LOG_BLOB, first, last, ringLog.lastSeq(), lines, /*retain=*/true)) {
+    logBlobSeq = last;
+  }
+}
+
+// Once per boot: what the previous one logged before its reset.
+static void publishPreviousBoot() {
+  if (previousBootPublished || !crashLog.hasPrevious()) return;
+  previousBootPublished = mqtt->publishPreviousBoot(CrashLog::reasonName(crashLog.resetReason()),
+                                                    crashLog.previousUptimeMs(),
+                                                    crashLog.previous(), crashLog.previousLen());
+}
+
+static void onLogFetch(uint32_t sinceSeq, uint32_t maxBytes) {
+  uint32_t budget = constrain(maxBytes, LOG_FETCH_MIN_BYTES, LOG_FETCH_MAX_BYTES);
+  uint32_t first = 0;
+  uint32_t last = 0;
+  LogSpans lines = ringLog.viewFrom(sinceSeq, budget, &first, &last);
+  mqtt->publishLogPage(TOPIC_LOG_FETCH, first, last, ringLog.lastSeq(), lines, /*retain=*/false);
+}
+
+static void onLogSnapshot() {
+  mqtt->publishLogCompressed(ringLog.firstSeq(), ringLog.lastSeq(), ringLog.view());
+}
+
 void setup() {
   Serial.begin(115200);
   delay(200);
   Serial.println();
+  crashLog.begin(esp_reset_reason());
 
   const char* rows[] = { "Wifi", "HASS", "Mode", "Action", "Analog", "Pos", "Safety" };
   statusStore.configure(rows, sizeof(rows) / sizeof(rows[0]));
@@ -324,6 +654,11 @@ void setup() {
   updateSafetyRow();
 
   logLine(F("[BOOT] Pool cover controller (ESP32-32U headless)"));
+  logLine(String(F("[BOOT] Reset reason: ")) + CrashLog::reasonName(crashLog.resetReason()));
+  if (crashLog.hasPrevious()) {
+    logLine(String(F("[BOOT] Previous boot log kept (")) + crashLog.previousLen() +
+            F(" B, up ") + (crashLog.previousUptimeMs() / 1000UL) + F(" s)"));
+  }
 
   loadSafetyConfig();
   resetSafetyRuntime("boot");
@@ -332,11 +667,12 @@ void setup() {
   statusLed.setPattern(StatusLed::Pattern::BOOT);
 
   relays = new RelaysModule(statusStore, logLine);
+  relays->setEventLogger(logEvent);
   relays->begin(RELAYS_ACTIVE_LOW != 0, 1000, 2000);
   relays->request(MotionState::IDLE);
   relays->update();
 
-  wifi = new WifiModule(statusStore, logLine);
+  wifi = new WifiModule(statusStore, netLogLine);
   wifi->begin();
 
   analogCtl = new AnalogController(statusStore, "Analog",
@@ -346,23 +682,65 @@ void setup() {
   lastAnalogEffective = MotionState::IDLE;
   analogEdgeArmed = (lastAnalogRaw == MotionState::IDLE);
 
-  mqtt = new MqttModule(statusStore, logLine);
+  mqtt = new MqttModule(statusStore, netLogLine);
   mqtt->begin();
-  mqtt->setMaxRuntimeHandler(onMqttSetMaxRuntime);
+  mqtt->setControlLink(&controlLink);
+  mqtt->setWifi(wifi);
+  mqtt->setLogDrain(&logDrain);
+  mqtt->setLogFetch(onLogFetch);
+  mqtt->setLogSnapshot(onLogSnapshot);
 
   clicks.setStatusLed(&statusLed);
   clicks.begin(PIN_CLICK_IN, /*simulate=*/false);
   clicks.setLogger(logLine);
+  clicks.setEventLogger(logEvent);
   clickSimulationEnabled = false;
-  logLine(F("[BOOT] Click counter ready (hardware ISR)"));
+  logLine(String(F("[BOOT] Click counter ready (source=")) + clicks.sourceName() + F(")"));
+
+#if POWER_FAIL_MONITOR_ENABLED
+  powerFail.begin(PIN_RAIL_SENSE);
+  logLine(String(F("[BOOT] Power-fail monitor armed (rail=")) + powerFail.railMv() + F(" mV)"));
+#endif
+  logLine(String(F("[BOOT] Position restored from ")) +
+          (clicks.restoredFromRtc() ? F("RTC (warm reset)") : F("flash")) +
+          F(": pos=") + clicks.position() + F(", end=") + clicks.end());
 
   logLine(F("[INIT] Modules initialized. Waiting for Wi-Fi/MQTT..."));
+  controlStarted = true;
+
+#if CONTROL_TASKS_ENABLED
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr,
+                          CONTROL_TASK_PRIORITY, nullptr, 1);
+  xTaskCreatePinnedToCore(netTask, "net", NET_TASK_STACK, nullptr,
+                          NET_TASK_PRIORITY, nullptr, 0);
+#endif
 }
 
 void loop() {
+#if CONTROL_TASKS_ENABLED
+  // Work lives in controlTask / netTask.
+  vTaskDelete(nullptr);
+#else
+  controlStep();
+  netStep();
+  delay(CONTROL_PERIOD_MS);
+#endif
+}
+
+static void controlStep() {
+  const uint64_t passUs = esp_timer_get_time();
+  if (lastControlPassUs != 0) {
+    controlTiming.add(static_cast<uint32_t>(passUs - lastControlPassUs));
+    PROFILE_RECORD(controlProfile, CTRL_PERIOD, static_cast<uint32_t>(passUs - lastControlPassUs));
+  }
+  lastControlPassUs = passUs;
+  PROFILE_START(controlProfile);
+
   unsigned long now = millis();
 
-  if (wifi) wifi->update();
+  if (powerFail.update()) {
+    handlePowerFail();
+  }
 
   MotionState analogState = lastAnalogEffective;
   if (analogCtl) {
@@ -393,6 +771,9 @@ void loop() {
         }
         resetMqttSetModeStreak();
         logLine(String(F("[INPUT] Analog switch -> ")) + analogSwitchLabel(newEffective));
+        uint32_t nowUs = micros();
+        uint32_t sinceEdgeMs = static_cast<uint32_t>(millis() - analogCtl->lastEdgeMs());
+        traceCommand(LatencyTracer::SRC_WALL, newEffective, nowUs - sinceEdgeMs * 1000UL);
         lastAnalogEffective = newEffective;
         analogLatched = newEffective;
         analogCommandSeq = ++commandSeqCounter;
@@ -403,10 +784,11 @@ void loop() {
   } else {
     analogState = MotionState::IDLE;
   }
+  PROFILE_LAP(controlProfile, CTRL_INPUT);
 
-  processHaCommands();
+  processControlCommands();
+  PROFILE_LAP(controlProfile, CTRL_COMMANDS);
 
-  MotionState haDesired = mqtt ? mqtt->desiredFromHA() : MotionState::IDLE;
   if (haDesired != lastHaDesired) {
     lastHaDesired = haDesired;
     haLatched = haDesired;
@@ -482,6 +864,8 @@ void loop() {
     loggedCloseLimit = false;
   }
 
+  target = applyPositionTarget(target, selectedSource);
+
   if (consumeAnalogCommand) {
     // WARNING: Analog switch acts as a momentary trigger only. Never let its
     // latched position block Home Assistant or subsequent commands.
@@ -501,13 +885,14 @@ void loop() {
   if (modeLabel != lastModeLabel) {
     lastModeLabel = modeLabel;
     statusStore.setStatus("Mode", lastModeLabel);
-    logLine(String(F("[MODE] -> ")) + lastModeLabel);
+    logEvent(LogId::MODE, { lastModeLabel });
   }
 
   if (target != commandedMotion) {
     commandedMotion = target;
-    logLine(String(F("[CTRL] Commanded motion -> ")) + motionLabel(commandedMotion));
+    logEvent(LogId::CTRL_COMMANDED, { motionLabel(commandedMotion) });
   }
+  PROFILE_LAP(controlProfile, CTRL_ARBITRATE);
 
   if (relays) {
     relays->request(commandedMotion);
@@ -519,9 +904,7 @@ void loop() {
         driveActive = true;
         driveAccumMs = 0;
         driveLastUpdateMs = now;
-        noClickMonitorActive = true;
-        noClickStartMs = now;
-        noClickPosAtEnable = clicks.position();
+        stallDetector.start(now, clicks.position(), NO_CLICK_PANIC_WINDOW_MS);
       } else {
         if (driveLastUpdateMs != 0) {
           unsigned long delta = now - driveLastUpdateMs;
@@ -535,11 +918,11 @@ void loop() {
         driveAccumMs = 0;
         driveLastUpdateMs = 0;
       }
-      noClickMonitorActive = false;
+      stallDetector.stop();
     }
     if (relayState != lastRelay) {
       lastRelay = relayState;
-      logLine(String(F("[CTRL] Relay state -> ")) + motionLabel(relayState));
+      logEvent(LogId::CTRL_RELAY_STATE, { motionLabel(relayState) });
     }
 
     if (driveActive && safetyMaxRunSeconds > 0) {
@@ -553,32 +936,32 @@ void loop() {
   }
 
   statusLed.setDriveActive(driveActive);
+  latencyTracer.update(static_cast<uint8_t>(commandedMotion),
+                       static_cast<uint8_t>(relays ? relays->current() : MotionState::IDLE),
+                       micros());
+  PROFILE_LAP(controlProfile, CTRL_RELAYS);
 
+  const int32_t posBeforeClicks = clicks.position();
   clicks.update(setModeActive);
+  traceMotion(posBeforeClicks);
+  PROFILE_LAP(controlProfile, CTRL_CLICKS);
 
-  if (noClickMonitorActive) {
-    int32_t currentPos = clicks.position();
-    if (currentPos != noClickPosAtEnable) {
-      noClickMonitorActive = false;
-    } else if ((long)(now - noClickStartMs) >= (long)NO_CLICK_PANIC_WINDOW_MS) {
-      triggerPanic("no-click-after-enable", true);
-      noClickMonitorActive = false;
-    }
+  if (stallDetector.active()) {
+    checkStall(now, relays ? relays->current() : MotionState::IDLE);
   }
+  settlePositionTarget();
 
   if (!setModeActive && clicks.panic() && !panicLatched) {
     triggerPanic("click-out-of-range", false);
   }
+  PROFILE_LAP(controlProfile, CTRL_SAFETY);
 
   int32_t pos = clicks.position();
-  int32_t end = clicks.end();
-  if (end < 1) end = 1;
-  int32_t pct = (pos <= 0) ? 0 : (int32_t)((static_cast<int64_t>(pos) * 100) / end);
-  if (pct > 100) pct = 100;
+  int32_t pct = clicks.percent();
 
   StatusLed::Pattern ledPattern = StatusLed::Pattern::IDLE;
-  bool wifiConnected = wifi && wifi->isConnected();
-  bool mqttConnected = mqtt && mqtt->isConnected();
+  bool wifiConnected = controlLink.wifiUp.load(std::memory_order_relaxed);
+  bool mqttConnected = controlLink.mqttUp.load(std::memory_order_relaxed);
   if (panicLatched || panicRebootPending) {
     ledPattern = StatusLed::Pattern::PANIC;
   } else if (setModeActive) {
@@ -603,38 +986,240 @@ void loop() {
 
   updateSafetyRow();
 
-  if (mqtt) {
-    uint32_t runtimeElapsedSec = driveActive ? (driveAccumMs / 1000UL) : 0;
-    mqtt->update(lastModeLabel,
-                 relays ? relays->current() : MotionState::IDLE,
-                 analogState,
-                 analogSwitchLabel(analogState),
-                 setModeActive,
-                 panicLatched,
-                 clicks,
-                 safetyMaxRunSeconds,
-                 runtimeElapsedSec,
-                 driveActive,
-                 NO_CLICK_PANIC_WINDOW_SECONDS);
-
-    bool connected = mqtt->isConnected();
-    if (connected && !lastMqttConnected) {
-      mqtt->publishLogSnapshot(ringLog.blob());
-    }
-    lastMqttConnected = connected;
-  }
+  publishControlSnapshot(analogState);
 
   if (panicRebootPending) {
     unsigned long rebootNow = millis();
     if ((long)(rebootNow - panicRebootAtMs) >= 0) {
       panicRebootPending = false;
       logLine(F("[PANIC] Forcing reboot"));
+      flushLogsForReset();
       delay(50);
       ESP.restart();
     }
   }
 
   statusLed.update();
+  PROFILE_LAP(controlProfile, CTRL_STATUS);
+  PROFILE_RECORD(controlProfile, CTRL_PASS, static_cast<uint32_t>(esp_timer_get_time() - passUs));
+  PROFILE_ROLL(controlProfile, now, PROFILE_WINDOW_MS);
+}
+
+// Starts a latency trace unless the command changes nothing.
+static void traceCommand(LatencyTracer::Source source, MotionState target, uint32_t inputUs) {
+  MotionState relayState = relays ? relays->current() : MotionState::IDLE;
+  if (target == commandedMotion && target == relayState) return;
+  latencyTracer.begin(source, static_cast<uint8_t>(target), target == MotionState::IDLE,
+                      relayState != MotionState::IDLE, inputUs, micros());
+}
+
+// Feeds the click side of the trace and logs each completed one.
+static void traceMotion(int32_t posBeforeClicks) {
+  if (latencyTracer.awaitingClick() && clicks.position() != posBeforeClicks) {
+    latencyTracer.click(clicks.edgeStats().lastClickUs);
+  }
+  const ClickCounter::RunStats& run = clicks.lastRun();
+  if (run.seq != tracedRunSeq) {
+    tracedRunSeq = run.seq;
+    latencyTracer.coastDone(run.coastMs * 1000UL);
+  }
+
+  const LatencyTracer::Stats& st = latencyTracer.stats();
+  if (st.seq == loggedTraceSeq) return;
+  loggedTraceSeq = st.seq;
+  const LatencyTracer::Record& r = st.last;
+  String line;
+  line.reserve(120);
+  line += F("[TRACE] #");
+  line += r.id;
+  line += ' ';
+  line += LatencyTracer::sourceName(r.source);
+  line += ' ';
+  line += LatencyTracer::kindName(r.kind);
+  line += ':';
+  for (uint8_t i = 0; i < LatencyTracer::STAGES; ++i) {
+    line += ' ';
+    line += LatencyTracer::stageName(i);
+    line += ' ';
+    line += String(r.stageUs[i] / 1000.0f, 1);
+  }
+  line += F(" ms");
+  logLine(line);
+}
+
+static void publishControlSnapshot(MotionState analogState) {
+  ControlSnapshot& s = controlLink.state.back();
+  MotionState action = relays ? relays->current() : MotionState::IDLE;
+  s.modeLabel = lastModeLabel;
+  s.action = action;
+  s.analogState = analogState;
+  s.analogLabel = analogSwitchLabel(analogState);
+  s.setModeActive = setModeActive;
+  s.panicActive = panicLatched;
+
+  s.pos = clicks.position();
+  s.end = clicks.end();
+  s.pct = clicks.percent();
+  s.speedCps = clicks.speedCps(action);
+  s.openCps = clicks.speedCps(MotionState::OPENING);
+  s.closeCps = clicks.speedCps(MotionState::CLOSING);
+  s.etaMs = clicks.etaMs();
+
+  s.maxRunSeconds = safetyMaxRunSeconds;
+  s.runElapsedSeconds = driveActive ? (driveAccumMs / 1000UL) : 0;
+  s.safetyActive = driveActive;
+  s.noClickGuardSeconds = NO_CLICK_PANIC_WINDOW_SECONDS;
+  s.stallFactor = stallDetector.factor();
+  s.stallLimitMs = stallDetector.limitMs();
+  s.stallTrips = stallDetector.trips();
+  s.powerFailFlushUs = clicks.lastEmergencyFlushUs();
+
+  s.persist = clicks.persistStats();
+  s.posLogActive = clicks.posLogActive();
+  s.posLogErases = clicks.posLogStats().erases;
+  s.edges = clicks.edgeStats();
+  s.clickSource = clicks.sourceName();
+
+  s.gotoActive = positionTarget.active();
+  s.gotoTarget = positionTarget.target();
+  s.gotoStats = positionTarget.stats();
+
+  s.gate = clicks.gateInfo();
+  const GateLearner& hist = clicks.gateHistogram();
+  s.gateSamples = hist.samples();
+  for (uint8_t i = 0; i < GateLearner::BUCKETS; ++i) s.gateCounts[i] = hist.count(i);
+
+  s.run = clicks.lastRun();
+  s.coast = clicks.coastModel();
+  if (relays) {
+    s.relays = relays->stats();
+    s.relayPhase = RelaysModule::phaseName(relays->phase());
+  }
 
-  delay(5);
+  s.control = controlTiming;
+  s.tasksSplit = CONTROL_TASKS_ENABLED != 0;
+  s.commandDrops = controlLink.commands.drops();
+  s.logDrops = controlLink.logs.drops() + controlLink.events.drops();
+  s.logHighWater = max(controlLink.logs.highWater(), controlLink.events.highWater());
+  controlLink.state.publish();
+
+  const LatencyTracer::Stats& latency = latencyTracer.stats();
+  if (latency.seq != sentTraceSeq) {
+    sentTraceSeq = latency.seq;
+    controlLink.latency.back() = latency;
+    controlLink.latency.publish();
+  }
+#if LOOP_PROFILER_ENABLED
+  const LoopProfiler::Window& window = controlProfile.last();
+  if (window.seq != sentProfileSeq) {
+    sentProfileSeq = window.seq;
+    controlLink.profile.back() = window;
+    controlLink.profile.publish();
+  }
+#endif
+}
+
+// Text lines and events, in the order they were logged (see LogMerge).
+static void drainLogs() {
+  for (;;) {
+    const LogEvent* text = controlLink.logs.peek();
+    const LogRecord* event = controlLink.events.peek();
+    const LogMerge::Take take = logMerge.next(text ? &text->seq : nullptr, event ? &event->seq : nullptr);
+    if (take == LogMerge::Take::NONE) break;
+    if (take == LogMerge::Take::TEXT) {
+      LogEvent ev;
+      controlLink.logs.pop(&ev);
+      netLogLine(String(ev.text));
+    } else {
+      LogRecord r;
+      controlLink.events.pop(&r);
+      char buf[sizeof(LogEvent::text)];
+      r.format(buf, sizeof(buf));
+      netLogLine(String(buf));
+    }
+  }
+}
+
+// The reboot must not lose the lines explaining it. With the tasks split,
+// the network task owns the drain: it clears the request once the
+// mailboxes and the drain are empty (pumpLogs()).
+static void flushLogsForReset() {
+#if CONTROL_TASKS_ENABLED
+  logFlushRequested.store(true, std::memory_order_release);
+  for (uint8_t i = 0; i < 20 && logFlushRequested.load(std::memory_order_acquire); ++i) {
+    delay(10);
+  }
+#else
+  drainLogs();
+  flushLogBatch();
+  for (uint8_t i = 0; i < 20 && !logDrain.idle(); ++i) {
+    logDrain.pumpSerial();
+    delay(10);
+  }
+#endif
+}
+
+static void netStep() {
+#if LOOP_PROFILER_ENABLED
+  const uint32_t passUs = profilerNowUs();
+  if (lastNetPassUs != 0) netProfile.record(NET_PERIOD, passUs - lastNetPassUs);
+  lastNetPassUs = passUs;
+#endif
+  PROFILE_START(netProfile);
+
+  if (wifi) wifi->update();
+  controlLink.wifiUp.store(wifi && wifi->isConnected(), std::memory_order_relaxed);
+  PROFILE_LAP(netProfile, NET_WIFI);
+
+  drainLogs();
+  pumpLogs(millis());
+  PROFILE_LAP(netProfile, NET_LOGS);
+
+  if (mqtt) {
+    controlLink.state.fetch();
+    mqtt->update(controlLink.state.front());
+
+    bool connected = mqtt->isConnected();
+    if (connected && !lastMqttConnected) {
+      publishLogDelta();
+      publishPreviousBoot();
+    }
+    controlLink.latency.fetch();
+    const LatencyTracer::Stats& latency = controlLink.latency.front();
+    if (connected && latency.seq != publishedTraceSeq) {
+      publishedTraceSeq = latency.seq;
+      mqtt->publishLatency(latency);
+    }
+    lastMqttConnected = connected;
+    controlLink.mqttUp.store(connected, std::memory_order_relaxed);
+  }
+  PROFILE_LAP(netProfile, NET_MQTT);
+
+#if LOOP_PROFILER_ENABLED
+  netProfile.record(NET_PASS, profilerNowUs() - passUs);
+  bool netRolled = netProfile.roll(millis(), PROFILE_WINDOW_MS);
+  if (mqtt) {
+    if (controlLink.profile.fetch()) {
+      mqtt->publishProfile("control", CONTROL_SECTION_NAMES, controlLink.profile.front());
+    }
+    if (netRolled) mqtt->publishProfile("net", NET_SECTION_NAMES, netProfile.last());
+  }
+#endif
+}
+
+#if CONTROL_TASKS_ENABLED
+static void controlTask(void*) {
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    controlStep();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+  }
+}
+
+static void netTask(void*) {
+  for (;;) {
+    netStep();
+    vTaskDelay(pdMS_TO_TICKS(NET_PERIOD_MS));
+  }
 }
+#endif
@@ -17,7 +17,14 @@
 #define TOPIC_PONG         BASE_TOPIC "/tele/pong"          // JSON reply to ping
 #define TOPIC_LOG_STREAM   BASE_TOPIC "/tele/log_stream"    // log stream (non-retained)
 #define TOPIC_LOG_LAST     BASE_TOPIC "/tele/log_last"      // single last line (retained)
-#define TOPIC_LOG_BLOB     BASE_TOPIC "/tele/log_blob"      // multi-line buffer (retained)
+#define TOPIC_LOG_BLOB     BASE_TOPIC "/tele/log_blob"      // lines since the last one, "@first-last newest" header (retained)
+#define TOPIC_LOG_FETCH    BASE_TOPIC "/tele/log_fetch"     // log_fetch reply, same format (non-retained)
+#define TOPIC_LOG_LZ       BASE_TOPIC "/tele/log_lz"        // log_snapshot reply, compressed ring (retained)
+#define TOPIC_LOG_PREV     BASE_TOPIC "/tele/log_prev"      // previous boot's log tail after a reset, "@reason uptime_ms" header (retained)
+#define TOPIC_CLICK_DIAG   BASE_TOPIC "/tele/click_diag"    // JSON edge-interval histogram (retained)
+#define TOPIC_RUN          BASE_TOPIC "/tele/run"           // JSON last run + coast model (retained)
+#define TOPIC_LATENCY      BASE_TOPIC "/tele/latency"       // JSON command latency per source/stage (retained)
+#define TOPIC_METRICS      BASE_TOPIC "/tele/metrics"       // JSON loop section timings (non-retained)
 
 
 // Commands (subscribed by device)
@@ -28,3 +35,7 @@
 
 // Heartbeat / ping cadence
 #define HEARTBEAT_SEC      15
+
+// State cadence: idle vs. while the relays are driving (live speed/ETA)
+#define STATE_PUB_IDLE_MS  1000
+#define STATE_PUB_DRIVE_MS 250
@@ -0,0 +1,90 @@
+#pragma once
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <freertos/FreeRTOS.h>
+#include <esp_attr.h>
+#include <esp_err.h>
+#include <esp_system.h>
+#include "HostFake.h"
+#include "WString.h"
+
+// Host build of the parts of the Arduino-ESP32 core the firmware modules
+// use. Time and pin levels come from HostFake.h, so tests drive them.
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+inline T constrain(T v, L lo, H hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// 32-bit like the ESP32's unsigned long: millis() wraps after 49.7 days,
+// micros() after 71.6 minutes.
+inline unsigned long millis() { return static_cast<uint32_t>(hostfake::nowUs / 1000ULL); }
+inline unsigned long micros() { return static_cast<uint32_t>(hostfake::nowUs); }
+inline void delay(uint32_t ms) { hostfake::advanceMs(ms); }
+inline void delayMicroseconds(uint32_t us) { hostfake::advanceUs(us); }
+
+// [lo, hi), like the core's.
+inline long random(long lo, long hi) {
+  return hi > lo ? lo + static_cast<long>(hostfake::randomNext() % static_cast<uint32_t>(hi - lo)) : lo;
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < hostfake::PIN_COUNT) hostfake::pinOutput[pin] = level ? 1 : 0;
+}
+inline int digitalRead(uint8_t pin) {
+  return pin < hostfake::PIN_COUNT ? hostfake::pinLevel[pin] : LOW;
+}
+
+// Serial output is collected in hostfake::serialOut, as fast as
+// hostfake::serialTxRoom lets it.
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+  int availableForWrite() { return hostfake::serialTxRoom < 0 ? 256 : hostfake::serialTxRoom; }
+  size_t write(const uint8_t* p, size_t n) {
+    if (hostfake::serialTxRoom >= 0) {
+      if (n > static_cast<size_t>(hostfake::serialTxRoom)) n = hostfake::serialTxRoom;
+      hostfake::serialTxRoom -= static_cast<int>(n);
+    }
+    hostfake::serialOut.append(reinterpret_cast<const char*>(p), n);
+    return n;
+  }
+  size_t print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t println(const char* s) { return print(s) + print("\n"); }
+  size_t println(const String& s) { return println(s.c_str()); }
+  size_t println(const __FlashStringHelper* s) { return println(reinterpret_cast<const char*>(s)); }
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    print(buf);
+    return n;
+  }
+};
+
+inline HardwareSerial Serial;
+
+class EspClass {
+public:
+  void restart() {}
+  uint32_t getFreeHeap() { return 200000; }
+};
+
+inline EspClass ESP;
@@ -0,0 +1,33 @@
+#pragma once
+#include <ClickCounter.h>
+#include <Preferences.h>
+#include "HostFake.h"
+
+// Helpers for driving a ClickCounter on the host shims the way the firmware
+// loop and the cover motor do.
+
+// Calibrated travel stored before begin(), so long runs stay inside it.
+inline void seedEnd(int32_t end) {
+  Preferences prefs;
+  prefs.begin("poolcover", false);
+  prefs.putInt("end", end);
+  prefs.end();
+}
+
+// Advances the clock in loop-sized steps, calling update() after each.
+inline void spin(ClickCounter& counter, uint32_t us, uint32_t stepUs = 10000) {
+  while (us) {
+    uint32_t step = us < stepUs ? us : stepUs;
+    hostfake::advanceUs(step);
+    counter.update();
+    us -= step;
+  }
+}
+
+// One clean click on the sensor pin: low for half a period, then high.
+inline void click(ClickCounter& counter, uint32_t periodUs, uint8_t pin = PIN_CLICK_IN) {
+  spin(counter, periodUs / 2);
+  hostfake::setPin(pin, LOW);
+  spin(counter, periodUs - periodUs / 2);
+  hostfake::setPin(pin, HIGH);
+}
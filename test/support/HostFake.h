@@ -0,0 +1,233 @@
+#pragma once
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// State behind the host shims in this directory (Arduino.h, Preferences.h,
+// esp_*.h, driver/*.h): a settable clock with esp_timer one-shots, GPIO
+// input levels with their interrupt handlers, the GPIO output register,
+// the PCNT units, the reset reason, raw flash partitions, the NVS store and
+// random(). It is global like the hardware it stands for; call
+// hostfake::reset() at the start of every test.
+namespace hostfake {
+
+// ---- clock ----------------------------------------------------------------
+
+inline uint64_t nowUs = 0;
+
+inline void advanceUs(uint64_t us) { nowUs += us; }
+inline void advanceMs(uint64_t ms) { nowUs += ms * 1000ULL; }
+
+// ---- esp_timer ------------------------------------------------------------
+
+constexpr int TIMER_COUNT = 8;
+
+struct OneShotTimer {
+  bool created = false;
+  void (*fn)(void*) = nullptr;
+  void* arg = nullptr;
+  const char* name = nullptr;
+  bool armed = false;
+  uint64_t deadlineUs = 0;
+  uint32_t fires = 0;
+};
+
+inline OneShotTimer timers[TIMER_COUNT];
+inline bool timerCreateFails = false;
+
+// Moves the clock to `us`, running each armed one-shot at its deadline on
+// the way (in deadline order, like the esp_timer task). A callback may
+// re-arm; a timer that keeps firing without the clock moving gives up
+// after a bounded number of rounds.
+inline void runTimersUntil(uint64_t us) {
+  for (int n = 0; n < 1000; ++n) {
+    OneShotTimer* next = nullptr;
+    for (OneShotTimer& t : timers) {
+      if (t.created && t.armed && t.deadlineUs <= us && (!next || t.deadlineUs < next->deadlineUs)) {
+        next = &t;
+      }
+    }
+    if (!next) break;
+    if (next->deadlineUs > nowUs) nowUs = next->deadlineUs;
+    next->armed = false;
+    ++next->fires;
+    next->fn(next->arg);
+  }
+  if (us > nowUs) nowUs = us;
+}
+
+// ---- GPIO -----------------------------------------------------------------
+
+constexpr int PIN_COUNT = 40;
+
+struct GpioIsr {
+  void (*fn)(void*) = nullptr;
+  void* arg = nullptr;
+  bool enabled = false;
+};
+
+inline uint8_t pinLevel[PIN_COUNT];
+inline uint8_t pinOutput[PIN_COUNT];
+inline uint32_t gpioOutWrites = 0;  // GPIO.out_w1ts / out_w1tc stores
+inline GpioIsr gpioIsr[PIN_COUNT];
+inline bool gpioIsrService = false;
+
+// ---- PCNT (legacy driver/pcnt.h) -----------------------------------------
+
+constexpr int PCNT_UNITS = 8;
+
+struct PcntUnit {
+  bool configured = false;
+  int pin = -1;
+  bool countRise = false;
+  bool countFall = false;
+  int16_t hLim = 0;
+  int16_t count = 0;
+  bool paused = true;
+  uint16_t filterCycles = 0;
+  bool filterOn = false;
+  bool hLimEvent = false;
+  void (*isr)(void*) = nullptr;
+  void* arg = nullptr;
+  uint32_t wraps = 0;
+  uint64_t lastEdgeUs = 0;
+  bool lastCounted = false;
+};
+
+inline PcntUnit pcnt[PCNT_UNITS];
+inline bool pcntIsrService = false;
+
+// Counts one edge on every running unit fed by `pin`; reaching the high
+// limit restarts the counter at 0 and raises the H_LIM interrupt. With the
+// glitch filter on, a pulse shorter than the filter (80 APB cycles per us)
+// is not counted: its closing edge takes back the opening one.
+inline void pcntEdge(int pin, bool rising) {
+  for (PcntUnit& u : pcnt) {
+    if (!u.configured || u.paused || u.pin != pin) continue;
+    const bool glitch = u.filterOn && u.lastCounted && nowUs - u.lastEdgeUs < u.filterCycles / 80u;
+    u.lastEdgeUs = nowUs;
+    u.lastCounted = false;
+    if (glitch) {
+      if (u.count > 0) --u.count;
+      continue;
+    }
+    if (!(rising ? u.countRise : u.countFall)) continue;
+    u.lastCounted = true;
+    if (++u.count < u.hLim) continue;
+    u.count = 0;
+    ++u.wraps;
+    if (u.hLimEvent && u.isr && pcntIsrService) u.isr(u.arg);
+  }
+}
+
+// Drives an input pin; an edge runs the pin's GPIO ISR and feeds any PCNT
+// unit counting that pin.
+inline void setPin(uint8_t pin, int level) {
+  uint8_t v = level ? 1 : 0;
+  if (pin >= PIN_COUNT || pinLevel[pin] == v) return;
+  pinLevel[pin] = v;
+  GpioIsr& isr = gpioIsr[pin];
+  if (isr.enabled && isr.fn && gpioIsrService) isr.fn(isr.arg);
+  pcntEdge(pin, v != 0);
+}
+
+// ---- reset reason ---------------------------------------------------------
+
+inline int resetReason = 1;  // ESP_RST_POWERON
+
+// ---- flash partitions -----------------------------------------------------
+
+struct Partition {
+  std::vector<uint8_t> mem;
+  uint32_t writes = 0;
+  uint32_t erases = 0;
+  uint32_t writeUs = 60;       // per write call
+  uint32_t eraseUs = 45000;    // per 4 KB sector
+  uint64_t powerOffUs = UINT64_MAX;
+  bool powerLost = false;
+};
+
+inline std::map<std::string, Partition> partitions;
+
+inline Partition& addPartition(const char* label, size_t bytes) {
+  Partition& p = partitions[label];
+  p = Partition();
+  p.mem.assign(bytes, 0xFF);
+  return p;
+}
+
+// The supply collapses at clock time `us`: an operation still running then
+// is cut short (a write lands only its leading bytes, an erase clears half
+// the sector) and later ones have no effect.
+inline void cutPowerAt(const char* label, uint64_t us) {
+  partitions[label].powerOffUs = us;
+}
+
+// ---- NVS ------------------------------------------------------------------
+
+inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+inline uint32_t nvsWrites = 0;
+inline std::map<std::string, uint32_t> nvsKeyWrites;
+
+// Puts to keys starting with `prefix`, in any namespace.
+inline uint32_t nvsWritesTo(const char* prefix) {
+  uint32_t n = 0;
+  for (const auto& kv : nvsKeyWrites) {
+    if (kv.first.compare(0, strlen(prefix), prefix) == 0) n += kv.second;
+  }
+  return n;
+}
+
+// ---- random ---------------------------------------------------------------
+
+// Arduino's random() on a seeded generator, so jittered timings repeat
+// from run to run; reset() reseeds.
+inline uint32_t randomState = 1;
+
+inline uint32_t randomNext() {
+  randomState = randomState * 1103515245u + 12345u;
+  return randomState >> 1;
+}
+
+// ---- serial ---------------------------------------------------------------
+
+inline std::string serialOut;
+// Bytes the UART TX buffer takes right now; writes use it up, tests refill
+// it to play out the line rate. Negative: unlimited.
+inline int serialTxRoom = -1;
+
+// A chip reset: timers, interrupt registrations and PCNT units start over
+// and the supply is back, while flash, NVS and (for warm resets) RTC memory
+// keep their contents. The ISR services stay installed because the firmware
+// tracks them in statics that outlive a simulated reboot.
+inline void reboot(int reason) {
+  for (OneShotTimer& t : timers) t = OneShotTimer();
+  for (GpioIsr& g : gpioIsr) g = GpioIsr();
+  for (PcntUnit& u : pcnt) u = PcntUnit();
+  for (auto& kv : partitions) {
+    kv.second.powerOffUs = UINT64_MAX;
+    kv.second.powerLost = false;
+  }
+  resetReason = reason;
+}
+
+inline void reset() {
+  reboot(1);  // ESP_RST_POWERON
+  nowUs = 1000000;  // not 0: firmware treats a zero stamp as "never"
+  memset(pinLevel, 1, sizeof(pinLevel));  // inputs idle high (pull-ups)
+  memset(pinOutput, 0, sizeof(pinOutput));
+  gpioOutWrites = 0;
+  timerCreateFails = false;
+  partitions.clear();
+  nvs.clear();
+  nvsWrites = 0;
+  nvsKeyWrites.clear();
+  serialOut.clear();
+  serialTxRoom = -1;
+  randomState = 1;
+}
+
+}  // namespace hostfake
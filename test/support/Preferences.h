@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "HostFake.h"
+
+// NVS namespace backed by hostfake::nvs, so values survive a new
+// Preferences object (a reboot) within one test. Every put counts in
+// hostfake::nvsWrites and, per key, in hostfake::nvsKeyWrites.
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false) {
+    _ns = &hostfake::nvs[name];
+    _readOnly = readOnly;
+    return true;
+  }
+  void end() { _ns = nullptr; }
+
+  bool isKey(const char* key) { return _ns && _ns->count(key); }
+  bool remove(const char* key) { return _ns && !_readOnly && _ns->erase(key); }
+
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (!_ns || _readOnly) return 0;
+    const uint8_t* p = static_cast<const uint8_t*>(value);
+    (*_ns)[key].assign(p, p + len);
+    ++hostfake::nvsWrites;
+    ++hostfake::nvsKeyWrites[key];
+    return len;
+  }
+  size_t getBytesLength(const char* key) {
+    return isKey(key) ? (*_ns)[key].size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!isKey(key)) return 0;
+    const std::vector<uint8_t>& v = (*_ns)[key];
+    if (v.size() > maxLen) return 0;
+    memcpy(buf, v.data(), v.size());
+    return v.size();
+  }
+
+  size_t putInt(const char* key, int32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putUInt(const char* key, uint32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putUChar(const char* key, uint8_t v) { return putBytes(key, &v, sizeof(v)); }
+  int32_t getInt(const char* key, int32_t def = 0) { return get(key, def); }
+  uint32_t getUInt(const char* key, uint32_t def = 0) { return get(key, def); }
+  uint8_t getUChar(const char* key, uint8_t def = 0) { return get(key, def); }
+
+private:
+  template <typename T>
+  T get(const char* key, T def) {
+    T v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+  }
+
+  std::map<std::string, std::vector<uint8_t>>* _ns = nullptr;
+  bool _readOnly = false;
+};
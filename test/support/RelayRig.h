@@ -0,0 +1,139 @@
+#pragma once
+#include <RelaysModule.h>
+#include "HostFake.h"
+
+// Host side of RelaysModule's seams. The sequencer's one-shot runs on the
+// hostfake clock and fires exactly at its deadline when the clock is moved
+// past it, like the esp_timer task would; the relay register writes land
+// in a recorder that keeps the output levels and when each relay last
+// switched. The hooks are defined here, so include this from one file per
+// suite and call relayrig::reset() after hostfake::reset().
+//
+// Every register write is checked as it lands, per transition (the writes
+// made by one call into the module, closed by endTransition()): FWD and REV
+// never energised together, the first write of a transition never
+// energises anything (break before make), and at most two writes.
+namespace relayrig {
+
+struct OneShot {
+  RelayTimer::Callback fn = nullptr;
+  void* arg = nullptr;
+  int64_t deadlineUs = 0;  // 0 = disarmed
+  bool available = true;   // false: creation fails, loop-only sequencing
+  uint32_t fires = 0;
+};
+
+inline OneShot timer;
+
+inline bool activeLow = true;
+inline uint32_t outHigh = 0;           // output register, 1 = pin high
+inline int64_t switchedUs[4];          // per relay bit (PSU, FWD, REV, EN)
+inline uint32_t registerWrites = 0;
+
+struct Violations {
+  uint32_t interlock = 0;        // FWD and REV both energised
+  uint32_t makeBeforeBreak = 0;  // first write of a transition closed a relay
+  uint32_t skew = 0;             // more than two writes in one transition
+};
+
+inline Violations violations;
+inline uint32_t transitions = 0;
+inline uint32_t transitionWrites = 0;
+inline uint8_t transitionFrom = 0;
+
+inline uint8_t energised() {
+  const uint8_t relays[] = {RelayOutputs::PSU, RelayOutputs::FWD, RelayOutputs::REV, RelayOutputs::EN};
+  uint8_t on = 0;
+  for (uint8_t r : relays) {
+    const bool high = (outHigh & RelayOutputs::pinMask(r)) != 0;
+    if (high != activeLow) on |= r;
+  }
+  return on;
+}
+
+// Clock time the relay last changed state; 0 if it never did.
+inline int64_t switchedAt(uint8_t relay) {
+  for (int b = 0; b < 4; ++b) {
+    if (relay == (1 << b)) return switchedUs[b];
+  }
+  return 0;
+}
+
+inline void reset(bool timerAvailable = true, bool outputsActiveLow = true) {
+  timer = OneShot();
+  timer.available = timerAvailable;
+  activeLow = outputsActiveLow;
+  outHigh = activeLow ? RelayOutputs::PIN_MASK_ALL : 0;
+  for (int64_t& t : switchedUs) t = 0;
+  registerWrites = 0;
+  violations = Violations();
+  transitions = 0;
+  transitionWrites = 0;
+}
+
+inline void endTransition() {
+  if (transitionWrites) ++transitions;
+  transitionWrites = 0;
+}
+
+// Moves the clock to `us`, firing the one-shot on the way if it is due. A
+// callback that keeps re-arming for a deadline already passed gives up
+// after a bounded number of fires instead of spinning.
+inline void advanceTo(uint64_t us) {
+  for (int n = 0; n < 1000 && timer.deadlineUs && static_cast<uint64_t>(timer.deadlineUs) <= us; ++n) {
+    if (static_cast<uint64_t>(timer.deadlineUs) > hostfake::nowUs) {
+      hostfake::nowUs = static_cast<uint64_t>(timer.deadlineUs);
+    }
+    timer.deadlineUs = 0;
+    ++timer.fires;
+    timer.fn(timer.arg);
+    endTransition();
+  }
+  hostfake::nowUs = us;
+}
+
+// A control loop passing every `periodUs` for `ms`.
+inline void loopFor(RelaysModule& relays, uint32_t ms, uint32_t periodUs = 5000) {
+  const uint64_t end = hostfake::nowUs + ms * 1000ULL;
+  while (hostfake::nowUs < end) {
+    advanceTo(hostfake::nowUs + periodUs);
+    relays.update();
+    endTransition();
+  }
+}
+
+// The loop is blocked for `ms`: only the timer runs meanwhile.
+inline void stall(uint32_t ms) { advanceTo(hostfake::nowUs + ms * 1000ULL); }
+
+}  // namespace relayrig
+
+int64_t relayTimerHostNowUs() { return static_cast<int64_t>(hostfake::nowUs); }
+
+bool relayTimerHostCreate(void (*fn)(void*), void* arg) {
+  if (!relayrig::timer.available) return false;
+  relayrig::timer.fn = fn;
+  relayrig::timer.arg = arg;
+  return true;
+}
+
+// esp_timer_start_once(0) fires straight away; the next clock move does.
+void relayTimerHostArm(int64_t deadlineUs) { relayrig::timer.deadlineUs = deadlineUs; }
+
+void relayOutputsHostWrite(uint32_t w1tc, uint32_t w1ts) {
+  using namespace relayrig;
+  const uint8_t before = energised();
+  if (transitionWrites == 0) transitionFrom = before;
+  outHigh = (outHigh | w1ts) & ~w1tc;
+  ++registerWrites;
+  ++transitionWrites;
+
+  const uint8_t now = energised();
+  if ((now & RelayOutputs::FWD) && (now & RelayOutputs::REV)) ++violations.interlock;
+  if (transitionWrites == 1 && (now & ~transitionFrom)) ++violations.makeBeforeBreak;
+  if (transitionWrites > 2) ++violations.skew;
+
+  const uint8_t changed = before ^ now;
+  for (int b = 0; b < 4; ++b) {
+    if (changed & (1 << b)) switchedUs[b] = static_cast<int64_t>(hostfake::nowUs);
+  }
+}
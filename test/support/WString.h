@@ -0,0 +1,78 @@
+#pragma once
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Host stand-in for the Arduino String: std::string storage, Arduino
+// formatting rules for numbers (integers in decimal, floats with two
+// decimals, char appended as a character).
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+class String {
+public:
+  String() = default;
+  String(const char* s) : _s(s ? s : "") {}
+  String(const __FlashStringHelper* s) : _s(reinterpret_cast<const char*>(s)) {}
+  String(const std::string& s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char v) : _s(std::to_string(v)) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned int v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+  explicit String(long long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long long v) : _s(std::to_string(v)) {}
+  explicit String(double v, unsigned decimals = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimals), v);
+    _s = buf;
+  }
+
+  const char* c_str() const { return _s.c_str(); }
+  size_t length() const { return _s.size(); }
+  bool reserve(size_t n) { _s.reserve(n); return true; }
+  char operator[](size_t i) const { return _s[i]; }
+
+  bool concat(const char* p, size_t n) { _s.append(p, n); return true; }
+  String& operator+=(const String& v) { _s += v._s; return *this; }
+  String& operator+=(const char* v) { _s += v ? v : ""; return *this; }
+  String& operator+=(const __FlashStringHelper* v) { return *this += reinterpret_cast<const char*>(v); }
+  String& operator+=(char c) { _s += c; return *this; }
+  template <typename T>
+  String& operator+=(T v) { _s += String(v)._s; return *this; }
+
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == o; }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  bool equalsIgnoreCase(const String& o) const {
+    if (_s.size() != o._s.size()) return false;
+    for (size_t i = 0; i < _s.size(); ++i) {
+      if (tolower(static_cast<unsigned char>(_s[i])) != tolower(static_cast<unsigned char>(o._s[i]))) return false;
+    }
+    return true;
+  }
+  bool startsWith(const String& p) const { return _s.rfind(p._s, 0) == 0; }
+  int indexOf(const char* p) const {
+    size_t at = _s.find(p);
+    return at == std::string::npos ? -1 : static_cast<int>(at);
+  }
+  long toInt() const { return atol(_s.c_str()); }
+
+private:
+  std::string _s;
+};
+
+template <typename T>
+inline String operator+(const String& a, const T& b) {
+  String r(a);
+  r += b;
+  return r;
+}
+
+inline String operator+(const char* a, const String& b) {
+  String r(a);
+  r += b;
+  return r;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <esp_err.h>
+#include "HostFake.h"
+
+// GPIO driver calls used by the click sources; levels live in
+// hostfake::pinLevel and edges are raised by hostfake::setPin().
+typedef int gpio_num_t;
+
+typedef enum {
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_POSEDGE = 1,
+  GPIO_INTR_NEGEDGE = 2,
+  GPIO_INTR_ANYEDGE = 3,
+} gpio_int_type_t;
+
+typedef enum { GPIO_MODE_DISABLE = 0, GPIO_MODE_INPUT = 1, GPIO_MODE_OUTPUT = 2 } gpio_mode_t;
+typedef enum { GPIO_PULLUP_DISABLE = 0, GPIO_PULLUP_ENABLE = 1 } gpio_pullup_t;
+typedef enum { GPIO_PULLDOWN_DISABLE = 0, GPIO_PULLDOWN_ENABLE = 1 } gpio_pulldown_t;
+
+typedef struct {
+  uint64_t pin_bit_mask;
+  gpio_mode_t mode;
+  gpio_pullup_t pull_up_en;
+  gpio_pulldown_t pull_down_en;
+  gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void*);
+
+inline esp_err_t gpio_config(const gpio_config_t*) { return ESP_OK; }
+
+inline esp_err_t gpio_install_isr_service(int) {
+  if (hostfake::gpioIsrService) return ESP_ERR_INVALID_STATE;
+  hostfake::gpioIsrService = true;
+  return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t fn, void* arg) {
+  if (pin < 0 || pin >= hostfake::PIN_COUNT) return ESP_ERR_INVALID_ARG;
+  if (!hostfake::gpioIsrService) return ESP_ERR_INVALID_STATE;
+  hostfake::gpioIsr[pin].fn = fn;
+  hostfake::gpioIsr[pin].arg = arg;
+  return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_remove(gpio_num_t pin) {
+  if (pin < 0 || pin >= hostfake::PIN_COUNT) return ESP_ERR_INVALID_ARG;
+  hostfake::gpioIsr[pin] = hostfake::GpioIsr();
+  return ESP_OK;
+}
+
+inline esp_err_t gpio_intr_enable(gpio_num_t pin) {
+  if (pin < 0 || pin >= hostfake::PIN_COUNT) return ESP_ERR_INVALID_ARG;
+  hostfake::gpioIsr[pin].enabled = true;
+  return ESP_OK;
+}
+
+inline esp_err_t gpio_intr_disable(gpio_num_t pin) {
+  if (pin < 0 || pin >= hostfake::PIN_COUNT) return ESP_ERR_INVALID_ARG;
+  hostfake::gpioIsr[pin].enabled = false;
+  return ESP_OK;
+}
+
+inline int gpio_get_level(gpio_num_t pin) {
+  return (pin >= 0 && pin < hostfake::PIN_COUNT) ? hostfake::pinLevel[pin] : 0;
+}
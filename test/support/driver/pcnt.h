@@ -0,0 +1,138 @@
+#pragma once
+#include <esp_err.h>
+#include "HostFake.h"
+
+// Legacy (IDF 4.x) pulse counter driver used by PcntClickSource; unit state
+// lives in hostfake::pcnt and edges arrive through hostfake::setPin(),
+// through the unit's glitch filter when it is enabled.
+typedef enum {
+  PCNT_UNIT_0 = 0, PCNT_UNIT_1, PCNT_UNIT_2, PCNT_UNIT_3,
+  PCNT_UNIT_4, PCNT_UNIT_5, PCNT_UNIT_6, PCNT_UNIT_7, PCNT_UNIT_MAX,
+} pcnt_unit_t;
+
+typedef enum { PCNT_CHANNEL_0 = 0, PCNT_CHANNEL_1, PCNT_CHANNEL_MAX } pcnt_channel_t;
+typedef enum { PCNT_COUNT_DIS = 0, PCNT_COUNT_INC, PCNT_COUNT_DEC } pcnt_count_mode_t;
+typedef enum { PCNT_MODE_KEEP = 0, PCNT_MODE_REVERSE, PCNT_MODE_DISABLE } pcnt_ctrl_mode_t;
+
+typedef enum {
+  PCNT_EVT_THRES_1 = 1 << 2,
+  PCNT_EVT_THRES_0 = 1 << 3,
+  PCNT_EVT_L_LIM = 1 << 4,
+  PCNT_EVT_H_LIM = 1 << 5,
+  PCNT_EVT_ZERO = 1 << 6,
+} pcnt_evt_type_t;
+
+#define PCNT_PIN_NOT_USED (-1)
+
+typedef struct {
+  int pulse_gpio_num;
+  int ctrl_gpio_num;
+  pcnt_ctrl_mode_t lctrl_mode;
+  pcnt_ctrl_mode_t hctrl_mode;
+  pcnt_count_mode_t pos_mode;
+  pcnt_count_mode_t neg_mode;
+  int16_t counter_h_lim;
+  int16_t counter_l_lim;
+  pcnt_unit_t unit;
+  pcnt_channel_t channel;
+} pcnt_config_t;
+
+inline hostfake::PcntUnit* pcntUnit(pcnt_unit_t unit) {
+  return (unit >= 0 && unit < hostfake::PCNT_UNITS) ? &hostfake::pcnt[unit] : nullptr;
+}
+
+inline esp_err_t pcnt_unit_config(const pcnt_config_t* cfg) {
+  hostfake::PcntUnit* u = cfg ? pcntUnit(cfg->unit) : nullptr;
+  if (!u || cfg->pulse_gpio_num < 0 || cfg->pulse_gpio_num >= hostfake::PIN_COUNT ||
+      cfg->counter_h_lim <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // Like the driver: configure, clear and leave the counter running.
+  u->configured = true;
+  u->pin = cfg->pulse_gpio_num;
+  u->countRise = cfg->pos_mode == PCNT_COUNT_INC;
+  u->countFall = cfg->neg_mode == PCNT_COUNT_INC;
+  u->hLim = cfg->counter_h_lim;
+  u->count = 0;
+  u->paused = false;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u || value > 1023) return ESP_ERR_INVALID_ARG;
+  u->filterCycles = value;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  u->filterOn = true;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  if (evt == PCNT_EVT_H_LIM) u->hLimEvent = true;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t evt) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  if (evt == PCNT_EVT_H_LIM) u->hLimEvent = false;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_isr_service_install(int) {
+  if (hostfake::pcntIsrService) return ESP_ERR_INVALID_STATE;
+  hostfake::pcntIsrService = true;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*fn)(void*), void* arg) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  if (!hostfake::pcntIsrService) return ESP_ERR_INVALID_STATE;
+  u->isr = fn;
+  u->arg = arg;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  u->isr = nullptr;
+  u->arg = nullptr;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  u->paused = true;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  u->paused = false;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u) return ESP_ERR_INVALID_ARG;
+  u->count = 0;
+  return ESP_OK;
+}
+
+inline esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+  hostfake::PcntUnit* u = pcntUnit(unit);
+  if (!u || !count) return ESP_ERR_INVALID_ARG;
+  *count = u->count;
+  return ESP_OK;
+}
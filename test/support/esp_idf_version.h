@@ -0,0 +1,8 @@
+#pragma once
+
+// The firmware builds against Arduino-ESP32 2.x, i.e. ESP-IDF 4.4.
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION_MAJOR 4
+#define ESP_IDF_VERSION_MINOR 4
+#define ESP_IDF_VERSION_PATCH 0
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(4, 4, 0)
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <esp_err.h>
+#include "HostFake.h"
+
+// Data partitions from hostfake::addPartition(), with NOR semantics (erase
+// sets 0xFF, writes only clear bits). Each call advances the fake clock by
+// the partition's write/erase time, and hostfake::cutPowerAt() freezes the
+// content partway through an operation.
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  hostfake::Partition* fake;
+} esp_partition_t;
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                        esp_partition_subtype_t,
+                                                        const char* label) {
+  static std::map<const hostfake::Partition*, esp_partition_t> handles;
+  auto it = hostfake::partitions.find(label ? label : "");
+  if (type != ESP_PARTITION_TYPE_DATA || it == hostfake::partitions.end()) return nullptr;
+  esp_partition_t& h = handles[&it->second];
+  h.type = type;
+  h.size = static_cast<uint32_t>(it->second.mem.size());
+  snprintf(h.label, sizeof(h.label), "%s", label);
+  h.fake = &it->second;
+  return &h;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* part, size_t off, void* dst, size_t len) {
+  hostfake::Partition& p = *part->fake;
+  if (off + len > p.mem.size()) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, p.mem.data() + off, len);
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* part, size_t off, const void* src, size_t len) {
+  hostfake::Partition& p = *part->fake;
+  if (off + len > p.mem.size()) return ESP_ERR_INVALID_SIZE;
+  if (p.powerLost || hostfake::nowUs >= p.powerOffUs) {
+    p.powerLost = true;
+    return ESP_FAIL;
+  }
+  size_t landed = len;
+  if (hostfake::nowUs + p.writeUs > p.powerOffUs) {
+    landed = static_cast<size_t>(len * (p.powerOffUs - hostfake::nowUs) / p.writeUs);
+  }
+  const uint8_t* s = static_cast<const uint8_t*>(src);
+  for (size_t i = 0; i < landed; ++i) p.mem[off + i] &= s[i];
+  hostfake::advanceUs(p.writeUs);
+  if (landed < len) {
+    p.powerLost = true;
+    return ESP_FAIL;
+  }
+  ++p.writes;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* part, size_t off, size_t len) {
+  hostfake::Partition& p = *part->fake;
+  if (off + len > p.mem.size() || off % 4096 || len % 4096) return ESP_ERR_INVALID_SIZE;
+  if (p.powerLost || hostfake::nowUs >= p.powerOffUs) {
+    p.powerLost = true;
+    return ESP_FAIL;
+  }
+  const uint64_t us = static_cast<uint64_t>(p.eraseUs) * (len / 4096);
+  hostfake::advanceUs(us);
+  if (hostfake::nowUs > p.powerOffUs) {
+    memset(p.mem.data() + off, 0xFF, len / 2);
+    p.powerLost = true;
+    return ESP_FAIL;
+  }
+  memset(p.mem.data() + off, 0xFF, len);
+  ++p.erases;
+  return ESP_OK;
+}
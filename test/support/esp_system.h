@@ -0,0 +1,21 @@
+#pragma once
+#include "HostFake.h"
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+// Set hostfake::resetReason before ClickCounter::begin().
+inline esp_reset_reason_t esp_reset_reason() {
+  return static_cast<esp_reset_reason_t>(hostfake::resetReason);
+}
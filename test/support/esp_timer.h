@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <esp_err.h>
+#include "HostFake.h"
+
+// esp_timer on the hostfake clock: one-shots live in hostfake::timers and
+// fire from hostfake::runTimersUntil(). Periodic timers are not modelled.
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+typedef hostfake::OneShotTimer* esp_timer_handle_t;
+
+inline int64_t esp_timer_get_time() { return static_cast<int64_t>(hostfake::nowUs); }
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+  if (!args || !args->callback || !out) return ESP_ERR_INVALID_ARG;
+  if (hostfake::timerCreateFails) return ESP_ERR_NO_MEM;
+  for (hostfake::OneShotTimer& t : hostfake::timers) {
+    if (t.created) continue;
+    t = hostfake::OneShotTimer();
+    t.created = true;
+    t.fn = args->callback;
+    t.arg = args->arg;
+    t.name = args->name;
+    *out = &t;
+    return ESP_OK;
+  }
+  return ESP_ERR_NO_MEM;
+}
+
+// Like IDF: starting a running timer is an error, stop it first.
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeoutUs) {
+  if (!t || !t->created) return ESP_ERR_INVALID_ARG;
+  if (t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = true;
+  t->deadlineUs = hostfake::nowUs + timeoutUs;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+  if (!t || !t->created) return ESP_ERR_INVALID_ARG;
+  if (!t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = false;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t t) {
+  if (!t || !t->created) return ESP_ERR_INVALID_ARG;
+  if (t->armed) return ESP_ERR_INVALID_STATE;
+  *t = hostfake::OneShotTimer();
+  return ESP_OK;
+}
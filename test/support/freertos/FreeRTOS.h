@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Critical sections are no-ops on the host: the native suites drive the
+// firmware from one thread, except EdgeRing which is lock-free.
+typedef struct {
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+inline void portENTER_CRITICAL(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE*) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE*) {}
@@ -0,0 +1,7 @@
+#pragma once
+#include <driver/gpio.h>
+#include <soc/gpio_struct.h>
+
+inline int gpio_ll_get_level(gpio_dev_t*, gpio_num_t pin) {
+  return gpio_get_level(pin);
+}
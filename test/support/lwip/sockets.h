@@ -0,0 +1,11 @@
+#pragma once
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// lwIP's BSD socket layer is call-compatible with the host's, so on the
+// host the firmware's socket code runs against real loopback sockets.
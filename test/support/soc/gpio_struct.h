@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include "HostFake.h"
+
+// The GPIO0-31 output set/clear registers: a store drives the masked pins
+// in hostfake::pinOutput and is counted.
+struct GpioOutW1 {
+  bool set;
+  GpioOutW1& operator=(uint32_t mask) {
+    for (int pin = 0; pin < 32 && pin < hostfake::PIN_COUNT; ++pin) {
+      if (mask & (1UL << pin)) hostfake::pinOutput[pin] = set ? 1 : 0;
+    }
+    ++hostfake::gpioOutWrites;
+    return *this;
+  }
+};
+
+typedef struct {
+  GpioOutW1 out_w1ts{true};
+  GpioOutW1 out_w1tc{false};
+} gpio_dev_t;
+
+inline gpio_dev_t GPIO;
@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <memory>
+#include "ClickSource.h"
+#include "HostFake.h"
+
+// The contract ClickCounter relies on, run against every edge source: the
+// GPIO interrupt, the PCNT peripheral (legacy IDF 4.4 driver on the host
+// fake) and the simulator. Each click is a falling then a rising edge.
+
+namespace {
+
+constexpr uint8_t PIN = 27;
+constexpr uint32_t GATE_US = 2250;        // ClickCounter::ISR_GATE_US
+constexpr uint32_t CLICK_US = 10000;
+
+enum class Kind { ISR, PCNT, SIM };
+
+Kind kind;
+std::unique_ptr<ClickSource> source;
+
+void use(Kind k) {
+  kind = k;
+  switch (k) {
+    case Kind::ISR:  source.reset(new IsrClickSource(GATE_US)); break;
+    case Kind::PCNT: source.reset(new PcntClickSource()); break;
+    case Kind::SIM:  source.reset(new SimClickSource()); break;
+  }
+  TEST_ASSERT_TRUE(source->start(PIN));
+  if (k == Kind::SIM) static_cast<SimClickSource*>(source.get())->setRunning(true);
+}
+
+// `n` clicks from whatever drives the source: the pin or the sim clock.
+void clicks(int n) {
+  if (kind == Kind::SIM) {
+    hostfake::advanceMs(n * SimClickSource::PERIOD_MS);
+    return;
+  }
+  for (int i = 0; i < n; ++i) {
+    hostfake::advanceUs(CLICK_US / 2);
+    hostfake::setPin(PIN, LOW);
+    hostfake::advanceUs(CLICK_US / 2);
+    hostfake::setPin(PIN, HIGH);
+  }
+}
+
+// Drains everything in batches of `batch`, checking that levels alternate
+// (starting low) and stamps never go backwards. Returns the edge count.
+size_t drainAll(size_t batch = 16) {
+  EdgeSample buf[16];
+  size_t total = 0;
+  uint32_t lastUs = 0;
+  for (size_t n; (n = source->drain(buf, batch)) != 0;) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(batch, n);
+    for (size_t i = 0; i < n; ++i, ++total) {
+      TEST_ASSERT_EQUAL_UINT8((total & 1) ? 1 : 0, buf[i].level);
+      if (total) TEST_ASSERT_GREATER_OR_EQUAL_UINT32(lastUs, buf[i].us);
+      lastUs = buf[i].us;
+    }
+  }
+  return total;
+}
+
+void run(Kind k, void (*body)()) {
+  use(k);
+  body();
+}
+
+}  // namespace
+
+#define SOURCE_TEST(fn)                          \
+  void fn##_isr() { run(Kind::ISR, fn); }        \
+  void fn##_pcnt() { run(Kind::PCNT, fn); }      \
+  void fn##_sim() { run(Kind::SIM, fn); }
+
+#define RUN_SOURCE_TEST(fn) \
+  RUN_TEST(fn##_isr);       \
+  RUN_TEST(fn##_pcnt);      \
+  RUN_TEST(fn##_sim)
+
+void setUp() {
+  hostfake::reset();
+}
+
+void tearDown() {
+  if (source) source->stop();
+  source.reset();
+}
+
+void clicks_arrive_in_order() {
+  clicks(40);
+  TEST_ASSERT_EQUAL_UINT32(80, drainAll());
+  TEST_ASSERT_EQUAL_INT(HIGH, source->readLevel());
+  TEST_ASSERT_EQUAL_UINT32(0, source->overflows());
+}
+SOURCE_TEST(clicks_arrive_in_order)
+
+void small_batches_lose_nothing() {
+  clicks(25);
+  TEST_ASSERT_EQUAL_UINT32(50, drainAll(3));
+}
+SOURCE_TEST(small_batches_lose_nothing)
+
+void discard_drops_queued_edges() {
+  clicks(10);
+  source->discard();
+  TEST_ASSERT_EQUAL_UINT32(0, drainAll());
+  clicks(7);
+  TEST_ASSERT_EQUAL_UINT32(14, drainAll());
+}
+SOURCE_TEST(discard_drops_queued_edges)
+
+void restart_starts_clean() {
+  clicks(5);
+  source->stop();
+  TEST_ASSERT_TRUE(source->start(PIN));
+  if (kind == Kind::SIM) static_cast<SimClickSource*>(source.get())->setRunning(true);
+  TEST_ASSERT_EQUAL_UINT32(0, drainAll());
+  clicks(5);
+  TEST_ASSERT_EQUAL_UINT32(10, drainAll());
+}
+SOURCE_TEST(restart_starts_clean)
+
+void test_isr_gate_drops_bounce() {
+  use(Kind::ISR);
+  // A contact bounce: four extra edges inside the gate after the fall.
+  hostfake::advanceUs(CLICK_US);
+  hostfake::setPin(PIN, LOW);
+  for (int i = 0; i < 4; ++i) {
+    hostfake::advanceUs(200);
+    hostfake::setPin(PIN, i % 2 ? LOW : HIGH);
+  }
+  hostfake::advanceUs(CLICK_US);
+  hostfake::setPin(PIN, HIGH);
+  TEST_ASSERT_EQUAL_UINT32(2, drainAll());
+}
+
+void test_pcnt_sets_up_legacy_unit() {
+  use(Kind::PCNT);
+  const hostfake::PcntUnit& u = hostfake::pcnt[0];
+  TEST_ASSERT_TRUE(u.configured);
+  TEST_ASSERT_EQUAL_INT(PIN, u.pin);
+  TEST_ASSERT_TRUE(u.countRise && u.countFall);
+  TEST_ASSERT_TRUE(u.filterOn);
+  TEST_ASSERT_EQUAL_UINT16(800, u.filterCycles);  // 10 us at 80 MHz
+  TEST_ASSERT_TRUE(u.hLimEvent);
+  TEST_ASSERT_NOT_NULL(u.isr);
+
+  source->stop();
+  TEST_ASSERT_TRUE(u.paused);
+  TEST_ASSERT_NULL(u.isr);
+}
+
+void test_pcnt_counts_across_limit_wraps() {
+  use(Kind::PCNT);
+  // 2.5 wraps of the 16-bit hardware counter between two drains.
+  const int n = PcntClickSource::LIMIT + PcntClickSource::LIMIT / 4;
+  clicks(n);
+  TEST_ASSERT_EQUAL_UINT32(2, hostfake::pcnt[0].wraps);
+  TEST_ASSERT_EQUAL_UINT32(2, source->overflows());
+  TEST_ASSERT_EQUAL_UINT32(2 * n, drainAll());
+  clicks(3);
+  TEST_ASSERT_EQUAL_UINT32(6, drainAll());
+}
+
+// A fall that rings `pulses` times (up and back down), `pulseUs` each way,
+// then a clean rise half a click later.
+void ringingClick(int pulses, uint32_t pulseUs) {
+  hostfake::advanceUs(CLICK_US);
+  hostfake::setPin(PIN, LOW);
+  for (int i = 0; i < pulses; ++i) {
+    hostfake::advanceUs(pulseUs);
+    hostfake::setPin(PIN, HIGH);
+    hostfake::advanceUs(pulseUs);
+    hostfake::setPin(PIN, LOW);
+  }
+  hostfake::advanceUs(CLICK_US / 2);
+  hostfake::setPin(PIN, HIGH);
+}
+
+void test_pcnt_filter_drops_glitches_but_not_bounce() {
+  use(Kind::PCNT);
+  // Pulses under the 10 us filter never reach the counter.
+  ringingClick(3, 2);
+  TEST_ASSERT_EQUAL_UINT32(2, drainAll());
+  // Contact bounce is hundreds of us: every pulse is counted, two edges
+  // each. ClickCounter's click-rate check has to catch these.
+  ringingClick(3, 300);
+  TEST_ASSERT_EQUAL_UINT32(2 + 3 * 2, drainAll());
+  TEST_ASSERT_EQUAL_INT(HIGH, source->readLevel());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_SOURCE_TEST(clicks_arrive_in_order);
+  RUN_SOURCE_TEST(small_batches_lose_nothing);
+  RUN_SOURCE_TEST(discard_drops_queued_edges);
+  RUN_SOURCE_TEST(restart_starts_clean);
+  RUN_TEST(test_isr_gate_drops_bounce);
+  RUN_TEST(test_pcnt_sets_up_legacy_unit);
+  RUN_TEST(test_pcnt_counts_across_limit_wraps);
+  RUN_TEST(test_pcnt_filter_drops_glitches_but_not_bounce);
+  return UNITY_END();
+}
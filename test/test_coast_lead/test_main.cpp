@@ -0,0 +1,119 @@
+#include <unity.h>
+#include <memory>
+#include "ClickRig.h"
+
+// Coast lead at the limits: canClose()/canOpen() drop the relays early by
+// the learned coast while driving. A motor that coasts as far as it got
+// going (never more than COAST clicks) must land on the limit from a long
+// run and still cover the last few clicks from a start right next to it.
+
+namespace {
+
+constexpr int32_t END = 300;
+constexpr int32_t COAST = 3;
+constexpr uint32_t CLICK_US = 40000;
+
+std::unique_ptr<ClickCounter> counter;
+
+bool mayDrive(MotionState dir) {
+  return dir == MotionState::CLOSING ? counter->canClose() : counter->canOpen();
+}
+
+// Drives like main.cpp's limit check: start if allowed, stop when the
+// counter says so, then let the cover coast. Returns the clicks driven.
+int32_t drive(MotionState dir, int32_t maxClicks = 10000) {
+  if (!mayDrive(dir)) return 0;
+  counter->setMotion(dir);
+  spin(*counter, 10000);
+  int32_t driven = 0;
+  while (mayDrive(dir) && driven < maxClicks) {
+    click(*counter, CLICK_US);
+    ++driven;
+  }
+  counter->setMotion(MotionState::IDLE);
+  const int32_t coast = driven < COAST ? driven : COAST;
+  for (int32_t i = 0; i < coast; ++i) click(*counter, CLICK_US);
+  spin(*counter, 2000000);
+  return driven;
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  seedEnd(END);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+
+  // Teach the coast with mid-travel runs (at a limit the count clamps).
+  drive(MotionState::CLOSING, 100);
+  for (int i = 0; i < 3; ++i) {
+    drive(MotionState::CLOSING, 50);
+    drive(MotionState::OPENING, 50);
+  }
+  TEST_ASSERT_EQUAL_UINT8(COAST, counter->coastModel().lead(0));
+  TEST_ASSERT_EQUAL_UINT8(COAST, counter->coastModel().lead(1));
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_long_runs_land_on_the_limits() {
+  drive(MotionState::CLOSING);
+  TEST_ASSERT_INT32_WITHIN(1, END, counter->position());
+  TEST_ASSERT_TRUE(counter->lastRun().limitStop);
+  drive(MotionState::OPENING);
+  TEST_ASSERT_INT32_WITHIN(1, 0, counter->position());
+}
+
+void test_short_hops_cover_the_last_clicks() {
+  // Park just short of each limit, then nudge towards it. The old
+  // behaviour stopped every nudge before its first click.
+  for (int32_t gap = 1; gap <= COAST + 1; ++gap) {
+    drive(MotionState::OPENING);
+    drive(MotionState::CLOSING, END - gap - counter->position() - COAST);
+    const int32_t parked = counter->position();
+    TEST_ASSERT_LESS_THAN_INT32(END, parked);
+
+    for (int hop = 0; hop < 4 && counter->position() < END; ++hop) {
+      TEST_ASSERT_TRUE(counter->canClose());
+      TEST_ASSERT_GREATER_THAN_INT32(0, drive(MotionState::CLOSING));
+    }
+    TEST_ASSERT_INT32_WITHIN(1, END, counter->position());
+  }
+
+  for (int32_t gap = 1; gap <= COAST + 1; ++gap) {
+    drive(MotionState::CLOSING);
+    drive(MotionState::OPENING, counter->position() - gap - COAST);
+    TEST_ASSERT_GREATER_THAN_INT32(0, counter->position());
+
+    for (int hop = 0; hop < 4 && counter->position() > 0; ++hop) {
+      TEST_ASSERT_TRUE(counter->canOpen());
+      TEST_ASSERT_GREATER_THAN_INT32(0, drive(MotionState::OPENING));
+    }
+    TEST_ASSERT_INT32_WITHIN(1, 0, counter->position());
+  }
+}
+
+void test_lead_only_applies_while_driving() {
+  drive(MotionState::OPENING);
+  drive(MotionState::CLOSING, END - 2 - counter->position() - COAST);
+  const int32_t pos = counter->position();
+  TEST_ASSERT_TRUE(counter->canClose());
+  counter->setMotion(MotionState::CLOSING);
+  spin(*counter, 10000);
+  // Nothing travelled yet: no lead, the run may start.
+  TEST_ASSERT_TRUE(counter->canClose());
+  TEST_ASSERT_EQUAL_INT32(pos, counter->position());
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_long_runs_land_on_the_limits);
+  RUN_TEST(test_short_hops_cover_the_last_clicks);
+  RUN_TEST(test_lead_only_applies_while_driving);
+  return UNITY_END();
+}
@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <random>
+#include <string>
+#include <CrashLog.h>
+
+// CrashLog across simulated resets. The RTC block is a static in the
+// module, so it outlives the CrashLog objects the way RTC memory outlives
+// a warm reset; each boot is a new object's begin(). A power-on (and a
+// block that was never written) keeps nothing; a software or watchdog
+// reset keeps an exact suffix of what was logged, starting on a whole
+// line once the ring has wrapped, with the uptime of the last stamp.
+
+namespace {
+
+std::string previous(const CrashLog& c) { return std::string(c.previous(), c.previousLen()); }
+
+void boot(CrashLog* c, esp_reset_reason_t reason) { c->begin(reason); }
+
+std::string append(CrashLog* c, const std::string& line, uint32_t ms) {
+  c->append(line.c_str(), line.size(), ms);
+  return line + "\n";
+}
+
+bool endsWith(const std::string& s, const std::string& tail) {
+  return s.size() >= tail.size() && s.compare(s.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_never_written_block_is_ignored() {
+  // Runs first: the block still holds what the "chip" powered up with.
+  CrashLog c;
+  boot(&c, ESP_RST_SW);
+  TEST_ASSERT_FALSE(c.hasPrevious());
+  TEST_ASSERT_EQUAL_UINT32(0, c.previousLen());
+}
+
+void test_power_on_discards_the_tail() {
+  CrashLog first;
+  boot(&first, ESP_RST_POWERON);
+  append(&first, "[BOOT] one", 10);
+  append(&first, "[BOOT] two", 20);
+
+  CrashLog second;
+  boot(&second, ESP_RST_POWERON);
+  TEST_ASSERT_FALSE(second.hasPrevious());
+  TEST_ASSERT_EQUAL_UINT32(0, second.previousLen());
+  TEST_ASSERT_EQUAL(ESP_RST_POWERON, second.resetReason());
+}
+
+void test_short_boot_round_trips_exactly() {
+  CrashLog first;
+  boot(&first, ESP_RST_POWERON);
+  std::string logged = append(&first, "[BOOT] a", 5);
+  logged += append(&first, "[PANIC] Triggered: click-stall", 9);
+  first.stamp(1234);
+
+  CrashLog second;
+  boot(&second, ESP_RST_TASK_WDT);
+  TEST_ASSERT_TRUE(second.hasPrevious());
+  TEST_ASSERT_EQUAL_STRING(logged.c_str(), previous(second).c_str());
+  TEST_ASSERT_EQUAL_UINT32(1234, second.previousUptimeMs());
+  TEST_ASSERT_EQUAL_STRING("task-wdt", CrashLog::reasonName(second.resetReason()));
+
+  // The ring started over: a reset straight away keeps nothing new.
+  CrashLog third;
+  boot(&third, ESP_RST_PANIC);
+  TEST_ASSERT_TRUE(third.hasPrevious());
+  TEST_ASSERT_EQUAL_UINT32(0, third.previousLen());
+}
+
+void test_software_reset_keeps_a_whole_line_suffix() {
+  std::mt19937 rng(25);
+  for (int round = 0; round < 50; ++round) {
+    CrashLog c;
+    boot(&c, ESP_RST_POWERON);
+    std::string logged;
+    const int lines = 40 + rng() % 200;
+    uint32_t ms = 0;
+    for (int i = 0; i < lines; ++i) {
+      std::string line = "[L" + std::to_string(i) + "] ";
+      const size_t len = line.size() + rng() % 100;
+      while (line.size() < len) line += static_cast<char>('a' + rng() % 26);
+      ms += 1 + rng() % 1000;
+      logged += append(&c, line, ms);
+    }
+
+    CrashLog next;
+    boot(&next, ESP_RST_SW);
+    TEST_ASSERT_TRUE(next.hasPrevious());
+    TEST_ASSERT_EQUAL_UINT32(ms, next.previousUptimeMs());
+    const std::string prev = previous(next);
+    TEST_ASSERT_TRUE(endsWith(logged, prev));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CrashLog::BYTES, prev.size());
+    if (logged.size() <= CrashLog::BYTES) {
+      TEST_ASSERT_EQUAL_UINT32(logged.size(), prev.size());
+    } else {
+      // Starts on a line: at most the partial first line (and, if the
+      // cut fell exactly on a line start, that one line) is lost.
+      TEST_ASSERT_EQUAL_INT('\n', logged[logged.size() - prev.size() - 1]);
+      TEST_ASSERT_EQUAL_INT('[', prev[0]);
+      TEST_ASSERT_GREATER_THAN_UINT32(CrashLog::BYTES - 2 * 110, prev.size());
+    }
+  }
+}
+
+void test_partial_first_line_is_dropped_on_wrap() {
+  CrashLog c;
+  boot(&c, ESP_RST_POWERON);
+  // 30 lines of 99 B + newline: 3000 B, so the ring cut falls 952 B into
+  // the log, 52 B into line 9.
+  std::string logged;
+  for (int i = 0; i < 30; ++i) {
+    char head[8];
+    snprintf(head, sizeof(head), "[%02d] ", i);
+    logged += append(&c, head + std::string(94, 'x'), 100 + i);
+  }
+  CrashLog next;
+  boot(&next, ESP_RST_INT_WDT);
+  const std::string prev = previous(next);
+  TEST_ASSERT_EQUAL_UINT32(20 * 100, prev.size());
+  TEST_ASSERT_EQUAL_STRING(logged.substr(10 * 100).c_str(), prev.c_str());
+  TEST_ASSERT_EQUAL_UINT32(129, next.previousUptimeMs());
+}
+
+void test_line_longer_than_the_ring_is_cut() {
+  CrashLog c;
+  boot(&c, ESP_RST_POWERON);
+  append(&c, "[BOOT] before", 1);
+  const std::string big(3 * CrashLog::BYTES, 'y');
+  c.append(big.c_str(), big.size(), 2);
+  CrashLog next;
+  boot(&next, ESP_RST_SW);
+  // BYTES - 1 of it and its newline fill the ring: no line start to keep
+  // from, so nothing is kept rather than a line without its beginning.
+  TEST_ASSERT_TRUE(next.hasPrevious());
+  TEST_ASSERT_EQUAL_UINT32(0, next.previousLen());
+  TEST_ASSERT_EQUAL_UINT32(2, next.previousUptimeMs());
+
+  // A line that fits with one byte to spare is kept whole.
+  const std::string fits(CrashLog::BYTES - 2, 'z');
+  append(&next, "[BOOT] before", 3);
+  append(&next, fits, 4);
+  CrashLog after;
+  boot(&after, ESP_RST_SW);
+  TEST_ASSERT_EQUAL_STRING((fits + "\n").c_str(), previous(after).c_str());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_never_written_block_is_ignored);
+  RUN_TEST(test_power_on_discards_the_tail);
+  RUN_TEST(test_short_boot_round_trips_exactly);
+  RUN_TEST(test_software_reset_keeps_a_whole_line_suffix);
+  RUN_TEST(test_partial_first_line_is_dropped_on_wrap);
+  RUN_TEST(test_line_longer_than_the_ring_is_cut);
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+#include <unity.h>
+#include <random>
+#include "EdgeDecoder.h"
+
+// EdgeDecoder over 20000 click cycles with injected faults. The error
+// bounds are the decoder's contract: a clean stream counts exactly, a
+// doubled edge never counts, and a missed edge is recovered from timing
+// unless two faults land in the same cycle.
+
+namespace {
+
+constexpr int CYCLES = 20000;
+
+struct Faults {
+  int missPct = 0;     // edges dropped, per hundred
+  int dupPct = 0;      // edges repeated at the same level, per hundred
+  bool timed = true;   // false: PCNT-style, no timestamps
+};
+
+struct Outcome {
+  long truth = 0;      // real clicks (falling edges sent)
+  long counted = 0;
+  int missed = 0;
+  int doubled = 0;
+  EdgeDecoder::Stats stats;
+};
+
+Outcome runCycles(const Faults& f, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> jitter(0, 2000);
+  std::uniform_int_distribution<int> pct(0, 99);
+
+  EdgeDecoder d;
+  d.reset(false);
+  Outcome o;
+  bool low = false;
+  uint32_t t = 0;
+  for (int c = 0; c < CYCLES; ++c) {
+    for (int h = 0; h < 2; ++h) {
+      low = !low;
+      t += 20000 + jitter(rng);
+      if (low) ++o.truth;
+      const uint8_t level = low ? 0 : 1;
+      if (pct(rng) < f.missPct) {
+        ++o.missed;
+        continue;
+      }
+      o.counted += d.feed({t, level}, f.timed);
+      if (pct(rng) < f.dupPct) {
+        ++o.doubled;
+        o.counted += d.feed({t + 3000, level}, f.timed);
+      }
+    }
+  }
+  o.stats = d.stats();
+  return o;
+}
+
+long err(const Outcome& o) {
+  return o.counted > o.truth ? o.counted - o.truth : o.truth - o.counted;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_clean_stream_counts_exactly() {
+  Outcome o = runCycles(Faults{}, 1);
+  TEST_ASSERT_EQUAL_INT32(CYCLES, o.truth);
+  TEST_ASSERT_EQUAL_INT32(o.truth, o.counted);
+  TEST_ASSERT_EQUAL_UINT32(2 * CYCLES, o.stats.transitions);
+  TEST_ASSERT_EQUAL_UINT32(0, o.stats.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(0, o.stats.resyncs);
+}
+
+void test_duplicate_edges_never_count() {
+  Faults f;
+  f.dupPct = 2;
+  Outcome o = runCycles(f, 2);
+  TEST_ASSERT_GREATER_THAN_INT32(500, o.doubled);
+  TEST_ASSERT_EQUAL_INT32(o.truth, o.counted);
+  TEST_ASSERT_EQUAL_UINT32(o.doubled, o.stats.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(0, o.stats.resyncs);
+}
+
+void test_missed_edges_are_recovered() {
+  Faults f;
+  f.missPct = 2;
+  Outcome o = runCycles(f, 3);
+  TEST_ASSERT_GREATER_THAN_INT32(500, o.missed);
+  // Only back-to-back misses (about missPct^2 of edges) can cost a click.
+  TEST_ASSERT_LESS_OR_EQUAL_INT32(CYCLES / 1000, err(o));
+  TEST_ASSERT_LESS_OR_EQUAL_INT32(o.missed, o.stats.resyncs);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT32(o.missed * 9 / 10, o.stats.resyncs);
+}
+
+void test_mixed_faults_stay_bounded() {
+  Faults f;
+  f.missPct = 2;
+  f.dupPct = 2;
+  long worst = 0;
+  for (uint32_t seed = 10; seed < 15; ++seed) {
+    Outcome o = runCycles(f, seed);
+    if (err(o) > worst) worst = err(o);
+  }
+  // Under 0.2 % of cycles, with ~4 % of edges faulty.
+  TEST_ASSERT_LESS_OR_EQUAL_INT32(CYCLES / 500, worst);
+}
+
+void test_untimed_source_drops_duplicates_only() {
+  // Without timestamps a same-level edge is always a duplicate; a miss
+  // then costs at most its own click and never shifts the phase.
+  Faults dup;
+  dup.dupPct = 2;
+  dup.timed = false;
+  Outcome o = runCycles(dup, 4);
+  TEST_ASSERT_EQUAL_INT32(o.truth, o.counted);
+
+  Faults miss;
+  miss.missPct = 2;
+  miss.timed = false;
+  o = runCycles(miss, 5);
+  TEST_ASSERT_LESS_OR_EQUAL_INT32(o.truth, o.counted);
+  TEST_ASSERT_LESS_OR_EQUAL_INT32(o.missed, err(o));
+  TEST_ASSERT_EQUAL_UINT32(0, o.stats.resyncs);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_stream_counts_exactly);
+  RUN_TEST(test_duplicate_edges_never_count);
+  RUN_TEST(test_missed_edges_are_recovered);
+  RUN_TEST(test_mixed_faults_stay_bounded);
+  RUN_TEST(test_untimed_source_drops_duplicates_only);
+  return UNITY_END();
+}
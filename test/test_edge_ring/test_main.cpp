@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "EdgeRing.h"
+
+// EdgeRing across two threads: a producer standing in for the GPIO ISR and
+// a consumer draining in batches like ClickCounter::drainSource().
+
+namespace {
+
+constexpr size_t RING = 128;
+constexpr uint32_t EDGES = 500000;
+
+// Drains until the producer is done and the ring is empty, checking order
+// on the fly; returns the samples seen. `stall` adds the odd slow loop pass.
+uint32_t consume(EdgeRing<RING>& ring, const std::atomic<bool>& done,
+                 uint32_t* lastSeq, bool* ordered, bool stall = false) {
+  EdgeSample batch[32];
+  uint32_t seen = 0;
+  bool first = true;
+  for (uint32_t pass = 1;; ++pass) {
+    if (stall && pass % 256 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    size_t n = ring.pop(batch, 32);
+    if (!n) {
+      if (done.load(std::memory_order_acquire) && !ring.pending()) break;
+      std::this_thread::yield();
+      continue;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t seq = batch[i].us;
+      if (batch[i].level != (seq & 1)) *ordered = false;
+      if (!first && seq <= *lastSeq) *ordered = false;
+      *lastSeq = seq;
+      first = false;
+      ++seen;
+    }
+  }
+  return seen;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_no_loss_or_reorder_below_capacity() {
+  EdgeRing<RING> ring;
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < EDGES; ++i) {
+      // Stay below capacity: wait for the consumer instead of dropping.
+      while (ring.pending() >= RING) std::this_thread::yield();
+      ring.push(i, i & 1);
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t last = 0;
+  bool ordered = true;
+  uint32_t seen = consume(ring, done, &last, &ordered);
+  producer.join();
+
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(EDGES, seen);
+  TEST_ASSERT_EQUAL_UINT32(EDGES - 1, last);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.overflows());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(RING, ring.highWater());
+}
+
+void test_overflow_drops_newest_and_counts_them() {
+  EdgeRing<RING> ring;
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < EDGES; ++i) ring.push(i, i & 1);
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t last = 0;
+  bool ordered = true;
+  uint32_t seen = consume(ring, done, &last, &ordered, true);
+  producer.join();
+
+  // Whatever got through is in order and nothing is unaccounted for.
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(EDGES, seen + ring.overflows());
+  TEST_ASSERT_EQUAL_UINT32(RING, ring.highWater());
+}
+
+void test_clear_from_consumer_while_producing() {
+  EdgeRing<RING> ring;
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < EDGES / 4; ++i) {
+      while (ring.pending() >= RING) std::this_thread::yield();
+      ring.push(i, i & 1);
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  EdgeSample batch[32];
+  uint32_t last = 0;
+  bool haveLast = false;
+  bool ordered = true;
+  for (uint32_t round = 0; !done.load(std::memory_order_acquire) || ring.pending(); ++round) {
+    if (round % 64 == 0) {
+      ring.clear();
+      continue;
+    }
+    size_t n = ring.pop(batch, 32);
+    for (size_t i = 0; i < n; ++i) {
+      if (haveLast && batch[i].us <= last) ordered = false;
+      last = batch[i].us;
+      haveLast = true;
+    }
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.pending());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_loss_or_reorder_below_capacity);
+  RUN_TEST(test_overflow_drops_newest_and_counts_them);
+  RUN_TEST(test_clear_from_consumer_while_producing);
+  return UNITY_END();
+}
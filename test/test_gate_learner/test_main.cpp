@@ -0,0 +1,220 @@
+#include <unity.h>
+#include <memory>
+#include <random>
+#include "ClickRig.h"
+#include "GateLearner.h"
+
+// Debounce gate learning from synthetic edge intervals: contact bounce plus
+// clean half-clicks must give a gate in the gap between the two, a clean
+// signal a gate safely under the half-click, and anything without a clear
+// gap no result at all.
+
+namespace {
+
+std::mt19937 rng(7);
+
+uint32_t uniform(uint32_t lo, uint32_t hi) {
+  return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+}
+
+// One click's worth of intervals: `bounces` short ones after the fall, then
+// the two half-click intervals.
+void addClick(GateLearner& g, uint32_t halfUs, int bounces, uint32_t bounceMaxUs) {
+  uint32_t bounced = 0;
+  for (int i = 0; i < bounces; ++i) {
+    uint32_t b = uniform(150, bounceMaxUs);
+    g.add(b);
+    bounced += b;
+  }
+  g.add(halfUs - bounced);
+  g.add(halfUs);
+}
+
+std::unique_ptr<ClickCounter> counter;
+
+// A click on the pin whose fall rings `bounces` times before settling low.
+void bouncyClick(uint32_t periodUs, int bounces) {
+  spin(*counter, periodUs / 2);
+  hostfake::setPin(PIN_CLICK_IN, LOW);
+  uint32_t spent = 0;
+  for (int i = 0; i < 2 * bounces; ++i) {
+    uint32_t b = uniform(250, 700);
+    hostfake::advanceUs(b);
+    spent += b;
+    hostfake::setPin(PIN_CLICK_IN, (i & 1) ? LOW : HIGH);
+  }
+  counter->update();
+  spin(*counter, periodUs - periodUs / 2 - spent);
+  hostfake::setPin(PIN_CLICK_IN, HIGH);
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_bounce_and_clean_edges_put_gate_in_the_gap() {
+  GateLearner g;
+  for (int i = 0; i < 400; ++i) addClick(g, uniform(18000, 22000), 3, 700);
+  GateLearner::Result r;
+  TEST_ASSERT_TRUE(g.derive(&r));
+  // Above every bounce interval, well below the shortest half-click.
+  TEST_ASSERT_GREATER_THAN_UINT32(700, r.gateUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(16000 * 3 / 4, r.gateUs);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(20, r.confidence);
+}
+
+void test_clean_signal_gate_stays_under_half_click() {
+  GateLearner g;
+  for (int i = 0; i < 200; ++i) addClick(g, uniform(9000, 11000), 0, 0);
+  GateLearner::Result r;
+  TEST_ASSERT_TRUE(g.derive(&r));
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(GateLearner::GATE_MIN_US, r.gateUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(9000 * 3 / 4, r.gateUs);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(90, r.confidence);
+}
+
+void test_learned_gate_filters_a_fresh_bouncy_stream() {
+  GateLearner g;
+  for (int i = 0; i < 300; ++i) addClick(g, uniform(14000, 16000), 4, 600);
+  GateLearner::Result r;
+  TEST_ASSERT_TRUE(g.derive(&r));
+
+  // Apply the gate the way ClickCounter::gateEdge() does.
+  uint32_t t = 0, lastAccepted = 0, accepted = 0;
+  bool have = false;
+  const int clicks = 1000;
+  auto edge = [&](uint32_t at) {
+    if (have && at - lastAccepted < r.gateUs) return;
+    lastAccepted = at;
+    have = true;
+    ++accepted;
+  };
+  for (int c = 0; c < clicks; ++c) {
+    const uint32_t half = uniform(14000, 16000);
+    uint32_t at = t;
+    edge(at);
+    for (int b = 0; b < 4; ++b) edge(at += uniform(150, 600));
+    edge(t + half);
+    t += 2 * half;
+  }
+  TEST_ASSERT_EQUAL_UINT32(2 * clicks, accepted);
+}
+
+void test_too_few_samples_gives_no_result() {
+  GateLearner g;
+  for (uint32_t i = 0; i + 1 < GateLearner::MIN_SAMPLES; ++i) g.add(20000);
+  GateLearner::Result r;
+  TEST_ASSERT_FALSE(g.derive(&r));
+  g.add(20000);
+  TEST_ASSERT_TRUE(g.derive(&r));
+}
+
+void test_no_clear_gap_gives_no_result() {
+  GateLearner::Result r;
+
+  // Two clusters with an empty bucket between them, but less than a
+  // factor of two apart.
+  GateLearner close;
+  for (int i = 0; i < 300; ++i) {
+    close.add(uniform(1200, 1500));
+    close.add(uniform(2300, 3100));
+  }
+  TEST_ASSERT_FALSE(close.derive(&r));
+
+  // Intervals smeared over the whole range: noise, not a signal.
+  GateLearner smear;
+  for (uint8_t i = 0; i < GateLearner::BUCKETS; ++i) {
+    for (int k = 0; k < 20; ++k) smear.add(GateLearner::bucketLowerUs(i));
+  }
+  TEST_ASSERT_FALSE(smear.derive(&r));
+}
+
+void test_decay_follows_a_new_signal() {
+  GateLearner g;
+  for (int i = 0; i < 3000; ++i) addClick(g, uniform(28000, 32000), 2, 500);
+  GateLearner::Result before;
+  TEST_ASSERT_TRUE(g.derive(&before));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(GateLearner::DECAY_AT, g.samples());
+
+  // The motor speeds up: half-clicks drop to ~6 ms.
+  for (int i = 0; i < 3000; ++i) addClick(g, uniform(5800, 6200), 2, 500);
+  GateLearner::Result after;
+  TEST_ASSERT_TRUE(g.derive(&after));
+  TEST_ASSERT_GREATER_THAN_UINT32(500, after.gateUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(5800 * 3 / 4, after.gateUs);
+}
+
+void test_counter_learns_gate_from_bouncy_pin() {
+  seedEnd(1000);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+  TEST_ASSERT_FALSE(counter->gateInfo().learned);
+
+  counter->setMotion(MotionState::CLOSING);
+  spin(*counter, 10000);
+  const int clicks = 120;
+  for (int i = 0; i < clicks; ++i) bouncyClick(40000, 2);
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+
+  const ClickCounter::GateInfo gate = counter->gateInfo();
+  TEST_ASSERT_TRUE(gate.learned);
+  TEST_ASSERT_GREATER_THAN_UINT32(4 * 700, gate.gateUs);   // past a whole bounce burst
+  TEST_ASSERT_LESS_THAN_UINT32(15000, gate.gateUs);
+  TEST_ASSERT_EQUAL_INT32(clicks, counter->position());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, gate.gatedEdges);
+}
+
+void test_pcnt_click_rate_check_drops_bounce_clicks() {
+  seedEnd(1000);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+  TEST_ASSERT_TRUE(counter->setHardwareBackend(ClickCounter::Backend::PCNT));
+  TEST_ASSERT_EQUAL_STRING("pcnt", counter->sourceName());
+
+  // No speed learned yet: bounce the glitch filter lets through is counted.
+  counter->setMotion(MotionState::CLOSING);
+  spin(*counter, 10000);
+  for (int i = 0; i < 4; ++i) bouncyClick(40000, 2);
+  TEST_ASSERT_GREATER_THAN_INT32(4, counter->position());
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+
+  // A clean run teaches the click interval.
+  const int32_t start = counter->position();
+  counter->setMotion(MotionState::CLOSING);
+  for (int i = 0; i < 40; ++i) click(*counter, 40000);
+  TEST_ASSERT_EQUAL_INT32(start + 40, counter->position());
+  TEST_ASSERT_EQUAL_UINT32(0, counter->gateInfo().rateDrops);
+  TEST_ASSERT_UINT32_WITHIN(4000, 40000, counter->clickIntervalUs(MotionState::CLOSING));
+
+  // Now the same bounce costs nothing.
+  const int32_t before = counter->position();
+  const uint32_t seq = counter->gateInfo().seq;
+  const int clicks = 60;
+  for (int i = 0; i < clicks; ++i) bouncyClick(40000, 2);
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+  TEST_ASSERT_EQUAL_INT32(before + clicks, counter->position());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(clicks, counter->gateInfo().rateDrops);
+  TEST_ASSERT_GREATER_THAN_UINT32(seq, counter->gateInfo().seq);  // click_diag goes out
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bounce_and_clean_edges_put_gate_in_the_gap);
+  RUN_TEST(test_clean_signal_gate_stays_under_half_click);
+  RUN_TEST(test_learned_gate_filters_a_fresh_bouncy_stream);
+  RUN_TEST(test_too_few_samples_gives_no_result);
+  RUN_TEST(test_no_clear_gap_gives_no_result);
+  RUN_TEST(test_decay_follows_a_new_signal);
+  RUN_TEST(test_counter_learns_gate_from_bouncy_pin);
+  RUN_TEST(test_pcnt_click_rate_check_drops_bounce_clicks);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <unity.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "LoopProfiler.h"
+
+// Log2Histogram percentiles against the exact order statistics of the same
+// samples, and the whole-octave counts the metrics payload publishes.
+
+namespace {
+
+using Hist = LoopProfiler::Section;
+
+std::mt19937 rng(21);
+
+uint32_t exactPercentile(std::vector<uint32_t> v, float p) {
+  std::sort(v.begin(), v.end());
+  size_t rank = static_cast<size_t>(p * static_cast<float>(v.size()) + 0.5f);
+  if (rank < 1) rank = 1;
+  return v[rank - 1];
+}
+
+float relErr(uint32_t got, uint32_t want) {
+  return std::fabs(static_cast<float>(got) - static_cast<float>(want)) / static_cast<float>(want);
+}
+
+// Worst relative error over p50/p90/p99 for `samples`.
+float worstError(const std::vector<uint32_t>& samples) {
+  Hist h = {};
+  for (uint32_t us : samples) h.add(us);
+  float worst = 0.0f;
+  for (float p : {0.50f, 0.90f, 0.99f}) {
+    float e = relErr(h.percentileUs(p), exactPercentile(samples, p));
+    if (e > worst) worst = e;
+  }
+  return worst;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_percentiles_track_exact_values() {
+  // Log-uniform loop times from 20 us to 20 ms.
+  std::uniform_real_distribution<double> logUs(std::log(20.0), std::log(20000.0));
+  for (int trial = 0; trial < 50; ++trial) {
+    std::vector<uint32_t> v(2000);
+    for (uint32_t& us : v) us = static_cast<uint32_t>(std::exp(logUs(rng)));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(100, static_cast<uint32_t>(worstError(v) * 1000));
+  }
+}
+
+void test_narrow_peak_inside_one_octave() {
+  // A tight cluster just above a power of two with a thin tail near the
+  // top of the octave: the octave's upper bound, even capped at max, would
+  // put p50 at nearly twice the real value.
+  std::normal_distribution<double> peak(1100.0, 15.0);
+  std::vector<uint32_t> v(1000);
+  for (uint32_t& us : v) us = static_cast<uint32_t>(peak(rng));
+  for (size_t i = 0; i < v.size(); i += 100) v[i] = 1950;
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(150, static_cast<uint32_t>(worstError(v) * 1000));
+}
+
+void test_constant_samples_stay_inside_their_slice() {
+  // Worst case for interpolation: every sample at one value. The answer
+  // stays within the 1/4-octave slice, and the tail is capped at max.
+  Hist h = {};
+  for (int i = 0; i < 100; ++i) h.add(3000);
+  TEST_ASSERT_UINT32_WITHIN(3000 / 8, 3000, h.percentileUs(0.50f));
+  TEST_ASSERT_EQUAL_UINT32(3000, h.percentileUs(1.0f));
+  TEST_ASSERT_EQUAL_UINT32(3000, h.meanUs());
+}
+
+void test_open_last_octave_caps_at_max() {
+  Hist h = {};
+  h.add(10);
+  h.add(5000000);   // far past the last octave boundary
+  TEST_ASSERT_EQUAL_UINT32(5000000, h.percentileUs(0.99f));
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucket(Hist::BUCKETS - 1));
+}
+
+void test_octave_counts_match_log2_buckets() {
+  Hist h = {};
+  uint32_t expect[Hist::BUCKETS] = {};
+  std::uniform_int_distribution<uint32_t> us(0, 100000);
+  for (int i = 0; i < 5000; ++i) {
+    const uint32_t v = us(rng);
+    h.add(v);
+    ++expect[Hist::bucketFor(v)];
+  }
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < Hist::BUCKETS; ++i) {
+    TEST_ASSERT_EQUAL_UINT32(expect[i], h.bucket(i));
+    total += h.bucket(i);
+  }
+  TEST_ASSERT_EQUAL_UINT32(h.count, total);
+  TEST_ASSERT_EQUAL_UINT32(0, h.bucket(Hist::BUCKETS));
+
+  // Small values: 0 and 1 share octave 0, 2 and 3 octave 1.
+  Hist s = {};
+  for (uint32_t v = 0; v < 4; ++v) s.add(v);
+  TEST_ASSERT_EQUAL_UINT32(2, s.bucket(0));
+  TEST_ASSERT_EQUAL_UINT32(2, s.bucket(1));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_percentiles_track_exact_values);
+  RUN_TEST(test_narrow_peak_inside_one_octave);
+  RUN_TEST(test_constant_samples_stay_inside_their_slice);
+  RUN_TEST(test_open_last_octave_caps_at_max);
+  RUN_TEST(test_octave_counts_match_log2_buckets);
+  return UNITY_END();
+}
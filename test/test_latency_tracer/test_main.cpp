@@ -0,0 +1,234 @@
+#include <unity.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "LatencyTracer.h"
+
+// Recorded command traces replayed into LatencyTracer the way the control
+// task feeds it: begin() at acceptance, update() with the commanded and
+// relay states each pass, click() for the first counted click and
+// coastDone() for a stop's run summary. Each stage must come out as the
+// difference of the stamps it is paired with, superseded and timed-out
+// traces must not be reported, the seq a publisher watches must move once
+// per completed trace, and the published percentiles must follow the exact
+// ones of the replayed stage times.
+
+namespace {
+
+using LT = LatencyTracer;
+
+enum : uint8_t { IDLE, OPENING, CLOSING };  // MotionState codes
+
+struct Recorded {
+  LT::Source source;
+  uint8_t from;          // commanded and relay state before the command
+  uint8_t target;
+  bool coasting;         // a stop while the motor runs
+  uint32_t inputUs;      // switch edge / MQTT arrival
+  uint32_t acceptedUs;
+  uint32_t commandedUs;  // pass in which it became the commanded motion
+  uint32_t relaysUs;     // pass in which the relays reached it
+  uint32_t motionUs;     // first counted click, or last coast click
+};
+
+LT* tracer;
+uint32_t publishedSeq;
+std::vector<LT::Record> published;
+
+// MqttModule's check: publish when the seq has moved since the last one.
+void publish() {
+  const LT::Stats& st = tracer->stats();
+  if (st.seq == publishedSeq) return;
+  publishedSeq = st.seq;
+  published.push_back(st.last);
+}
+
+void replay(const Recorded& r) {
+  const bool stop = r.target == IDLE;
+  tracer->begin(r.source, r.target, stop, r.coasting, r.inputUs, r.acceptedUs);
+  tracer->update(r.from, r.from, r.acceptedUs);
+  publish();
+  tracer->update(r.target, r.from, r.commandedUs);
+  publish();
+  tracer->update(r.target, r.target, r.relaysUs);
+  publish();
+  if (!stop) {
+    tracer->click(r.motionUs);
+  } else if (r.coasting) {
+    tracer->coastDone(r.motionUs - r.relaysUs);
+  }
+  publish();
+}
+
+void assertStages(const Recorded& r, const LT::Record& got) {
+  TEST_ASSERT_EQUAL_UINT32(r.source, got.source);
+  TEST_ASSERT_EQUAL_UINT32(r.target == IDLE ? LT::KIND_STOP : LT::KIND_START, got.kind);
+  TEST_ASSERT_EQUAL_UINT32(r.acceptedUs - r.inputUs, got.stageUs[LT::ST_INPUT]);
+  TEST_ASSERT_EQUAL_UINT32(r.commandedUs - r.acceptedUs, got.stageUs[LT::ST_ARBITRATE]);
+  TEST_ASSERT_EQUAL_UINT32(r.relaysUs - r.commandedUs, got.stageUs[LT::ST_RELAYS]);
+  TEST_ASSERT_EQUAL_UINT32(r.motionUs - r.relaysUs, got.stageUs[LT::ST_MOTION]);
+  TEST_ASSERT_EQUAL_UINT32(r.motionUs - r.inputUs, got.stageUs[LT::ST_TOTAL]);
+}
+
+uint32_t exactPercentile(std::vector<uint32_t> v, float p) {
+  std::sort(v.begin(), v.end());
+  size_t rank = static_cast<size_t>(p * static_cast<float>(v.size()) + 0.5f);
+  if (rank < 1) rank = 1;
+  return v[rank - 1];
+}
+
+}  // namespace
+
+void setUp() {
+  tracer = new LT();
+  publishedSeq = 0;
+  published.clear();
+}
+
+void tearDown() {
+  delete tracer;
+}
+
+void test_recorded_session_pairs_every_stage() {
+  // A wall open through PSU spin-up, an HA stop while coasting, an HA
+  // close, and a wall stop during spin-up that ends at the relays.
+  const Recorded session[] = {
+      {LT::SRC_WALL, IDLE, OPENING, false, 1000000, 1061000, 1061000, 2265000, 2568000},
+      {LT::SRC_HA, OPENING, IDLE, true, 9000000, 9004100, 9005000, 9005000, 9187000},
+      {LT::SRC_HA, IDLE, CLOSING, false, 20000000, 20003300, 20005000, 21210000, 21492500},
+      {LT::SRC_WALL, CLOSING, IDLE, false, 30000000, 30060000, 30060000, 30060000, 30060000},
+  };
+  uint16_t id = 0;
+  for (const Recorded& r : session) {
+    replay(r);
+    TEST_ASSERT_FALSE(tracer->active());
+    TEST_ASSERT_EQUAL_UINT32(++id, published.back().id);
+    TEST_ASSERT_EQUAL_UINT32(id, published.size());
+    assertStages(r, published.back());
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, tracer->stats().completed);
+  TEST_ASSERT_EQUAL_UINT32(0, tracer->stats().superseded);
+  TEST_ASSERT_EQUAL_UINT32(0, tracer->stats().dropped);
+}
+
+void test_clicks_and_coasts_outside_their_stage_are_ignored() {
+  tracer->begin(LT::SRC_WALL, OPENING, false, false, 1000, 2000);
+  // A late coast click of the previous run, before the relays closed.
+  tracer->click(2500);
+  tracer->coastDone(1000);
+  tracer->update(OPENING, IDLE, 3000);
+  tracer->click(3500);
+  TEST_ASSERT_TRUE(tracer->active());
+  TEST_ASSERT_FALSE(tracer->awaitingClick());
+  tracer->update(OPENING, OPENING, 8000);
+  TEST_ASSERT_TRUE(tracer->awaitingClick());
+  tracer->coastDone(1000);  // a start does not end on a run summary
+  TEST_ASSERT_TRUE(tracer->active());
+  tracer->click(9000);
+  TEST_ASSERT_FALSE(tracer->active());
+  TEST_ASSERT_EQUAL_UINT32(8000, tracer->stats().last.stageUs[LT::ST_TOTAL]);
+  TEST_ASSERT_EQUAL_UINT32(1000, tracer->stats().last.stageUs[LT::ST_MOTION]);
+
+  // Nothing in flight: later feeds change nothing.
+  const uint32_t seq = tracer->stats().seq;
+  tracer->click(10000);
+  tracer->coastDone(500);
+  tracer->update(OPENING, OPENING, 11000);
+  TEST_ASSERT_EQUAL_UINT32(seq, tracer->stats().seq);
+}
+
+void test_superseded_and_timed_out_traces_are_not_published() {
+  // An HA open replaced by a wall close before the relays moved.
+  tracer->begin(LT::SRC_HA, OPENING, false, false, 1000, 5000);
+  tracer->update(OPENING, IDLE, 5000);
+  publish();
+  const Recorded close = {LT::SRC_WALL, IDLE, CLOSING, false, 40000, 100000, 100000, 1300000, 1600000};
+  replay(close);
+  TEST_ASSERT_EQUAL_UINT32(1, published.size());
+  TEST_ASSERT_EQUAL_UINT32(2, published[0].id);
+  assertStages(close, published[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, tracer->stats().superseded);
+
+  // An open whose motor never turns: dropped after TIMEOUT_US.
+  tracer->begin(LT::SRC_HA, OPENING, false, false, 2000000, 2004000);
+  uint32_t now = 2004000;
+  for (; tracer->active(); now += 5000) {
+    tracer->update(OPENING, OPENING, now);
+    publish();
+  }
+  TEST_ASSERT_TRUE(now - 2000000 > LT::TIMEOUT_US);
+  TEST_ASSERT_TRUE(now - 2000000 <= LT::TIMEOUT_US + 10000);
+  tracer->click(now);
+  publish();
+  TEST_ASSERT_EQUAL_UINT32(1, tracer->stats().dropped);
+  TEST_ASSERT_EQUAL_UINT32(1, tracer->stats().completed);
+  TEST_ASSERT_EQUAL_UINT32(1, published.size());
+}
+
+void test_percentiles_follow_the_replayed_stage_times() {
+  // 300 wall starts and 200 HA stops with spread-out stage times.
+  std::mt19937 rng(17);
+  std::lognormal_distribution<double> debounce(std::log(60000.0), 0.1);
+  std::lognormal_distribution<double> spinUp(std::log(1200000.0), 0.05);
+  std::lognormal_distribution<double> firstClick(std::log(250000.0), 0.3);
+  std::lognormal_distribution<double> pickup(std::log(3000.0), 0.6);
+  std::lognormal_distribution<double> coast(std::log(180000.0), 0.2);
+  std::vector<uint32_t> want[LT::SOURCES][LT::KINDS][LT::STAGES];
+  uint32_t now = 1000000;
+  for (int i = 0; i < 500; ++i) {
+    Recorded r;
+    if (i % 5 < 3) {
+      const uint32_t input = static_cast<uint32_t>(debounce(rng));
+      const uint32_t relays = static_cast<uint32_t>(spinUp(rng));
+      r = {LT::SRC_WALL, IDLE, OPENING, false, now, now + input, now + input + 5000 * (i % 2),
+           0, 0};
+      r.relaysUs = r.commandedUs + relays;
+      r.motionUs = r.relaysUs + static_cast<uint32_t>(firstClick(rng));
+    } else {
+      const uint32_t input = static_cast<uint32_t>(pickup(rng));
+      r = {LT::SRC_HA, OPENING, IDLE, true, now, now + input, now + input + 400, 0, 0};
+      r.relaysUs = r.commandedUs;
+      r.motionUs = r.relaysUs + static_cast<uint32_t>(coast(rng));
+    }
+    replay(r);
+    std::vector<uint32_t>* w = want[r.source][r.target == IDLE ? LT::KIND_STOP : LT::KIND_START];
+    w[LT::ST_INPUT].push_back(r.acceptedUs - r.inputUs);
+    w[LT::ST_ARBITRATE].push_back(r.commandedUs - r.acceptedUs);
+    w[LT::ST_RELAYS].push_back(r.relaysUs - r.commandedUs);
+    w[LT::ST_MOTION].push_back(r.motionUs - r.relaysUs);
+    w[LT::ST_TOTAL].push_back(r.motionUs - r.inputUs);
+    now = r.motionUs + 5000000;
+  }
+  TEST_ASSERT_EQUAL_UINT32(500, published.size());
+  TEST_ASSERT_EQUAL_UINT32(500, tracer->stats().seq);
+
+  for (uint8_t src = 0; src < LT::SOURCES; ++src) {
+    for (uint8_t kind = 0; kind < LT::KINDS; ++kind) {
+      for (uint8_t st = 0; st < LT::STAGES; ++st) {
+        const std::vector<uint32_t>& v = want[src][kind][st];
+        const LT::Summary& s = tracer->stats().summary[src][kind][st];
+        TEST_ASSERT_EQUAL_UINT32(v.size(), s.n);
+        if (v.empty()) continue;
+        TEST_ASSERT_EQUAL_UINT32(*std::max_element(v.begin(), v.end()), s.maxUs);
+        const uint32_t got[] = {s.p50Us, s.p90Us, s.p99Us};
+        const float ps[] = {0.50f, 0.90f, 0.99f};
+        for (int k = 0; k < 3; ++k) {
+          // Within 10 %, or a slice of the lowest octave for near-zero stages.
+          const uint32_t exact = exactPercentile(v, ps[k]);
+          const uint32_t err = got[k] > exact ? got[k] - exact : exact - got[k];
+          TEST_ASSERT_LESS_OR_EQUAL_UINT32(exact / 10 + 1, err);
+        }
+      }
+    }
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_recorded_session_pairs_every_stage);
+  RUN_TEST(test_clicks_and_coasts_outside_their_stage_are_ignored);
+  RUN_TEST(test_superseded_and_timed_out_traces_are_not_published);
+  RUN_TEST(test_percentiles_follow_the_replayed_stage_times);
+  return UNITY_END();
+}
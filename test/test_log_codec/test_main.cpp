@@ -0,0 +1,188 @@
+#include <unity.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <LogCodec.h>
+
+// LogLz round trips through a decoder that follows
+// tools/decode_log_snapshot.py step for step, over one span and over the
+// same text split into two spans at every kind of point (mid-match,
+// mid-literal, at a group boundary). Also the header, match lengths at
+// the nibble edges, matches reaching back the whole window, input that
+// does not compress, and the counting pass agreeing with the sending one.
+
+namespace {
+
+std::vector<uint8_t> out;
+
+void sink(void*, const uint8_t* data, size_t len) { out.insert(out.end(), data, data + len); }
+
+uint32_t u32(const std::vector<uint8_t>& d, size_t at) {
+  return d[at] | d[at + 1] << 8 | d[at + 2] << 16 | static_cast<uint32_t>(d[at + 3]) << 24;
+}
+
+// decode() from tools/decode_log_snapshot.py; false where it raises.
+bool decode(const std::vector<uint8_t>& data, std::string* text, uint32_t* firstSeq, uint32_t* lastSeq) {
+  if (data.size() < 16 || memcmp(data.data(), "LGZ1", 4) != 0) return false;
+  const uint32_t rawLen = u32(data, 4);
+  *firstSeq = u32(data, 8);
+  *lastSeq = u32(data, 12);
+  text->clear();
+  size_t i = 16;
+  while (text->size() < rawLen) {
+    if (i >= data.size()) return false;
+    const uint8_t flags = data[i++];
+    for (int bit = 0; bit < 8 && text->size() < rawLen; ++bit) {
+      if (flags & (1 << bit)) {
+        if (i + 2 > data.size()) return false;
+        const uint8_t b0 = data[i], b1 = data[i + 1];
+        i += 2;
+        const size_t dist = (b0 | (b1 >> 4) << 8) + 1;
+        size_t length = (b1 & 0x0F) + 3;
+        if ((b1 & 0x0F) == 15) {
+          if (i >= data.size()) return false;
+          length += data[i++];
+        }
+        if (dist > text->size()) return false;
+        for (size_t k = 0; k < length; ++k) text->push_back((*text)[text->size() - dist]);
+      } else {
+        if (i >= data.size()) return false;
+        text->push_back(static_cast<char>(data[i++]));
+      }
+    }
+  }
+  return true;
+}
+
+LogLz* lz;
+
+// Header plus stream for a + b, checking the counting pass on the way.
+std::vector<uint8_t> compress(const std::string& a, const std::string& b = std::string(), uint32_t firstSeq = 1,
+                              uint32_t lastSeq = 1) {
+  const size_t counted = lz->encode(a.data(), a.size(), b.data(), b.size(), nullptr, nullptr);
+  out.assign(LogLz::HEADER_BYTES, 0);
+  LogLz::header(out.data(), static_cast<uint32_t>(a.size() + b.size()), firstSeq, lastSeq);
+  const size_t sent = lz->encode(a.data(), a.size(), b.data(), b.size(), sink, nullptr);
+  TEST_ASSERT_EQUAL_UINT32(counted, sent);
+  TEST_ASSERT_EQUAL_UINT32(LogLz::HEADER_BYTES + sent, out.size());
+  return out;
+}
+
+void assertRoundTrip(const std::string& a, const std::string& b = std::string()) {
+  const std::vector<uint8_t> data = compress(a, b);
+  std::string text;
+  uint32_t first, last;
+  TEST_ASSERT_TRUE(decode(data, &text, &first, &last));
+  TEST_ASSERT_TRUE(text == a + b);
+}
+
+// Log-like text: a handful of line formats with changing numbers.
+std::string logText(std::mt19937& rng, size_t bytes) {
+  static const char* const formats[] = {
+      "[CTRL] Commanded motion -> %s\n",
+      "[RELAYS] Action -> %s\n",
+      "[TRACE] #%u wall start: input %u arbitrate %u relays %u motion %u ms\n",
+      "[MQTT] Connected to 192.168.1.10:1883 in %u ms\n",
+      "[CLICK] Run closing: coast %u (predicted %u) in %u ms\n",
+  };
+  static const char* const labels[] = {"Opening", "Closing", "Idle", "PSU spin-up"};
+  std::string s;
+  char line[160];
+  while (s.size() < bytes) {
+    const uint32_t f = rng() % 5;
+    if (f < 2) {
+      snprintf(line, sizeof(line), formats[f], labels[rng() % 4]);
+    } else {
+      snprintf(line, sizeof(line), formats[f], rng() % 3000, rng() % 3000, rng() % 3000, rng() % 3000, rng() % 3000);
+    }
+    s += line;
+  }
+  s.resize(bytes);
+  return s;
+}
+
+}  // namespace
+
+void setUp() {
+  lz = new LogLz();
+  out.clear();
+}
+
+void tearDown() {
+  delete lz;
+}
+
+void test_header_and_empty_input() {
+  const std::vector<uint8_t> data = compress("", "", 17, 42);
+  TEST_ASSERT_EQUAL_UINT32(LogLz::HEADER_BYTES, data.size());
+  TEST_ASSERT_EQUAL_MEMORY("LGZ1", data.data(), 4);
+  TEST_ASSERT_EQUAL_UINT32(0, u32(data, 4));
+  std::string text = "x";
+  uint32_t first = 0, last = 0;
+  TEST_ASSERT_TRUE(decode(data, &text, &first, &last));
+  TEST_ASSERT_EQUAL_UINT32(17, first);
+  TEST_ASSERT_EQUAL_UINT32(42, last);
+  TEST_ASSERT_EQUAL_UINT32(0, text.size());
+}
+
+void test_one_span_round_trips_and_compresses_log_text() {
+  std::mt19937 rng(24);
+  const std::string text = logText(rng, 8000);
+  assertRoundTrip(text);
+  TEST_ASSERT_LESS_THAN_UINT32(text.size() / 3, out.size());
+  assertRoundTrip("a");
+  assertRoundTrip("abc");
+  assertRoundTrip("abcabc");
+}
+
+void test_two_spans_round_trip_at_every_split() {
+  std::mt19937 rng(25);
+  const std::string text = logText(rng, 2000);
+  const std::vector<uint8_t> whole = compress(text);
+  for (size_t split = 0; split <= text.size(); split += 1 + split / 50) {
+    assertRoundTrip(text.substr(0, split), text.substr(split));
+    // Where the text is split makes no difference to the stream.
+    TEST_ASSERT_TRUE(out == whole);
+  }
+}
+
+void test_match_length_and_distance_edges() {
+  // Runs of one byte: lengths around the 15 nibble and the 273 cap.
+  for (size_t len : {1u, 3u, 4u, 17u, 18u, 19u, 273u, 274u, 276u, 600u}) {
+    assertRoundTrip(std::string(len, 'z'));
+  }
+  // A repeat exactly the window back, and one just beyond it.
+  std::mt19937 rng(26);
+  std::string noise;
+  for (int i = 0; i < LogLz::WINDOW + 200; ++i) noise += static_cast<char>('A' + rng() % 26);
+  assertRoundTrip(noise.substr(0, LogLz::WINDOW) + noise.substr(0, 100));
+  assertRoundTrip(noise.substr(0, LogLz::WINDOW + 1) + noise.substr(0, 100));
+}
+
+void test_incompressible_input_grows_by_one_byte_in_eight() {
+  std::mt19937 rng(27);
+  std::string bytes;
+  for (int i = 0; i < 4096; ++i) bytes += static_cast<char>(rng());
+  assertRoundTrip(bytes.substr(0, 1000), bytes.substr(1000));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(LogLz::HEADER_BYTES + 4096 + 4096 / 8 + 1, out.size());
+}
+
+void test_truncated_stream_is_rejected() {
+  std::mt19937 rng(28);
+  std::vector<uint8_t> data = compress(logText(rng, 1000));
+  data.resize(data.size() - 3);
+  std::string text;
+  uint32_t first, last;
+  TEST_ASSERT_FALSE(decode(data, &text, &first, &last));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_header_and_empty_input);
+  RUN_TEST(test_one_span_round_trips_and_compresses_log_text);
+  RUN_TEST(test_two_spans_round_trip_at_every_split);
+  RUN_TEST(test_match_length_and_distance_edges);
+  RUN_TEST(test_incompressible_input_grows_by_one_byte_in_eight);
+  RUN_TEST(test_truncated_stream_is_rejected);
+  return UNITY_END();
+}
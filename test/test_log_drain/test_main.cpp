@@ -0,0 +1,210 @@
+#include <unity.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <LogDrain.h>
+
+// LogDrain's two buffers against a UART that takes bytes at 115200 baud
+// (hostfake::serialTxRoom refilled per pass) and a caller that publishes
+// batches the way pumpLogs() does. Every line is accounted for: it reaches
+// the serial port or is a serial drop, and it goes out in a batch or is a
+// batch drop. Serial text comes out in order and whole, batches are
+// newline-joined within BATCH_BYTES, and idle() only reports true once
+// both buffers are empty.
+
+namespace {
+
+constexpr uint32_t PASS_MS = 10;                 // network pass
+constexpr int UART_BYTES_PER_PASS = 115;         // 115200 8N1: 11.52 B/ms
+
+LogDrain* drain;
+
+struct Published {
+  std::vector<std::string> batches;
+};
+
+std::string line(std::mt19937& rng, uint32_t n) {
+  std::string s = "[T] " + std::to_string(n) + " ";
+  const size_t len = 10 + rng() % 110;
+  while (s.size() < len) s += static_cast<char>('a' + rng() % 26);
+  return s;
+}
+
+void log(const std::string& s, Published* out) {
+  if (!drain->batchFits(s.size())) {
+    out->batches.emplace_back(drain->batch(), drain->batchLen());
+    drain->batchSent();
+  }
+  drain->line(s.c_str(), s.size());
+}
+
+// One pumpLogs() pass with a broker.
+void pump(Published* out) {
+  drain->pumpSerial();
+  if (drain->batchDue(millis())) {
+    out->batches.emplace_back(drain->batch(), drain->batchLen());
+    drain->batchSent();
+  }
+}
+
+uint32_t countLines(const std::vector<std::string>& batches) {
+  uint32_t n = 0;
+  for (const std::string& b : batches) {
+    n += 1;
+    for (char c : b) n += c == '\n';
+  }
+  return n;
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  drain = new LogDrain();
+}
+
+void tearDown() {
+  delete drain;
+}
+
+void test_lines_reach_serial_and_the_batch() {
+  TEST_ASSERT_TRUE(drain->idle());
+  drain->line("one", 3);
+  drain->line("two", 3);
+  TEST_ASSERT_FALSE(drain->idle());
+  TEST_ASSERT_EQUAL_STRING("one\ntwo", drain->batch());
+  TEST_ASSERT_EQUAL_UINT32(7, drain->batchLen());
+  TEST_ASSERT_EQUAL_STRING("two", std::string(drain->lastLine(), drain->lastLineLen()).c_str());
+
+  drain->pumpSerial();
+  TEST_ASSERT_EQUAL_STRING("one\r\ntwo\r\n", hostfake::serialOut.c_str());
+  TEST_ASSERT_FALSE(drain->idle());  // batch still pending
+
+  TEST_ASSERT_FALSE(drain->batchDue(millis()));
+  hostfake::advanceMs(LogDrain::BATCH_INTERVAL_MS - 1);
+  TEST_ASSERT_FALSE(drain->batchDue(millis()));
+  hostfake::advanceMs(1);
+  TEST_ASSERT_TRUE(drain->batchDue(millis()));
+  drain->batchSent();
+  TEST_ASSERT_TRUE(drain->idle());
+  TEST_ASSERT_EQUAL_UINT32(0, drain->batchLen());
+  TEST_ASSERT_EQUAL_UINT32(1, drain->stats().batches);
+  TEST_ASSERT_EQUAL_UINT32(2, drain->stats().maxBatchLines);
+}
+
+void test_full_batch_is_due_early_and_long_lines_are_cut() {
+  const std::string a(200, 'a');
+  drain->line(a.c_str(), a.size());
+  TEST_ASSERT_TRUE(drain->batchFits(54));   // 200 + '\n' + 54 = 255
+  TEST_ASSERT_FALSE(drain->batchFits(55));
+  const std::string b(60, 'b');
+  drain->line(b.c_str(), b.size());         // does not fit: dropped
+  TEST_ASSERT_EQUAL_UINT32(1, drain->stats().batchDrops);
+  TEST_ASSERT_TRUE(drain->batchDue(millis()));
+  drain->batchSent();
+
+  const std::string big(400, 'c');
+  TEST_ASSERT_TRUE(drain->batchFits(big.size()));
+  drain->line(big.c_str(), big.size());
+  TEST_ASSERT_EQUAL_UINT32(LogDrain::BATCH_BYTES, drain->batchLen());
+  TEST_ASSERT_EQUAL_UINT32(LogDrain::BATCH_BYTES, strlen(drain->batch()));
+}
+
+void test_discarded_batches_count_their_lines() {
+  drain->line("a", 1);
+  drain->line("b", 1);
+  drain->line("c", 1);
+  drain->discardBatch();
+  TEST_ASSERT_EQUAL_UINT32(3, drain->stats().batchDrops);
+  TEST_ASSERT_EQUAL_UINT32(0, drain->stats().batches);
+  TEST_ASSERT_FALSE(drain->batchDue(millis() + 1000));
+}
+
+void test_blocked_uart_drops_whole_lines_and_resumes_in_order() {
+  hostfake::serialTxRoom = 0;
+  std::string expected;
+  uint32_t queued = 0;
+  for (uint32_t i = 0; i < 200; ++i) {
+    const std::string s = "line " + std::to_string(i) + " ..............................";
+    const uint32_t dropsBefore = drain->stats().serialDrops;
+    drain->line(s.c_str(), s.size());
+    drain->discardBatch();
+    drain->pumpSerial();
+    if (drain->stats().serialDrops == dropsBefore) {
+      expected += s + "\r\n";
+      ++queued;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, hostfake::serialOut.size());
+  TEST_ASSERT_EQUAL_UINT32(200 - queued, drain->stats().serialDrops);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(LogDrain::SERIAL_BYTES, drain->stats().serialHighWater);
+  TEST_ASSERT_GREATER_THAN_UINT32(LogDrain::SERIAL_BYTES - 40, drain->stats().serialHighWater);
+  TEST_ASSERT_FALSE(drain->idle());
+
+  // The UART frees up a little at a time; the backlog comes out as queued.
+  for (int pass = 0; pass < 100 && !drain->idle(); ++pass) {
+    hostfake::serialTxRoom = 37;
+    drain->pumpSerial();
+  }
+  TEST_ASSERT_TRUE(drain->idle());
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), hostfake::serialOut.c_str());
+
+  // And again across the ring's wrap point.
+  hostfake::serialOut.clear();
+  hostfake::serialTxRoom = -1;
+  for (int i = 0; i < 50; ++i) drain->line("wrapped", 7);
+  drain->discardBatch();
+  drain->pumpSerial();
+  std::string wrapped;
+  for (int i = 0; i < 50; ++i) wrapped += "wrapped\r\n";
+  TEST_ASSERT_EQUAL_STRING(wrapped.c_str(), hostfake::serialOut.c_str());
+}
+
+void test_storm_accounts_for_every_line() {
+  // 10 lines per 5 ms control pass for 2 s, drained every 10 ms; the
+  // broker drops out for the middle half second.
+  std::mt19937 rng(22);
+  Published out;
+  uint32_t n = 0;
+  for (uint32_t ms = 0; ms < 2000; ms += PASS_MS) {
+    hostfake::serialTxRoom = UART_BYTES_PER_PASS;
+    for (int i = 0; i < 20; ++i) log(line(rng, n++), &out);
+    const bool broker = ms < 750 || ms >= 1250;
+    if (broker) {
+      pump(&out);
+    } else {
+      drain->pumpSerial();
+      drain->discardBatch();
+    }
+    hostfake::advanceMs(PASS_MS);
+  }
+  // Let the UART and the last batch finish.
+  for (int pass = 0; pass < 1000 && !drain->idle(); ++pass) {
+    hostfake::serialTxRoom = UART_BYTES_PER_PASS;
+    pump(&out);
+    hostfake::advanceMs(PASS_MS);
+  }
+  TEST_ASSERT_TRUE(drain->idle());
+
+  const LogDrain::Stats& s = drain->stats();
+  TEST_ASSERT_EQUAL_UINT32(n, s.lines);
+  TEST_ASSERT_EQUAL_UINT32(s.batches, out.batches.size());
+  TEST_ASSERT_EQUAL_UINT32(n, countLines(out.batches) + s.batchDrops);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, s.batchDrops);   // the outage
+  TEST_ASSERT_GREATER_THAN_UINT32(0, s.serialDrops);  // the UART cannot keep up
+
+  uint32_t serialLines = 0;
+  for (size_t at = 0; (at = hostfake::serialOut.find("\r\n", at)) != std::string::npos; at += 2) ++serialLines;
+  TEST_ASSERT_EQUAL_UINT32(n, serialLines + s.serialDrops);
+  for (const std::string& b : out.batches) TEST_ASSERT_LESS_OR_EQUAL_UINT32(LogDrain::BATCH_BYTES, b.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_lines_reach_serial_and_the_batch);
+  RUN_TEST(test_full_batch_is_due_early_and_long_lines_are_cut);
+  RUN_TEST(test_discarded_batches_count_their_lines);
+  RUN_TEST(test_blocked_uart_drops_whole_lines_and_resumes_in_order);
+  RUN_TEST(test_storm_accounts_for_every_line);
+  return UNITY_END();
+}
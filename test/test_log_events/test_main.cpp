@@ -0,0 +1,217 @@
+#include <unity.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <Mailbox.h>
+#include <LogEvents.h>
+#include <LogMerge.h>
+
+// LogRecord formats the same text the String-built lines had, within the
+// consumer's buffer. LogMerge over the two log mailboxes, fed the way logLine() and
+// logEvent() feed them: one seq counter across both queues, taken only by
+// a successful push. The merged output must come back in seq order,
+// including when one head lags behind the other, across the 16-bit wrap
+// and with the producer on another thread; a record that never arrives
+// holds the log for MAX_MISSES passes only.
+
+namespace {
+
+struct Rec {
+  uint16_t seq;
+  uint32_t n;  // position in the logged order
+};
+
+Mailbox<Rec, 32>* texts;
+Mailbox<Rec, 64>* events;
+LogMerge* merge;
+uint16_t seq;
+uint32_t logged;
+
+bool log(bool text) {
+  Rec r{seq, logged};
+  const bool ok = text ? texts->push(r) : events->push(r);
+  if (ok) {
+    ++seq;
+    ++logged;
+  }
+  return ok;
+}
+
+// One drainLogs() pass; the records taken, in order, go to out.
+template <typename Out>
+void drain(Out&& out) {
+  for (;;) {
+    const Rec* t = texts->peek();
+    const Rec* e = events->peek();
+    const LogMerge::Take take = merge->next(t ? &t->seq : nullptr, e ? &e->seq : nullptr);
+    if (take == LogMerge::Take::NONE) break;
+    Rec r{};
+    if (take == LogMerge::Take::TEXT) {
+      texts->pop(&r);
+    } else {
+      events->pop(&r);
+    }
+    out(r);
+  }
+}
+
+char line[160];
+
+const char* format(const LogRecord& r, size_t cap = sizeof(line)) {
+  r.format(line, cap);
+  return line;
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  texts = new Mailbox<Rec, 32>();
+  events = new Mailbox<Rec, 64>();
+  merge = new LogMerge();
+  seq = 0;
+  logged = 0;
+}
+
+void tearDown() {
+  delete texts;
+  delete events;
+  delete merge;
+}
+
+void test_records_format_as_the_old_lines() {
+  TEST_ASSERT_EQUAL_STRING("[CTRL] HA desired -> Opening", format(LogRecord(LogId::CTRL_HA_DESIRED, {"Opening"})));
+  TEST_ASSERT_EQUAL_STRING("[CTRL] Commanded motion -> Idle", format(LogRecord(LogId::CTRL_COMMANDED, {"Idle"})));
+  TEST_ASSERT_EQUAL_STRING("[CTRL] Relay state -> Closing", format(LogRecord(LogId::CTRL_RELAY_STATE, {"Closing"})));
+  TEST_ASSERT_EQUAL_STRING("[MODE] -> LOCAL", format(LogRecord(LogId::MODE, {"LOCAL"})));
+  TEST_ASSERT_EQUAL_STRING("[RELAYS] Action -> PSU spin-up", format(LogRecord(LogId::RELAYS_ACTION, {"PSU spin-up"})));
+  TEST_ASSERT_EQUAL_STRING("[CLICK] Motion overshoot detected (pos=-3, end=4000)",
+                           format(LogRecord(LogId::CLICK_OVERSHOOT, {-3, 4000})));
+  const String built = String(F("[CLICK] Motion overshoot detected (pos=")) + 2147483647 + F(", end=") + (-2147483647 - 1) + F(")");
+  TEST_ASSERT_EQUAL_STRING(built.c_str(), format(LogRecord(LogId::CLICK_OVERSHOOT, {2147483647, -2147483647 - 1})));
+}
+
+void test_record_arguments_and_truncation() {
+  hostfake::nowUs = 7000000;
+  const LogRecord r(LogId::CLICK_OVERSHOOT, {1, 2, 3, 4, 5});
+  TEST_ASSERT_EQUAL_UINT32(7000, r.ms);
+  TEST_ASSERT_EQUAL_UINT8(LogRecord::MAX_ARGS, r.argc);
+  // Missing arguments leave their slot empty; a null string prints "?".
+  TEST_ASSERT_EQUAL_STRING("[CLICK] Motion overshoot detected (pos=9, end=)", format(LogRecord(LogId::CLICK_OVERSHOOT, {9})));
+  TEST_ASSERT_EQUAL_STRING("[MODE] -> ?", format(LogRecord(LogId::MODE, {static_cast<const char*>(nullptr)})));
+  // Cut to the buffer, always terminated; the length returned is what was written.
+  const LogRecord m(LogId::CTRL_COMMANDED, {"Opening"});
+  TEST_ASSERT_EQUAL_STRING("[CTRL] Com", format(m, 11));
+  TEST_ASSERT_EQUAL_UINT32(10, m.format(line, 11));
+  TEST_ASSERT_EQUAL_UINT32(0, m.format(line, 0));
+  TEST_ASSERT_EQUAL_STRING("[CTRL] Commanded motion -> Opening", m.toString().c_str());
+}
+
+void test_interleaved_queues_come_back_in_order() {
+  const bool pattern[] = {true, false, false, true, false, true, true, false, false, false};
+  uint32_t next = 0;
+  for (int round = 0; round < 200; ++round) {
+    for (bool text : pattern) TEST_ASSERT_TRUE(log(text));
+    drain([&](const Rec& r) { TEST_ASSERT_EQUAL_UINT32(next++, r.n); });
+  }
+  TEST_ASSERT_EQUAL_UINT32(2000, next);
+  TEST_ASSERT_EQUAL_UINT32(0, merge->skips());
+  TEST_ASSERT_EQUAL_UINT16(2000, merge->expected());
+}
+
+void test_lagging_head_is_waited_for() {
+  // Seq 1 is visible in the text queue before seq 0 lands in the events.
+  Rec late{0, 0};
+  seq = 1;
+  logged = 1;
+  log(true);
+  uint32_t taken = 0;
+  for (uint8_t pass = 0; pass < LogMerge::MAX_MISSES - 1; ++pass) {
+    drain([&](const Rec&) { ++taken; });
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, taken);
+  events->push(late);
+  uint32_t next = 0;
+  drain([&](const Rec& r) { TEST_ASSERT_EQUAL_UINT32(next++, r.n); });
+  TEST_ASSERT_EQUAL_UINT32(2, next);
+  TEST_ASSERT_EQUAL_UINT32(0, merge->skips());
+}
+
+void test_missing_record_stalls_for_max_misses_only() {
+  seq = 1;  // seq 0 never arrives
+  log(false);
+  log(true);
+  uint32_t taken = 0;
+  for (uint8_t pass = 0; pass < LogMerge::MAX_MISSES - 1; ++pass) {
+    drain([&](const Rec&) { ++taken; });
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, taken);
+  uint32_t next = 0;
+  drain([&](const Rec& r) { TEST_ASSERT_EQUAL_UINT32(next++, r.n); });
+  TEST_ASSERT_EQUAL_UINT32(2, next);
+  TEST_ASSERT_EQUAL_UINT32(1, merge->skips());
+  TEST_ASSERT_EQUAL_UINT16(3, merge->expected());
+}
+
+void test_older_head_wins_across_the_seq_wrap() {
+  // Both heads ahead of the expected seq, on either side of 65535.
+  texts->push(Rec{1, 1});
+  events->push(Rec{65535, 0});
+  uint32_t next = 0;
+  for (uint8_t pass = 0; pass < LogMerge::MAX_MISSES; ++pass) {
+    drain([&](const Rec& r) { TEST_ASSERT_EQUAL_UINT32(next++, r.n); });
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, next);  // 65535, then 0 is missing
+  for (uint8_t pass = 0; pass < LogMerge::MAX_MISSES; ++pass) {
+    drain([&](const Rec& r) { TEST_ASSERT_EQUAL_UINT32(next++, r.n); });
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, next);
+  TEST_ASSERT_EQUAL_UINT32(2, merge->skips());
+}
+
+void test_producer_thread_order_survives_drops_and_wrap() {
+  // 200000 records (three wraps of the seq) from a control-side thread
+  // that does not wait for room; the network side drains in passes.
+  constexpr uint32_t RECORDS = 200000;
+  std::atomic<bool> done{false};
+  uint32_t dropped = 0;
+  std::thread control([&] {
+    std::mt19937 rng(21);
+    while (logged < RECORDS) {
+      if (!log(rng() % 3 == 0)) ++dropped;
+      if (rng() % 16 == 0) std::this_thread::yield();
+    }
+    done.store(true);
+  });
+
+  uint32_t next = 0;
+  bool ordered = true;
+  while (!done.load() || !texts->empty() || !events->empty()) {
+    drain([&](const Rec& r) {
+      if (r.n != next) ordered = false;
+      next = r.n + 1;
+    });
+    std::this_thread::yield();
+  }
+  control.join();
+  drain([&](const Rec& r) {
+    if (r.n != next) ordered = false;
+    next = r.n + 1;
+  });
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(RECORDS, next);
+  TEST_ASSERT_EQUAL_UINT32(0, merge->skips());
+  TEST_ASSERT_EQUAL_UINT32(dropped, texts->drops() + events->drops());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_format_as_the_old_lines);
+  RUN_TEST(test_record_arguments_and_truncation);
+  RUN_TEST(test_interleaved_queues_come_back_in_order);
+  RUN_TEST(test_lagging_head_is_waited_for);
+  RUN_TEST(test_missing_record_stalls_for_max_misses_only);
+  RUN_TEST(test_older_head_wins_across_the_seq_wrap);
+  RUN_TEST(test_producer_thread_order_survives_drops_and_wrap);
+  return UNITY_END();
+}
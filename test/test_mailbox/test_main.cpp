@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include <Mailbox.h>
+
+// Mailbox and LatestValue between two real threads, the way the control
+// task hands commands, log lines and snapshots to the network task. The
+// queue must deliver every accepted message once and in order, and count
+// every one it refuses; the latest-value slot must never hand the reader
+// a torn value or one older than the value it already has.
+
+namespace {
+
+constexpr uint32_t MESSAGES = 200000;
+
+struct Snapshot {
+  uint32_t seq;
+  uint32_t body[64];
+  uint32_t check;
+};
+
+void fill(Snapshot* s, uint32_t seq) {
+  s->seq = seq;
+  for (uint32_t& x : s->body) x = seq;
+  s->check = ~seq;
+}
+
+bool whole(const Snapshot& s) {
+  for (uint32_t x : s.body) {
+    if (x != s.seq) return false;
+  }
+  return s.check == ~s.seq;
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_mailbox_is_fifo_and_counts_drops() {
+  Mailbox<uint32_t, 4> q;
+  uint32_t v = 0;
+  TEST_ASSERT_TRUE(q.empty());
+  TEST_ASSERT_NULL(q.peek());
+  TEST_ASSERT_FALSE(q.pop(&v));
+  for (uint32_t i = 0; i < 4; ++i) TEST_ASSERT_TRUE(q.push(i));
+  TEST_ASSERT_FALSE(q.push(99));
+  TEST_ASSERT_EQUAL_UINT32(1, q.drops());
+  TEST_ASSERT_EQUAL_UINT32(4, q.highWater());
+  TEST_ASSERT_EQUAL_UINT32(0, *q.peek());
+  for (uint32_t i = 0; i < 4; ++i) {
+    TEST_ASSERT_TRUE(q.pop(&v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+  TEST_ASSERT_TRUE(q.empty());
+  // Indices keep counting past the slot count.
+  for (uint32_t i = 0; i < 10; ++i) {
+    TEST_ASSERT_TRUE(q.push(i));
+    TEST_ASSERT_TRUE(q.pop(&v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, q.highWater());
+}
+
+void test_mailbox_hands_over_every_message_in_order() {
+  static Mailbox<uint32_t, 16> q;
+  std::atomic<bool> stop{false};
+  std::thread producer([&stop] {
+    for (uint32_t i = 0; i < MESSAGES && !stop;) {
+      if (q.push(i)) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint32_t next = 0;
+  uint32_t outOfOrder = 0;
+  uint32_t idle = 0;
+  while (next < MESSAGES && idle < 1000000) {
+    uint32_t v;
+    if (!q.pop(&v)) {
+      ++idle;
+      std::this_thread::yield();
+      continue;
+    }
+    if (v != next) ++outOfOrder;
+    next = v + 1;
+    idle = 0;
+  }
+  stop = true;
+  producer.join();
+  TEST_ASSERT_EQUAL_UINT32(MESSAGES, next);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_TRUE(q.empty());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(16, q.highWater());
+}
+
+void test_mailbox_drops_are_counted_not_lost() {
+  // A producer that never waits, like logLine() on the control task.
+  static Mailbox<Snapshot, 8> q;
+  std::atomic<bool> done{false};
+  std::thread producer([&done] {
+    Snapshot s;
+    for (uint32_t i = 1; i <= MESSAGES; ++i) {
+      fill(&s, i);
+      q.push(s);
+      if ((i & 31) == 0) std::this_thread::yield();
+    }
+    done = true;
+  });
+  uint32_t received = 0;
+  uint32_t last = 0;
+  uint32_t bad = 0;
+  Snapshot s;
+  for (;;) {
+    const bool finished = done;
+    if (q.pop(&s)) {
+      ++received;
+      if (s.seq <= last || !whole(s)) ++bad;
+      last = s.seq;
+    } else if (finished) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, bad);
+  TEST_ASSERT_EQUAL_UINT32(MESSAGES, received + q.drops());
+}
+
+void test_latest_value_keeps_only_the_newest() {
+  LatestValue<Snapshot> lv;
+  TEST_ASSERT_FALSE(lv.fetch());
+  for (uint32_t i = 1; i <= 3; ++i) {
+    fill(&lv.back(), i);
+    lv.publish();
+  }
+  TEST_ASSERT_TRUE(lv.fetch());
+  TEST_ASSERT_EQUAL_UINT32(3, lv.front().seq);
+  TEST_ASSERT_FALSE(lv.fetch());
+  TEST_ASSERT_EQUAL_UINT32(3, lv.front().seq);
+  fill(&lv.back(), 4);
+  lv.publish();
+  TEST_ASSERT_TRUE(lv.fetch());
+  TEST_ASSERT_TRUE(whole(lv.front()));
+  TEST_ASSERT_EQUAL_UINT32(4, lv.front().seq);
+  // The writer's next value, half filled, is not what a fetch sees.
+  fill(&lv.back(), 5);
+  lv.publish();
+  lv.back().seq = 6;
+  TEST_ASSERT_TRUE(lv.fetch());
+  TEST_ASSERT_TRUE(whole(lv.front()));
+  TEST_ASSERT_EQUAL_UINT32(5, lv.front().seq);
+}
+
+void test_latest_value_is_never_torn_or_stale() {
+  static LatestValue<Snapshot> lv;
+  std::atomic<bool> done{false};
+  std::thread writer([&done] {
+    for (uint32_t i = 1; i <= MESSAGES; ++i) {
+      fill(&lv.back(), i);
+      lv.publish();
+      if ((i & 63) == 0) std::this_thread::yield();
+    }
+    done = true;
+  });
+  uint32_t reads = 0;
+  uint32_t torn = 0;
+  uint32_t backwards = 0;
+  uint32_t last = 0;
+  for (;;) {
+    const bool finished = done;
+    if (lv.fetch()) {
+      const Snapshot& s = lv.front();
+      if (!whole(s)) ++torn;
+      if (s.seq <= last) ++backwards;
+      last = s.seq;
+      ++reads;
+    } else if (finished) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  writer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, backwards);
+  TEST_ASSERT_EQUAL_UINT32(MESSAGES, last);
+  TEST_ASSERT_GREATER_THAN_UINT32(1, reads);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_mailbox_is_fifo_and_counts_drops);
+  RUN_TEST(test_mailbox_hands_over_every_message_in_order);
+  RUN_TEST(test_mailbox_drops_are_counted_not_lost);
+  RUN_TEST(test_latest_value_keeps_only_the_newest);
+  RUN_TEST(test_latest_value_is_never_torn_or_stale);
+  return UNITY_END();
+}
@@ -0,0 +1,242 @@
+#include <unity.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <MqttConnector.h>
+
+// MqttConnector against real host sockets: a loopback port nobody listens
+// on (refused), a listener whose accept queue is full (SYNs dropped, the
+// handshake never completes), a TEST-NET address that nothing routes to
+// and a listener that answers.
+// poll() is timed on the wall clock and must never wait; the attempt time
+// it is given is simulated, so timeouts and backoff run on the test's
+// schedule. Failure reasons, backoff doubling up to the cap, equal jitter
+// and the duration buckets are checked against the documented values.
+
+namespace {
+
+constexpr uint32_t POLL_BUDGET_US = 2000;   // one poll(), generously
+constexpr uint32_t STEP_MS = 10;            // netStep period
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t worstPollUs = 0;
+
+int listener(int backlog, uint16_t* port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+  listen(fd, backlog);
+  socklen_t len = sizeof(a);
+  getsockname(fd, reinterpret_cast<sockaddr*>(&a), &len);
+  *port = ntohs(a.sin_port);
+  return fd;
+}
+
+uint16_t closedPort() {
+  uint16_t port;
+  close(listener(1, &port));
+  return port;
+}
+
+MqttConnector::Poll timedPoll(MqttConnector& c, uint32_t nowMs) {
+  const Clock::time_point t0 = Clock::now();
+  MqttConnector::Poll p = c.poll(nowMs);
+  const uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+  if (us > worstPollUs) worstPollUs = us;
+  return p;
+}
+
+// Polls once per simulated step until the attempt settles or `untilMs`.
+MqttConnector::Poll pollUntil(MqttConnector& c, uint32_t* nowMs, uint32_t untilMs) {
+  MqttConnector::Poll p = MqttConnector::Poll::PENDING;
+  while (p == MqttConnector::Poll::PENDING && *nowMs <= untilMs) {
+    p = timedPoll(c, *nowMs);
+    if (p == MqttConnector::Poll::PENDING) {
+      usleep(200);  // give loopback a moment to answer
+      *nowMs += STEP_MS;
+    }
+  }
+  return p;
+}
+
+uint32_t failures(const MqttConnector& c, MqttConnector::Failure f) {
+  return c.stats().failures[static_cast<uint8_t>(f)];
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  worstPollUs = 0;
+}
+
+void tearDown() {}
+
+void test_refused_port_fails_fast_and_backs_off() {
+  MqttConnector c;
+  uint32_t now = 1000;
+  TEST_ASSERT_TRUE(c.due(now));
+  const uint16_t port = closedPort();
+  if (c.begin(htonl(INADDR_LOOPBACK), port, now)) {
+    TEST_ASSERT_TRUE(c.pending());
+    TEST_ASSERT_EQUAL(MqttConnector::Poll::FAILED, pollUntil(c, &now, 1000 + 500));
+  }
+  TEST_ASSERT_FALSE(c.pending());
+  TEST_ASSERT_EQUAL(MqttConnector::Failure::TCP_REFUSED, c.lastFailure());
+  TEST_ASSERT_EQUAL_UINT32(1, failures(c, MqttConnector::Failure::TCP_REFUSED));
+  TEST_ASSERT_EQUAL_UINT32(1, c.stats().attempts);
+  TEST_ASSERT_EQUAL_UINT32(0, c.stats().connects);
+  TEST_ASSERT_EQUAL_UINT32(MqttConnector::BACKOFF_MIN_MS, c.backoffMs());
+  TEST_ASSERT_FALSE(c.due(now));
+  TEST_ASSERT_UINT32_WITHIN(MqttConnector::BACKOFF_MIN_MS / 4, MqttConnector::BACKOFF_MIN_MS * 3 / 4, c.retryInMs(now));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_BUDGET_US, worstPollUs);
+}
+
+void test_backoff_doubles_to_the_cap_with_equal_jitter() {
+  MqttConnector c;
+  const uint16_t port = closedPort();
+  uint32_t now = 5000;
+  uint32_t expected = MqttConnector::BACKOFF_MIN_MS;
+  for (int i = 0; i < 10; ++i) {
+    while (!c.due(now)) now += STEP_MS;
+    if (c.begin(htonl(INADDR_LOOPBACK), port, now)) pollUntil(c, &now, now + 500);
+    TEST_ASSERT_FALSE(c.pending());
+    TEST_ASSERT_EQUAL_UINT32(expected, c.backoffMs());
+    // Half fixed, half random.
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(expected / 2, c.retryInMs(now));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(expected, c.retryInMs(now));
+    expected = expected < MqttConnector::BACKOFF_MAX_MS / 2 ? expected * 2 : MqttConnector::BACKOFF_MAX_MS;
+  }
+  TEST_ASSERT_EQUAL_UINT32(MqttConnector::BACKOFF_MAX_MS, c.backoffMs());
+  TEST_ASSERT_EQUAL_UINT32(10, c.stats().attempts);
+  TEST_ASSERT_EQUAL_UINT32(10, failures(c, MqttConnector::Failure::TCP_REFUSED));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_BUDGET_US, worstPollUs);
+
+  // A dropped session retries at the minimum again; so does a network
+  // that came back, and without waiting.
+  c.fail(MqttConnector::Failure::LOST, now);
+  TEST_ASSERT_EQUAL_UINT32(MqttConnector::BACKOFF_MIN_MS, c.backoffMs());
+  c.fail(MqttConnector::Failure::DNS, now);
+  TEST_ASSERT_EQUAL_UINT32(2 * MqttConnector::BACKOFF_MIN_MS, c.backoffMs());
+  c.resetBackoff(now);
+  TEST_ASSERT_TRUE(c.due(now));
+  TEST_ASSERT_EQUAL_UINT32(1, failures(c, MqttConnector::Failure::LOST));
+  TEST_ASSERT_EQUAL_UINT32(1, failures(c, MqttConnector::Failure::DNS));
+}
+
+void test_jitter_spreads_a_fleet() {
+  // Devices failing at the same instant retry across the jitter window.
+  uint32_t lo = UINT32_MAX, hi = 0;
+  for (int unit = 0; unit < 64; ++unit) {
+    MqttConnector c;
+    c.fail(MqttConnector::Failure::TCP_TIMEOUT, 0);
+    c.fail(MqttConnector::Failure::TCP_TIMEOUT, 0);
+    c.fail(MqttConnector::Failure::TCP_TIMEOUT, 0);  // 4 s backoff
+    const uint32_t r = c.retryInMs(0);
+    lo = r < lo ? r : lo;
+    hi = r > hi ? r : hi;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2000, lo);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(4000, hi);
+  TEST_ASSERT_GREATER_THAN_UINT32(1500, hi - lo);
+}
+
+void test_dropped_syns_time_out_without_blocking() {
+  // Backlog 0 and one connection already queued: further SYNs are dropped.
+  uint16_t port;
+  const int lfd = listener(0, &port);
+  int fillers[4];
+  for (int& f : fillers) {
+    f = socket(AF_INET, SOCK_STREAM, 0);
+    fcntl(f, F_SETFL, O_NONBLOCK);
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(f, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+  }
+  usleep(50000);
+
+  MqttConnector c;
+  uint32_t now = 1000;
+  TEST_ASSERT_TRUE(c.begin(htonl(INADDR_LOOPBACK), port, now));
+  TEST_ASSERT_EQUAL(MqttConnector::Poll::PENDING, pollUntil(c, &now, 1000 + MqttConnector::TCP_TIMEOUT_MS - STEP_MS));
+  TEST_ASSERT_TRUE(c.pending());
+  TEST_ASSERT_EQUAL(MqttConnector::Poll::FAILED, pollUntil(c, &now, 1000 + MqttConnector::TCP_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_UINT32(1000 + MqttConnector::TCP_TIMEOUT_MS, now);
+  TEST_ASSERT_EQUAL(MqttConnector::Failure::TCP_TIMEOUT, c.lastFailure());
+  TEST_ASSERT_EQUAL_UINT32(1, failures(c, MqttConnector::Failure::TCP_TIMEOUT));
+  TEST_ASSERT_EQUAL_UINT32(MqttConnector::BACKOFF_MIN_MS, c.backoffMs());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_BUDGET_US, worstPollUs);
+
+  for (int f : fillers) close(f);
+  close(lfd);
+}
+
+void test_unroutable_address_never_blocks() {
+  // 192.0.2.1 (TEST-NET-1): depending on the host's network there is no
+  // route (a socket error at once), a filtering gateway answers with a RST
+  // (refused) or the SYN goes nowhere and the attempt times out. Which one
+  // is up to the host; that it is one failure and no wait is not.
+  MqttConnector c;
+  uint32_t now = 1000;
+  if (c.begin(inet_addr("192.0.2.1"), 1883, now)) {
+    MqttConnector::Poll p = pollUntil(c, &now, 1000 + MqttConnector::TCP_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL(MqttConnector::Poll::FAILED, p);
+  }
+  TEST_ASSERT_FALSE(c.pending());
+  const uint32_t timeouts = failures(c, MqttConnector::Failure::TCP_TIMEOUT);
+  const uint32_t errors = failures(c, MqttConnector::Failure::TCP_ERROR) +
+                          failures(c, MqttConnector::Failure::TCP_REFUSED);
+  TEST_ASSERT_EQUAL_UINT32(1, timeouts + errors);
+  if (timeouts) TEST_ASSERT_EQUAL_UINT32(1000 + MqttConnector::TCP_TIMEOUT_MS, now);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_BUDGET_US, worstPollUs);
+  TEST_ASSERT_FALSE(c.due(now));
+}
+
+void test_listening_broker_connects_and_fills_duration_buckets() {
+  uint16_t port;
+  const int lfd = listener(4, &port);
+  MqttConnector c;
+  uint32_t now = 1000;
+  c.fail(MqttConnector::Failure::TCP_REFUSED, now);
+  c.resetBackoff(now);
+  TEST_ASSERT_TRUE(c.begin(htonl(INADDR_LOOPBACK), port, now));
+  TEST_ASSERT_EQUAL(MqttConnector::Poll::READY, pollUntil(c, &now, 1000 + 500));
+  const int fd = c.takeSocket();
+  TEST_ASSERT_TRUE(fd >= 0);
+  TEST_ASSERT_FALSE(c.pending());
+  TEST_ASSERT_EQUAL_INT(0, fcntl(fd, F_GETFL, 0) & O_NONBLOCK);  // handed over blocking
+  close(fd);
+  c.succeeded(1000 + 30);
+  TEST_ASSERT_EQUAL_UINT32(0, c.backoffMs());
+  TEST_ASSERT_EQUAL_UINT32(1, c.stats().connects);
+  TEST_ASSERT_EQUAL_UINT32(30, c.stats().lastConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(1, c.stats().durations[1]);  // (25, 50]
+
+  // Bucket edges are inclusive upper bounds; the last is open.
+  const uint32_t durations[] = {25, 26, 2500, 2501, 60000};
+  const uint8_t buckets[] = {0, 1, 6, 7, 7};
+  for (uint8_t i = 0; i < 5; ++i) {
+    MqttConnector d;
+    TEST_ASSERT_TRUE(d.begin(htonl(INADDR_LOOPBACK), port, 0));
+    d.succeeded(durations[i]);
+    TEST_ASSERT_EQUAL_UINT32(1, d.stats().durations[buckets[i]]);
+    TEST_ASSERT_EQUAL_UINT32(durations[i], d.stats().maxConnectMs);
+  }
+  close(lfd);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_BUDGET_US, worstPollUs);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_refused_port_fails_fast_and_backs_off);
+  RUN_TEST(test_backoff_doubles_to_the_cap_with_equal_jitter);
+  RUN_TEST(test_jitter_spreads_a_fleet);
+  RUN_TEST(test_dropped_syns_time_out_without_blocking);
+  RUN_TEST(test_unroutable_address_never_blocks);
+  RUN_TEST(test_listening_broker_connects_and_fills_duration_buckets);
+  return UNITY_END();
+}
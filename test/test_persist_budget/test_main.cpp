@@ -0,0 +1,142 @@
+#include <unity.h>
+#include <memory>
+#include "ClickRig.h"
+
+// Write-behind position journal: while the motor runs a record is written
+// once CLICK_COUNTER_PERSIST_CLICK_BUDGET clicks or
+// CLICK_COUNTER_PERSIST_INTERVAL_MS have piled up, and stopping always
+// commits. Counted as writes landing on the poslog partition (or puts to
+// the pos_N NVS slots without it).
+
+namespace {
+
+constexpr uint32_t CLICK_BUDGET = CLICK_COUNTER_PERSIST_CLICK_BUDGET;
+constexpr uint32_t INTERVAL_MS = CLICK_COUNTER_PERSIST_INTERVAL_MS;
+
+std::unique_ptr<ClickCounter> counter;
+
+void boot() {
+  hostfake::reboot(ESP_RST_POWERON);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+}
+
+uint32_t flashWrites() {
+  auto it = hostfake::partitions.find("poslog");
+  return it == hostfake::partitions.end() ? hostfake::nvsWritesTo("pos_") : it->second.writes;
+}
+
+// Runs `clicks` clicks and checks after each one that neither budget was
+// overrun since the last write. Returns the writes made during the run.
+uint32_t runChecked(MotionState dir, uint32_t clicks, uint32_t periodUs) {
+  counter->setMotion(dir);
+  spin(*counter, 10000);
+  const uint32_t before = flashWrites();
+  uint32_t lastWrites = before;
+  uint32_t clicksSinceWrite = 0;
+  unsigned long lastWriteMs = millis();
+  for (uint32_t i = 0; i < clicks; ++i) {
+    click(*counter, periodUs);
+    spin(*counter, 10000);
+    ++clicksSinceWrite;
+    if (flashWrites() != lastWrites) {
+      lastWrites = flashWrites();
+      clicksSinceWrite = 0;
+      lastWriteMs = millis();
+    }
+    TEST_ASSERT_LESS_THAN_UINT32(CLICK_BUDGET, clicksSinceWrite);
+    // One loop pass plus one click of slack: the budget is checked on events.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(INTERVAL_MS + 10 + periodUs / 1000,
+                                     millis() - lastWriteMs);
+  }
+  return flashWrites() - before;
+}
+
+uint32_t stop() {
+  const uint32_t before = flashWrites();
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);  // past the coast tail window
+  return flashWrites() - before;
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  hostfake::addPartition(CLICK_COUNTER_POS_LOG_PARTITION, 16 * 4096);
+  seedEnd(5000);
+  boot();
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_fast_run_is_bounded_by_click_budget() {
+  // 25 clicks/s: the click budget runs out long before the interval.
+  const uint32_t clicks = 1000;
+  uint32_t writes = runChecked(MotionState::CLOSING, clicks, 40000);
+  TEST_ASSERT_UINT32_WITHIN(1, clicks / CLICK_BUDGET, writes);
+  TEST_ASSERT_EQUAL_UINT32(clicks, counter->position());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(clicks - writes - 1,
+                                      counter->persistStats().writesAvoided);
+}
+
+void test_slow_run_is_bounded_by_interval() {
+  // 2 clicks/s: the interval expires after 4-5 clicks, well under 16.
+  const uint32_t clicks = 60;
+  const uint32_t periodUs = 500000;
+  uint32_t writes = runChecked(MotionState::CLOSING, clicks, periodUs);
+  const uint32_t runMs = clicks * (periodUs / 1000 + 10);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(runMs / INTERVAL_MS + 1, writes);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(runMs / (INTERVAL_MS + periodUs / 1000), writes);
+}
+
+void test_stop_commits_pending_clicks() {
+  runChecked(MotionState::CLOSING, CLICK_BUDGET + 5, 40000);
+  TEST_ASSERT_EQUAL_UINT32(1, stop());
+  const int32_t pos = counter->position();
+
+  boot();
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(pos, counter->position());
+}
+
+void test_stop_without_pending_clicks_writes_once() {
+  runChecked(MotionState::OPENING, 0, 40000);
+  // Nothing moved, but the stop still commits (and the tail stays quiet).
+  TEST_ASSERT_EQUAL_UINT32(1, stop());
+}
+
+void test_zero_click_budget_writes_through() {
+  counter->setPersistBudget(0, INTERVAL_MS);
+  const uint32_t clicks = 40;
+  uint32_t writes = runChecked(MotionState::CLOSING, clicks, 40000);
+  TEST_ASSERT_EQUAL_UINT32(clicks, writes);
+}
+
+void test_nvs_fallback_uses_the_same_budget() {
+  hostfake::reset();
+  seedEnd(5000);
+  boot();
+  TEST_ASSERT_FALSE(counter->posLogActive());
+  const uint32_t clicks = 320;
+  uint32_t writes = runChecked(MotionState::CLOSING, clicks, 40000);
+  TEST_ASSERT_UINT32_WITHIN(1, clicks / CLICK_BUDGET, writes);
+  TEST_ASSERT_EQUAL_UINT32(1, stop());
+
+  const int32_t pos = counter->position();
+  boot();
+  TEST_ASSERT_EQUAL_INT32(pos, counter->position());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fast_run_is_bounded_by_click_budget);
+  RUN_TEST(test_slow_run_is_bounded_by_interval);
+  RUN_TEST(test_stop_commits_pending_clicks);
+  RUN_TEST(test_stop_without_pending_clicks_writes_once);
+  RUN_TEST(test_zero_click_budget_writes_through);
+  RUN_TEST(test_nvs_fallback_uses_the_same_budget);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include <unity.h>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include "ClickRig.h"
+#include "PositionTarget.h"
+
+// Drive-to-position against a motor model, through the same calls main.cpp
+// makes: start(), shouldStop() with the counter's stop lead each pass,
+// stopped() when the relays drop, settle() once the run summary is in. The
+// motor keeps clicking for a speed-dependent coast after the stop (relay
+// release included); once the coast is learned every move must land within
+// a click of its target, against the full coast for a naive stop.
+
+namespace {
+
+constexpr int32_t END = 400;
+constexpr uint32_t LATENCY_MS = 20;       // main.cpp POSITION_STOP_LATENCY_MS
+constexpr uint32_t COAST_CLICK_US = 20000;
+constexpr int LEARN_RUNS = CoastModel::MIN_RUNS;  // per direction
+
+struct Motor {
+  uint32_t periodUs;
+  int coastClicks;
+};
+
+std::unique_ptr<ClickCounter> counter;
+PositionTarget goTo;
+uint32_t serial = 0;
+std::mt19937 rng(9);
+
+// One set_position move; returns the landing error in clicks.
+int32_t move(const Motor& m, int32_t target, bool predictive = true) {
+  const int32_t from = counter->position();
+  goTo.start(target, from, ++serial);
+  const MotionState dir = goTo.direction();
+  counter->setMotion(dir);
+  spin(*counter, 10000);
+  auto lead = [&] { return predictive ? counter->stopLeadClicks(dir, LATENCY_MS) : 0.0f; };
+  while (!goTo.shouldStop(counter->position(), lead())) click(*counter, m.periodUs);
+
+  goTo.stopped(counter->lastRun().seq);
+  counter->setMotion(MotionState::IDLE);
+  for (int i = 0; i < m.coastClicks; ++i) click(*counter, COAST_CLICK_US);
+  spin(*counter, 2000000);  // past the tail window: the run summary is in
+
+  TEST_ASSERT_TRUE(goTo.settle(counter->lastRun().seq, counter->lastRun().finalPos));
+  TEST_ASSERT_EQUAL_INT32(target, counter->lastRun().finalPos - goTo.stats().lastError);
+  return goTo.stats().lastError;
+}
+
+int32_t randomTarget() {
+  const int32_t pos = counter->position();
+  int32_t target;
+  do {
+    target = std::uniform_int_distribution<int32_t>(20, END - 20)(rng);
+  } while (std::abs(target - pos) < 12);
+  return target;
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  seedEnd(END);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+  goTo = PositionTarget();
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_lands_within_a_click_once_coast_is_learned() {
+  const Motor motors[] = {{40000, 3}, {80000, 2}, {125000, 1}};
+  for (const Motor& m : motors) {
+    setUp();
+    move(m, END / 2);
+    for (int i = 0; i < LEARN_RUNS; ++i) {
+      move(m, counter->position() + 40);
+      move(m, counter->position() - 40);
+    }
+    const PositionTarget::Stats learning = goTo.stats();
+
+    uint32_t worst = 0;
+    const int moves = 30;
+    for (int i = 0; i < moves; ++i) {
+      const uint32_t err = static_cast<uint32_t>(std::abs(move(m, randomTarget())));
+      if (err > worst) worst = err;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, worst);
+    const uint32_t sum = goTo.stats().sumAbsError - learning.sumAbsError;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(moves, sum);
+    if (m.coastClicks > 1) TEST_ASSERT_LESS_THAN_UINT32(moves * m.coastClicks / 2, sum);
+    TEST_ASSERT_EQUAL_UINT32(1 + 2 * LEARN_RUNS + moves, goTo.stats().moves);
+    tearDown();
+  }
+}
+
+void test_naive_stop_overshoots_by_the_coast() {
+  const Motor m = {40000, 3};
+  for (int i = 0; i < 10; ++i) {
+    const int32_t target = randomTarget();
+    const int32_t err = move(m, target, false);
+    TEST_ASSERT_EQUAL_INT32(goTo.direction() == MotionState::CLOSING ? m.coastClicks : -m.coastClicks,
+                            err);
+  }
+}
+
+void test_cancel_and_stale_runs_are_not_settled() {
+  goTo.start(100, 0, 1);
+  TEST_ASSERT_TRUE(goTo.active());
+  goTo.cancel();
+  TEST_ASSERT_FALSE(goTo.active());
+  TEST_ASSERT_EQUAL_UINT32(1, goTo.stats().cancelled);
+  TEST_ASSERT_FALSE(goTo.settle(5, 100));
+
+  // The summary of the run before the stop must not count as the landing.
+  goTo.start(100, 0, 2);
+  goTo.stopped(7);
+  TEST_ASSERT_FALSE(goTo.settle(7, 90));
+  TEST_ASSERT_TRUE(goTo.settle(8, 101));
+  TEST_ASSERT_EQUAL_INT32(1, goTo.stats().lastError);
+  TEST_ASSERT_FALSE(goTo.settle(9, 50));
+}
+
+void test_should_stop_follows_direction_and_lead() {
+  goTo.start(100, 50, 1);
+  TEST_ASSERT_EQUAL(MotionState::CLOSING, goTo.direction());
+  TEST_ASSERT_FALSE(goTo.shouldStop(97, 2.0f));
+  TEST_ASSERT_TRUE(goTo.shouldStop(98, 2.0f));
+
+  goTo.start(100, 150, 2);
+  TEST_ASSERT_EQUAL(MotionState::OPENING, goTo.direction());
+  TEST_ASSERT_FALSE(goTo.shouldStop(103, 2.0f));
+  TEST_ASSERT_TRUE(goTo.shouldStop(102, 2.0f));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_lands_within_a_click_once_coast_is_learned);
+  RUN_TEST(test_naive_stop_overshoots_by_the_coast);
+  RUN_TEST(test_cancel_and_stale_runs_are_not_settled);
+  RUN_TEST(test_should_stop_follows_direction_and_lead);
+  return UNITY_END();
+}
@@ -0,0 +1,213 @@
+#include <unity.h>
+#include <memory>
+#include "ClickRig.h"
+#include "Crc32.h"
+#include "FlashDevice.h"
+#include "PosLog.h"
+
+// Position log on a RAM flash: torn and failed writes, sector wrap, and the
+// one-time migration of the legacy pos_N NVS slots.
+
+namespace {
+
+constexpr size_t SECTORS = 3;
+constexpr size_t SLOTS = 4096 / 16;
+
+using Flash = RamFlashDevice<SECTORS>;
+
+// Fails one chosen write call, landing only its first `landed` bytes.
+class FlakyFlash : public Flash {
+public:
+  void failWrite(int nth, size_t landed) {
+    _failIn = nth;
+    _landed = landed;
+  }
+
+  bool write(size_t offset, const void* src, size_t len) override {
+    if (_failIn > 0 && --_failIn == 0) {
+      Flash::write(offset, src, _landed < len ? _landed : len);
+      return false;
+    }
+    return Flash::write(offset, src, len);
+  }
+
+private:
+  int _failIn = 0;
+  size_t _landed = 0;
+};
+
+std::unique_ptr<FlakyFlash> flash;
+
+PosLog::Record rec(uint32_t epoch) {
+  PosLog::Record r;
+  r.epoch = epoch;
+  r.pos = static_cast<int32_t>(epoch * 3) - 100;
+  r.level = epoch & 1;
+  return r;
+}
+
+// Appends epochs [from, to] and checks every append succeeded.
+void fill(PosLog& log, uint32_t from, uint32_t to) {
+  for (uint32_t e = from; e <= to; ++e) TEST_ASSERT_TRUE(log.append(rec(e)));
+}
+
+// A fresh PosLog on the same flash, as after a reboot.
+uint32_t newestAfterBoot() {
+  PosLog log;
+  TEST_ASSERT_TRUE(log.begin(flash.get()));
+  if (!log.hasRecord()) return 0;
+  TEST_ASSERT_EQUAL_INT32(rec(log.newest().epoch).pos, log.newest().pos);
+  return log.newest().epoch;
+}
+
+std::unique_ptr<ClickCounter> counter;
+
+void bootCounter() {
+  hostfake::reboot(ESP_RST_POWERON);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+}
+
+void putLegacySlot(uint8_t slot, const void* rec, size_t len) {
+  Preferences prefs;
+  prefs.begin("poolcover", false);
+  char key[12];
+  snprintf(key, sizeof(key), "pos_%u", slot);
+  prefs.putBytes(key, rec, len);
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  flash.reset(new FlakyFlash());
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_empty_flash_has_no_record() {
+  PosLog log;
+  TEST_ASSERT_TRUE(log.begin(flash.get()));
+  TEST_ASSERT_FALSE(log.hasRecord());
+  TEST_ASSERT_TRUE(log.append(rec(1)));
+  TEST_ASSERT_EQUAL_UINT32(1, log.stats().erases);
+  TEST_ASSERT_EQUAL_UINT32(1, newestAfterBoot());
+}
+
+void test_torn_write_at_every_byte_keeps_previous_record() {
+  for (long cut = 0; cut < 16; ++cut) {
+    flash.reset(new FlakyFlash());
+    PosLog log;
+    TEST_ASSERT_TRUE(log.begin(flash.get()));
+    fill(log, 1, 20);
+    // Power dies partway into record 21.
+    flash->failAfterBytes(cut);
+    TEST_ASSERT_FALSE(log.append(rec(21)));
+    flash->failAfterBytes(-1);
+
+    PosLog booted;
+    TEST_ASSERT_TRUE(booted.begin(flash.get()));
+    TEST_ASSERT_EQUAL_UINT32(20, booted.newest().epoch);
+    TEST_ASSERT_EQUAL_UINT32(cut ? 1 : 0, booted.stats().tornSkipped);
+    // Logging resumes after the torn slot and the next boot sees it.
+    fill(booted, 21, 30);
+    TEST_ASSERT_EQUAL_UINT32(30, newestAfterBoot());
+  }
+}
+
+void test_failed_write_leaves_no_hole() {
+  // Nothing landed, or part of the record: either way the retry must not
+  // leave an erased slot in front of later records. The failure hits slot
+  // SLOTS / 2, the first one the boot-time binary search probes.
+  const size_t landed[] = {0, 7};
+  for (size_t l : landed) {
+    flash.reset(new FlakyFlash());
+    PosLog log;
+    TEST_ASSERT_TRUE(log.begin(flash.get()));
+    fill(log, 1, SLOTS / 2);
+    flash->failWrite(1, l);
+    TEST_ASSERT_TRUE(log.append(rec(SLOTS / 2 + 1)));
+    TEST_ASSERT_EQUAL_UINT32(1, log.stats().writeFailures);
+    fill(log, SLOTS / 2 + 2, SLOTS - 10);
+    TEST_ASSERT_EQUAL_UINT32(SLOTS - 10, newestAfterBoot());
+  }
+}
+
+void test_failed_slot_zero_moves_to_next_sector() {
+  PosLog log;
+  TEST_ASSERT_TRUE(log.begin(flash.get()));
+  fill(log, 1, SLOTS);
+  // First write into sector 1 tears; sector 1 has no valid head record.
+  flash->failWrite(1, 5);
+  TEST_ASSERT_TRUE(log.append(rec(SLOTS + 1)));
+  fill(log, SLOTS + 2, SLOTS + 20);
+  TEST_ASSERT_EQUAL_UINT32(SLOTS + 20, newestAfterBoot());
+}
+
+void test_wraps_over_oldest_sector() {
+  PosLog log;
+  TEST_ASSERT_TRUE(log.begin(flash.get()));
+  const uint32_t total = SLOTS * SECTORS * 2 + 17;
+  fill(log, 1, total);
+  TEST_ASSERT_EQUAL_UINT32(total, newestAfterBoot());
+
+  PosLog booted;
+  TEST_ASSERT_TRUE(booted.begin(flash.get()));
+  // One slot-0 read per sector plus the binary search and the tail check.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SECTORS + 10, booted.stats().bootReads);
+}
+
+void test_legacy_slots_migrate_once() {
+  hostfake::addPartition(CLICK_COUNTER_POS_LOG_PARTITION, 4 * 4096);
+  seedEnd(500);
+
+  // Same layouts as ClickCounter::PosRecV0/V1.
+  struct V0 { uint32_t epoch; int32_t pos; uint32_t crc32; };
+  struct V1 { uint32_t epoch; int32_t pos; uint8_t level; uint8_t reserved[3]; uint32_t crc32; };
+  auto crcV1 = [](uint32_t epoch, int32_t pos, uint8_t level) {
+    uint8_t buf[9];
+    memcpy(buf, &epoch, 4);
+    memcpy(buf + 4, &pos, 4);
+    buf[8] = level;
+    return crc32Ieee(buf, sizeof(buf));
+  };
+  auto crcV0 = [](uint32_t epoch, int32_t pos) {
+    uint8_t buf[8];
+    memcpy(buf, &epoch, 4);
+    memcpy(buf + 4, &pos, 4);
+    return crc32Ieee(buf, sizeof(buf));
+  };
+  V0 old = {41, 120, crcV0(41, 120)};
+  V1 newest = {42, 123, 1, {0, 0, 0}, crcV1(42, 123, 1)};
+  V1 corrupt = {43, 999, 0, {0, 0, 0}, 0};
+  putLegacySlot(1, &old, sizeof(old));
+  putLegacySlot(2, &newest, sizeof(newest));
+  putLegacySlot(3, &corrupt, sizeof(corrupt));
+
+  bootCounter();
+  TEST_ASSERT_TRUE(counter->posLogActive());
+  TEST_ASSERT_EQUAL_INT32(123, counter->position());
+  TEST_ASSERT_TRUE(hostfake::serialOut.find("[POSLOG] Migrated") != std::string::npos);
+  TEST_ASSERT_EQUAL_UINT32(0, hostfake::nvs["poolcover"].count("pos_1") +
+                              hostfake::nvs["poolcover"].count("pos_2") +
+                              hostfake::nvs["poolcover"].count("pos_3"));
+
+  // Second boot reads the log; nothing left to migrate.
+  hostfake::serialOut.clear();
+  bootCounter();
+  TEST_ASSERT_EQUAL_INT32(123, counter->position());
+  TEST_ASSERT_TRUE(hostfake::serialOut.find("Migrated") == std::string::npos);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_flash_has_no_record);
+  RUN_TEST(test_torn_write_at_every_byte_keeps_previous_record);
+  RUN_TEST(test_failed_write_leaves_no_hole);
+  RUN_TEST(test_failed_slot_zero_moves_to_next_sector);
+  RUN_TEST(test_wraps_over_oldest_sector);
+  RUN_TEST(test_legacy_slots_migrate_once);
+  return UNITY_END();
+}
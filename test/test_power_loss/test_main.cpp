@@ -0,0 +1,156 @@
+#include <unity.h>
+#include <memory>
+#include <random>
+#include "ClickRig.h"
+
+// Power-loss injection on the position log. The supply is cut at random
+// moments (mid-write, mid-erase, between records) and the next power-on
+// boot must find a position no older than the last completed commit. A
+// power-fail flush inside the hold-up window must always land, which
+// needs the next sector erased before the current one fills up.
+
+namespace {
+
+constexpr uint32_t HOLD_UP_US = 20000;   // main.cpp POWER_FAIL_FLUSH_BUDGET_US
+constexpr uint32_t CLICK_US = 40000;
+constexpr size_t LOG_BYTES = 2 * 4096;   // smallest log: wraps often
+
+std::unique_ptr<ClickCounter> counter;
+std::mt19937 rng(12345);
+
+hostfake::Partition& part() {
+  return hostfake::partitions[CLICK_COUNTER_POS_LOG_PARTITION];
+}
+
+void boot() {
+  hostfake::reboot(ESP_RST_POWERON);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+}
+
+void stop() {
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+}
+
+// Random run lengths with stops, so the log cursor lands anywhere in a
+// sector when the interesting part starts.
+void wander(int runs) {
+  for (int r = 0; r < runs; ++r) {
+    MotionState dir = counter->position() > 250 ? MotionState::OPENING : MotionState::CLOSING;
+    counter->setMotion(dir);
+    spin(*counter, 10000);
+    int clicks = std::uniform_int_distribution<int>(1, 120)(rng);
+    for (int i = 0; i < clicks; ++i) click(*counter, CLICK_US);
+    stop();
+  }
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  hostfake::addPartition(CLICK_COUNTER_POS_LOG_PARTITION, LOG_BYTES);
+  seedEnd(500);
+  boot();
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_emergency_flush_never_erases() {
+  // Write-through makes every click a record, so sectors roll over fast.
+  counter->setPersistBudget(0, CLICK_COUNTER_PERSIST_INTERVAL_MS);
+  MotionState dir = MotionState::CLOSING;
+  counter->setMotion(dir);
+  spin(*counter, 10000);
+  for (int i = 0; i < 1500; ++i) {
+    click(*counter, 10000);
+    spin(*counter, 1000);  // count the click on the loop, like the firmware
+    const uint32_t erases = part().erases;
+    const uint64_t started = hostfake::nowUs;
+    counter->emergencyFlush();
+    TEST_ASSERT_EQUAL_UINT32(erases, part().erases);
+    TEST_ASSERT_LESS_THAN_UINT32(HOLD_UP_US, hostfake::nowUs - started);
+    TEST_ASSERT_EQUAL_UINT32(0, counter->posLogStats().eraseBlocked);
+    const int32_t pos = counter->position();
+    if ((dir == MotionState::CLOSING && pos >= 490) ||
+        (dir == MotionState::OPENING && pos <= 10)) {
+      stop();
+      dir = (dir == MotionState::CLOSING) ? MotionState::OPENING : MotionState::CLOSING;
+      counter->setMotion(dir);
+      spin(*counter, 10000);
+    }
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(4, part().erases);
+}
+
+void test_power_fail_flush_lands_within_hold_up() {
+  for (int trial = 0; trial < 300; ++trial) {
+    wander(3);
+    counter->setMotion(MotionState::CLOSING);
+    spin(*counter, 10000);
+    int clicks = std::uniform_int_distribution<int>(0, 40)(rng);
+    for (int i = 0; i < clicks; ++i) click(*counter, CLICK_US);
+    spin(*counter, 1000);
+
+    // Rail trips: relays drop, the flush gets the hold-up time, then the
+    // supply is gone.
+    const int32_t live = counter->position();
+    hostfake::cutPowerAt(CLICK_COUNTER_POS_LOG_PARTITION, hostfake::nowUs + HOLD_UP_US);
+    counter->setMotion(MotionState::IDLE);
+    counter->emergencyFlush();
+    hostfake::advanceUs(HOLD_UP_US);
+
+    boot();
+    TEST_ASSERT_EQUAL_INT32(live, counter->position());
+  }
+}
+
+void test_random_cuts_never_lose_committed_clicks() {
+  for (int trial = 0; trial < 300; ++trial) {
+    wander(2);
+    counter->setMotion(MotionState::CLOSING);
+    spin(*counter, 10000);
+    const int32_t startPos = counter->position();
+
+    // Cut anywhere in the next 80 clicks, including inside erases.
+    const uint64_t cutAt = hostfake::nowUs +
+        std::uniform_int_distribution<uint64_t>(0, 80ULL * CLICK_US)(rng);
+    hostfake::cutPowerAt(CLICK_COUNTER_POS_LOG_PARTITION, cutAt);
+    int32_t committed = startPos;
+    uint32_t writes = counter->persistStats().writes;
+    while (hostfake::nowUs < cutAt && counter->position() < 495) {
+      click(*counter, CLICK_US);
+      if (counter->persistStats().writes != writes && !part().powerLost) {
+        writes = counter->persistStats().writes;
+        committed = counter->position();
+      }
+    }
+    const int32_t live = counter->position();
+
+    boot();
+    const int32_t restored = counter->position();
+    TEST_ASSERT_GREATER_OR_EQUAL_INT32(committed, restored);
+    TEST_ASSERT_LESS_OR_EQUAL_INT32(live, restored);
+    TEST_ASSERT_LESS_OR_EQUAL_INT32(CLICK_COUNTER_PERSIST_CLICK_BUDGET, live - restored);
+
+    // The log keeps working after the torn write.
+    counter->setMotion(MotionState::OPENING);
+    spin(*counter, 10000);
+    for (int i = 0; i < 20 && counter->position() > 5; ++i) click(*counter, CLICK_US);
+    stop();
+    const int32_t pos = counter->position();
+    boot();
+    TEST_ASSERT_EQUAL_INT32(pos, counter->position());
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_emergency_flush_never_erases);
+  RUN_TEST(test_power_fail_flush_lands_within_hold_up);
+  RUN_TEST(test_random_cuts_never_lose_committed_clicks);
+  return UNITY_END();
+}
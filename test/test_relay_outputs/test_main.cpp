@@ -0,0 +1,158 @@
+#include <unity.h>
+#include <memory>
+#include <random>
+#include "RelayRig.h"
+
+// Relay output safety, checked on every GPIO register write the recorder
+// sees: every state-to-state switch of RelayOutputs, then 200000 fuzzed
+// steps of the sequencer (requests, panics, loop passes and stalls, with
+// and without the one-shot). FWD and REV are never energised together, no
+// transition closes a contact before the ones opening have opened or takes
+// more than two writes, a direction never closes within the dead-time of
+// the other opening, and the enable only closes behind an armed direction.
+
+namespace {
+
+constexpr uint32_t DEAD_MS = 1000;
+constexpr uint32_t SPIN_MS = 2000;
+constexpr uint32_t ENABLE_MS = 200;     // RelaysModule::_enableDelayMs
+constexpr int FUZZ_STEPS = 200000;
+
+StatusStore store;
+std::unique_ptr<RelaysModule> relays;
+
+void assertClean() {
+  TEST_ASSERT_EQUAL_UINT32(0, relayrig::violations.interlock);
+  TEST_ASSERT_EQUAL_UINT32(0, relayrig::violations.makeBeforeBreak);
+  TEST_ASSERT_EQUAL_UINT32(0, relayrig::violations.skew);
+}
+
+// Contacts that are closed now closed far enough after the others opened.
+void assertSequenced() {
+  const uint8_t on = relayrig::energised();
+  const int64_t dead = static_cast<int64_t>(DEAD_MS) * 1000;
+  if (on & RelayOutputs::FWD) {
+    const int64_t rev = relayrig::switchedAt(RelayOutputs::REV);
+    if (rev) TEST_ASSERT_GREATER_OR_EQUAL_INT64(rev + dead, relayrig::switchedAt(RelayOutputs::FWD));
+  }
+  if (on & RelayOutputs::REV) {
+    const int64_t fwd = relayrig::switchedAt(RelayOutputs::FWD);
+    if (fwd) TEST_ASSERT_GREATER_OR_EQUAL_INT64(fwd + dead, relayrig::switchedAt(RelayOutputs::REV));
+  }
+  if (on & RelayOutputs::EN) {
+    const uint8_t dir = on & (RelayOutputs::FWD | RelayOutputs::REV);
+    TEST_ASSERT_TRUE(dir == RelayOutputs::FWD || dir == RelayOutputs::REV);
+    TEST_ASSERT_TRUE(on & RelayOutputs::PSU);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT64(relayrig::switchedAt(dir) + ENABLE_MS * 1000,
+                                       relayrig::switchedAt(RelayOutputs::EN));
+  }
+}
+
+void fuzz(bool timer, bool activeLow, uint32_t seed) {
+  hostfake::reset();
+  relayrig::reset(timer, activeLow);
+  relays.reset(new RelaysModule(store));
+  relays->begin(activeLow, DEAD_MS, SPIN_MS);
+  relayrig::endTransition();
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> action(0, 7);
+  std::uniform_int_distribution<int> motion(0, 2);
+  std::uniform_int_distribution<uint32_t> gapUs(0, 400000);
+  for (int i = 0; i < FUZZ_STEPS; ++i) {
+    switch (action(rng)) {
+      case 0:
+      case 1:
+        relays->request(static_cast<MotionState>(motion(rng)));
+        break;
+      case 2:
+        relays->emergencyPanicOff("fuzz", true);
+        break;
+      case 3:
+        relayrig::advanceTo(hostfake::nowUs + gapUs(rng) * 8);  // loop blocked
+        break;
+      default:
+        relayrig::advanceTo(hostfake::nowUs + gapUs(rng));
+        relays->update();
+        break;
+    }
+    relayrig::endTransition();
+    assertSequenced();
+  }
+  assertClean();
+  // Enough runs reached the enable to mean something.
+  TEST_ASSERT_GREATER_THAN_UINT32(FUZZ_STEPS / 200, relays->stats().timing[RelaysModule::T_ENABLE].count);
+  TEST_ASSERT_GREATER_THAN_UINT32(FUZZ_STEPS / 8, relayrig::transitions);
+  TEST_ASSERT_EQUAL_UINT32(0, relays->stats().interlockTrips);
+  relays.reset();
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  relayrig::reset();
+}
+
+void tearDown() {
+  relays.reset();
+}
+
+void test_every_switch_is_two_writes_break_before_make() {
+  const bool polarities[] = {true, false};
+  for (bool activeLow : polarities) {
+    for (uint8_t from = 0; from < 16; ++from) {
+      for (uint8_t to = 0; to < 16; ++to) {
+        relayrig::reset(true, activeLow);
+        RelayOutputs out;
+        out.begin(activeLow);
+        relayrig::endTransition();
+        out.write(from);
+        relayrig::endTransition();
+        const uint32_t before = relayrig::registerWrites;
+        out.write(to);
+        relayrig::endTransition();
+
+        TEST_ASSERT_EQUAL_UINT8(out.state(), relayrig::energised());
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(2, relayrig::registerWrites - before);
+        assertClean();
+      }
+    }
+  }
+}
+
+void test_fwd_and_rev_together_trip_the_interlock() {
+  RelayOutputs out;
+  out.begin(true);
+  relayrig::endTransition();
+  TEST_ASSERT_TRUE(out.write(RelayOutputs::PSU | RelayOutputs::FWD | RelayOutputs::EN));
+  relayrig::endTransition();
+  TEST_ASSERT_FALSE(out.write(RelayOutputs::PSU | RelayOutputs::FWD | RelayOutputs::REV | RelayOutputs::EN));
+  relayrig::endTransition();
+  TEST_ASSERT_EQUAL_UINT8(RelayOutputs::PSU, out.state());
+  TEST_ASSERT_EQUAL_UINT8(RelayOutputs::PSU, relayrig::energised());
+  TEST_ASSERT_EQUAL_UINT32(1, out.interlockTrips());
+  assertClean();
+}
+
+void test_fuzzed_sequencer_with_timer() {
+  fuzz(true, true, 7);
+}
+
+void test_fuzzed_sequencer_loop_only() {
+  fuzz(false, true, 8);
+}
+
+void test_fuzzed_sequencer_active_high() {
+  fuzz(true, false, 9);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_switch_is_two_writes_break_before_make);
+  RUN_TEST(test_fwd_and_rev_together_trip_the_interlock);
+  RUN_TEST(test_fuzzed_sequencer_with_timer);
+  RUN_TEST(test_fuzzed_sequencer_loop_only);
+  RUN_TEST(test_fuzzed_sequencer_active_high);
+  return UNITY_END();
+}
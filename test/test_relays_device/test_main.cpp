@@ -0,0 +1,128 @@
+// RelaysModule built as on the device: with ARDUINO defined it runs on
+// esp_timer (clock and one-shot) and drives the relays through the GPIO
+// set/clear registers, here served by the esp_timer.h and soc/gpio_struct.h
+// shims. The other suites use the host hooks, so this is the one that
+// exercises the firmware's own timer path.
+#define ARDUINO 10812
+
+#include <unity.h>
+#include <memory>
+#include <RelaysModule.h>
+
+namespace {
+
+constexpr uint32_t DEAD_MS = 1000;
+constexpr uint32_t SPIN_MS = 2000;
+constexpr uint32_t ENABLE_MS = 200;     // RelaysModule::_enableDelayMs
+
+StatusStore store;
+std::unique_ptr<RelaysModule> relays;
+
+// Active-low outputs: energised is low.
+bool on(uint8_t pin) { return hostfake::pinOutput[pin] == 0; }
+
+hostfake::OneShotTimer* relayTimer() {
+  for (hostfake::OneShotTimer& t : hostfake::timers) {
+    if (t.created && t.name && !strcmp(t.name, "relays")) return &t;
+  }
+  return nullptr;
+}
+
+void runTo(uint64_t us) {
+  hostfake::runTimersUntil(us);
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  relays.reset(new RelaysModule(store));
+  relays->begin(true, DEAD_MS, SPIN_MS);
+}
+
+void tearDown() {
+  relays.reset();
+}
+
+void test_sequence_runs_on_the_esp_timer() {
+  TEST_ASSERT_NOT_NULL(relayTimer());
+  TEST_ASSERT_FALSE(on(PIN_RELAY_PSU));
+  const uint64_t t0 = hostfake::nowUs;
+  relays->request(MotionState::OPENING);
+  TEST_ASSERT_TRUE(on(PIN_RELAY_PSU));
+  TEST_ASSERT_TRUE(relayTimer()->armed);
+  TEST_ASSERT_EQUAL_UINT32(t0 + SPIN_MS * 1000ULL, relayTimer()->deadlineUs);
+
+  runTo(t0 + SPIN_MS * 1000ULL - 1);
+  TEST_ASSERT_FALSE(on(PIN_RELAY_FWD));
+  runTo(t0 + SPIN_MS * 1000ULL);
+  TEST_ASSERT_TRUE(on(PIN_RELAY_FWD));
+  TEST_ASSERT_FALSE(on(PIN_RELAY_EN));
+  runTo(t0 + (SPIN_MS + ENABLE_MS) * 1000ULL);
+  TEST_ASSERT_TRUE(on(PIN_RELAY_EN));
+  TEST_ASSERT_FALSE(on(PIN_RELAY_REV));
+  TEST_ASSERT_EQUAL(MotionState::OPENING, relays->current());
+
+  // Reverse: everything but the PSU opens at once, REV after the dead-time.
+  const uint64_t t1 = hostfake::nowUs;
+  relays->request(MotionState::CLOSING);
+  TEST_ASSERT_FALSE(on(PIN_RELAY_FWD));
+  TEST_ASSERT_FALSE(on(PIN_RELAY_EN));
+  TEST_ASSERT_TRUE(on(PIN_RELAY_PSU));
+  runTo(t1 + (DEAD_MS + ENABLE_MS) * 1000ULL);
+  TEST_ASSERT_TRUE(on(PIN_RELAY_REV));
+  TEST_ASSERT_TRUE(on(PIN_RELAY_EN));
+  relays->update();
+  TEST_ASSERT_EQUAL(MotionState::CLOSING, relays->current());
+
+  const RelaysModule::Stats s = relays->stats();
+  TEST_ASSERT_EQUAL_UINT32(4, s.timerFires);
+  TEST_ASSERT_EQUAL_UINT32(0, s.loopFires);
+  TEST_ASSERT_EQUAL_UINT32(4, relayTimer()->fires);
+  for (uint8_t t = 0; t < RelaysModule::TRANSITIONS; ++t) {
+    TEST_ASSERT_EQUAL_UINT32(0, s.timing[t].maxLateUs);
+  }
+  // At most one set/clear pair per relay change.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * s.outputWrites, hostfake::gpioOutWrites);
+}
+
+void test_panic_disarms_and_teardown_deletes_the_timer() {
+  relays->request(MotionState::CLOSING);
+  TEST_ASSERT_TRUE(relayTimer()->armed);
+  relays->emergencyPanicOff("test", true);
+  TEST_ASSERT_FALSE(relayTimer()->armed);
+  TEST_ASSERT_FALSE(on(PIN_RELAY_PSU));
+  runTo(hostfake::nowUs + 120000000ULL);
+  TEST_ASSERT_EQUAL_UINT32(0, relayTimer()->fires);
+
+  relays.reset();
+  TEST_ASSERT_NULL(relayTimer());
+}
+
+void test_without_a_timer_the_loop_sequences() {
+  relays.reset();
+  hostfake::reset();
+  hostfake::timerCreateFails = true;
+  relays.reset(new RelaysModule(store));
+  relays->begin(true, DEAD_MS, SPIN_MS);
+  TEST_ASSERT_NULL(relayTimer());
+
+  const uint64_t t0 = hostfake::nowUs;
+  relays->request(MotionState::OPENING);
+  while (hostfake::nowUs < t0 + (SPIN_MS + ENABLE_MS + 20) * 1000ULL) {
+    runTo(hostfake::nowUs + 5000);
+    relays->update();
+  }
+  TEST_ASSERT_TRUE(on(PIN_RELAY_FWD));
+  TEST_ASSERT_TRUE(on(PIN_RELAY_EN));
+  TEST_ASSERT_EQUAL_UINT32(2, relays->stats().loopFires);
+  TEST_ASSERT_EQUAL_UINT32(0, relays->stats().timerFires);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sequence_runs_on_the_esp_timer);
+  RUN_TEST(test_panic_disarms_and_teardown_deletes_the_timer);
+  RUN_TEST(test_without_a_timer_the_loop_sequences);
+  return UNITY_END();
+}
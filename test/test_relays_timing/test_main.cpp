@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <memory>
+#include "RelayRig.h"
+
+// RelaysModule timing replayed on a simulated clock: spin-up, arming,
+// reversal dead-time and PSU hold must switch when due while the control
+// loop is blocked for longer than the whole sequence, and keep doing so
+// when the clock runs through the point where a 32-bit millis() wraps.
+// Without the one-shot the loop applies overdue transitions: late, but
+// never early.
+
+namespace {
+
+constexpr uint32_t DEAD_MS = 1000;
+constexpr uint32_t SPIN_MS = 2000;
+constexpr uint32_t ENABLE_MS = 200;     // RelaysModule::_enableDelayMs
+constexpr uint32_t HOLD_MS = 60000;     // RelaysModule::_psuHoldMs
+constexpr uint32_t LOOP_US = 5000;
+constexpr uint64_t MILLIS_WRAP_US = 4294967296ULL * 1000ULL;
+
+StatusStore store;
+std::unique_ptr<RelaysModule> relays;
+
+void start(bool timer, uint64_t clockUs = 1000000) {
+  hostfake::reset();
+  hostfake::nowUs = clockUs;
+  relayrig::reset(timer);
+  relays.reset(new RelaysModule(store));
+  relays->begin(true, DEAD_MS, SPIN_MS);
+}
+
+int64_t at(uint8_t relay) { return relayrig::switchedAt(relay); }
+int64_t ms(uint32_t v) { return static_cast<int64_t>(v) * 1000; }
+int64_t now() { return static_cast<int64_t>(hostfake::nowUs); }
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {
+  relays.reset();
+}
+
+void test_transitions_on_time_through_a_stretched_loop() {
+  start(true);
+  const int64_t t0 = now();
+  relays->request(MotionState::OPENING);
+  relays->update();
+  relayrig::stall(1500);   // blocked across the end of spin-up
+  relayrig::loopFor(*relays, 5);
+  relayrig::stall(900);    // and across arming
+  relayrig::loopFor(*relays, 100);
+
+  TEST_ASSERT_EQUAL_INT64(t0, at(RelayOutputs::PSU));
+  TEST_ASSERT_EQUAL_INT64(t0 + ms(SPIN_MS), at(RelayOutputs::FWD));
+  TEST_ASSERT_EQUAL_INT64(t0 + ms(SPIN_MS + ENABLE_MS), at(RelayOutputs::EN));
+  TEST_ASSERT_EQUAL(MotionState::OPENING, relays->current());
+
+  const int64_t t1 = now();
+  relays->request(MotionState::CLOSING);
+  TEST_ASSERT_EQUAL_INT64(t1, at(RelayOutputs::EN));
+  TEST_ASSERT_EQUAL_INT64(t1, at(RelayOutputs::FWD));
+  relayrig::stall(1300);   // through dead-time and arming
+  relayrig::loopFor(*relays, 50);
+  TEST_ASSERT_EQUAL_INT64(t1 + ms(DEAD_MS), at(RelayOutputs::REV));
+  TEST_ASSERT_EQUAL_INT64(t1 + ms(DEAD_MS + ENABLE_MS), at(RelayOutputs::EN));
+  TEST_ASSERT_EQUAL(MotionState::CLOSING, relays->current());
+
+  const RelaysModule::Stats s = relays->stats();
+  TEST_ASSERT_EQUAL_UINT32(4, s.timerFires);
+  TEST_ASSERT_EQUAL_UINT32(0, s.loopFires);
+  TEST_ASSERT_EQUAL_UINT32(ms(SPIN_MS), s.timing[RelaysModule::T_SPIN_UP].lastActualUs);
+  for (uint8_t t = 0; t < RelaysModule::TRANSITIONS; ++t) {
+    TEST_ASSERT_EQUAL_UINT32(0, s.timing[t].maxLateUs);
+  }
+}
+
+void test_deadlines_hold_across_millis_rollover() {
+  start(true, MILLIS_WRAP_US - 500000);
+  const unsigned long millisBefore = millis();
+  const int64_t t0 = now();
+  relays->request(MotionState::CLOSING);
+  relayrig::loopFor(*relays, SPIN_MS + ENABLE_MS + 100);
+  TEST_ASSERT_LESS_THAN_UINT32(millisBefore, millis());  // wrapped meanwhile
+  TEST_ASSERT_EQUAL_INT64(t0 + ms(SPIN_MS), at(RelayOutputs::REV));
+  TEST_ASSERT_EQUAL_INT64(t0 + ms(SPIN_MS + ENABLE_MS), at(RelayOutputs::EN));
+
+  // Stop, then reverse 300 ms later from PSU hold: the dead-time counts
+  // from the stop, not from the new request.
+  const int64_t t2 = now();
+  relays->request(MotionState::IDLE);
+  relayrig::loopFor(*relays, 300);
+  relays->request(MotionState::OPENING);
+  relayrig::loopFor(*relays, 1500);
+  TEST_ASSERT_EQUAL_INT64(t2 + ms(DEAD_MS), at(RelayOutputs::FWD));
+  TEST_ASSERT_EQUAL_INT64(t2 + ms(DEAD_MS + ENABLE_MS), at(RelayOutputs::EN));
+
+  const int64_t t3 = now();
+  relays->request(MotionState::IDLE);
+  relayrig::stall(HOLD_MS + 1000);
+  relayrig::loopFor(*relays, 10);
+  TEST_ASSERT_EQUAL_INT64(t3 + ms(HOLD_MS), at(RelayOutputs::PSU));
+  TEST_ASSERT_EQUAL(RelaysModule::Phase::OFF, relays->phase());
+  TEST_ASSERT_EQUAL_UINT8(0, relayrig::energised());
+  TEST_ASSERT_EQUAL_UINT32(0, relays->stats().loopFires);
+}
+
+void test_loop_only_is_late_but_never_early() {
+  // Steady loop: each transition within one pass of its deadline.
+  start(false);
+  TEST_ASSERT_NULL(relayrig::timer.fn);
+  int64_t t0 = now();
+  relays->request(MotionState::OPENING);
+  relayrig::loopFor(*relays, SPIN_MS + ENABLE_MS + 100, LOOP_US);
+  TEST_ASSERT_INT64_WITHIN(LOOP_US, t0 + ms(SPIN_MS) + LOOP_US / 2, at(RelayOutputs::FWD));
+  TEST_ASSERT_GREATER_OR_EQUAL_INT64(t0 + ms(SPIN_MS + ENABLE_MS), at(RelayOutputs::EN));
+  TEST_ASSERT_LESS_OR_EQUAL_INT64(t0 + ms(SPIN_MS + ENABLE_MS) + 2 * LOOP_US, at(RelayOutputs::EN));
+
+  // Stretched loop: the blocked time is added, the dead-time is not cut.
+  start(false);
+  t0 = now();
+  relays->request(MotionState::OPENING);
+  relayrig::stall(1500);
+  relayrig::loopFor(*relays, 600, LOOP_US);
+  relayrig::stall(900);
+  relayrig::loopFor(*relays, 100, LOOP_US);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT64(t0 + ms(SPIN_MS), at(RelayOutputs::FWD));
+  TEST_ASSERT_GREATER_OR_EQUAL_INT64(t0 + ms(SPIN_MS + ENABLE_MS), at(RelayOutputs::EN));
+  TEST_ASSERT_EQUAL(MotionState::OPENING, relays->current());
+
+  const int64_t t1 = now();
+  relays->request(MotionState::CLOSING);
+  relayrig::stall(400);
+  relayrig::loopFor(*relays, 2000, LOOP_US);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT64(t1 + ms(DEAD_MS), at(RelayOutputs::REV));
+  TEST_ASSERT_EQUAL(MotionState::CLOSING, relays->current());
+
+  const RelaysModule::Stats s = relays->stats();
+  TEST_ASSERT_EQUAL_UINT32(0, s.timerFires);
+  TEST_ASSERT_EQUAL_UINT32(4, s.loopFires);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ms(600), s.timing[RelaysModule::T_ENABLE].maxLateUs);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_transitions_on_time_through_a_stretched_loop);
+  RUN_TEST(test_deadlines_hold_across_millis_rollover);
+  RUN_TEST(test_loop_only_is_late_but_never_early);
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <unity.h>
+#include <cstddef>
+#include <memory>
+#include "ClickRig.h"
+#include "Crc32.h"
+
+// Boot-time restore from the RTC mirror: warm resets (software, panic and
+// the watchdogs) take the live position from RTC memory, everything else
+// (power-on, brownout, ...) and a damaged block fall back to the flash log.
+
+namespace {
+
+constexpr int32_t PERSISTED = 20;  // committed by a stop
+constexpr int32_t LIVE = 25;       // 5 more clicks still in RAM
+
+ClickCounter::RtcBlock rtcMem;
+std::unique_ptr<ClickCounter> counter;
+
+void boot(esp_reset_reason_t reason) {
+  hostfake::reboot(reason);
+  counter.reset(new ClickCounter());
+  counter->setRtcBlock(&rtcMem);
+  counter->begin(PIN_CLICK_IN, false);
+}
+
+void drive(MotionState dir, int clicks) {
+  counter->setMotion(dir);
+  spin(*counter, 10000);
+  for (int i = 0; i < clicks; ++i) click(*counter, 40000);
+  spin(*counter, 10000);  // drain the last edge
+}
+
+uint32_t flashWrites() {
+  return hostfake::partitions[CLICK_COUNTER_POS_LOG_PARTITION].writes;
+}
+
+void resealRtc() {
+  rtcMem.crc32 = crc32Ieee(&rtcMem, offsetof(ClickCounter::RtcBlock, crc32));
+}
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+  hostfake::addPartition(CLICK_COUNTER_POS_LOG_PARTITION, 4 * 4096);
+  seedEnd(500);
+  memset(&rtcMem, 0xA5, sizeof(rtcMem));  // power-on garbage
+
+  boot(ESP_RST_POWERON);
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  drive(MotionState::CLOSING, PERSISTED);
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+  drive(MotionState::CLOSING, LIVE - PERSISTED);
+  TEST_ASSERT_EQUAL_INT32(LIVE, counter->position());
+  TEST_ASSERT_EQUAL_UINT8(1, rtcMem.unpersisted);
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_warm_resets_restore_from_rtc() {
+  const esp_reset_reason_t warm[] = {
+    ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT,
+  };
+  const ClickCounter::RtcBlock staged = rtcMem;
+  for (esp_reset_reason_t reason : warm) {
+    rtcMem = staged;
+    boot(reason);
+    TEST_ASSERT_TRUE(counter->restoredFromRtc());
+    TEST_ASSERT_EQUAL_INT32(LIVE, counter->position());
+    TEST_ASSERT_EQUAL_INT32(500, counter->end());
+  }
+  // The unpersisted clicks were committed at boot: a later power cut keeps them.
+  boot(ESP_RST_POWERON);
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(LIVE, counter->position());
+}
+
+void test_cold_resets_use_the_log() {
+  const esp_reset_reason_t cold[] = {
+    ESP_RST_POWERON, ESP_RST_BROWNOUT, ESP_RST_EXT, ESP_RST_DEEPSLEEP, ESP_RST_UNKNOWN,
+  };
+  const ClickCounter::RtcBlock staged = rtcMem;
+  for (esp_reset_reason_t reason : cold) {
+    rtcMem = staged;
+    boot(reason);
+    TEST_ASSERT_FALSE(counter->restoredFromRtc());
+    TEST_ASSERT_EQUAL_INT32(PERSISTED, counter->position());
+  }
+}
+
+void test_crc_mismatch_falls_back_to_log() {
+  rtcMem.pos += 1;
+  boot(ESP_RST_PANIC);
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(PERSISTED, counter->position());
+}
+
+void test_bad_magic_or_range_falls_back_to_log() {
+  const ClickCounter::RtcBlock staged = rtcMem;
+  rtcMem.magic ^= 1;
+  resealRtc();
+  boot(ESP_RST_SW);
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(PERSISTED, counter->position());
+
+  rtcMem = staged;
+  rtcMem.pos = 100000;
+  resealRtc();
+  boot(ESP_RST_SW);
+  TEST_ASSERT_FALSE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(PERSISTED, counter->position());
+}
+
+void test_clean_warm_boot_does_not_touch_flash() {
+  counter->setMotion(MotionState::IDLE);
+  spin(*counter, 2000000);
+  TEST_ASSERT_EQUAL_UINT8(0, rtcMem.unpersisted);
+  const uint32_t before = flashWrites();
+  boot(ESP_RST_TASK_WDT);
+  TEST_ASSERT_TRUE(counter->restoredFromRtc());
+  TEST_ASSERT_EQUAL_INT32(LIVE, counter->position());
+  TEST_ASSERT_EQUAL_UINT32(before, flashWrites());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_warm_resets_restore_from_rtc);
+  RUN_TEST(test_cold_resets_use_the_log);
+  RUN_TEST(test_crc_mismatch_falls_back_to_log);
+  RUN_TEST(test_bad_magic_or_range_falls_back_to_log);
+  RUN_TEST(test_clean_warm_boot_does_not_touch_flash);
+  return UNITY_END();
+}
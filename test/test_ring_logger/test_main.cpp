@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <deque>
+#include <random>
+#include <string>
+#include <RingLogger.h>
+
+// RingLogger against a deque-of-lines model: after every append the two
+// spans hold exactly the newest whole lines that fit (at most MAX_LINES),
+// with the sequence numbers of the lines kept. viewFrom() pages through
+// the ring by sequence number within a byte budget and the pages add up
+// to view(), whatever the ring's wrap point.
+
+namespace {
+
+constexpr size_t N = 512;
+
+struct Model {
+  std::deque<std::string> lines;  // newline included
+  size_t bytes = 0;
+  uint32_t appends = 0;
+
+  void append(std::string line) {
+    if (!line.empty() && line.back() == '\n') line.pop_back();
+    if (line.size() > N - 1) line.resize(N - 1);
+    line += '\n';
+    while (!lines.empty() && (N - bytes < line.size() || lines.size() == RingLogger<N>::MAX_LINES)) {
+      bytes -= lines.front().size();
+      lines.pop_front();
+    }
+    bytes += line.size();
+    lines.push_back(line);
+    ++appends;
+  }
+
+  std::string text(size_t from = 0, size_t to = SIZE_MAX) const {
+    std::string s;
+    for (size_t i = from; i < lines.size() && i < to; ++i) s += lines[i];
+    return s;
+  }
+};
+
+RingLogger<N>* ring;
+Model model;
+
+std::string text(const LogSpans& v) {
+  std::string s(v.first ? v.first : "", v.firstLen);
+  if (v.secondLen) s.append(v.second, v.secondLen);
+  return s;
+}
+
+std::string randomLine(std::mt19937& rng, size_t maxLen) {
+  const size_t len = rng() % (maxLen + 1);
+  std::string s;
+  for (size_t i = 0; i < len; ++i) s += static_cast<char>('a' + rng() % 26);
+  return s;
+}
+
+void appendBoth(const std::string& line) {
+  ring->append(line.c_str(), line.size());
+  model.append(line);
+}
+
+void assertMatchesModel() {
+  TEST_ASSERT_EQUAL_STRING(model.text().c_str(), text(ring->view()).c_str());
+  TEST_ASSERT_EQUAL_UINT32(model.lines.size(), ring->lines());
+  TEST_ASSERT_EQUAL_UINT32(model.bytes, ring->sizeBytes());
+  TEST_ASSERT_EQUAL_UINT32(model.appends, ring->lastSeq());
+  TEST_ASSERT_EQUAL_UINT32(model.appends - model.lines.size() + 1, ring->firstSeq());
+}
+
+}  // namespace
+
+void setUp() {
+  ring = new RingLogger<N>();
+  model = Model();
+}
+
+void tearDown() {
+  delete ring;
+}
+
+void test_wrap_and_evict_follow_the_model() {
+  std::mt19937 rng(20);
+  bool wrapped = false;
+  for (int i = 0; i < 20000; ++i) {
+    // Mostly log-sized lines, some empty, some short, a few over N.
+    const uint32_t kind = rng() % 100;
+    const size_t maxLen = kind < 3 ? 2 * N : (kind < 20 ? 8 : 120);
+    std::string line = randomLine(rng, maxLen);
+    if (kind % 7 == 0) line += '\n';
+    appendBoth(line);
+    assertMatchesModel();
+    if (ring->view().secondLen) wrapped = true;
+  }
+  TEST_ASSERT_TRUE(wrapped);
+}
+
+void test_oversize_line_is_cut_and_kept_alone() {
+  appendBoth("first");
+  const std::string big(3 * N, 'x');
+  appendBoth(big);
+  assertMatchesModel();
+  TEST_ASSERT_EQUAL_UINT32(1, ring->lines());
+  TEST_ASSERT_EQUAL_UINT32(N, ring->sizeBytes());
+  const std::string kept = text(ring->view());
+  TEST_ASSERT_EQUAL_INT('\n', kept.back());
+}
+
+void test_short_lines_are_capped_at_max_lines() {
+  for (int i = 0; i < 500; ++i) appendBoth("x");
+  assertMatchesModel();
+  TEST_ASSERT_EQUAL_UINT32(RingLogger<N>::MAX_LINES, ring->lines());
+  TEST_ASSERT_EQUAL_UINT32(500 - RingLogger<N>::MAX_LINES + 1, ring->firstSeq());
+}
+
+void test_clear_keeps_the_numbering() {
+  appendBoth("one");
+  appendBoth("two");
+  ring->clear();
+  TEST_ASSERT_EQUAL_UINT32(0, ring->view().size());
+  TEST_ASSERT_EQUAL_UINT32(3, ring->firstSeq());
+  ring->append("three", 5);
+  TEST_ASSERT_EQUAL_UINT32(3, ring->lastSeq());
+  TEST_ASSERT_EQUAL_STRING("three\n", text(ring->view()).c_str());
+}
+
+void test_view_from_pages_add_up_to_the_ring() {
+  std::mt19937 rng(23);
+  const size_t budgets[] = {1, 40, 100, 256};
+  for (int round = 0; round < 300; ++round) {
+    for (int k = rng() % 12; k >= 0; --k) appendBoth(randomLine(rng, 90));
+    for (size_t budget : budgets) {
+      std::string paged;
+      uint32_t since = 0;
+      uint32_t expectFirst = ring->firstSeq();
+      for (;;) {
+        uint32_t first = 0, last = 0;
+        const LogSpans page = ring->viewFrom(since, budget, &first, &last);
+        if (!page.size()) {
+          TEST_ASSERT_EQUAL_UINT32(first - 1, last);
+          break;
+        }
+        TEST_ASSERT_EQUAL_UINT32(expectFirst, first);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(first, last);
+        // Whole lines, within budget unless one line alone exceeds it.
+        const std::string p = text(page);
+        const size_t from = first - ring->firstSeq();
+        const size_t to = last - ring->firstSeq() + 1;
+        TEST_ASSERT_EQUAL_STRING(model.text(from, to).c_str(), p.c_str());
+        if (last > first) TEST_ASSERT_LESS_OR_EQUAL_UINT32(budget, p.size());
+        paged += p;
+        since = last + 1;
+        expectFirst = since;
+      }
+      TEST_ASSERT_EQUAL_STRING(text(ring->view()).c_str(), paged.c_str());
+    }
+  }
+}
+
+void test_view_from_clamps_and_reports_nothing_new() {
+  for (int i = 0; i < 200; ++i) appendBoth("line " + std::to_string(i));
+  TEST_ASSERT_GREATER_THAN_UINT32(1, ring->firstSeq());
+
+  // Older than the ring: starts at the oldest kept line.
+  uint32_t first = 0, last = 0;
+  LogSpans v = ring->viewFrom(1, 4096, &first, &last);
+  TEST_ASSERT_EQUAL_UINT32(ring->firstSeq(), first);
+  TEST_ASSERT_EQUAL_UINT32(ring->lastSeq(), last);
+  TEST_ASSERT_EQUAL_STRING(text(ring->view()).c_str(), text(v).c_str());
+
+  // Only the newest line.
+  v = ring->viewFrom(ring->lastSeq(), 4096, &first, &last);
+  TEST_ASSERT_EQUAL_STRING("line 199\n", text(v).c_str());
+  TEST_ASSERT_EQUAL_UINT32(200, first);
+  TEST_ASSERT_EQUAL_UINT32(200, last);
+
+  // Caught up: empty, last = since - 1.
+  v = ring->viewFrom(ring->lastSeq() + 1, 4096, &first, &last);
+  TEST_ASSERT_EQUAL_UINT32(0, v.size());
+  TEST_ASSERT_EQUAL_UINT32(201, first);
+  TEST_ASSERT_EQUAL_UINT32(200, last);
+
+  // Empty ring.
+  RingLogger<N> empty;
+  v = empty.viewFrom(0, 4096, &first, &last);
+  TEST_ASSERT_EQUAL_UINT32(0, v.size());
+  TEST_ASSERT_EQUAL_UINT32(1, first);
+  TEST_ASSERT_EQUAL_UINT32(0, last);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_wrap_and_evict_follow_the_model);
+  RUN_TEST(test_oversize_line_is_cut_and_kept_alone);
+  RUN_TEST(test_short_lines_are_capped_at_max_lines);
+  RUN_TEST(test_clear_keeps_the_numbering);
+  RUN_TEST(test_view_from_pages_add_up_to_the_ring);
+  RUN_TEST(test_view_from_clamps_and_reports_nothing_new);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <unity.h>
+#include <memory>
+#include <random>
+#include "ClickRig.h"
+#include "SpeedEstimator.h"
+
+// Speed estimate against a simulated motor: a few slow spin-up clicks, then
+// cruise with +-5 % interval jitter. Fed per edge (ISR) or in drain batches
+// sharing one timestamp (PCNT), the cruise estimate must be within 2 %.
+
+namespace {
+
+constexpr float MAX_ERR = 0.02f;
+constexpr uint32_t PCNT_DRAIN_US = 150000;
+
+std::mt19937 rng(3);
+
+// One run of `clicks` clicks at `periodUs`; returns the estimated click rate.
+float runMotor(SpeedEstimator& s, uint32_t periodUs, int clicks, bool batched) {
+  std::uniform_int_distribution<uint32_t> jitter(0, periodUs / 10);
+  s.restart();
+  uint32_t t = 0, lastDrain = 0;
+  uint16_t pending = 0;
+  for (int c = 0; c < clicks; ++c) {
+    // Spin-up: the first clicks take 3x, 2.5x, ... the cruise period.
+    const uint32_t iv = c < 5 ? periodUs * (6 - c) / 2 : periodUs + jitter(rng) - periodUs / 20;
+    t += iv;
+    ++pending;
+    if (!batched || t - lastDrain >= PCNT_DRAIN_US) {
+      s.addClicks(t, pending);
+      pending = 0;
+      lastDrain = t;
+    }
+  }
+  return s.clicksPerSecond();
+}
+
+std::unique_ptr<ClickCounter> counter;
+
+}  // namespace
+
+void setUp() {
+  hostfake::reset();
+}
+
+void tearDown() {
+  counter.reset();
+}
+
+void test_per_edge_estimate_within_two_percent() {
+  const uint32_t periods[] = {40000, 50000, 100000, 200000, 400000};
+  for (uint32_t p : periods) {
+    for (int trial = 0; trial < 20; ++trial) {
+      SpeedEstimator s;
+      const float truth = 1e6f / static_cast<float>(p);
+      TEST_ASSERT_FLOAT_WITHIN(truth * MAX_ERR, truth, runMotor(s, p, 60, false));
+    }
+  }
+}
+
+void test_batched_estimate_within_two_percent() {
+  const uint32_t periods[] = {40000, 50000, 100000, 200000, 400000};
+  for (uint32_t p : periods) {
+    for (int trial = 0; trial < 20; ++trial) {
+      SpeedEstimator s;
+      const float truth = 1e6f / static_cast<float>(p);
+      TEST_ASSERT_FLOAT_WITHIN(truth * MAX_ERR, truth, runMotor(s, p, 80, true));
+    }
+  }
+}
+
+void test_restart_ignores_the_gap_between_runs() {
+  SpeedEstimator s;
+  runMotor(s, 100000, 60, false);
+  const uint32_t before = s.intervalUs();
+  // A new run a minute later, straight at cruise speed: neither the gap
+  // nor the first (spin-up) window may move the estimate.
+  s.restart();
+  uint32_t t = 60000000;
+  for (uint16_t c = 0; c <= SpeedEstimator::WINDOW_CLICKS; ++c, t += 50000) s.addClicks(t, 1);
+  TEST_ASSERT_EQUAL_UINT32(before, s.intervalUs());
+  for (int c = 0; c < 60; ++c, t += 100000) s.addClicks(t, 1);
+  TEST_ASSERT_UINT32_WITHIN(100000 * MAX_ERR, 100000, s.intervalUs());
+}
+
+void test_estimate_follows_a_speed_change() {
+  SpeedEstimator s;
+  runMotor(s, 100000, 60, false);
+  const float est = runMotor(s, 50000, 100, false);
+  TEST_ASSERT_FLOAT_WITHIN(20.0f * MAX_ERR, 20.0f, est);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(50000 / 10, s.deviationUs());
+}
+
+void test_counter_reports_speed_and_eta() {
+  seedEnd(1000);
+  counter.reset(new ClickCounter());
+  counter->begin(PIN_CLICK_IN, false);
+  counter->setMotion(MotionState::CLOSING);
+  spin(*counter, 10000);
+  for (int i = 0; i < 80; ++i) click(*counter, 40000, PIN_CLICK_IN);
+
+  TEST_ASSERT_FLOAT_WITHIN(25.0f * MAX_ERR, 25.0f, counter->speedCps(MotionState::CLOSING));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, counter->speedCps(MotionState::OPENING));
+  const uint32_t eta = (1000 - counter->position()) * 40;
+  TEST_ASSERT_UINT32_WITHIN(eta / 50, eta, counter->etaMs());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_per_edge_estimate_within_two_percent);
+  RUN_TEST(test_batched_estimate_within_two_percent);
+  RUN_TEST(test_restart_ignores_the_gap_between_runs);
+  RUN_TEST(test_estimate_follows_a_speed_change);
+  RUN_TEST(test_counter_reports_speed_and_eta);
+  return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <random>
+#include "SpeedEstimator.h"
+#include "StallDetector.h"
+
+// Stall detection on a simulated drive with a 1 ms loop, fed by the speed
+// estimate the way main.cpp's checkStall() does: a jam or a dead sensor
+// must trip within the limit, jitter, a slow-down and a single lost click
+// must not.
+
+namespace {
+
+constexpr uint32_t FALLBACK_MS = 5000;   // main.cpp NO_CLICK_PANIC_WINDOW_MS
+constexpr uint32_t RUN_MS = 20000;
+constexpr uint32_t NEVER = UINT32_MAX;
+
+struct Drive {
+  uint32_t periodMs = 200;
+  uint32_t stopAtMs = NEVER;     // clicks cease (jam or sensor lost)
+  uint32_t skipAtMs = NEVER;     // one click goes missing
+  int jitterPct = 0;             // +- per click
+  bool slowDown = false;         // period grows to 2x over the run
+  bool warm = true;              // estimator has a previous run
+};
+
+struct Result {
+  uint32_t tripMs = NEVER;
+  bool progress = false;
+  uint32_t limitMs = 0;
+};
+
+Result drive(const Drive& d, float factor = StallDetector::DEFAULT_FACTOR) {
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> jitter(-d.jitterPct, d.jitterPct);
+  SpeedEstimator speed;
+  StallDetector stall;
+  stall.setFactor(factor);
+
+  if (d.warm) {
+    uint32_t t = 0;
+    for (int i = 0; i < 40; ++i) speed.addClicks(t += d.periodMs * 1000, 1);
+    speed.restart();
+  }
+
+  int32_t pos = 0;
+  uint32_t next = d.periodMs * 2;  // spin-up
+  bool skipped = false;
+  stall.start(0, pos, FALLBACK_MS);
+  Result r;
+  for (uint32_t now = 0; now < RUN_MS; ++now) {
+    if (now >= next && now < d.stopAtMs) {
+      if (now >= d.skipAtMs && !skipped) {
+        skipped = true;
+      } else {
+        ++pos;
+        speed.addClicks(now * 1000, 1);
+      }
+      uint32_t p = d.periodMs;
+      if (d.slowDown) p += d.periodMs * now / RUN_MS;
+      next = now + p + static_cast<int32_t>(p) * jitter(rng) / 100;
+    }
+    if (stall.update(now, pos, speed.intervalUs(), speed.deviationUs())) {
+      r.tripMs = now;
+      r.progress = stall.sawProgress();
+      r.limitMs = stall.limitMs();
+      break;
+    }
+  }
+  return r;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_steady_run_never_trips() {
+  const uint32_t periods[] = {50, 100, 200, 400};
+  for (uint32_t p : periods) {
+    Drive d;
+    d.periodMs = p;
+    TEST_ASSERT_EQUAL_UINT32(NEVER, drive(d).tripMs);
+  }
+}
+
+void test_jam_trips_within_the_limit() {
+  const uint32_t periods[] = {50, 100, 200, 400};
+  for (uint32_t p : periods) {
+    Drive d;
+    d.periodMs = p;
+    d.stopAtMs = 3000;
+    Result r = drive(d);
+    TEST_ASSERT_NOT_EQUAL(NEVER, r.tripMs);
+    TEST_ASSERT_TRUE(r.progress);
+    // Not before the factor has passed, and within it plus one period.
+    uint32_t limit = p * 3 < StallDetector::MIN_LIMIT_MS ? StallDetector::MIN_LIMIT_MS : p * 3;
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(limit, r.tripMs - (d.stopAtMs - p));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(limit + p, r.tripMs - d.stopAtMs);
+  }
+}
+
+void test_dead_sensor_trips_before_the_fallback() {
+  // No click at all after the relays close: with a learned speed the
+  // limit is the spin-up allowance on top, well under the fixed window.
+  Drive d;
+  d.stopAtMs = 0;
+  Result r = drive(d);
+  TEST_ASSERT_FALSE(r.progress);
+  TEST_ASSERT_EQUAL_UINT32(3 * d.periodMs + StallDetector::SPINUP_MS + 1, r.tripMs);
+
+  // First run ever: nothing learned, the fixed window applies.
+  d.warm = false;
+  r = drive(d);
+  TEST_ASSERT_FALSE(r.progress);
+  TEST_ASSERT_EQUAL_UINT32(FALLBACK_MS + 1, r.tripMs);
+}
+
+void test_single_lost_click_does_not_trip() {
+  Drive d;
+  d.skipAtMs = 4000;
+  TEST_ASSERT_EQUAL_UINT32(NEVER, drive(d).tripMs);
+}
+
+void test_jitter_and_slowdown_do_not_trip() {
+  Drive jitter;
+  jitter.jitterPct = 20;
+  TEST_ASSERT_EQUAL_UINT32(NEVER, drive(jitter).tripMs);
+
+  Drive slow;
+  slow.slowDown = true;
+  TEST_ASSERT_EQUAL_UINT32(NEVER, drive(slow).tripMs);
+}
+
+void test_noisy_cover_widens_the_limit() {
+  // +-60 % jitter at the smallest factor: the spread term has to carry it.
+  Drive d;
+  d.jitterPct = 60;
+  TEST_ASSERT_EQUAL_UINT32(NEVER, drive(d, StallDetector::MIN_FACTOR).tripMs);
+
+  d.stopAtMs = 5000;
+  Result r = drive(d, StallDetector::MIN_FACTOR);
+  TEST_ASSERT_NOT_EQUAL(NEVER, r.tripMs);
+  TEST_ASSERT_GREATER_THAN_UINT32(static_cast<uint32_t>(d.periodMs * StallDetector::MIN_FACTOR),
+                                  r.limitMs);
+}
+
+void test_factor_is_clamped() {
+  StallDetector s;
+  s.setFactor(0.5f);
+  TEST_ASSERT_EQUAL_FLOAT(StallDetector::MIN_FACTOR, s.factor());
+  s.setFactor(50.0f);
+  TEST_ASSERT_EQUAL_FLOAT(StallDetector::MAX_FACTOR, s.factor());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_steady_run_never_trips);
+  RUN_TEST(test_jam_trips_within_the_limit);
+  RUN_TEST(test_dead_sensor_trips_before_the_fallback);
+  RUN_TEST(test_single_lost_click_does_not_trip);
+  RUN_TEST(test_jitter_and_slowdown_do_not_trip);
+  RUN_TEST(test_noisy_cover_widens_the_limit);
+  RUN_TEST(test_factor_is_clamped);
+  return UNITY_END();
+}
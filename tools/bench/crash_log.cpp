@@ -0,0 +1,55 @@
+// What CrashLog::append adds to every kept log line, next to the
+// RingLogger append it sits beside in netLogLine(), over the lines of
+// sample.log. The correctness side (what survives which reset) is
+// test/test_crash_log.
+//
+//   g++ -std=gnu++17 -O2 -I test/support -I src tools/bench/crash_log.cpp -o /tmp/crash_log
+//   /tmp/crash_log tools/bench/sample.log        (from the project root)
+#include <Arduino.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <CrashLog.h>
+#include <RingLogger.h>
+
+namespace {
+
+constexpr int APPENDS = 2000000;
+
+template <typename Fn>
+double nsPerLine(const std::vector<std::string>& lines, Fn fn) {
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < APPENDS; ++i) fn(lines[i % lines.size()]);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / APPENDS;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::ifstream f(argc > 1 ? argv[1] : "tools/bench/sample.log");
+  std::vector<std::string> lines;
+  for (std::string s; std::getline(f, s);) lines.push_back(s);
+  if (lines.empty()) {
+    fprintf(stderr, "no input lines\n");
+    return 1;
+  }
+  size_t bytes = 0;
+  for (const std::string& l : lines) bytes += l.size();
+
+  static CrashLog crash;
+  static RingLogger<8192> ring;
+  crash.begin(ESP_RST_POWERON);
+
+  const double loop = nsPerLine(lines, [](const std::string& l) { asm volatile("" ::"r"(l.data()) : "memory"); });
+  const double ringNs = nsPerLine(lines, [](const std::string& l) { ring.append(l.c_str(), l.size()); });
+  const double crashNs = nsPerLine(lines, [](const std::string& l) { crash.append(l.c_str(), l.size(), 7); });
+
+  CrashLog next;
+  next.begin(ESP_RST_SW);
+  printf("%zu lines, %zu B average, %d appends each\n", lines.size(), bytes / lines.size(), APPENDS);
+  printf("RingLogger::append  %.1f ns/line\n", ringNs - loop);
+  printf("CrashLog::append    %.1f ns/line\n", crashNs - loop);
+  printf("kept after a software reset: %zu B of %zu\n", next.previousLen(), CrashLog::BYTES);
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Broker traffic of log_blob over a simulated day: full-ring snapshots
+// (before) against sequence-numbered deltas from viewFrom() (after), on
+// the same 1.5 s cadence and reconnects. Then pages the ring through
+// log_fetch-sized viewFrom() calls and compares with view().
+//
+// The day: 30 boot lines, four 90 s cover runs of 25 lines, a line every
+// 10 minutes and three reconnects of 4 lines each.
+//
+//   g++ -std=gnu++17 -O2 -I test/support -I src tools/bench/log_blob_day.cpp -o /tmp/log_blob_day
+//   /tmp/log_blob_day
+#include <Arduino.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <RingLogger.h>
+
+namespace {
+
+constexpr uint32_t DAY_MS = 86400000u;
+constexpr uint32_t HOUR_MS = 3600000u;
+constexpr uint32_t SNAPSHOT_MS = 1500;
+constexpr size_t BLOB_MAX_BYTES = 1024;
+constexpr size_t FETCH_BYTES = 512;
+// Topic plus MQTT fixed header and length bytes.
+const size_t PUBLISH_OVERHEAD = strlen("poolcover/tele/log_blob") + 5;
+
+struct Line {
+  uint32_t ms;
+  std::string text;
+};
+
+std::string make(const char* tag, size_t len) {
+  std::string s = tag;
+  while (s.size() < len) s += static_cast<char>('a' + rand() % 26);
+  return s;
+}
+
+}  // namespace
+
+int main() {
+  srand(11);
+  std::vector<Line> day;
+  for (uint32_t i = 0; i < 30; ++i) day.push_back({i * 200, make("[BOOT] ", 40 + rand() % 40)});
+  const uint32_t runs[] = {8 * HOUR_MS, 12 * HOUR_MS, 15 * HOUR_MS, 20 * HOUR_MS};
+  for (uint32_t r : runs) {
+    for (uint32_t i = 0; i < 25; ++i) day.push_back({r + i * 90000 / 25, make("[CTRL] ", 30 + rand() % 60)});
+  }
+  for (uint32_t t = 0; t < DAY_MS; t += 600000u) day.push_back({t + 1234, make("[MQTT] ", 45)});
+  const uint32_t reconnects[] = {3 * HOUR_MS, 10 * HOUR_MS, 18 * HOUR_MS};
+  for (uint32_t r : reconnects) {
+    for (uint32_t i = 0; i < 4; ++i) day.push_back({r + i * 500, make("[WIFI] ", 50)});
+  }
+  std::stable_sort(day.begin(), day.end(), [](const Line& a, const Line& b) { return a.ms < b.ms; });
+
+  static RingLogger<8192> ring;
+  size_t bytesBefore = 0, bytesAfter = 0, pubsBefore = 0, pubsAfter = 0;
+  uint32_t lastBefore = 0, lastAfter = 0, blobSeq = 0;
+  bool first = true;
+  size_t next = 0;
+  for (uint32_t now = 0; now < DAY_MS; now += 10) {  // network passes
+    while (next < day.size() && day[next].ms <= now) {
+      const std::string& l = day[next++].text;
+      ring.append(l.c_str(), l.size());
+      // Before: the whole ring, from the log call, at most every 1.5 s.
+      if (first || now - lastBefore >= SNAPSHOT_MS) {
+        first = false;
+        lastBefore = now;
+        bytesBefore += ring.sizeBytes() + PUBLISH_OVERHEAD;
+        ++pubsBefore;
+      }
+    }
+    bool reconnect = false;
+    for (uint32_t r : reconnects) reconnect |= now == r + 3000;
+    if (reconnect) {
+      bytesBefore += ring.sizeBytes() + PUBLISH_OVERHEAD;
+      ++pubsBefore;
+    }
+    // After: what is new since the last publish, under an "@first-last newest" header.
+    if (ring.lastSeq() != blobSeq && (now - lastAfter >= SNAPSHOT_MS || reconnect)) {
+      lastAfter = now;
+      uint32_t from, to;
+      const LogSpans v = ring.viewFrom(blobSeq + 1, BLOB_MAX_BYTES, &from, &to);
+      char header[40];
+      const int h = snprintf(header, sizeof(header), "@%u-%u %u\n", from, to, ring.lastSeq());
+      bytesAfter += h + v.size() + PUBLISH_OVERHEAD;
+      ++pubsAfter;
+      blobSeq = to;
+    }
+  }
+  printf("day: %zu lines\n", day.size());
+  printf("before: %zu publishes, %zu B/day, %.0f B/hour\n", pubsBefore, bytesBefore, bytesBefore / 24.0);
+  printf("after:  %zu publishes, %zu B/day, %.0f B/hour (%.0fx less)\n", pubsAfter, bytesAfter, bytesAfter / 24.0,
+         static_cast<double>(bytesBefore) / bytesAfter);
+
+  // log_fetch: page the ring FETCH_BYTES at a time.
+  const LogSpans all = ring.view();
+  std::string whole(all.first, all.firstLen), paged;
+  if (all.secondLen) whole.append(all.second, all.secondLen);
+  uint32_t since = 0;
+  int pages = 0;
+  bool overBudget = false;
+  for (;;) {
+    uint32_t from, to;
+    const LogSpans p = ring.viewFrom(since, FETCH_BYTES, &from, &to);
+    if (!p.size()) break;
+    overBudget |= p.size() > FETCH_BYTES && to > from;
+    paged.append(p.first, p.firstLen);
+    if (p.secondLen) paged.append(p.second, p.secondLen);
+    since = to + 1;
+    ++pages;
+  }
+  const bool ok = paged == whole && !overBudget;
+  printf("log_fetch: %d pages of <= %zu B over seq %u-%u, %s\n", pages, FETCH_BYTES, ring.firstSeq(), ring.lastSeq(),
+         ok ? "matches the ring" : "MISMATCH");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// LogLz on a full 8 KB ring of log text: compression ratio and encode
+// time per snapshot at several wrap points, and a round trip of each
+// snapshot through tools/decode_log_snapshot.py (python3 on the PATH).
+//
+// sample.log is synthetic, built from the firmware's own line formats
+// (connects, HA and wall runs, relay actions, traces, coast reports).
+//
+//   g++ -std=gnu++17 -O2 -I test/support -I src tools/bench/log_codec.cpp -o /tmp/log_codec
+//   /tmp/log_codec tools/bench/sample.log        (from the project root)
+#include <Arduino.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <LogCodec.h>
+#include <RingLogger.h>
+
+namespace {
+
+std::vector<uint8_t> out;
+
+void sink(void*, const uint8_t* data, size_t len) { out.insert(out.end(), data, data + len); }
+
+// Decodes `snapshot` with the Python tool; true if it gives back `raw`.
+bool pythonRoundTrip(const std::vector<uint8_t>& snapshot, const std::string& raw) {
+  const char* path = "/tmp/log_codec_snapshot.lgz";
+  std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+  FILE* p = popen("python3 tools/decode_log_snapshot.py /tmp/log_codec_snapshot.lgz 2>/dev/null", "r");
+  if (!p) return false;
+  std::string decoded;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), p)) > 0) decoded.append(buf, n);
+  return pclose(p) == 0 && decoded == raw;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::ifstream f(argc > 1 ? argv[1] : "tools/bench/sample.log");
+  std::vector<std::string> lines;
+  for (std::string s; std::getline(f, s);) lines.push_back(s);
+  if (lines.empty()) {
+    fprintf(stderr, "no input lines\n");
+    return 1;
+  }
+
+  static LogLz lz;
+  bool ok = true;
+  // From just full to well past the first wrap.
+  for (size_t feed : {lines.size(), size_t(300), size_t(450), size_t(777)}) {
+    static RingLogger<8192> ring;
+    ring.clear();
+    for (size_t i = 0; i < feed; ++i) {
+      const std::string& l = lines[i % lines.size()];
+      ring.append(l.c_str(), l.size());
+    }
+    const LogSpans v = ring.view();
+    std::string raw(v.first, v.firstLen);
+    if (v.secondLen) raw.append(v.second, v.secondLen);
+
+    const size_t counted = lz.encode(v.first, v.firstLen, v.second, v.secondLen, nullptr, nullptr);
+    constexpr int REPS = 200;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; ++r) lz.encode(v.first, v.firstLen, v.second, v.secondLen, nullptr, nullptr);
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / REPS;
+
+    out.assign(LogLz::HEADER_BYTES, 0);
+    LogLz::header(out.data(), static_cast<uint32_t>(v.size()), ring.firstSeq(), ring.lastSeq());
+    const size_t sent = lz.encode(v.first, v.firstLen, v.second, v.secondLen, sink, nullptr);
+    const bool python = pythonRoundTrip(out, raw);
+    ok &= python && counted == sent;
+    printf("%4zu lines fed: %4zu B (%zu+%zu) -> %4zu B, %.2fx, encode %3.0f us, counted==sent %d, python %s\n", feed,
+           v.size(), v.firstLen, v.secondLen, out.size(), static_cast<double>(v.size()) / out.size(), us,
+           counted == sent, python ? "ok" : "MISMATCH");
+  }
+  printf("sizeof(LogLz) %zu B\n", sizeof(LogLz));
+  return ok ? 0 : 1;
+}
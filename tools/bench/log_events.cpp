@@ -0,0 +1,151 @@
+// Control-side cost of a log line: a String built and copied into a
+// LogEvent against a LogRecord, both through their mailbox (enqueue plus
+// dequeue), then the consumer-side format() of a record. Last, the two
+// queues fed from a producer thread and merged back by LogMerge, counting
+// lines that come out of order.
+//
+//   g++ -std=gnu++17 -O2 -pthread -I test/support -I src -I include tools/bench/log_events.cpp -o /tmp/log_events
+//   /tmp/log_events
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <ControlLink.h>
+#include <LogMerge.h>
+
+namespace {
+
+size_t allocations = 0;
+size_t allocatedBytes = 0;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+void bench(const char* name, F f, int n = 1000000) {
+  allocations = 0;
+  allocatedBytes = 0;
+  const Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < n; ++i) f(i);
+  const double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+  printf("%-32s %7.1f ns/event  %5.2f allocs/event  %6.1f heap B/event\n", name, ns,
+         static_cast<double>(allocations) / n, static_cast<double>(allocatedBytes) / n);
+}
+
+const char* const labels[3] = {"Idle", "Opening", "Closing"};
+
+}  // namespace
+
+void* operator new(size_t n) {
+  ++allocations;
+  allocatedBytes += n;
+  void* p = malloc(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main() {
+  static Mailbox<LogEvent, 32> textBox;
+  static Mailbox<LogRecord, 64> eventBox;
+  volatile int sink = 0;
+  printf("sizeof LogEvent %zu, LogRecord %zu (host pointers)\n", sizeof(LogEvent), sizeof(LogRecord));
+
+  bench("String + LogEvent (CTRL)", [&](int i) {
+    LogEvent ev;
+    ev.set(String(F("[CTRL] Commanded motion -> ")) + labels[i % 3]);
+    textBox.push(ev);
+    LogEvent out{};
+    textBox.pop(&out);
+    sink = sink + out.text[3];
+  });
+  bench("LogRecord (CTRL)", [&](int i) {
+    eventBox.push(LogRecord(LogId::CTRL_COMMANDED, {labels[i % 3]}));
+    LogRecord out;
+    eventBox.pop(&out);
+    sink = sink + out.argc;
+  });
+  bench("String + LogEvent (overshoot)", [&](int i) {
+    String msg;
+    msg.reserve(80);
+    msg += F("[CLICK] Motion overshoot detected (pos=");
+    msg += i;
+    msg += F(", end=");
+    msg += 4000;
+    msg += F(")");
+    LogEvent ev;
+    ev.set(msg);
+    textBox.push(ev);
+    LogEvent out{};
+    textBox.pop(&out);
+    sink = sink + out.text[3];
+  });
+  bench("LogRecord (overshoot)", [&](int i) {
+    eventBox.push(LogRecord(LogId::CLICK_OVERSHOOT, {i, 4000}));
+    LogRecord out;
+    eventBox.pop(&out);
+    sink = sink + out.argc;
+  });
+  const LogRecord overshoot(LogId::CLICK_OVERSHOOT, {-3, 4000});
+  char buf[sizeof(LogEvent::text)];
+  bench("format() on consume (overshoot)", [&](int) { sink = sink + static_cast<int>(overshoot.format(buf, sizeof(buf))); });
+
+  // Merge order with the producer on another thread, as logLine() and
+  // logEvent() feed the queues and drainLogs() empties them.
+  constexpr uint32_t RECORDS = 200000;
+  static LogMerge merge;
+  std::atomic<bool> done{false};
+  uint16_t seq = 0;
+  std::thread control([&] {
+    uint32_t logged = 0;
+    while (logged < RECORDS) {
+      bool ok;
+      if (logged % 3 == 0) {
+        LogEvent ev;
+        ev.seq = seq;
+        snprintf(ev.text, sizeof(ev.text), "%lu", static_cast<unsigned long>(logged));
+        ok = textBox.push(ev);
+      } else {
+        LogRecord r(LogId::CLICK_OVERSHOOT, {static_cast<int32_t>(logged), 0});
+        r.seq = seq;
+        ok = eventBox.push(r);
+      }
+      if (ok) {
+        ++seq;
+        ++logged;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    done.store(true);
+  });
+  uint32_t next = 0, outOfOrder = 0;
+  while (!done.load() || !textBox.empty() || !eventBox.empty()) {
+    for (;;) {
+      const LogEvent* text = textBox.peek();
+      const LogRecord* event = eventBox.peek();
+      const LogMerge::Take take = merge.next(text ? &text->seq : nullptr, event ? &event->seq : nullptr);
+      if (take == LogMerge::Take::NONE) break;
+      uint32_t n;
+      if (take == LogMerge::Take::TEXT) {
+        LogEvent ev;
+        textBox.pop(&ev);
+        n = strtoul(ev.text, nullptr, 10);
+      } else {
+        LogRecord r;
+        eventBox.pop(&r);
+        n = static_cast<uint32_t>(r.args[0].i);
+      }
+      if (n != next) ++outOfOrder;
+      next = n + 1;
+    }
+    std::this_thread::yield();
+  }
+  control.join();
+  printf("merge: %lu records from a producer thread, %lu out of order, %lu heads skipped\n",
+         static_cast<unsigned long>(next), static_cast<unsigned long>(outOfOrder),
+         static_cast<unsigned long>(merge.skips()));
+  return outOfOrder ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+// Control-pass time under a log storm: 10 lines per 5 ms pass for 2 s,
+// printed inline with a blocking println against a modelled 115200-baud
+// UART (128-byte TX FIFO), then pushed as LogRecords and drained by a
+// network thread through LogDrain. Reports pass times and the drop and
+// high-water counters of the queue and both drain buffers.
+//
+//   g++ -std=gnu++17 -O2 -pthread -I test/support -I src -I include tools/bench/log_storm.cpp -o /tmp/log_storm
+//   /tmp/log_storm
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+Clock::time_point t0 = Clock::now();
+
+double nowUs() { return std::chrono::duration<double, std::micro>(Clock::now() - t0).count(); }
+
+// The UART: 11.52 bytes per ms leave a 128-byte FIFO.
+struct FakeUart {
+  std::atomic<double> emptyAtUs{0};
+
+  int availableForWrite() {
+    double backlog = (emptyAtUs.load() - nowUs()) * 0.01152;
+    if (backlog < 0) backlog = 0;
+    return 128 - static_cast<int>(backlog);
+  }
+  size_t write(const uint8_t*, size_t n) {
+    const double start = std::max(emptyAtUs.load(), nowUs());
+    emptyAtUs = start + n / 0.01152;
+    return n;
+  }
+  // Arduino's println waits until the FIFO takes the whole line.
+  void println(const char* s) {
+    const size_t n = strlen(s) + 2;
+    while (availableForWrite() < static_cast<int>(std::min<size_t>(n, 128))) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    write(nullptr, n);
+  }
+};
+
+FakeUart uart;
+
+}  // namespace
+
+#define Serial uart
+#include <LogDrain.h>
+#undef Serial
+#include <ControlLink.h>
+
+namespace {
+
+constexpr int PASSES = 400;
+constexpr int LINES = 10;
+
+void tick() { hostfake::nowUs = static_cast<uint64_t>(nowUs()); }
+
+void report(const char* name, std::vector<double>& d) {
+  std::sort(d.begin(), d.end());
+  printf("%-20s pass p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, d[d.size() / 2], d[d.size() * 99 / 100],
+         d.back());
+}
+
+}  // namespace
+
+int main() {
+  const char* const labels[2] = {"Closing", "Opening"};
+  {
+    std::vector<double> passes;
+    t0 = Clock::now();
+    for (int p = 0; p < PASSES; ++p) {
+      const double start = nowUs();
+      for (int i = 0; i < LINES; ++i) {
+        const String line = String("[CTRL] Commanded motion -> ") + labels[i & 1];
+        uart.println(line.c_str());
+      }
+      passes.push_back(nowUs() - start);
+      std::this_thread::sleep_until(t0 + std::chrono::microseconds((p + 1) * 5000));
+    }
+    report("inline println", passes);
+  }
+  {
+    static ControlLink link;
+    static LogDrain drain;
+    std::atomic<bool> stop{false};
+    uart.emptyAtUs = 0;
+    t0 = Clock::now();
+    std::thread net([&] {
+      while (!stop.load()) {
+        LogRecord r;
+        while (link.events.pop(&r)) {
+          char buf[sizeof(LogEvent::text)];
+          const size_t n = r.format(buf, sizeof(buf));
+          if (!drain.batchFits(n)) drain.batchSent();
+          drain.line(buf, n);
+        }
+        drain.pumpSerial();
+        if (drain.batchDue(millis())) drain.batchSent();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    });
+    std::vector<double> passes;
+    for (int p = 0; p < PASSES; ++p) {
+      tick();
+      const double start = nowUs();
+      for (int i = 0; i < LINES; ++i) link.events.push(LogRecord(LogId::CTRL_COMMANDED, {labels[i & 1]}));
+      passes.push_back(nowUs() - start);
+      std::this_thread::sleep_until(t0 + std::chrono::microseconds((p + 1) * 5000));
+    }
+    stop = true;
+    net.join();
+    report("queued + LogDrain", passes);
+    const LogDrain::Stats& s = drain.stats();
+    printf("  lines %u, queue drops %u, queue high water %u, serial drops %u, serial high water %u B,\n"
+           "  batches %u (max %u lines), batch drops %u\n",
+           s.lines, link.events.drops(), link.events.highWater(), s.serialDrops, s.serialHighWater, s.batches,
+           s.maxBatchLines, s.batchDrops);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+// RingLogger against the deque-of-lines logger it replaced: cost per
+// appended line with a snapshot every 50 lines, heap use, and whether the
+// two hold the same text.
+//
+//   g++ -std=gnu++17 -O2 -I test/support -I src tools/bench/ring_logger.cpp -o /tmp/ring_logger
+//   /tmp/ring_logger
+#include <Arduino.h>
+#include <malloc.h>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <vector>
+#include <RingLogger.h>
+
+namespace {
+
+size_t liveBytes = 0;
+size_t peakBytes = 0;
+size_t allocations = 0;
+
+// The previous RingLogger (std::string standing in for String).
+class DequeLogger {
+public:
+  explicit DequeLogger(size_t maxBytes) : _maxBytes(maxBytes) {}
+
+  void append(const std::string& line) {
+    std::string s = line;
+    if (s.empty() || s.back() != '\n') s += '\n';
+    const size_t len = s.size();
+    while (_totalBytes + len > _maxBytes && !_lines.empty()) {
+      _totalBytes -= _lines.front().size();
+      _lines.pop_front();
+    }
+    _lines.push_back(std::move(s));
+    _totalBytes += len;
+    _dirty = true;
+  }
+
+  std::string blob() {
+    if (!_dirty) return _cached;
+    std::string out;
+    out.reserve(_totalBytes + 16);
+    for (const std::string& l : _lines) out += l;
+    _cached = std::move(out);
+    _dirty = false;
+    return _cached;
+  }
+
+private:
+  std::deque<std::string> _lines;
+  size_t _maxBytes;
+  size_t _totalBytes = 0;
+  bool _dirty = true;
+  std::string _cached;
+};
+
+std::string text(const LogSpans& v) {
+  std::string s(v.first ? v.first : "", v.firstLen);
+  if (v.secondLen) s.append(v.second, v.secondLen);
+  return s;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double nsPerLine(Clock::time_point t0, int lines) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / lines;
+}
+
+}  // namespace
+
+void* operator new(size_t n) {
+  void* p = malloc(n);
+  if (!p) throw std::bad_alloc();
+  liveBytes += malloc_usable_size(p);
+  if (liveBytes > peakBytes) peakBytes = liveBytes;
+  ++allocations;
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  if (p) liveBytes -= malloc_usable_size(p);
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+int main() {
+  constexpr int LINES = 200000;
+  constexpr int SNAPSHOT_EVERY = 50;
+  static RingLogger<8192> ring;
+
+  srand(3);
+  std::vector<std::string> lines(1024);
+  for (std::string& l : lines) {
+    const size_t n = 20 + rand() % 100;
+    l = "[X] ";
+    while (l.size() < n) l += static_cast<char>('a' + rand() % 26);
+  }
+
+  int mismatches = 0;
+  {
+    DequeLogger old(8192);
+    for (int i = 0; i < 20000; ++i) {
+      old.append(lines[i & 1023]);
+      ring.append(lines[i & 1023].c_str(), lines[i & 1023].size());
+      if (i % 7 == 0 && old.blob() != text(ring.view())) ++mismatches;
+    }
+  }
+
+  volatile size_t sink = 0;
+  {
+    DequeLogger old(8192);
+    const size_t base = liveBytes;
+    peakBytes = liveBytes;
+    allocations = 0;
+    const Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < LINES; ++i) {
+      old.append(lines[i & 1023]);
+      if (i % SNAPSHOT_EVERY == 0) sink = sink + old.blob().size();
+    }
+    printf("deque of lines: %6.1f ns/line, peak heap %zu B, %zu allocations\n", nsPerLine(t0, LINES),
+           peakBytes - base, allocations);
+  }
+  {
+    ring.clear();
+    const size_t base = liveBytes;
+    peakBytes = liveBytes;
+    allocations = 0;
+    const Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < LINES; ++i) {
+      ring.append(lines[i & 1023].c_str(), lines[i & 1023].size());
+      if (i % SNAPSHOT_EVERY == 0) sink = sink + ring.view().size();
+    }
+    printf("RingLogger:     %6.1f ns/line, peak heap %zu B, %zu allocations (static %zu B)\n",
+           nsPerLine(t0, LINES), peakBytes - base, allocations, sizeof(ring));
+  }
+  printf("snapshot mismatches over 20000 appends: %d\n", mismatches);
+  return mismatches ? 1 : 0;
+}
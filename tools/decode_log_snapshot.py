@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Decode a compressed log snapshot published on <base>/tele/log_lz.
+
+    mosquitto_sub -h <broker> -t poolcover/tele/log_lz -C 1 > snap.bin
+    python3 tools/decode_log_snapshot.py snap.bin
+
+Reads stdin when no file is given. The format is described in
+src/LogCodec.h.
+"""
+import struct
+import sys
+
+
+def decode(data):
+    if len(data) < 16 or data[:4] != b"LGZ1":
+        raise ValueError("not a LGZ1 log snapshot")
+    raw_len, first_seq, last_seq = struct.unpack_from("<III", data, 4)
+    out = bytearray()
+    i = 16
+    while len(out) < raw_len:
+        if i >= len(data):
+            raise ValueError("truncated stream")
+        flags = data[i]
+        i += 1
+        for bit in range(8):
+            if len(out) >= raw_len:
+                break
+            if flags & (1 << bit):
+                b0, b1 = data[i], data[i + 1]
+                i += 2
+                dist = (b0 | (b1 >> 4) << 8) + 1
+                length = (b1 & 0x0F) + 3
+                if (b1 & 0x0F) == 15:
+                    length += data[i]
+                    i += 1
+                if dist > len(out):
+                    raise ValueError("match before start of data")
+                for _ in range(length):
+                    out.append(out[-dist])
+            else:
+                out.append(data[i])
+                i += 1
+    return first_seq, last_seq, bytes(out)
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    first_seq, last_seq, text = decode(data)
+    sys.stderr.write("lines %d-%d, %d -> %d bytes\n" % (first_seq, last_seq, len(data), len(text)))
+    sys.stdout.write(text.decode("utf-8", errors="replace"))
+
+
+if __name__ == "__main__":
+    main()